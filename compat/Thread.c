@@ -78,6 +78,9 @@
 extern "C" {
 #endif
 
+// signals the reporter thread, see src/main.cpp
+extern Condition ReportCond;
+
 #if HAVE_THREAD_DEBUG
 #include <time.h>
 #include <unistd.h>
@@ -355,6 +358,14 @@ thread_run_wrapper( void* paramPtr ) {
     Condition_Signal( &thread_sNum_cond );
     Condition_Unlock( thread_sNum_cond );
 
+    // The reporter exits once the traffic threads are gone, wake it
+    // rather than leave that to its timed wait
+    if ((thread->mThreadMode == kMode_Client) || (thread->mThreadMode == kMode_Server)) {
+	Condition_Lock( ReportCond );
+	Condition_Signal( &ReportCond );
+	Condition_Unlock( ReportCond );
+    }
+
     // Check if we need to start up a thread after executing this one
     if ( thread->runNext != NULL ) {
         thread_start( thread->runNext );
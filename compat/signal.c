@@ -52,6 +52,9 @@
 
 #include "headers.h"
 #include "util.h"
+#ifdef HAVE_FLOWTIMER
+#include <sys/syscall.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -158,6 +161,79 @@ SigfuncPtr my_signal( int inSigno, SigfuncPtr inFunc ) {
     }
 } /* end my_signal */
 
+#ifdef HAVE_FLOWTIMER
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+/* -------------------------------------------------------------------
+ * flowtimer_start
+ *
+ * arms a one shot timer at the absolute (CLOCK_REALTIME) deadline
+ * whose signal is delivered to the calling thread only.  The handler
+ * sets the timer's expired flag; it's installed without SA_RESTART
+ * so a blocked syscall is interrupted.  Returns 0 on success.
+ * ------------------------------------------------------------------- */
+
+static void flowtimer_handler( int inSigno, siginfo_t *inInfo, void *inContext ) {
+    (void) inSigno;
+    (void) inContext;
+    if ( inInfo->si_code == SI_TIMER && inInfo->si_value.sival_ptr != NULL ) {
+        ((flowtimer *) inInfo->si_value.sival_ptr)->expired = 1;
+    }
+}
+
+int flowtimer_start( flowtimer *inTimer, const struct timeval *inDeadline ) {
+    struct sigaction theAction;
+    struct sigevent sev;
+    struct itimerspec its;
+
+    inTimer->armed = 0;
+    inTimer->expired = 0;
+
+    memset( &theAction, 0, sizeof(theAction) );
+    theAction.sa_sigaction = flowtimer_handler;
+    theAction.sa_flags = SA_SIGINFO;
+    sigemptyset( &theAction.sa_mask );
+    if ( sigaction( SIGRTMIN, &theAction, NULL ) < 0 ) {
+        return -1;
+    }
+
+    memset( &sev, 0, sizeof(sev) );
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGRTMIN;
+    sev.sigev_value.sival_ptr = inTimer;
+    sev.sigev_notify_thread_id = syscall( SYS_gettid );
+    if ( timer_create( CLOCK_REALTIME, &sev, &inTimer->timer ) < 0 ) {
+        return -1;
+    }
+
+    memset( &its, 0, sizeof(its) );
+    its.it_value.tv_sec = inDeadline->tv_sec;
+    its.it_value.tv_nsec = inDeadline->tv_usec * 1000;
+    if ( timer_settime( inTimer->timer, TIMER_ABSTIME, &its, NULL ) < 0 ) {
+        timer_delete( inTimer->timer );
+        return -1;
+    }
+    inTimer->armed = 1;
+    return 0;
+} /* end flowtimer_start */
+
+/* -------------------------------------------------------------------
+ * flowtimer_stop
+ *
+ * disarms and deletes the timer, must be called by the arming thread
+ * before the flowtimer goes away
+ * ------------------------------------------------------------------- */
+
+void flowtimer_stop( flowtimer *inTimer ) {
+    if ( inTimer->armed ) {
+        timer_delete( inTimer->timer );
+        inTimer->armed = 0;
+    }
+} /* end flowtimer_stop */
+#endif /* HAVE_FLOWTIMER */
+
 #endif /* not WIN32 */
 
 /* -------------------------------------------------------------------
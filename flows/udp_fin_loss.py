@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+#
+# ---------------------------------------------------------------
+# * Copyright (c) 2020
+# * Broadcom Corporation
+# * All Rights Reserved.
+# *---------------------------------------------------------------
+# Redistribution and use in source and binary forms, with or without modification, are permitted
+# provided that the following conditions are met:
+#
+# Redistributions of source code must retain the above copyright notice, this list of conditions
+# and the following disclaimer.  Redistributions in binary form must reproduce the above copyright
+# notice, this list of conditions and the following disclaimer in the documentation and/or other
+# materials provided with the distribution.  Neither the name of the Broadcom nor the names of
+# contributors may be used to endorse or promote products derived from this software without
+# specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+# IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+# FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+# IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+# OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+# UDP end of test (FIN) teardown latency under loss, on the local host.
+#
+# The client talks to a local server through a relay that drops the
+# end of test datagrams, i.e. the client's FINs (negative ids) and
+# FINACKACKs and the server's AckFINs, with the given probability.
+# The data isn't dropped so the loss only hits the handshake.  The
+# drops come from a seeded generator, per run, so a run list repeats
+# for the same seed, e.g. to compare two builds:
+#
+#   udp_fin_loss.py --iperf ./old/src/iperf --loss 0.3 --seed 1
+#   udp_fin_loss.py --iperf ./new/src/iperf --loss 0.3 --seed 1
+#
+# Teardown is the client's wall time less -t, the time from the end of
+# the traffic to the client's exit.  The relay's drop decisions follow
+# the datagrams' arrival order, so the timing of a run may still vary
+# with the scheduling of the flows' threads.
+import argparse
+import random
+import select
+import socket
+import statistics
+import subprocess
+import sys
+import threading
+import time
+
+parser = argparse.ArgumentParser(description='Measure the UDP end of test teardown time under loss')
+parser.add_argument('--iperf', type=str, default='iperf', required=False, help='iperf binary to test')
+parser.add_argument('--loss', type=float, default=0.3, required=False, help='drop probability of the end of test datagrams')
+parser.add_argument('-n','--runcount', type=int, default=10, required=False, help='number of runs')
+parser.add_argument('--seed', type=int, default=1, required=False, help='seed of the drops, run n uses seed + n')
+parser.add_argument('-t','--time', type=float, default=1, required=False, help='time or duration to run traffic')
+parser.add_argument('-P','--parallel', type=int, default=1, required=False, help='client flows')
+parser.add_argument('-p','--port', type=int, default=5101, required=False, help='server port, the relay uses the next one')
+parser.add_argument('--client_args', type=str, default='', required=False, help='more client options, e.g. "--sport-spray 4"')
+
+args = parser.parse_args()
+
+# sizeof(UDP_datagram), a bare FINACKACK
+FINACKACK_LEN = 16
+
+class relay(object) :
+    def __init__(self, lport, sport) :
+        self.lport = lport
+        self.sport = sport
+        self.rand = random.Random()
+        self.drops = 0
+        self.done = False
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.bind(('127.0.0.1', lport))
+        self.thread = threading.Thread(target=self.run, daemon=True)
+        self.thread.start()
+
+    def reset(self, seed) :
+        self.rand.seed(seed)
+        self.drops = 0
+
+    def drop(self) :
+        if self.rand.random() < args.loss :
+            self.drops += 1
+            return True
+        return False
+
+    def run(self) :
+        # a server side socket per client socket, as the server
+        # tells the flows apart by their source ports
+        up = {}
+        down = {}
+        while not self.done :
+            r, _, _ = select.select([self.sock] + list(down), [], [], 0.1)
+            for s in r :
+                data, addr = s.recvfrom(65536)
+                if s is self.sock :
+                    u = up.get(addr)
+                    if u is None :
+                        u = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+                        u.connect(('127.0.0.1', self.sport))
+                        up[addr] = u
+                        down[u] = addr
+                    fin = (len(data) >= 4) and (data[0] & 0x80)
+                    if (fin or (len(data) == FINACKACK_LEN)) and self.drop() :
+                        continue
+                    u.send(data)
+                else :
+                    # all the server sends a UDP client are AckFINs
+                    if self.drop() :
+                        continue
+                    self.sock.sendto(data, down[s])
+
+server = subprocess.Popen([args.iperf, '-s', '-u', '-B', '127.0.0.1', '-p', str(args.port)], stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+proxy = relay(args.port + 1, args.port)
+time.sleep(0.5)
+
+teardowns = []
+noacks = 0
+try :
+    for run in range(args.runcount) :
+        proxy.reset(args.seed + run)
+        cmd = [args.iperf, '-c', '127.0.0.1', '-u', '-p', str(args.port + 1), '-t', str(args.time), '-P', str(args.parallel)] + args.client_args.split()
+        start = time.time()
+        result = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+        teardown = time.time() - start - args.time
+        warnings = result.stdout.count('did not receive ack')
+        noacks += warnings
+        teardowns.append(teardown)
+        print('run {} teardown {:.3f} sec, {} drops, {} unacked flows'.format(run, teardown, proxy.drops, warnings))
+        # let the server linger out the flows before the next run
+        time.sleep(0.2)
+finally :
+    proxy.done = True
+    server.terminate()
+    server.wait()
+
+print('{} runs, loss {}, seed {}: teardown min/median/max {:.3f}/{:.3f}/{:.3f} sec, {} unacked flows'.format(
+    args.runcount, args.loss, args.seed, min(teardowns), statistics.median(teardowns), max(teardowns), noacks))
@@ -56,6 +56,9 @@
 
 #include "Settings.hpp"
 #include "Timestamp.hpp"
+#include "pdfs.h"
+#include "tx_ring.h"
+#include "xdp_sock.h"
 
 
 // Define fatal and nonfatal write errors
@@ -69,6 +72,15 @@
 #define FATALUDPWRITERR(errno) 	((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR) && (errno != ECONNREFUSED) && (errno != ENOBUFS))
 #endif
 
+// UDP end of test retransmit timer, units are seconds
+#define UDPFIN_RTO_INIT 0.050  // before any FIN round trip was measured
+#define UDPFIN_RTO_MIN  0.005
+#define UDPFIN_RTO_MAX  0.500
+#define UDPFIN_TRIES    10
+#define UDPFIN_BUDGET   2.5    // give up, same as the old 10 x 250 ms
+// --full-report over TCP, wait for the server's final report
+#define FULLREPORT_WAIT 5
+
 /* ------------------------------------------------------------------- */
 class Client {
 public:
@@ -89,11 +101,14 @@ public:
 
 private:
     void WritePacketID( intmax_t );
+    void WriteIntendedTime( Timestamp, double );
     void WriteTcpHdr( ReportStruct *);
+    void StampTcpWrite( ReportStruct *);
     void InitTrafficLoop(void);
     void FinishTrafficActions(void);
     void FinalUDPHandshake(void);
-    void write_UDP_FIN(void);
+    void ReadServerReport(void);
+    void write_UDP_FIN(int n, int *socks, intmax_t *ids);
     bool InProgress(void);
 
     ReportStruct *reportstruct;
@@ -111,6 +126,38 @@ private:
     // client connect
     double Connect( );
     void HdrXchange(int flags);
+    // multicast scale (--mcast-groups), round robin over the groups
+    void McastGroupsInit(void);
+    iperf_sockaddr *mcastGroups;
+    intmax_t *mcastIDs;
+    int mcastNext;
+    // source port spraying (--sport-spray), one connected socket
+    // per source port, each with its own sequence numbers
+    void SprayInit(void);
+    void SprayFIN(void);
+    int *spraySocks;
+    intmax_t *sprayIDs;
+    intmax_t sprayBase;
+    int sprayNext;
+#if defined(HAVE_LINUX_FILTER_H) && defined(HAVE_AF_PACKET)
+    // packet generator, prebuilt frames in a PACKET_TX_RING (--tx-ring)
+    // or an AF_XDP socket's UMEM (--xdp)
+    bool FramesInit(void);
+    void RunUDPFrames(void);
+    tx_ring *txRing;
+#ifdef HAVE_AF_XDP
+    xdp_sock *xsk;
+#endif
+#endif
+    // payload verification (--verify), a TCP block stays whole
+    // across partial writes
+    void VerifyTcpBlock(ReportStruct *);
+    int verifyOffset;
+    uint32_t verifyId;
+    // write size distribution (--write-sizes)
+    int NextWriteLen(void);
+    size_pdf *writeSizes;
+    pdf_rand writeRand;
 
     //客户端对应的配置
     thread_Settings *mSettings;
@@ -126,6 +173,9 @@ private:
     Timestamp now;
     char* readAt;
     Timestamp connect_done, connect_start;
+#ifdef HAVE_FLOWTIMER
+    flowtimer flowTimer;
+#endif
 }; // end class Client
 
 #endif // CLIENT_H
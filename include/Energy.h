@@ -0,0 +1,82 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * Energy.h
+ * RAPL energy accounting (--energy)
+ *
+ * Samples the package and DRAM energy counters of the powercap RAPL
+ * zones.  Like --softirqs only the reporter thread samples, once per
+ * interval, the flows' reports share the same deltas.
+ * ------------------------------------------------------------------- */
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include "headers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// a sample of the accumulated counters, e.g. a flow's start
+typedef struct EnergyMark {
+    double time;
+    uintmax_t package;		// uJ
+    uintmax_t dram;		// uJ
+} EnergyMark;
+
+typedef struct EnergyReport {
+    double seconds;		// between the samples
+    double package;		// joules, all packages
+    double dram;		// joules, all packages' DRAM
+    int hasdram;
+    int perjoule;		// add the bytes per joule, the test's traffic
+    int sum;			// the SUM report
+} EnergyReport;
+
+void energy_open(void);
+void energy_mark(EnergyMark *mark);
+int energy_report(EnergyReport *report, EnergyMark *base, double interval, int final);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // ENERGY_H
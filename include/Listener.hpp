@@ -77,7 +77,7 @@ public:
 
     void Listen( );
 
-    void McastJoin( );
+    int McastJoin( int sock );
 
     void McastSetTTL( int val );
 
@@ -85,6 +85,16 @@ public:
 
     void UDPSingleServer ();
 
+    // multicast scale mode (--mcast-groups), the groups are joined
+    // on a pool of sockets and reported per group
+    void McastJoinGroups( );
+
+    int McastPoolSocket( );
+
+    void McastScaleRead( int sock, ReportStruct *reportstruct );
+
+    void McastScaleServer( );
+
 protected:
     int mClients;
     char* mBuf;
@@ -97,6 +107,20 @@ protected:
     Timestamp mEndTime;
 
 private:
+    struct McastGroup {
+	thread_Settings *server;
+	Timestamp joined;
+	bool received;
+	int sock;	// pool socket of the group, INVALID_SOCKET if the join failed
+	int joinerr;	// errno of the failed join
+    };
+    McastGroup *mcastGroups;
+    int *mcastSocks;	// the pool, the listen socket first
+    int mcastSockCnt;
+    int McastGroupIndex(struct msghdr *msg);
+    void McastGroupStart(McastGroup *group, int ix, iperf_sockaddr *peer, Socklen_t len, ReportStruct *reportstruct);
+    void McastGroupEnd(McastGroup *group, ReportStruct *reportstruct);
+
     int ReadClientHeader(client_hdr *hdr);
     int ClientHeaderAck(void);
     int L2_setup(void);
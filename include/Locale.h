@@ -137,6 +137,56 @@ extern const char report_bw_jitter_loss_format[];
 
 extern const char report_sum_bw_jitter_loss_format[];
 
+extern const char report_group_bw_format[];
+
+extern const char report_group_bw_jitter_loss_format[];
+
+extern const char report_anomaly_stall_format[];
+
+extern const char report_anomaly_loss_format[];
+
+extern const char report_cpufreq_format[];
+
+extern const char report_softirqs_format[];
+
+extern const char report_softirqs_cpu[];
+
+extern const char report_energy_format[];
+
+extern const char report_energy_perjoule_format[];
+
+extern const char report_sum_energy_format[];
+
+extern const char report_perf_format[];
+
+extern const char report_perf_reporter_format[];
+
+extern const char report_ringlag_format[];
+
+extern const char report_sum_ringlag_format[];
+
+extern const char report_cpu_dma_latency[];
+
+extern const char report_mcast_join_latency[];
+
+extern const char report_mcast_groups_silent[];
+
+extern const char report_mcast_groups_unjoined[];
+
+extern const char warn_mcast_join_failed[];
+
+extern const char report_sport_spray[];
+
+extern const char report_tx_ring[];
+
+extern const char warn_udp_frames[];
+
+extern const char report_xdp_tx[];
+
+extern const char report_xdp_rx[];
+
+extern const char report_udp_fin[];
+
 /* -------------------------------------------------------------------
  * Enhanced reports (per -e)
  * ------------------------------------------------------------------- */
@@ -150,6 +200,8 @@ extern const char report_sum_bw_enhanced_format[];
 
 extern const char report_bw_read_enhanced_header[];
 
+extern const char report_bw_read_enhanced_log_header[];
+
 extern const char report_bw_read_enhanced_format[];
 
 extern const char report_sum_bw_read_enhanced_format[];
@@ -194,6 +246,18 @@ extern const char report_outoforder[];
 
 extern const char report_l2statistics[];
 
+extern const char report_verify_format[];
+
+extern const char report_write_sizes_format[];
+
+extern const char report_frame_format[];
+
+extern const char report_frame_suppress_format[];
+
+extern const char report_sched_deadline_format[];
+
+extern const char report_intended_format[];
+
 extern const char report_sum_outoforder[];
 
 extern const char report_peer[];
@@ -214,6 +278,20 @@ extern const char reportCSV_bw_format[];
 
 extern const char reportCSV_bw_jitter_loss_format[];
 
+extern const char reportCSV_anomaly_format[];
+
+extern const char reportCSV_cpufreq_format[];
+
+extern const char reportCSV_softirqs_format[];
+
+extern const char reportCSV_softirqs_cpu[];
+
+extern const char reportCSV_energy_format[];
+
+extern const char reportCSV_perf_format[];
+
+extern const char reportCSV_ringlag_format[];
+
 /* -------------------------------------------------------------------
  * warnings
  * ------------------------------------------------------------------- */
@@ -230,6 +308,8 @@ extern const char warn_no_ack[];
 
 extern const char warn_ack_failed[];
 
+extern const char warn_no_full_report[];
+
 extern const char warn_fileopen_failed[];
 
 extern const char unable_to_change_win[];
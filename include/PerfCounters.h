@@ -0,0 +1,97 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * PerfCounters.h
+ * Hardware performance counters per thread (--perf-counters)
+ *
+ * Each traffic thread opens a perf_event_open group on itself at its
+ * first packet and the reporter thread one on itself.  The reporter
+ * reads a group in one read() per interval, the deltas are reported
+ * per event, i.e. per packet or per read or write.
+ * ------------------------------------------------------------------- */
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include "headers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_CACHEMISSES,
+    PERF_BRANCHMISSES,
+    PERF_CSWITCHES,
+    PERF_COUNTERS
+};
+
+typedef struct PerfGroup {
+    int fd;			// group leader, -1 none
+    int fds[PERF_COUNTERS];
+    int slot[PERF_COUNTERS];	// position in the group read, -1 not counted
+    int nslots;
+    int useronly;		// the kernel is excluded per perf_event_paranoid
+    double last[PERF_COUNTERS];	// counts at the last interval read
+    intmax_t lastevents;
+} PerfGroup;
+
+typedef struct PerfReport {
+    double counts[PERF_COUNTERS];	// deltas, -1 not counted
+    intmax_t events;		// packets, reads or writes over the deltas
+    int useronly;
+} PerfReport;
+
+void perf_group_init(PerfGroup *group);
+// counts the calling thread
+int perf_group_open(PerfGroup *group);
+int perf_group_read(PerfGroup *group, PerfReport *report, intmax_t events, int final);
+void perf_group_close(PerfGroup *group);
+// the reporter thread's group, sampled once per interval for all flows
+void perf_reporter_open(void);
+int perf_reporter_report(PerfReport *report, intmax_t events, double interval, int final);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // PERFCOUNTERS_H
@@ -72,6 +72,7 @@ extern "C" {
     extern int sInterupted;
     extern int groupID;
     extern Mutex groupCond;
+    extern Mutex udpfinCond;
 
 #ifdef __cplusplus
 } /* end extern "C" */
@@ -0,0 +1,99 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * Processes.h
+ * Multiple process scale out (--processes)
+ *
+ * The flows (-P) are split across forked worker processes.  Each
+ * worker sums its flows per interval, as the SUM report would, and
+ * publishes that sum into a shared memory segment instead of printing
+ * it.  The parent runs no traffic, it sums the workers' intervals and
+ * prints the usual SUM reports.
+ * ------------------------------------------------------------------- */
+#ifndef PROCESSES_H
+#define PROCESSES_H
+
+#include "Settings.hpp"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// intervals a worker can be ahead of the parent
+#define PROCS_SLOTS 64
+#define PROCS_MAX 256
+
+typedef struct ProcSlot {
+    volatile int seq;		// interval index + 1, 0 when empty
+    Transfer_Info info;
+} ProcSlot;
+
+typedef struct ProcWorker {
+    ProcSlot slots[PROCS_SLOTS];
+    ProcSlot final;
+    volatile int flowsdone;	// flows that made their final report
+} ProcWorker;
+
+typedef struct ProcShared {
+    int nprocs;
+    double interval;
+    ProcWorker worker[1];
+} ProcShared;
+
+// set in the workers only, NULL otherwise
+extern ProcShared *procs_shared;
+extern int procs_index;
+// the workers' sockets share numbers, a worker past the first reports
+// its flows as worker * procs_idspan + socket so the ids stay unique,
+// the span is a power of ten above the workers' RLIMIT_NOFILE
+extern int procs_idspan;
+
+#define procs_transferid(sock) ((procs_index > 0) ? ((procs_index * procs_idspan) + (sock)) : (sock))
+
+void procs_fork(thread_Settings *mSettings);
+void procs_publish(Transfer_Info *stats, int final);
+void procs_flowdone(void);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // PROCESSES_H
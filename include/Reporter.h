@@ -56,6 +56,8 @@
 #include "headers.h"
 #include "Mutex.h"
 #include "histogram.h"
+#include "PerfCounters.h"
+#include "Energy.h"
 
 struct thread_Settings;
 struct server_hdr;
@@ -97,13 +99,19 @@ typedef struct TransitStats {
     double totvdTransit;
 } TransitStats;
 
-#define BINCOUNT 8
+#define BINCOUNT 8       // default, linear bins of --len / 8
+#define READ_BINMAX 32   // --read-bins upper limit
+#define LOG2_BINS 32     // size distributions, bin n holds (2^(n-1), 2^n]
 typedef struct ReadStats {
     int cntRead;
     int totcntRead;
-    int bins[BINCOUNT];
-    int totbins[BINCOUNT];
-    int binsize;
+    int bins[READ_BINMAX];
+    int totbins[READ_BINMAX];
+    int binsize;   // linear bin width, or the largest read for log2 bins
+    int bincnt;
+    // log2 bins, the last bin is (binsize/2, binsize], the one
+    // before (binsize/4, binsize/2] and the first holds the rest
+    int binlog;
 } ReadStats;
 
 typedef struct WriteStats {
@@ -118,6 +126,9 @@ typedef struct WriteStats {
     int rtt;//当前rtt值
     double meanrtt;
     int up_to_date;
+    int sizebinned;      // --write-sizes, bin the write sizes
+    int sizebins[LOG2_BINS];
+    int totsizebins[LOG2_BINS];
 } WriteStats;
 
 #ifdef HAVE_ISOCHRONOUS
@@ -161,6 +172,85 @@ typedef struct L2Stats {
     intmax_t tot_lengtherr;
 } L2Stats;
 
+typedef struct VerifyStats {
+    intmax_t cnt;
+    intmax_t corrupt;
+    intmax_t tot_cnt;
+    intmax_t tot_corrupt;
+} VerifyStats;
+
+typedef struct FrameStats {
+    intmax_t cnt;        // client writes recovered
+    intmax_t gaps;       // write ids missing
+    intmax_t resyncs;    // framing lost, e.g. to a short write
+    intmax_t tot_cnt;
+    intmax_t tot_gaps;
+    intmax_t tot_resyncs;
+    intmax_t nextid;
+    intmax_t cntLatency;  // writes with a client timestamp
+    intmax_t totcntLatency;
+    double minLatency;
+    double maxLatency;
+    double sumLatency;
+    double totminLatency;
+    double totmaxLatency;
+    double totsumLatency;
+    int bins[LOG2_BINS];
+    int totbins[LOG2_BINS];
+} FrameStats;
+
+typedef struct SchedStats {
+    int runtime;         // --sched-deadline reservation, usecs
+    int deadline;
+    int period;
+    intmax_t wakes;      // sender wake ups timed
+    intmax_t misses;     // frames or datagrams sent past their deadline
+    intmax_t tot_wakes;
+    intmax_t tot_misses;
+    double minLate;      // wake up past the schedule, seconds
+    double maxLate;
+    double sumLate;
+    double totminLate;
+    double totmaxLate;
+    double totsumLate;
+} SchedStats;
+
+typedef struct IntendedStats {
+    intmax_t cnt;        // datagrams carrying their intended send time
+    intmax_t tot_cnt;
+    double minLatency;   // receive time less the intended send time, seconds
+    double maxLatency;
+    double sumLatency;
+    double maxLag;       // actual less the intended send time
+    double sumLag;
+    double totminLatency;
+    double totmaxLatency;
+    double totsumLatency;
+    double totmaxLag;
+    double totsumLag;
+} IntendedStats;
+
+/*
+ * Ring residency, how long a packet waits in the packet ring before
+ * the reporter thread accounts it, in log linear bins of clock ticks,
+ * 2^RINGLAG_SUBBITS bins per octave
+ */
+#define RINGLAG_SUBBITS 2
+#define RINGLAG_BINS (48 << RINGLAG_SUBBITS)
+typedef struct RingLagStats {
+    intmax_t cnt;
+    uint64_t max;
+    unsigned int bins[RINGLAG_BINS];
+} RingLagStats;
+
+#define RINGLAG_QUANTILES 4      // p50, p90, p99 and p99.9
+typedef struct RingLagReport {
+    intmax_t cnt;
+    double quantiles[RINGLAG_QUANTILES];   // usecs
+    double max;
+    int sum;                               // the SUM report, all the flows
+} RingLagReport;
+
 typedef struct ReportStruct {
     intmax_t packetID;
     intmax_t packetLen;
@@ -171,8 +261,18 @@ typedef struct ReportStruct {
     int emptyreport;
     int socket;
     int l2errors;
+    int verifyblocks;               // --verify, blocks checked
+    int verifycorrupt;              // --verify, blocks that failed
+    int framelen;                   // --tcp-framing, a client write ended
+    int frameresyncs;               // --tcp-framing, framing lost
+    int wakes;                      // --sched-deadline, wakelate is set
+    int deadlinemiss;               // --sched-deadline, sent past the deadline
+    double wakelate;
+    int intended;                   // --intended-time, intendedTime is set
+    struct timeval intendedTime;
     int l2len;
     int expected_l2len;
+    uint64_t enqueued;              // ring residency clock when enqueued, -e
 #ifdef HAVE_ISOCHRONOUS
     struct timeval isochStartTime;
     intmax_t prevframeID;
@@ -225,6 +325,11 @@ typedef struct Transfer_Info {
     int    free;  // A  misnomer - used by summing for a traffic thread counter
     histogram_t *latency_histogram;
     L2Stats l2counts;
+    VerifyStats verify;
+    FrameStats frames;
+    SchedStats sched;
+    IntendedStats intended;
+    histogram_t *intendedlatency_histogram;
 #ifdef HAVE_ISOCHRONOUS
     IsochStats isochstats;
     char   mIsochronous;                 // -e
@@ -250,6 +355,50 @@ typedef struct Connection_Info {
     char mFormat;
 } Connection_Info;
 
+/*
+ * Aggregation groups (--sum-groups) sum the interval reports of
+ * all flows sharing a key at a given level, e.g. all flows to one
+ * destination.  A flow is a member of one group per configured level.
+ */
+#define AGGR_ALL        0x00000001
+#define AGGR_SRC        0x00000002
+#define AGGR_DST        0x00000004
+#define AGGR_TOS        0x00000008
+#define AGGR_PORT       0x00000010
+#define AGGR_MAXLEVELS  5
+#define AGGR_SLOTS      8
+#define AGGR_LABELSIZE  80
+
+typedef struct AggrGroup {
+    char label[AGGR_LABELSIZE];
+    int level;
+    int members;   // flows currently contributing intervals
+    int finals;    // flows that delivered their final report
+    int mode;      // ReportMode
+    Transfer_Info slots[AGGR_SLOTS];
+    int slotcnt[AGGR_SLOTS];    // flows summed into the slot
+    int slotneed[AGGR_SLOTS];   // flows expected in the slot
+    Transfer_Info final;
+    struct AggrGroup *next;
+} AggrGroup;
+
+/*
+ * Interval report policies (--report-policy) limit the per flow
+ * interval lines for tests with many flows.  SUM, group and final
+ * reports are always printed.
+ */
+#define RPOLICY_SUMONLY     0x00000001  // suppress per flow interval lines
+#define RPOLICY_TOPN        0x00000002  // ... except the top N flows
+#define RPOLICY_BOTTOMN     0x00000004  // ... and the bottom N flows
+#define RPOLICY_BYLOSS      0x00000008  // rank by loss rather than throughput
+#define RPOLICY_CHANGES     0x00000010  // ... and flows that changed by a percent
+#define RPOLICY_ANOMALIES   0x00000020  // print stalled flow and loss spike lines
+
+#define ANOMALY_STALL       1
+#define ANOMALY_LOSS        2
+#define ANOMALY_MINLOSS     1.0         // percent
+#define ANOMALY_LOSSFACTOR  4.0         // times the flow's mean loss
+
 typedef struct ReporterData {
     char*  mHost;                   // -c
     char*  mLocalhost;              // -B
@@ -310,6 +459,32 @@ typedef struct ReporterData {
 #endif
     double TxSyncInterval;
     unsigned int FQPacingRate;
+    AggrGroup *aggr[AGGR_MAXLEVELS];
+    int aggrcnt;
+    double aggrlast;                // start time of the last interval summed
+    int policy;                     // RPOLICY_* bitmask
+    int policytopn;
+    int policybottomn;
+    double policychange;            // percent
+    int policyjoined;
+    double policylast;              // start time of the last interval offered
+    double policylastbw;            // last printed throughput, changes policy
+    double policylossmean;          // mean interval loss, anomalies policy
+    int policyintervals;
+    int cpufreq;                    // report the traffic thread's CPU frequency
+    volatile int cpu;               // CPU of the traffic thread, -1 unknown
+    int cpudmalatency;              // held PM QoS value in usecs, -1 not held
+    int softirqs;                   // report softirqs and interrupts per CPU
+    int energy;                     // report RAPL energy and bytes per joule
+    EnergyMark energybase;          // at the flow's, or the sum's, start
+    int perfcounters;               // report the traffic thread's and reporter's counters
+    int perfopened;                 // the traffic thread tried to open its group
+    PerfGroup perf;                 // opened by the traffic thread, read by the reporter
+    intmax_t perfevents;
+    RingLagStats ringlag;           // -e, packet ring residency
+    int fullreport;                 // --full-report, encode the final report for the client
+    char *fullreportbuf;
+    int fullreportlen;
 } ReporterData;
 
 typedef struct MultiHeader {
@@ -355,10 +530,88 @@ typedef struct ReportHeader {
     PacketRing *packetring;
 } ReportHeader;
 
+/*
+ * The server's final report relayed to the client, --full-report.  It
+ * follows the server_hdr of the UDP AckFIN, for TCP the server writes
+ * it on the connection after the client's half close.  A
+ * server_fullreport then a server_histogram per latency histogram,
+ * each followed by its populated bins as (bin, count) pairs.  All in
+ * network order, times in microseconds, 64 bit counts as upper and
+ * lower halves.
+ */
+#define FULLREPORT_TCP       0x00000001
+#define FULLREPORT_UDP       0x00000002
+#define FULLREPORT_ENHANCED  0x00000004
+#define FULLREPORT_MAXLEN    60000      // fits one UDP datagram
+#define FULLREPORT_NAMELEN   8
+
+#pragma pack(push,4)
+typedef struct server_fullreport {
+    struct {                    // same layout as hdr_typelen
+	int32_t type;           // SERVERFULLREPORT
+	int32_t length;         // length of the whole report
+    } typelen;
+    int32_t flags;
+    int32_t total_len1;
+    int32_t total_len2;
+    int32_t stop_sec;
+    int32_t stop_usec;
+    int32_t triptime_sec;
+    int32_t triptime_usec;
+    int32_t reads;
+    int32_t read_binsize;
+    int32_t read_bincnt;
+    int32_t read_binlog;
+    int32_t read_bins[READ_BINMAX];
+    int32_t verify_cnt1;
+    int32_t verify_cnt2;
+    int32_t verify_corrupt1;
+    int32_t verify_corrupt2;
+    int32_t l2_cnt1;
+    int32_t l2_cnt2;
+    int32_t l2_unknown;
+    int32_t l2_udpcsumerr;
+    int32_t l2_lengtherr;
+    int32_t frame_cnt1;
+    int32_t frame_cnt2;
+    int32_t frame_gaps;
+    int32_t frame_resyncs;
+    int32_t frame_cntlatency;
+    int32_t frame_minlatency;
+    int32_t frame_maxlatency;
+    int32_t frame_sumlatency1;
+    int32_t frame_sumlatency2;
+    int32_t frame_bins[LOG2_BINS];
+    int32_t histograms;
+} server_fullreport;
+
+typedef struct server_histogram {
+    int32_t bincount;
+    int32_t binwidth;
+    int32_t units;              // 1000 (ms) or 1000000 (us) per second
+    int32_t populationcnt;
+    int32_t loweroutofbounds;
+    int32_t upperoutofbounds;   // includes bins that didn't fit the report
+    int32_t ci_lower;           // hundredths of a percent
+    int32_t ci_upper;
+    char name[FULLREPORT_NAMELEN];
+    int32_t bins;               // (bin, count) pairs following
+} server_histogram;
+#pragma pack(pop)
+
 typedef void* (* report_connection)( Connection_Info*, int );
 typedef void (* report_settings)( ReporterData* );
 typedef void (* report_statistics)( Transfer_Info* );
 typedef void (* report_serverstatistics)( Connection_Info*, Transfer_Info* );
+typedef void (* report_groupstatistics)( Transfer_Info*, const char* );
+typedef void (* report_anomaly)( Transfer_Info*, int, double, double );
+typedef void (* report_cpufreq)( Transfer_Info*, int, double, int );
+struct SoftirqReport;
+typedef void (* report_softirqs)( Transfer_Info*, struct SoftirqReport* );
+struct EnergyReport;
+typedef void (* report_energy)( Transfer_Info*, struct EnergyReport* );
+typedef void (* report_perf)( Transfer_Info*, PerfReport*, PerfReport* );
+typedef void (* report_ringlag)( Transfer_Info*, RingLagReport* );
 
 MultiHeader* InitMulti( struct thread_Settings *agent, int inID );
 void InitReport( struct thread_Settings *agent );
@@ -371,10 +624,13 @@ void CloseReport( ReportHeader *agent, ReportStruct *packet );
 void EndReport( ReportHeader *agent );
 void FreeReport(ReportHeader *agent);
 Transfer_Info* GetReport( ReportHeader *agent );
-void ReportServerUDP( struct thread_Settings *agent, struct server_hdr *server );
+void ReportServerUDP( struct thread_Settings *agent, struct server_hdr *server, int len );
+void ReportServerTCP( struct thread_Settings *agent, const char *report, int len );
 ReportHeader *ReportSettings( struct thread_Settings *agent );
 void ReportConnections( struct thread_Settings *agent );
 void reporter_peerversion (struct thread_Settings *inSettings, int upper, int lower);
+void reporter_transfer_add (Transfer_Info *current, Transfer_Info *stats, int first);
+void reporter_multiple_print (MultiHeader *reporthdr, Transfer_Info *stats, int force);
 
 extern report_connection connection_reports[];
 
@@ -386,6 +642,20 @@ extern report_serverstatistics serverstatistics_reports[];
 
 extern report_statistics multiple_reports[];
 
+extern report_groupstatistics group_reports[];
+
+extern report_anomaly anomaly_reports[];
+
+extern report_cpufreq cpufreq_reports[];
+
+extern report_softirqs softirq_reports[];
+
+extern report_energy energy_reports[];
+
+extern report_perf perf_reports[];
+
+extern report_ringlag ringlag_reports[];
+
 #define SNBUFFERSIZE 120
 extern char buffer[SNBUFFERSIZE]; // Buffer for printing
 
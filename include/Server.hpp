@@ -58,6 +58,9 @@
 #include "Settings.hpp"
 #include "util.h"
 #include "Timestamp.hpp"
+#include "verify.h"
+#include "tcp_framing.h"
+#include "xdp_sock.h"
 
 
 
@@ -84,16 +87,29 @@ private:
     Timestamp mEndTime;
     Timestamp now;
     ReportStruct *reportstruct;
+    VerifyStream verifyStream;      // --verify, TCP receive state
+    TcpFrameParser frameParser;     // --tcp-framing, TCP receive state
+    void ReportFrames(const char *buf, int len);
 
     void InitKernelTimeStamping (void);
     void InitTrafficLoop (void);
     int ReadWithRxTimestamp (int *readerr);
     bool ReadPacketID (void);
+    bool UDPPacket (int rxlen);
+#ifdef HAVE_AF_XDP
+    // AF_XDP receive (--xdp)
+    bool XdpInit (void);
+    bool RunUDPXdp (int *readerr);
+    xdp_sock *xsk;
+#endif
     void L2_processing (void);
     int L2_quintuple_filter (void);
     void Isoch_processing (int);
     bool InProgress(void);
     Timestamp connect_done;
+#ifdef HAVE_FLOWTIMER
+    flowtimer flowTimer;
+#endif
 #if WIN32
     SOCKET mySocket;
     SOCKET myDropSocket;
@@ -138,6 +138,11 @@ typedef struct thread_Settings {
     char*  mSSMMulticastStr;        // --ssm-host
     char*  mIsochronousStr;         // --isochronous
     char*  mRxHistogramStr;         // --udp-histogram
+    char*  mSumGroupsStr;           // --sum-groups
+    char*  mReportPolicyStr;        // --report-policy
+    char*  mSoftirqIfaces;          // --softirqs
+    char*  mWriteSizes;             // --write-sizes
+    char*  mTxRingMac;              // --tx-ring, next hop MAC
     FILE*  Extractor_file;
     ReportHeader*  reporthdr;
     MultiHeader*   multihdr;
@@ -227,6 +232,24 @@ typedef struct thread_Settings {
     unsigned short mRXunits;
     double mRXci_lower;
     double mRXci_upper;
+    int mMcastGroups;               // --mcast-groups
+    int mSprayPorts;                // --sport-spray, UDP sockets per client thread
+    int mSprayHash;                 // --sport-spray, hash rather than round robin
+    int mTxRing;                    // --tx-ring, frames per kick
+    int mXdpQueue;                  // --xdp, interface queue
+    int mProcesses;                 // --processes
+    int mCpuDmaLatency;             // --cpu-dma-latency, usecs
+    int mSchedRuntime;              // --sched-deadline reservation, usecs
+    int mSchedDeadline;
+    int mSchedPeriod;               // < 0 until derived, 0 is off
+    int mReadBins;                  // --read-bins, log2 scaled when set
+    int mRcvLowat;                  // --rcvlowat, SO_RCVLOWAT
+    int mAggrLevels;                // --sum-groups levels, AGGR_* bitmask
+    int mAggrPortWidth;             // --sum-groups port range width
+    int mReportPolicy;              // --report-policy, RPOLICY_* bitmask
+    int mPolicyTopN;
+    int mPolicyBottomN;
+    double mPolicyChangePct;
 #if defined( HAVE_WIN32_THREAD )
     HANDLE mHandle;
 #endif
@@ -314,6 +337,15 @@ typedef struct thread_Settings {
 #define FLAG_SERVERREVERSE  0x00040000
 #define FLAG_BIDIR          0x00080000
 #define FLAG_WRITEACK       0x00100000
+#define FLAG_CPUDMALATENCY  0x00200000
+#define FLAG_SOFTIRQS       0x00400000
+#define FLAG_VERIFY         0x00800000
+#define FLAG_TCPFRAMING     0x01000000
+#define FLAG_XDP            0x02000000
+#define FLAG_FULLREPORT     0x04000000
+#define FLAG_INTENDEDTIME   0x08000000
+#define FLAG_ENERGY         0x10000000
+#define FLAG_PERFCOUNTERS   0x20000000
 
 #define isBuflenSet(settings)      ((settings->flags & FLAG_BUFLENSET) != 0)
 #define isCompat(settings)         ((settings->flags & FLAG_COMPAT) != 0)
@@ -363,6 +395,15 @@ typedef struct thread_Settings {
 #define isModeAmount(settings)     (!isModeTime(settings) && !isModeInfinite(settings))
 #define isConnectOnly(settings)    ((settings->flags_extend & FLAG_CONNECTONLY) != 0)
 #define isWriteAck(settings)       ((settings->flags_extend & FLAG_WRITEACK) != 0)
+#define isCpuDmaLatency(settings)  ((settings->flags_extend & FLAG_CPUDMALATENCY) != 0)
+#define isSoftirqs(settings)       ((settings->flags_extend & FLAG_SOFTIRQS) != 0)
+#define isVerify(settings)         ((settings->flags_extend & FLAG_VERIFY) != 0)
+#define isTcpFraming(settings)     ((settings->flags_extend & FLAG_TCPFRAMING) != 0)
+#define isXdp(settings)            ((settings->flags_extend & FLAG_XDP) != 0)
+#define isFullReport(settings)     ((settings->flags_extend & FLAG_FULLREPORT) != 0)
+#define isIntendedTime(settings)   ((settings->flags_extend & FLAG_INTENDEDTIME) != 0)
+#define isEnergy(settings)         ((settings->flags_extend & FLAG_ENERGY) != 0)
+#define isPerfCounters(settings)   ((settings->flags_extend & FLAG_PERFCOUNTERS) != 0)
 
 //设置了读写buffer的长度
 #define setBuflenSet(settings)     settings->flags |= FLAG_BUFLENSET
@@ -419,6 +460,15 @@ typedef struct thread_Settings {
 #define setModeInfinite(settings)  settings->flags_extend |= FLAG_MODEINFINITE
 #define setConnectOnly(settings)   settings->flags_extend |= FLAG_CONNECTONLY
 #define setWriteAck(settings)      settings->flags_extend |= FLAG_WRITEACK
+#define setCpuDmaLatency(settings) settings->flags_extend |= FLAG_CPUDMALATENCY
+#define setSoftirqs(settings)      settings->flags_extend |= FLAG_SOFTIRQS
+#define setVerify(settings)        settings->flags_extend |= FLAG_VERIFY
+#define setTcpFraming(settings)    settings->flags_extend |= FLAG_TCPFRAMING
+#define setXdp(settings)           settings->flags_extend |= FLAG_XDP
+#define setFullReport(settings)    settings->flags_extend |= FLAG_FULLREPORT
+#define setIntendedTime(settings)  settings->flags_extend |= FLAG_INTENDEDTIME
+#define setEnergy(settings)        settings->flags_extend |= FLAG_ENERGY
+#define setPerfCounters(settings)  settings->flags_extend |= FLAG_PERFCOUNTERS
 
 #define unsetBuflenSet(settings)   settings->flags &= ~FLAG_BUFLENSET
 #define unsetCompat(settings)      settings->flags &= ~FLAG_COMPAT
@@ -466,23 +516,41 @@ typedef struct thread_Settings {
 #define unsetModeInfinite(settings) settings->flags_extend &= ~FLAG_MODEINFINITE
 #define unsetConnectOnly(settings)  settings->flags_extend &= ~FLAG_CONNECTONLY
 #define unsetWriteAack(settings)    settings->flags_extend &= ~FLAG_WRITEACK
+#define unsetCpuDmaLatency(settings) settings->flags_extend &= ~FLAG_CPUDMALATENCY
+#define unsetSoftirqs(settings)    settings->flags_extend &= ~FLAG_SOFTIRQS
+#define unsetVerify(settings)      settings->flags_extend &= ~FLAG_VERIFY
+#define unsetTcpFraming(settings)  settings->flags_extend &= ~FLAG_TCPFRAMING
+#define unsetXdp(settings)         settings->flags_extend &= ~FLAG_XDP
+#define unsetFullReport(settings)  settings->flags_extend &= ~FLAG_FULLREPORT
+#define unsetIntendedTime(settings) settings->flags_extend &= ~FLAG_INTENDEDTIME
+#define unsetEnergy(settings)      settings->flags_extend &= ~FLAG_ENERGY
+#define unsetPerfCounters(settings) settings->flags_extend &= ~FLAG_PERFCOUNTERS
 
 /*
  * Message header flags
  *
  * base flags, keep compatible with older versions
  */
+#define SPRAY_MAX 1024  // --sport-spray sockets per thread
+// --sched-deadline reservation estimates, units are microseconds
+#define SCHED_DL_MINPERIOD 1000 // paced senders, at most a period per ms
+#define SCHED_DL_PKTCOST   40   // per datagram write
+#define SCHED_DL_WAKECOST  100  // per timer wake up
+#define SCHED_DL_MAXUTIL   0.9  // of the period
+
 #define HEADER_VERSION1 0x80000000
 #define HEADER_EXTEND   0x40000000
 #define HEADER_UDPTESTS 0x20000000
 #define HEADER_TIMESTAMP 0x10000000
 #define HEADER_SEQNO64B  0x08000000
+#define HEADER_FULLREPORT 0x04000000  // server_hdr, the full report follows
 
 // Below flags are used to pass test settings in *every* UDP packet
 // and not just during the header exchange
 #define HEADER_UDP_ISOCH    0x00000001
 #define HEADER_L2ETHPIPV6   0x00000002
 #define HEADER_L2LENCHECK   0x00000004
+#define HEADER_UDP_INTENDED 0x00000008
 
 #define RUN_NOW         0x00000001
 // newer flags
@@ -492,6 +560,7 @@ typedef struct thread_Settings {
 #define REVERSE               0x00000008
 #define BIDIR                 0x00000010
 #define WRITEACK              0x00000020
+#define FULLREPORT            0x00000040
 
 // later features
 #define HDRXACKMAX 2500000 // default 2.5 seconds, units microseconds
@@ -505,7 +574,8 @@ typedef enum MsgType {
     CLIENTHDR = 0x1,
     CLIENTHDRACK,
     SERVERHDR,
-    SERVERHDRACK
+    SERVERHDRACK,
+    SERVERFULLREPORT
 } MsgType;
 
 /*
@@ -630,7 +700,13 @@ typedef struct client_hdrext {
  *                +--------+--------+--------+--------+
  *            21  |        isoch reserved             |
  *                +--------+--------+--------+--------+
+ *            22  |        intended send time (s)     |
+ *                +--------+--------+--------+--------+
+ *            23  |        intended send time (us)    |
+ *                +--------+--------+--------+--------+
  *
+ * The intended send time (--intended-time) follows the isoch fields
+ * whether or not the test is isochronous.
  */
 
 typedef struct UDP_isoch_payload {
@@ -661,6 +737,14 @@ typedef struct client_hdr_udp_isoch_tests {
     UDP_isoch_payload isoch;
 } client_hdr_udp_isoch_tests;
 
+// when the sender's schedule said the datagram should go out
+typedef struct UDP_intended_payload {
+    uint32_t tv_sec;
+    uint32_t tv_usec;
+} UDP_intended_payload;
+
+#define UDP_INTENDED_OFFSET ((int) (sizeof(UDP_datagram) + sizeof(client_hdr_v1) + sizeof(client_hdr_udp_isoch_tests)))
+
 typedef struct client_hdr_ack {
     hdr_typelen typelen;
     int32_t flags;
@@ -743,6 +827,12 @@ typedef struct server_hdr {
 #define SIZEOF_TCPHDRMSG (int) ((sizeof(client_hdr) > sizeof(server_hdr)) ? (int) sizeof(client_hdr) : (int) sizeof(server_hdr))
 #define SIZEOF_UDPHDRMSG (int) ((SIZEOF_UDPCLIENTMSG > sizeof(server_hdr)) ? SIZEOF_UDPCLIENTMSG : sizeof(server_hdr))
 #define SIZEOF_MAXHDRMSG (int) ((SIZEOF_TCPHDRMSG > SIZEOF_UDPHDRMSG) ? SIZEOF_TCPHDRMSG : SIZEOF_UDPHDRMSG)
+// the server's AckFIN, sent whole regardless of -l
+#define SIZEOF_UDPACKFIN (int) (sizeof(UDP_datagram) + sizeof(server_hdr))
+// The client's ack of the AckFIN, a bare UDP_datagram of zero ids with
+// this in tv_usec (never a valid usec count.)  The server stops waiting
+// for FIN retries on it, older servers take it as one more FIN.
+#define UDP_FINACKACK 0x7FFFFFFF
 
 // set to defaults
 void Settings_Initialize( thread_Settings* main );
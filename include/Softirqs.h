@@ -0,0 +1,82 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * Softirqs.h
+ * Softirq and interrupt accounting (--softirqs)
+ *
+ * Samples the NET_RX/NET_TX rows of /proc/softirqs and the test
+ * interfaces' rows of /proc/interrupts per CPU.  Only the reporter
+ * thread samples, once per interval no matter how many flows report
+ * that interval, so the flows' reports share the same deltas.
+ * ------------------------------------------------------------------- */
+#ifndef SOFTIRQS_H
+#define SOFTIRQS_H
+
+#include "Settings.hpp"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// CPUs listed per report, ordered by NET_RX + NET_TX
+#define SOFTIRQS_HOTTEST 3
+
+typedef struct SoftirqCpu {
+    int cpu;			// -1 unknown
+    uintmax_t net_rx;
+    uintmax_t net_tx;
+    uintmax_t irqs;		// the test interfaces' interrupts
+} SoftirqCpu;
+
+typedef struct SoftirqReport {
+    int nhot;
+    SoftirqCpu hot[SOFTIRQS_HOTTEST];
+    SoftirqCpu flow;		// the CPU of the flow's traffic thread
+} SoftirqReport;
+
+void softirqs_open(thread_Settings *mSettings);
+int softirqs_report(SoftirqReport *report, double interval, int cpu, int final);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // SOFTIRQS_H
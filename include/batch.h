@@ -0,0 +1,103 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * batch.h
+ * Batch statistics for the reporter's UDP server accounting
+ *
+ * The reporter gathers the datagrams drained from a packet ring as a
+ * struct of arrays slice and computes over the slice at once: byte
+ * count, transit sum/min/max, the transit moments in usecs (two pass,
+ * merged into the running Welford mean and M2 per Chan et al.) and
+ * the RFC 3550 jitter recurrence
+ *
+ *   J(i) = J(i-1) + (|D(i-1,i)| - J(i-1)) / 16
+ *
+ * unrolled as J(n) = a^n J(0) + 1/16 sum a^(n-i) |D(i)|, a = 15/16,
+ * i.e. a dot product.  The kernels run 4 lanes, on AVX2 when the CPU
+ * has it else in portable C, and give the same bits either way.  The
+ * transits, min/max, byte count and ids match the per packet path
+ * exactly, the sums, moments and jitter to rounding (src/checkbatch.)
+ * ------------------------------------------------------------------- */
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "headers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BATCH_MAX 256
+
+typedef struct PacketBatch {
+    int cnt;
+    intmax_t id[BATCH_MAX];
+    intmax_t len[BATCH_MAX];
+    double txsec[BATCH_MAX];        // sent and received timevals, split
+    double txusec[BATCH_MAX];
+    double rxsec[BATCH_MAX];
+    double rxusec[BATCH_MAX];
+    double transit[BATCH_MAX];      // computed by batch_stats, seconds
+} PacketBatch;
+
+typedef struct BatchStats {
+    intmax_t bytes;
+    int inorder;                    // each id one more than the one before
+    double sumTransit;
+    double minTransit;
+    double maxTransit;
+    double meanUsecs;               // of the batch's transits, see batch_merge
+    double m2Usecs;
+    double jitter;                  // in, the jitter before the batch, out after it
+    double lastTransit;             // in, the transit before the batch, out its last
+} BatchStats;
+
+void batch_init(void);
+const char *batch_impl(void);
+void batch_stats(PacketBatch *batch, BatchStats *stats);
+void batch_stats_sw(PacketBatch *batch, BatchStats *stats);
+void batch_merge(double *mean, double *m2, double *vd, int cnt, int n, BatchStats *stats);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // BATCH_H
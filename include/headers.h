@@ -121,6 +121,11 @@
 #define  IPV6HDRLEN 40
 #endif // HAVE_AF_PACKET
 
+// AF_XDP sockets, the frames use the AF_PACKET header layouts
+#if defined(HAVE_LINUX_FILTER_H) && defined(HAVE_AF_PACKET) && defined(HAVE_LINUX_BPF_H) && defined(HAVE_LINUX_IF_XDP_H)
+#define HAVE_AF_XDP 1
+#endif
+
 #ifdef WIN32
 
 /* Windows config file */
@@ -190,6 +195,14 @@ int usleep(useconds_t usec);
 #ifdef HAVE_SIGNAL_H
     #include <signal.h>
 #endif
+// per flow timers, a POSIX timer signaling only the thread that armed it
+#if defined(HAVE_TIMER_CREATE) && defined(SIGEV_THREAD_ID)
+    #define HAVE_FLOWTIMER 1
+#endif
+// SCHED_DEADLINE, set with the sched_setattr syscall
+#if defined(HAVE_SCHED_SETSCHEDULER) && defined(__linux__)
+    #define HAVE_SCHED_DEADLINE 1
+#endif
 
 #ifdef HAVE_SYSLOG_H
 /** Added for daemonizing the process */
@@ -65,6 +65,11 @@ typedef struct histogram_t {
     struct histogram_t *prev;
 } histogram_t;
 
+// histogram_init allocates the histogram with its bins, name and print buffer
+#define HISTOGRAM_OUTBUFSZ(bincount, namelen) (120 + (32 * (bincount)) + (namelen))
+#define HISTOGRAM_SIZE(bincount, namelen) (sizeof(histogram_t) + ((bincount) * sizeof(unsigned int)) \
+					   + (namelen) + 1 + HISTOGRAM_OUTBUFSZ(bincount, namelen))
+
 extern histogram_t *histogram_init(unsigned int bincount, unsigned int binwidth, float offset,\
 				   float units, double ci_lower, double ci_upper, unsigned int id, char *name);
 extern void histogram_delete(histogram_t *h);
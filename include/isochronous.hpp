@@ -64,6 +64,7 @@ namespace Isochronous {
 	long getUsecs(void);
 	void reset(void);
 	unsigned int slip;
+	long late;  // usecs the last wait_tick woke past the tick, < 0 is early
 
     private :
 	Timestamp startTime;
@@ -47,12 +47,53 @@
 
 #ifndef PDFS_H
 #define PDFS_H
+#include <stdint.h>
 #ifdef __cplusplus
 extern "C" {
 #endif
 float normal(float mean, float stdev);
 float lognormal(float mean, float stdev);
 float box_muller(void);
+
+/*
+ * Per thread generator (xorshift64*), no locks or shared state
+ * unlike rand()
+ */
+typedef struct pdf_rand {
+    uint64_t state;
+    int spare;     // y2 holds the second box muller deviate
+    float y2;
+} pdf_rand;
+
+void pdf_rand_seed(pdf_rand *r, uint64_t seed);
+double pdf_rand_unit(pdf_rand *r);
+float lognormal_r(pdf_rand *r, float mean, float stdev);
+
+/*
+ * Write size distributions, spec is one of
+ *   fixed:<size>[,<size>...]   pick one of the sizes per write
+ *   uniform:<min>,<max>
+ *   lognormal:<mean>,<stdev>
+ *   cdf:<file>                 lines of <size> <cumulative probability>
+ */
+#define SIZEPDF_FIXED     1
+#define SIZEPDF_UNIFORM   2
+#define SIZEPDF_LOGNORMAL 3
+#define SIZEPDF_CDF       4
+#define SIZEPDF_MAXPOINTS 1024
+
+typedef struct size_pdf {
+    int type;
+    int cnt;          // sizes of a fixed list or cdf
+    int *sizes;
+    double *cdf;
+    double a, b;      // uniform min and max, lognormal mean and stdev
+    int maxsize;      // the largest draw, zero when unbounded
+} size_pdf;
+
+int size_pdf_parse(size_pdf *pdf, const char *spec);
+void size_pdf_free(size_pdf *pdf);
+int size_pdf_draw(size_pdf *pdf, pdf_rand *r, int cap);
 #ifdef __cplusplus
 } /* end extern "C" */
 #endif
@@ -0,0 +1,100 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * pool.h
+ * Typed object pools for the report objects and histograms
+ *
+ * Every flow allocates its reports, packet ring and histograms and
+ * the reporter thread frees the one-shot reports, so with flow churn
+ * malloc sees a steady cross-thread alloc/free stream of large
+ * objects.  Each pool keeps a small per-thread cache refilled from
+ * and flushed to a shared depot in batches, the depot is bounded and
+ * the rest goes back to malloc.
+ *
+ * Objects carry a header with their pool and state, so a double put,
+ * or putting a pointer the pool didn't hand out, is reported rather
+ * than corrupting the heap.  The pools count objects taken and put,
+ * i.e. the objects live, and those malloc'd and freed.
+ * ------------------------------------------------------------------- */
+#ifndef POOL_H
+#define POOL_H
+
+#include "headers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    POOL_REPORTHDR = 0,		// ReportHeader
+    POOL_MULTIHDR,		// MultiHeader with a server's multi slots
+    POOL_PACKETRING,		// PacketRing and its NUM_REPORT_STRUCTS
+    POOL_HISTOGRAM,		// histogram_t of the default --rx-histogram bins
+    POOL_MAX
+};
+
+typedef struct pool_stats {
+    const char *name;
+    size_t size;
+    intmax_t gets;		// objects taken
+    intmax_t puts;		// objects put back
+    intmax_t mallocs;		// objects malloc'd, including oversize ones
+    intmax_t frees;		// objects freed to malloc
+    intmax_t oversize;		// larger than the pool's size, not cached
+    intmax_t badputs;		// double puts or foreign pointers
+    int depot;			// objects in the depot
+} pool_stats;
+
+void pool_init(void);
+// uninitialized like malloc, sizes above the pool's size are malloc'd
+void *pool_get(int pool, size_t size);
+void *pool_getz(int pool, size_t size);
+void pool_put(void *obj);
+// returns the calling thread's cached objects to the depots
+void pool_thread_flush(void);
+void pool_getstats(int pool, pool_stats *stats);
+void pool_debug(void);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // POOL_H
@@ -0,0 +1,75 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * probes.h
+ * USDT probes, provider iperf, for bpftrace and the like
+ *
+ * With <sys/sdt.h> each probe compiles to a nop and a note in the
+ * binary, a tracer attaching to it patches in a breakpoint.  Without
+ * it they compile to nothing.  The arguments are integers or pointers.
+ *
+ *   ring_enqueue   ring, slot, packet id, packet len
+ *   ring_dequeue   ring, slot, packet id, packet len
+ *   ring_stall     ring, stalls so far                    producer blocked
+ *   ring_unstall   ring, stalls so far                    and resumed
+ *   interval       transfer id, end usecs, bytes, datagrams
+ *   udp_pace       packet id, running delay ns, adjust ns
+ *   rx_read        socket, bytes or 0, kernel timestamp 1/0
+ *   accept         socket, UDP 1/0
+ *   connect_start  socket, UDP 1/0
+ *   connect_done   socket, connect() return
+ *
+ * See the bpftrace directory for scripts using them.
+ * ------------------------------------------------------------------- */
+#ifndef PROBES_H
+#define PROBES_H
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define IPERF_PROBE2(name, a1, a2) DTRACE_PROBE2(iperf, name, a1, a2)
+#define IPERF_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(iperf, name, a1, a2, a3)
+#define IPERF_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(iperf, name, a1, a2, a3, a4)
+#else
+#define IPERF_PROBE2(name, a1, a2) do {} while (0)
+#define IPERF_PROBE3(name, a1, a2, a3) do {} while (0)
+#define IPERF_PROBE4(name, a1, a2, a3, a4) do {} while (0)
+#endif
+
+#endif // PROBES_H
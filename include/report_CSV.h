@@ -55,6 +55,13 @@
 #define REPORT_CSV_H
 
 void CSV_stats( Transfer_Info *stats );
+void CSV_groupstats( Transfer_Info *stats, const char *label );
+void CSV_anomaly( Transfer_Info *stats, int kind, double value, double mean );
+void CSV_cpufreq( Transfer_Info *stats, int cpu, double mhz, int dmalatency );
+void CSV_softirqs( Transfer_Info *stats, struct SoftirqReport *report );
+void CSV_energy( Transfer_Info *stats, struct EnergyReport *report );
+void CSV_perf( Transfer_Info *stats, PerfReport *flow, PerfReport *reporter );
+void CSV_ringlag( Transfer_Info *stats, RingLagReport *report );
 void *CSV_peer( Connection_Info *stats, int ID);
 void CSV_serverstats( Connection_Info *conn, Transfer_Info *stats );
 
@@ -56,6 +56,14 @@
 
 void reporter_printstats( Transfer_Info *stats );
 void reporter_multistats( Transfer_Info *stats );
+void reporter_groupstats( Transfer_Info *stats, const char *label );
+void reporter_anomaly( Transfer_Info *stats, int kind, double value, double mean );
+void reporter_cpufreq( Transfer_Info *stats, int cpu, double mhz, int dmalatency );
+void reporter_softirqs( Transfer_Info *stats, struct SoftirqReport *report );
+void reporter_energy( Transfer_Info *stats, struct EnergyReport *report );
+void reporter_perf( Transfer_Info *stats, PerfReport *flow, PerfReport *reporter );
+void reporter_ringlag( Transfer_Info *stats, RingLagReport *report );
+void reporter_resetstats( Transfer_Info *stats );
 void reporter_serverstats( Connection_Info *conn, Transfer_Info *stats );
 void reporter_reportsettings( ReporterData *stats );
 void *reporter_reportpeer( Connection_Info *stats, int ID);
@@ -0,0 +1,85 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * tcp_framing.h
+ * Recovery of the client's writes from a TCP stream (--tcp-framing)
+ *
+ * Unless --trip-times or --verify are set the client starts each
+ * write with a TCP_datagram whose length field holds the write size.
+ * The server walks those headers over its read buffers in place,
+ * only a header split across two reads is staged.
+ * ------------------------------------------------------------------- */
+#ifndef TCP_FRAMING_H
+#define TCP_FRAMING_H
+
+#include "headers.h"
+#include "Settings.hpp"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TCPFRAME_MAXLEN 0x10000000
+
+typedef struct TcpFrame {
+    intmax_t id;
+    int len;
+    struct timeval sent;	// client timestamp of the write
+} TcpFrame;
+
+typedef struct TcpFrameParser {
+    int state;
+    int have;			// header bytes staged so far
+    int synced;			// the last header was good
+    intmax_t resyncs;		// times framing was lost
+    uintmax_t remaining;	// body bytes to go
+    unsigned char hdr[sizeof(TCP_datagram)];
+    TcpFrame frame;		// the write in progress
+} TcpFrameParser;
+
+void tcpframe_init(TcpFrameParser *parser);
+int tcpframe_next(TcpFrameParser *parser, const char **buf, int *len, TcpFrame *frame);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // TCP_FRAMING_H
@@ -0,0 +1,105 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * tx_ring.h
+ * AF_PACKET PACKET_TX_RING packet generator (--tx-ring)
+ *
+ * The client's UDP datagrams are built as whole Ethernet/IPv4/UDP
+ * frames, the same ether_header, iphdr and udphdr layouts the server
+ * takes apart in L2_processing, in an mmap'd PACKET_TX_RING.  Each
+ * slot holds a copy of the template frame so a send only rewrites the
+ * datagram's sequence number and timestamp.  One send() kicks all of
+ * the frames queued since the last one.
+ * ------------------------------------------------------------------- */
+#ifndef TX_RING_H
+#define TX_RING_H
+
+#include "headers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TXRING_BATCH    64    // frames per kick by default
+#define TXRING_MAXBATCH 4096
+#define TXRING_MINFRAMES 256
+
+#if defined(HAVE_LINUX_FILTER_H) && defined(HAVE_AF_PACKET)
+// the UDP payload offset of a tx_ring_build_udp4 frame
+#define TXRING_UDP4_PAYLOAD (sizeof(struct ether_header) + sizeof(struct iphdr) + sizeof(struct udphdr))
+
+typedef struct tx_ring {
+    int sock;
+    unsigned char *map;
+    size_t maplen;
+    int frame_size;		// ring slot size
+    int frame_nr;
+    int block_size;
+    int perblock;		// slots per block
+    int next;			// next slot to fill
+    int framelen;		// on the wire frame length
+    intmax_t kicks;
+    intmax_t rejected;		// frames the kernel wouldn't send
+} tx_ring;
+
+int tx_ring_open(tx_ring *ring, const char *ifname, int framelen, int frames);
+void tx_ring_close(tx_ring *ring);
+int tx_ring_build_udp4(unsigned char *frame, const unsigned char *srcmac, const unsigned char *dstmac,
+		       const struct sockaddr_in *src, const struct sockaddr_in *dst, int tos, int ttl,
+		       const char *payload, int len);
+void tx_ring_template(tx_ring *ring, const unsigned char *frame);
+unsigned char *tx_ring_next(tx_ring *ring);
+void tx_ring_queue(tx_ring *ring);
+int tx_ring_kick(tx_ring *ring);
+int tx_ring_wait(tx_ring *ring, int msecs);
+int tx_ring_drain(tx_ring *ring, int msecs);
+int tx_ring_ifmac(const char *ifname, unsigned char *mac, int *loopback, int *mtu);
+int tx_ring_loopback_ok(const char *ifname);
+int tx_ring_neighbor(const char *ifname, struct in_addr dst, unsigned char *mac);
+int tx_ring_parse_mac(const char *str, unsigned char *mac);
+#endif
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+
+#endif // TX_RING_H
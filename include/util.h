@@ -73,6 +73,7 @@ int  getsock_tcp_mss( int inSock );
 bool setsock_blocking(int fd, bool blocking);
 
 int recvn( int inSock, char *outBuf, int inLen, int flags );
+ssize_t writen( int inSock, const void *inBuf, size_t inLen );
 /* -------------------------------------------------------------------
  * signal handlers
  * signal.c
@@ -84,6 +85,22 @@ typedef Sigfunc *SigfuncPtr;
 
 SigfuncPtr my_signal( int inSigno, SigfuncPtr inFunc );
 
+#ifdef HAVE_FLOWTIMER
+/*
+ * A traffic thread's end of test timer.  Unlike setitimer()'s process
+ * wide SIGALRM its signal goes to the arming thread only, so every flow
+ * gets its own deadline and a blocked read or write returns EINTR.
+ */
+typedef struct flowtimer {
+    timer_t timer;
+    int armed;
+    volatile sig_atomic_t expired;
+} flowtimer;
+
+int flowtimer_start( flowtimer *inTimer, const struct timeval *inDeadline );
+void flowtimer_stop( flowtimer *inTimer );
+#endif
+
 #ifdef WIN32
 
 #ifdef HAVE_SIGNAL_H
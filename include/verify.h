@@ -0,0 +1,121 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * verify.h
+ * Payload integrity verification (--verify)
+ *
+ * The client writes each TCP write block, or the tail of each UDP
+ * datagram past the iperf headers, as a verify block
+ *
+ *                 0      7 8     15 16    23 24    31
+ *                +--------+--------+--------+--------+
+ *      0x00      |          magic "ipvf"             |
+ *                +--------+--------+--------+--------+
+ *      0x04      |    block length incl. trailer     |
+ *                +--------+--------+--------+--------+
+ *      0x08      |  block (TCP) or datagram id (UDP) |
+ *                +--------+--------+--------+--------+
+ *      0x0c      |          (reserved)               |
+ *                +--------+--------+--------+--------+
+ *      0x10      |  pseudo random payload keyed by   |
+ *                |  the id, regenerable by the peer  |
+ *                +--------+--------+--------+--------+
+ *      len - 4   |  CRC32C of the above              |
+ *                +--------+--------+--------+--------+
+ *
+ * The receiver checks the CRC32C and the id.  CRC32C runs on the
+ * SSE4.2 or ARMv8 CRC instructions when available, else per table.
+ * ------------------------------------------------------------------- */
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include "headers.h"
+#include "Settings.hpp"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VERIFY_MAGIC 0x69707666
+#define VERIFY_MINLEN ((int) (sizeof(verify_hdr) + sizeof(uint32_t)))
+#define VERIFY_MAXLEN 0x10000000
+// keep clear of the UDP headers the client may rewrite per datagram
+#define VERIFY_UDP_OFFSET ((int) (UDP_INTENDED_OFFSET + sizeof(UDP_intended_payload)))
+
+#pragma pack(push,4)
+typedef struct verify_hdr {
+    uint32_t magic;
+    uint32_t length;
+    uint32_t id;
+    uint32_t reserved;
+} verify_hdr;
+#pragma pack(pop)
+
+/*
+ * Receive state of a TCP stream, the stream holds the client's
+ * headers then back to back verify blocks, possibly split across
+ * reads
+ */
+typedef struct VerifyStream {
+    int state;
+    int have;			// header or trailer bytes so far
+    unsigned char hdr[sizeof(verify_hdr)];
+    unsigned char trailer[sizeof(uint32_t)];
+    uint32_t remaining;		// payload bytes to go
+    uint32_t crc;
+    uint32_t id;		// the expected block id
+} VerifyStream;
+
+void crc32c_init(void);
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+uint32_t crc32c_table(uint32_t crc, const void *buf, size_t len);
+const char *crc32c_impl(void);
+
+void verify_fill(char *block, int len, uint32_t id);
+int verify_block(const char *block, int len, uint32_t id);
+void verify_stream_init(VerifyStream *stream);
+void verify_stream(VerifyStream *stream, const char *buf, int len, int *blocks, int *corrupt);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // VERIFY_H
@@ -0,0 +1,115 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * xdp_sock.h
+ * AF_XDP socket engine (--xdp)
+ *
+ * One AF_XDP socket on an interface queue with its own UMEM.  The
+ * server's socket receives, a minimal XDP program redirects the
+ * flow's datagrams (matched on the UDP 4-tuple) into it and passes
+ * everything else on to the stack.  The client's socket transmits
+ * frames built like --tx-ring's.  Generic (skb) XDP is used when the
+ * driver has no native XDP, e.g. that works on veth pairs.
+ * ------------------------------------------------------------------- */
+#ifndef XDP_SOCK_H
+#define XDP_SOCK_H
+
+#include "headers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XDP_SOCK_BATCH      64      // frames per pass of the ring
+#define XDP_SOCK_FRAMESIZE  2048    // UMEM chunk
+#define XDP_SOCK_FRAMES     2048    // also each ring's size
+
+#ifdef HAVE_AF_XDP
+typedef struct xdp_sock_ring {
+    uint32_t *producer;
+    uint32_t *consumer;
+    void *descs;
+    uint32_t mask;
+    uint32_t cached;		// local producer (or consumer) not yet published
+    void *map;
+    size_t maplen;
+} xdp_sock_ring;
+
+typedef struct xdp_sock {
+    int sock;
+    int queue;
+    int mapfd;
+    int progfd;
+    int linkfd;
+    int skbmode;		// generic XDP, the driver has no native support
+    unsigned char *umem;
+    size_t umemlen;
+    xdp_sock_ring fill;
+    xdp_sock_ring comp;
+    xdp_sock_ring rx;
+    xdp_sock_ring tx;
+    uint64_t *txfree;		// UMEM frames free for transmit
+    int ntxfree;
+    int framelen;
+    intmax_t frames;		// received or sent
+    intmax_t kicks;
+} xdp_sock;
+
+int xdp_sock_open(xdp_sock *xs, const char *ifname, int queue, int rx);
+void xdp_sock_close(xdp_sock *xs);
+int xdp_sock_attach(xdp_sock *xs, const char *ifname, const struct sockaddr_in *local, const struct sockaddr_in *peer);
+int xdp_sock_wait(xdp_sock *xs, int msecs);
+int xdp_sock_rx_peek(xdp_sock *xs, int max);
+unsigned char *xdp_sock_rx_frame(xdp_sock *xs, int ix, int *len);
+void xdp_sock_rx_release(xdp_sock *xs, int n);
+void xdp_sock_tx_template(xdp_sock *xs, const unsigned char *frame, int framelen);
+unsigned char *xdp_sock_tx_next(xdp_sock *xs);
+void xdp_sock_tx_queue(xdp_sock *xs);
+int xdp_sock_kick(xdp_sock *xs);
+int xdp_sock_tx_drain(xdp_sock *xs, int msecs);
+#endif
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+
+#endif // XDP_SOCK_H
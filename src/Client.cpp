@@ -52,6 +52,7 @@
  * ------------------------------------------------------------------- */
 
 #include <time.h>
+#include <math.h>
 #include "headers.h"
 #include "Client.hpp"
 #include "Thread.h"
@@ -64,6 +65,9 @@
 #include "isochronous.hpp"
 #include "pdfs.h"
 #include "version.h"
+#include "verify.h"
+#include "probes.h"
+#include "Processes.h"
 
 // const double kSecs_to_usecs = 1e6;
 const double kSecs_to_nsecs = 1e9;
@@ -84,6 +88,26 @@ Client::Client( thread_Settings *inSettings ) {
     mSettings = inSettings;
     mBuf = NULL;
     myJob = NULL;
+    mcastGroups = NULL;
+    mcastIDs = NULL;
+    mcastNext = 0;
+    spraySocks = NULL;
+    sprayIDs = NULL;
+    sprayBase = 0;
+    sprayNext = 0;
+#ifdef HAVE_FLOWTIMER
+    flowTimer.armed = 0;
+    flowTimer.expired = 0;
+#endif
+#if defined(HAVE_LINUX_FILTER_H) && defined(HAVE_AF_PACKET)
+    txRing = NULL;
+#ifdef HAVE_AF_XDP
+    xsk = NULL;
+#endif
+#endif
+    verifyOffset = 0;
+    verifyId = 0;
+    writeSizes = NULL;
     mySocket = isServerReverse(inSettings) ? inSettings->mSock : INVALID_SOCKET;
     double ct = -1.0;
 
@@ -123,6 +147,16 @@ Client::Client( thread_Settings *inSettings ) {
             unsetFileInput( mSettings );
         }
     }
+    if (mSettings->mWriteSizes && !isUDP(mSettings)) {
+	Timestamp seed;
+	writeSizes = new size_pdf;
+	if (size_pdf_parse(writeSizes, mSettings->mWriteSizes) != 0) {
+	    delete writeSizes;
+	    writeSizes = NULL;
+	}
+	// flows draw independent sequences
+	pdf_rand_seed(&writeRand, ((uint64_t) seed.getUsecs() << 32) ^ (uint64_t) (uintptr_t) this ^ (uint64_t) seed.getSecs());
+    }
 #ifdef HAVE_ISOCHRONOUS
     if (isIsochronous(mSettings) && isUDP(mSettings))
 	FAIL_errno( !(mSettings->mFPS > 0.0), "Invalid value for frames per second in the isochronous settings\n", mSettings );
@@ -254,7 +288,39 @@ Client::~Client() {
         int rc = close( mySocket );
         WARN_errno( rc == SOCKET_ERROR, "close" );
     }
+#ifdef HAVE_FLOWTIMER
+    flowtimer_stop(&flowTimer);
+#endif
     DELETE_ARRAY( mBuf );
+    DELETE_ARRAY( mcastGroups );
+    DELETE_ARRAY( mcastIDs );
+    if (spraySocks) {
+	// socket zero is the thread's socket and closed above
+	for (int ix = 1; ix < mSettings->mSprayPorts; ix++) {
+	    if (spraySocks[ix] != INVALID_SOCKET) {
+		int rc = close(spraySocks[ix]);
+		WARN_errno( rc == SOCKET_ERROR, "close" );
+	    }
+	}
+	DELETE_ARRAY( spraySocks );
+    }
+    DELETE_ARRAY( sprayIDs );
+#if defined(HAVE_LINUX_FILTER_H) && defined(HAVE_AF_PACKET)
+    if (txRing) {
+	tx_ring_close(txRing);
+	delete txRing;
+    }
+#ifdef HAVE_AF_XDP
+    if (xsk) {
+	xdp_sock_close(xsk);
+	delete xsk;
+    }
+#endif
+#endif
+    if (writeSizes) {
+	size_pdf_free(writeSizes);
+	delete writeSizes;
+    }
     if (!isConnectOnly(mSettings) && !isReverse(mSettings)) {
       FreeReport(myJob);
     }
@@ -308,6 +374,7 @@ double Client::Connect() {
     }
 
     // connect socket
+    IPERF_PROBE2(connect_start, mSettings->mSock, (int) isUDP(mSettings));
     if (!isUDP(mSettings) && isEnhanced(mSettings)) {
 	connect_start.setnow();
 	rc = connect( mSettings->mSock, (sockaddr*) &mSettings->peer,
@@ -318,6 +385,7 @@ double Client::Connect() {
 	rc = connect( mSettings->mSock, (sockaddr*) &mSettings->peer,
 		      SockAddr_get_sizeof_sockaddr( &mSettings->peer ));
     }
+    IPERF_PROBE2(connect_done, mSettings->mSock, rc);
     FAIL_errno( rc == SOCKET_ERROR, "connect", mSettings );
 
     getsockname( mSettings->mSock, (sockaddr*) &mSettings->local,
@@ -356,10 +424,13 @@ void Client::InitTrafficLoop (void) {
     /*
      * Set up common termination variables
      *
-     * Terminate the thread by setitimer's alarm (if possible)
-     * as the alarm will break a blocked syscall (i.e. the write)
-     * and provide for accurate timing. Otherwise the thread cannot
-     * terminate until the write completes or the socket SO_SNDTIMEO occurs.
+     * Terminate the thread by its own flow timer (if possible), a
+     * POSIX timer whose signal goes to this thread only.  It breaks a
+     * blocked syscall (i.e. the write) and provides for accurate timing
+     * in every test mode and with staggered starts.  Otherwise fall back
+     * to setitimer's alarm, also breaking the write. Otherwise the thread
+     * cannot terminate until the write completes or the socket
+     * SO_SNDTIMEO occurs.
      *
      * In the case of no setitimer we're just using the gettimeofday (or equivalent)
      * calls to determine if the loop time exceeds the request time
@@ -375,10 +446,20 @@ void Client::InitTrafficLoop (void) {
      * the Server thread's itimer.  The Client process then rejects
      * the reverse connection, and the Server process exits early.  To
      * resolve this, only use the itimer mechanism for "Normal" tests.
+     * The flow timer doesn't have this problem.
      */
 
     if (isModeTime(mSettings)) {
-#ifdef HAVE_SETITIMER
+        mEndTime.setnow();
+        mEndTime.add( mSettings->mAmount / 100.0 );
+#ifdef HAVE_FLOWTIMER
+	struct timeval deadline;
+	deadline.tv_sec = mEndTime.getSecs();
+	deadline.tv_usec = mEndTime.getUsecs();
+	if (flowtimer_start(&flowTimer, &deadline) < 0) {
+	    WARN_errno( 1, "flow timer" );
+	}
+#elif defined(HAVE_SETITIMER)
         if (mSettings->mMode == kTest_Normal) {
 	    int err;
 	    struct itimerval it;
@@ -390,8 +471,6 @@ void Client::InitTrafficLoop (void) {
 	    FAIL_errno( err != 0, "setitimer", mSettings );
 	}
 #endif
-        mEndTime.setnow();
-        mEndTime.add( mSettings->mAmount / 100.0 );
     }
 
     lastPacketTime.setnow();
@@ -469,6 +548,10 @@ void Client::Run( void ) {
 	// Launch the approprate UDP traffic loop
 	if (isIsochronous(mSettings)) {
 	    RunUDPIsochronous();
+#if defined(HAVE_LINUX_FILTER_H) && defined(HAVE_AF_PACKET)
+	} else if (mSettings->mTxRing || isXdp(mSettings)) {
+	    RunUDPFrames();
+#endif
 	} else {
 	    RunUDP();
 	}
@@ -489,17 +572,22 @@ void Client::Run( void ) {
 void Client::RunTCP( void ) {
 	//tcp报文发送
     while (InProgress()) {
-        if (isModeAmount(mSettings)) {
-	    reportstruct->packetLen = ((mSettings->mAmount < (unsigned) mSettings->mBufLen) ? mSettings->mAmount : mSettings->mBufLen);
-	} else {
-	    reportstruct->packetLen = mSettings->mBufLen;
-	}
-	if (!isTripTime(mSettings)) {
-	    WriteTcpHdr(reportstruct);
+	char *writeAt = mBuf + verifyOffset;
+	reportstruct->packetLen = NextWriteLen();
+	if (isVerify(mSettings)) {
+	    VerifyTcpBlock(reportstruct);
+	} else if (!isTripTime(mSettings)) {
+	    // a write too short for the header goes out without it
+	    if (reportstruct->packetLen >= (intmax_t) sizeof(TCP_datagram)) {
+		StampTcpWrite(reportstruct);
+		WriteTcpHdr(reportstruct);
+	    } else {
+		writeAt = mBuf + sizeof(TCP_datagram);
+	    }
 	}
 	// perform write
 	//向socket中执行write操作
-	reportstruct->packetLen = write( mSettings->mSock, mBuf, reportstruct->packetLen);
+	reportstruct->packetLen = write( mSettings->mSock, writeAt, reportstruct->packetLen);
         if ( reportstruct->packetLen < 0 ) {
         	//发送失败
 	    if (NONFATALTCPWRITERR(errno)) {
@@ -518,10 +606,15 @@ void Client::RunTCP( void ) {
 		//发送成功
 	    totLen += reportstruct->packetLen;
 	    reportstruct->errwrite=WriteNoErr;
+	    if (isVerify(mSettings))
+		verifyOffset = (verifyOffset + reportstruct->packetLen) % mSettings->mBufLen;
 	}
 // skip the packet time setting syscall() for the case of no interval reporting
-// or packet reporting needed and an itimer is available to stop the traffic/while loop
-#ifdef HAVE_SETITIMER
+// or packet reporting needed and a timer is available to stop the traffic/while loop
+#ifdef HAVE_FLOWTIMER
+	if ((mSettings->mInterval > 0) || isEnhanced(mSettings) ||
+	    (isModeTime(mSettings) && !flowTimer.armed))
+#elif defined(HAVE_SETITIMER)
 	if ((mSettings->mInterval > 0) || isEnhanced(mSettings) ||
 	    mSettings->mMode != kTest_Normal)
 #endif
@@ -575,16 +668,20 @@ void Client::RunRateLimitedTCP ( void ) {
 	tokens += time2.subSec(time1) * (var_rate / 8.0);
 	time1 = time2;
 	if (tokens >= 0.0) {
-	    if (isModeAmount(mSettings)) {
-	        reportstruct->packetLen = ((mSettings->mAmount < (unsigned) mSettings->mBufLen) ? mSettings->mAmount : mSettings->mBufLen);
-	    } else {
-	        reportstruct->packetLen = mSettings->mBufLen;
-	    }
-	    if (!isTripTime(mSettings)) {
-	        WriteTcpHdr(reportstruct);
+	    char *writeAt = mBuf + verifyOffset;
+	    reportstruct->packetLen = NextWriteLen();
+	    if (isVerify(mSettings)) {
+		VerifyTcpBlock(reportstruct);
+	    } else if (!isTripTime(mSettings)) {
+		if (reportstruct->packetLen >= (intmax_t) sizeof(TCP_datagram)) {
+		    StampTcpWrite(reportstruct);
+		    WriteTcpHdr(reportstruct);
+		} else {
+		    writeAt = mBuf + sizeof(TCP_datagram);
+		}
 	    }
 	    // perform write
-	    reportstruct->packetLen = write( mSettings->mSock, mBuf, reportstruct->packetLen);
+	    reportstruct->packetLen = write( mSettings->mSock, writeAt, reportstruct->packetLen);
 	    if ( reportstruct->packetLen < 0 ) {
 	        if (NONFATALTCPWRITERR(errno)) {
 		    reportstruct->errwrite=WriteErrAccount;
@@ -602,6 +699,8 @@ void Client::RunRateLimitedTCP ( void ) {
 	        tokens -= reportstruct->packetLen;
 	        totLen += reportstruct->packetLen;
 		reportstruct->errwrite=WriteNoErr;
+		if (isVerify(mSettings))
+		    verifyOffset = (verifyOffset + reportstruct->packetLen) % mSettings->mBufLen;
 	    }
 	    time2.setnow();
 	    reportstruct->packetTime.tv_sec = time2.getSecs();
@@ -656,7 +755,21 @@ void Client::RunUDP( void ) {
     // Set this to > 0 so first loop iteration will delay the IPG
     currLen = 1;
     double variance = mSettings->mVariance;
+    if (isMulticast(mSettings) && (mSettings->mMcastGroups > 1)) {
+	McastGroupsInit();
+    } else if (mSettings->mSprayPorts > 1) {
+	SprayInit();
+    }
 
+    // --sched-deadline, time each wake up from the pacing delay
+    Timestamp wakeTime;
+    bool wakeTimed = false;
+    // --intended-time, the running delay's schedule, from the start of
+    // the loop by the delay target per datagram sent, though it doesn't
+    // give up on falling behind the way the running delay does
+    Timestamp intendedStart = lastPacketTime;
+    double intendedOffset = 0;
+    bool intendedNext = false;
     while (InProgress()) {
         // Test case: drop 17 packets and send 2 out-of-order:
         // sequence 51, 52, 70, 53, 54, 71, 72
@@ -669,6 +782,12 @@ void Client::RunUDP( void ) {
 	now.setnow();
 	reportstruct->packetTime.tv_sec = now.getSecs();
 	reportstruct->packetTime.tv_usec = now.getUsecs();
+	if (wakeTimed) {
+	    wakeTimed = false;
+	    reportstruct->wakes = 1;
+	    reportstruct->wakelate = now.subSec(wakeTime);
+	    reportstruct->deadlinemiss = (reportstruct->wakelate * 1e6) > mSettings->mSchedDeadline;
+	}
         if (isVaryLoad(mSettings) && mSettings->mUDPRateUnits == kRate_BW) {
 	    static Timestamp time3;
 	    if (now.subSec(time3) >= VARYLOAD_PERIOD) {
@@ -681,8 +800,30 @@ void Client::RunUDP( void ) {
 		time3 = now;
 	    }
 	}
-	// store datagram ID into buffer
-	WritePacketID(reportstruct->packetID++);
+	if (isIntendedTime(mSettings)) {
+	    if (intendedNext && (currLen > 0))
+		intendedOffset += delay_target / kSecs_to_nsecs;
+	    intendedNext = true;
+	    WriteIntendedTime(intendedStart, intendedOffset);
+	}
+	// store datagram ID into buffer, each group
+	// carries its own sequence
+	if (mcastGroups) {
+	    WritePacketID(mcastIDs[mcastNext]++);
+	    reportstruct->packetID++;
+	} else if (spraySocks) {
+	    if (mSettings->mSprayHash) {
+		// splitmix64 finalizer of the thread's datagram count
+		uint64_t h = (uint64_t) reportstruct->packetID;
+		h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+		sprayNext = (int) ((h ^ (h >> 31)) % (uint64_t) mSettings->mSprayPorts);
+	    }
+	    WritePacketID(sprayIDs[sprayNext]++);
+	    reportstruct->packetID++;
+	} else {
+	    WritePacketID(reportstruct->packetID++);
+	}
 	mBuf_UDP->tv_sec  = htonl(reportstruct->packetTime.tv_sec);
 	mBuf_UDP->tv_usec = htonl(reportstruct->packetTime.tv_usec);
 
@@ -714,18 +855,32 @@ void Client::RunUDP( void ) {
 	if (delay < delay_lower_bounds) {
 	    delay = delay_target;
 	}
+	IPERF_PROBE3(udp_pace, (int64_t) reportstruct->packetID, (int64_t) delay, (int64_t) adjust);
 
 	reportstruct->errwrite = WriteNoErr;
 	reportstruct->emptyreport = 0;
 
 	// perform write
-	if (isModeAmount(mSettings)) {
-	    currLen = write( mSettings->mSock, mBuf, (mSettings->mAmount < (unsigned) mSettings->mBufLen) ? mSettings->mAmount : mSettings->mBufLen);
+	int writeLen = mSettings->mBufLen;
+	if (isModeAmount(mSettings) && (mSettings->mAmount < (unsigned) mSettings->mBufLen)) {
+	    writeLen = mSettings->mAmount;
+	}
+	if (isVerify(mSettings) && (writeLen >= (VERIFY_UDP_OFFSET + VERIFY_MINLEN))) {
+	    verify_fill(mBuf + VERIFY_UDP_OFFSET, writeLen - VERIFY_UDP_OFFSET, ntohl(mBuf_UDP->id));
+	}
+	if (mcastGroups) {
+	    currLen = sendto( mSettings->mSock, mBuf, writeLen, 0, (sockaddr*) &mcastGroups[mcastNext], mSettings->size_peer);
+	} else if (spraySocks) {
+	    currLen = write( spraySocks[sprayNext], mBuf, writeLen);
 	} else {
-	    currLen = write( mSettings->mSock, mBuf, mSettings->mBufLen);
+	    currLen = write( mSettings->mSock, mBuf, writeLen);
 	}
 	if ( currLen < 0 ) {
 	    reportstruct->packetID--;
+	    if (mcastGroups)
+		mcastIDs[mcastNext]--;
+	    if (spraySocks)
+		sprayIDs[sprayNext]--;
 	    if (FATALUDPWRITERR(errno)) {
 	        reportstruct->errwrite = WriteErrFatal;
 	        WARN_errno( 1, "write" );
@@ -736,6 +891,12 @@ void Client::RunUDP( void ) {
 	    }
 	  reportstruct->emptyreport = 1;
 	}
+	if (mcastGroups && (++mcastNext == mSettings->mMcastGroups)) {
+	    mcastNext = 0;
+	}
+	if (spraySocks && !mSettings->mSprayHash && (++sprayNext == mSettings->mSprayPorts)) {
+	    sprayNext = 0;
+	}
 
 	if (isModeAmount(mSettings)) {
 	    /* mAmount may be unsigned, so don't let it underflow! */
@@ -749,9 +910,16 @@ void Client::RunUDP( void ) {
 	// report packets
 	reportstruct->packetLen = (unsigned long) currLen;
 	ReportPacket( mSettings->reporthdr, reportstruct );
+	reportstruct->wakes = 0;
+	reportstruct->deadlinemiss = 0;
 	// Insert delay here only if the running delay is greater than 1 usec,
 	// otherwise don't delay and immediately continue with the next tx.
 	if ( delay >= 1000 ) {
+	    if (mSettings->mSchedPeriod > 0) {
+		wakeTime.setnow();
+		wakeTime.add(delay / 1e9);
+		wakeTimed = true;
+	    }
 	    // Convert from nanoseconds to microseconds
 	    // and invoke the microsecond delay
 	    delay_loop((unsigned long) (delay / 1000));
@@ -761,6 +929,231 @@ void Client::RunUDP( void ) {
     FinishTrafficActions();
 }
 
+#if defined(HAVE_LINUX_FILTER_H) && defined(HAVE_AF_PACKET)
+/*
+ * Map the TX_RING, or open the AF_XDP socket, and fill every frame
+ * with the complete frame, the payload is mBuf, i.e. the datagram and
+ * client headers RunUDP sends
+ */
+bool Client::FramesInit (void) {
+    unsigned char frame[ETH_FRAME_LEN + MAXUDPBUF];
+    unsigned char srcmac[ETH_ALEN], dstmac[ETH_ALEN];
+    int loopback = 0, mtu = 0;
+    int ttl = (mSettings->mTTL > 0) ? mSettings->mTTL : 64;
+    const char *opt = (isXdp(mSettings) ? "--xdp" : "--tx-ring");
+
+    if (SockAddr_isIPv6(&mSettings->peer) || !mSettings->mIfrname) {
+	fprintf(stderr, warn_udp_frames, opt, "needs an IPv4 interface");
+	return false;
+    }
+    if (tx_ring_ifmac(mSettings->mIfrname, srcmac, &loopback, &mtu) != 0) {
+	fprintf(stderr, warn_udp_frames, opt, "can't read the interface MAC");
+	return false;
+    }
+    if ((mtu > 0) && ((int) (sizeof(struct iphdr) + sizeof(struct udphdr)) + mSettings->mBufLen > mtu)) {
+	fprintf(stderr, warn_udp_frames, opt, "-l exceeds the interface MTU");
+	return false;
+    }
+    if ((mSettings->mBufLen > MAXUDPBUF) && (mSettings->mBufLen > (int) (sizeof(frame) - ETH_FRAME_LEN))) {
+	fprintf(stderr, warn_udp_frames, opt, "-l is too large");
+	return false;
+    }
+    if (loopback) {
+	if (!tx_ring_loopback_ok(mSettings->mIfrname)) {
+	    fprintf(stderr, warn_udp_frames, opt, "loopback drops the frames without accept_local and route_localnet");
+	    return false;
+	}
+	memset(dstmac, 0, ETH_ALEN);
+    } else if (mSettings->mTxRingMac) {
+	tx_ring_parse_mac(mSettings->mTxRingMac, dstmac);
+    } else {
+	// the first datagram went out the UDP socket, give the
+	// kernel some time to resolve the next hop
+	int tries;
+	for (tries = 0; tries < 100; tries++) {
+	    if (tx_ring_neighbor(mSettings->mIfrname, ((struct sockaddr_in *) &mSettings->peer)->sin_addr, dstmac) == 0)
+		break;
+	    delay_loop(10000);
+	}
+	if (tries == 100) {
+	    fprintf(stderr, warn_udp_frames, opt, "no neighbor entry for the next hop");
+	    return false;
+	}
+    }
+    int framelen = tx_ring_build_udp4(frame, srcmac, dstmac, (struct sockaddr_in *) &mSettings->local, \
+				      (struct sockaddr_in *) &mSettings->peer, mSettings->mTOS, ttl, mBuf, mSettings->mBufLen);
+#ifdef HAVE_AF_XDP
+    if (isXdp(mSettings)) {
+	if (framelen > XDP_SOCK_FRAMESIZE) {
+	    fprintf(stderr, warn_udp_frames, opt, "-l is too large");
+	    return false;
+	}
+	xsk = new xdp_sock;
+	if (xdp_sock_open(xsk, mSettings->mIfrname, mSettings->mXdpQueue, 0) != 0) {
+	    delete xsk;
+	    xsk = NULL;
+	    fprintf(stderr, warn_udp_frames, opt, "can't open an AF_XDP socket (needs CAP_NET_RAW)");
+	    return false;
+	}
+	xdp_sock_tx_template(xsk, frame, framelen);
+	return true;
+    }
+#endif
+    txRing = new tx_ring;
+    int frames = 4 * mSettings->mTxRing;
+    if (frames < TXRING_MINFRAMES)
+	frames = TXRING_MINFRAMES;
+    if (tx_ring_open(txRing, mSettings->mIfrname, framelen, frames) != 0) {
+	delete txRing;
+	txRing = NULL;
+	fprintf(stderr, warn_udp_frames, opt, "can't map a TX_RING (needs CAP_NET_RAW)");
+	return false;
+    }
+    tx_ring_template(txRing, frame);
+    return true;
+}
+
+/*
+ * UDP send loop over the TX_RING or AF_XDP socket, a batch of frames
+ * per kick
+ */
+void Client::RunUDPFrames (void) {
+    struct UDP_datagram* mBuf_UDP = (struct UDP_datagram*) mBuf;
+    double delay_target = 0;
+    double delay = 0;
+    double adjust = 0;
+    int queued = 1;
+    int batch = mSettings->mTxRing;
+
+    if (mSettings->mUDPRateUnits == kRate_BW) {
+	delay_target = (double) ( mSettings->mBufLen * ((kSecs_to_nsecs * kBytes_to_Bits)
+							/ mSettings->mUDPRate) );
+    } else {
+	delay_target = 1e9 / mSettings->mUDPRate;
+    }
+    if ( delay_target < 0  ||
+	 delay_target > 1.0 * kSecs_to_nsecs ) {
+	fprintf( stderr, warn_delay_large, delay_target / kSecs_to_nsecs );
+	delay_target = 1.0 * kSecs_to_nsecs;
+    }
+
+    // The first datagram takes the UDP socket, this starts the server's
+    // flow the usual way and gets the next hop into the neighbor table
+    now.setnow();
+    reportstruct->packetTime.tv_sec = now.getSecs();
+    reportstruct->packetTime.tv_usec = now.getUsecs();
+    lastPacketTime.set(reportstruct->packetTime.tv_sec, reportstruct->packetTime.tv_usec);
+    WritePacketID(reportstruct->packetID++);
+    mBuf_UDP->tv_sec  = htonl(reportstruct->packetTime.tv_sec);
+    mBuf_UDP->tv_usec = htonl(reportstruct->packetTime.tv_usec);
+    reportstruct->errwrite = WriteNoErr;
+    reportstruct->emptyreport = 0;
+    int currLen = write(mSettings->mSock, mBuf, mSettings->mBufLen);
+    if (currLen < 0) {
+	reportstruct->packetID--;
+	reportstruct->errwrite = WriteErrAccount;
+	reportstruct->emptyreport = 1;
+	currLen = 0;
+    }
+    reportstruct->packetLen = (unsigned long) currLen;
+    ReportPacket(mSettings->reporthdr, reportstruct);
+    if (!FramesInit()) {
+	RunUDP();
+	return;
+    }
+#ifdef HAVE_AF_XDP
+    if (xsk)
+	batch = XDP_SOCK_BATCH;
+#endif
+
+    while (InProgress()) {
+	now.setnow();
+	reportstruct->packetTime.tv_sec = now.getSecs();
+	reportstruct->packetTime.tv_usec = now.getUsecs();
+	// Same running delay as RunUDP, though per batch, i.e. the
+	// frames of a kick leave back to back
+	adjust = (delay_target * queued) + (1000.0 * lastPacketTime.subUsec(reportstruct->packetTime));
+	lastPacketTime.set(reportstruct->packetTime.tv_sec, reportstruct->packetTime.tv_usec);
+	delay += adjust;
+	if (delay < delay_lower_bounds) {
+	    delay = delay_target;
+	}
+	mBuf_UDP->tv_sec  = htonl(reportstruct->packetTime.tv_sec);
+	mBuf_UDP->tv_usec = htonl(reportstruct->packetTime.tv_usec);
+	reportstruct->errwrite = WriteNoErr;
+	reportstruct->emptyreport = 0;
+	reportstruct->packetLen = mSettings->mBufLen;
+	for (queued = 0; queued < batch; queued++) {
+	    unsigned char *payload;
+#ifdef HAVE_AF_XDP
+	    payload = (xsk ? xdp_sock_tx_next(xsk) : tx_ring_next(txRing));
+#else
+	    payload = tx_ring_next(txRing);
+#endif
+	    if (!payload || (isModeAmount(mSettings) && !mSettings->mAmount))
+		break;
+	    // only the datagram header differs between frames
+	    WritePacketID(reportstruct->packetID++);
+	    memcpy(payload, mBuf, sizeof(struct UDP_datagram));
+#ifdef HAVE_AF_XDP
+	    if (xsk)
+		xdp_sock_tx_queue(xsk);
+	    else
+#endif
+		tx_ring_queue(txRing);
+	    if (isModeAmount(mSettings)) {
+		if (mSettings->mAmount >= (unsigned long) mSettings->mBufLen) {
+		    mSettings->mAmount -= (unsigned long) mSettings->mBufLen;
+		} else {
+		    mSettings->mAmount = 0;
+		}
+	    }
+	    ReportPacket(mSettings->reporthdr, reportstruct);
+	}
+	if (queued) {
+	    int rc;
+#ifdef HAVE_AF_XDP
+	    rc = (xsk ? xdp_sock_kick(xsk) : tx_ring_kick(txRing));
+#else
+	    rc = tx_ring_kick(txRing);
+#endif
+	    if ((rc < 0) && FATALUDPWRITERR(errno)) {
+		reportstruct->errwrite = WriteErrFatal;
+		WARN_errno(1, "frames send");
+		break;
+	    }
+	}
+	if (queued < batch) {
+	    // ring full, wait for the kernel to free some frames
+#ifdef HAVE_AF_XDP
+	    if (xsk)
+		xdp_sock_wait(xsk, 1);
+	    else
+#endif
+		tx_ring_wait(txRing, 1);
+	} else if (delay >= 1000) {
+	    delay_loop((unsigned long) (delay / 1000));
+	}
+    }
+    // the FIN mustn't pass frames still in the ring
+#ifdef HAVE_AF_XDP
+    if (xsk) {
+	xdp_sock_tx_drain(xsk, 1000);
+	if (isEnhanced(mSettings))
+	    printf(report_xdp_tx, procs_transferid(mSettings->mSock), mSettings->mIfrname, xsk->queue, xsk->frames, xsk->kicks);
+    } else
+#endif
+    {
+	tx_ring_drain(txRing, 1000);
+	if (isEnhanced(mSettings)) {
+	    printf(report_tx_ring, procs_transferid(mSettings->mSock), mSettings->mIfrname, txRing->frame_nr, txRing->framelen,
+		   txRing->kicks, txRing->rejected);
+	}
+    }
+    FinishTrafficActions();
+}
+#endif
+
 /*
  * UDP isochronous send loop
  */
@@ -781,11 +1174,13 @@ void Client::RunUDPIsochronous (void) {
     double adjust = 0;
     int currLen = 1;
     int frameid=0;
-    Timestamp t1;
+    Timestamp t1, deadlineTime;
     int bytecntmin;
     // make sure the packet can carry the isoch payload
     if (isModeTime(mSettings)) {
 	bytecntmin = sizeof(UDP_datagram) + sizeof(client_hdr_v1) + sizeof(struct client_hdr_udp_isoch_tests);
+	if (isIntendedTime(mSettings))
+	    bytecntmin = UDP_INTENDED_OFFSET + sizeof(UDP_intended_payload);
     } else {
 	bytecntmin = 1;
     }
@@ -794,6 +1189,7 @@ void Client::RunUDPIsochronous (void) {
 
     int initdone = 0;
     int fatalwrite_err = 0;
+    int burstpkts = 0;
     while (InProgress() && !fatalwrite_err) {
 	int bytecnt = (int) (lognormal(mSettings->mMean,mSettings->mVariance)) / (mSettings->mFPS * 8);
 	if (bytecnt < bytecntmin)
@@ -806,7 +1202,19 @@ void Client::RunUDPIsochronous (void) {
 	reportstruct->burstsize=bytecnt;
 	frameid =  fc->wait_tick();
 	mBuf_isoch->frameid  = htonl(frameid);
+	burstpkts = 0;
 	lastPacketTime.setnow();
+	// --sched-deadline, time the wake up, and the burst
+	// against the frame's deadline
+	bool timed = (mSettings->mSchedPeriod > 0) && (frameid > 1);
+	if (timed) {
+	    reportstruct->wakes = 1;
+	    reportstruct->wakelate = fc->late / 1e6;
+	    long slack = mSettings->mSchedDeadline - fc->late;
+	    deadlineTime = lastPacketTime;
+	    if (slack > 0)
+		deadlineTime.add(slack / 1e6);
+	}
 	if (!initdone) {
 	    initdone = 1;
 	    mBuf_isoch->start_tv_sec = htonl(fc->getSecs());
@@ -820,6 +1228,12 @@ void Client::RunUDPIsochronous (void) {
 	    mBuf_UDP->tv_sec  = htonl(reportstruct->packetTime.tv_sec);
 	    mBuf_UDP->tv_usec = htonl(reportstruct->packetTime.tv_usec);
 	    WritePacketID(reportstruct->packetID++);
+	    // the frame's tick then the burst's inter packet gaps
+	    if (isIntendedTime(mSettings)) {
+		Timestamp tick(fc->getSecs(), fc->getUsecs());
+		WriteIntendedTime(tick, ((double) fc->period_us() * (frameid - 1)) / 1e6 + \
+				  burstpkts * (mSettings->mBurstIPG / 1e3));
+	    }
 
 	    // Adjustment for the running delay
 	    // o measure how long the last loop iteration took
@@ -854,15 +1268,19 @@ void Client::RunUDPIsochronous (void) {
 	    reportstruct->emptyreport = 0;
 
 	    // perform write
+	    int writeLen = (bytecnt < mSettings->mBufLen) ? bytecnt : mSettings->mBufLen;
 	    if (isModeAmount(mSettings) && (mSettings->mAmount < (unsigned) mSettings->mBufLen)) {
+		writeLen = mSettings->mAmount;
 	        mBuf_isoch->remaining = htonl(mSettings->mAmount);
 		reportstruct->remaining=mSettings->mAmount;
-	        currLen = write(mSettings->mSock, mBuf, mSettings->mAmount);
 	    } else {
 	        mBuf_isoch->remaining = htonl(bytecnt);
 		reportstruct->remaining=bytecnt;
-	        currLen = write(mSettings->mSock, mBuf, (bytecnt < mSettings->mBufLen) ? bytecnt : mSettings->mBufLen);
 	    }
+	    if (isVerify(mSettings) && (writeLen >= (VERIFY_UDP_OFFSET + VERIFY_MINLEN))) {
+		verify_fill(mBuf + VERIFY_UDP_OFFSET, writeLen - VERIFY_UDP_OFFSET, ntohl(mBuf_UDP->id));
+	    }
+	    currLen = write(mSettings->mSock, mBuf, writeLen);
 
 	    if ( currLen < 0 ) {
 	        reportstruct->packetID--;
@@ -877,12 +1295,17 @@ void Client::RunUDPIsochronous (void) {
 		}
 	    } else {
 		bytecnt -= currLen;
+		burstpkts++;
 		// adjust bytecnt so last packet of burst is greater or equal to min packet
 		if ((bytecnt > 0) && (bytecnt < bytecntmin)) {
 		    bytecnt = bytecntmin;
 		    mBuf_isoch->burstsize  = htonl(bytecnt);
 		    reportstruct->burstsize=bytecnt;
 		}
+		if (timed && (bytecnt <= 0)) {
+		    Timestamp burstDone;
+		    reportstruct->deadlinemiss = deadlineTime.before(burstDone);
+		}
 	    }
 
 	    if (isModeAmount(mSettings)) {
@@ -898,6 +1321,8 @@ void Client::RunUDPIsochronous (void) {
 	    reportstruct->frameID=frameid;
 	    reportstruct->packetLen = (unsigned long) currLen;
 	    ReportPacket( mSettings->reporthdr, reportstruct );
+	    reportstruct->wakes = 0;
+	    reportstruct->deadlinemiss = 0;
 
 	    // Insert delay here only if the running delay is greater than 1 usec,
 	    // otherwise don't delay and immediately continue with the next tx.
@@ -918,6 +1343,17 @@ void Client::RunUDPIsochronous (void) {
 
 
 
+/*
+ * --intended-time, store when the datagram should have been sent, the
+ * schedule's start plus offset seconds
+ */
+void Client::WriteIntendedTime (Timestamp intended, double offset) {
+    struct UDP_intended_payload *mBuf_intended = (struct UDP_intended_payload *) (mBuf + UDP_INTENDED_OFFSET);
+    intended.add(offset);
+    mBuf_intended->tv_sec = htonl(intended.getSecs());
+    mBuf_intended->tv_usec = htonl(intended.getUsecs());
+}
+
 void Client::WritePacketID (intmax_t packetID) {
     struct UDP_datagram * mBuf_UDP = (struct UDP_datagram *) mBuf;
     // store datagram ID into buffer
@@ -941,6 +1377,114 @@ void Client::WritePacketID (intmax_t packetID) {
 #endif
 }
 
+/*
+ * --mcast-groups, the groups are consecutive addresses starting at
+ * the -c group and each has its own sequence numbers so the server
+ * can account loss per group
+ */
+void Client::McastGroupsInit (void) {
+    mcastGroups = new iperf_sockaddr[mSettings->mMcastGroups];
+    mcastIDs = new intmax_t[mSettings->mMcastGroups];
+    for (int ix = 0; ix < mSettings->mMcastGroups; ix++) {
+	mcastGroups[ix] = mSettings->peer;
+	SockAddr_incrAddress(&mcastGroups[ix], ix);
+	mcastIDs[ix] = reportstruct->packetID;
+    }
+    mcastNext = 0;
+}
+
+/*
+ * --sport-spray, the thread's socket plus K-1 more sockets connected
+ * to the same server, each on its own ephemeral source port, so one
+ * thread offers K 5-tuples to RSS or ECMP hashing.  The server sees
+ * K flows, --sum-groups src on the server adds them back up.
+ */
+void Client::SprayInit (void) {
+    int sock = mSettings->mSock;
+    int domain = (SockAddr_isIPv6( &mSettings->peer ) ?
+#ifdef HAVE_IPV6
+                  AF_INET6
+#else
+                  AF_INET
+#endif
+                  : AF_INET);
+    iperf_sockaddr local = mSettings->local;
+    int port = (mSettings->mLocalhost != NULL) ? SockAddr_getPort(&mSettings->local) : 0;
+
+    spraySocks = new int[mSettings->mSprayPorts];
+    sprayIDs = new intmax_t[mSettings->mSprayPorts];
+    spraySocks[0] = sock;
+    sprayBase = reportstruct->packetID;
+    for (int ix = 0; ix < mSettings->mSprayPorts; ix++) {
+	sprayIDs[ix] = reportstruct->packetID;
+	if (ix == 0)
+	    continue;
+	spraySocks[ix] = socket(domain, SOCK_DGRAM, 0);
+	WARN_errno( spraySocks[ix] == INVALID_SOCKET, "socket" );
+	if (spraySocks[ix] == INVALID_SOCKET) {
+	    // run with what was opened
+	    mSettings->mSprayPorts = ix;
+	    break;
+	}
+	// same socket options as the thread's socket
+	mSettings->mSock = spraySocks[ix];
+	SetSocketOptions(mSettings);
+	mSettings->mSock = sock;
+	// keep the -B address, an explicit -B port counts up
+	if (port)
+	    SockAddr_setPort(&local, port + ix);
+	else
+	    SockAddr_setPortAny(&local);
+	int rc = bind(spraySocks[ix], (sockaddr*) &local, SockAddr_get_sizeof_sockaddr(&local));
+	WARN_errno( rc == SOCKET_ERROR, "bind" );
+	rc = connect(spraySocks[ix], (sockaddr*) &mSettings->peer, SockAddr_get_sizeof_sockaddr(&mSettings->peer));
+	FAIL_errno( rc == SOCKET_ERROR, "connect", mSettings );
+    }
+    sprayNext = 0;
+}
+
+/*
+ * Start the next verify block when the last one went out whole and
+ * limit the write to the rest of the block, --verify.  The per write
+ * TCP header is left out so the stream is back to back blocks.
+ */
+void Client::VerifyTcpBlock (ReportStruct *reportstruct) {
+    if (verifyOffset == 0) {
+	verify_fill(mBuf, mSettings->mBufLen, verifyId++);
+    }
+    if (reportstruct->packetLen > (mSettings->mBufLen - verifyOffset)) {
+	reportstruct->packetLen = mSettings->mBufLen - verifyOffset;
+    }
+}
+
+/*
+ * Size of the next TCP write, per --write-sizes or else -l, and
+ * no more than what's left of -n
+ */
+int Client::NextWriteLen (void) {
+    int len = mSettings->mBufLen;
+    if (writeSizes)
+	len = size_pdf_draw(writeSizes, &writeRand, mSettings->mBufLen);
+    if (isModeAmount(mSettings) && (mSettings->mAmount < (unsigned) len))
+	len = mSettings->mAmount;
+    return len;
+}
+
+/*
+ * Timestamp a write as it's submitted, the header otherwise carries
+ * the end of the previous write and the server's --tcp-framing write
+ * latency would include the time between the writes.  Only the runs
+ * that time their writes, the others would pay a clock read per write
+ * for nothing.
+ */
+void Client::StampTcpWrite (ReportStruct *reportstruct) {
+    if ((mSettings->mInterval > 0) || isEnhanced(mSettings)) {
+	now.setnow();
+	reportstruct->packetTime.tv_sec = now.getSecs();
+	reportstruct->packetTime.tv_usec = now.getUsecs();
+    }
+}
+
 void Client::WriteTcpHdr (ReportStruct *reportstruct) {
     struct TCP_datagram * mBuf_TCP = (struct TCP_datagram *) mBuf;
     // store packet ID into buffer
@@ -984,6 +1528,10 @@ bool Client::InProgress (void) {
 	    return false;
     }
 
+#ifdef HAVE_FLOWTIMER
+    if (flowTimer.expired)
+	return false;
+#endif
     if (sInterupted ||
 	(isModeTime(mSettings) &&  mEndTime.before(reportstruct->packetTime))  ||
 	(isModeAmount(mSettings) && (mSettings->mAmount <= 0)))
@@ -996,6 +1544,10 @@ bool Client::InProgress (void) {
  * Common things to do to finish a traffic thread
  */
 void Client::FinishTrafficActions(void) {
+#ifdef HAVE_FLOWTIMER
+    // the end of test exchanges aren't to be interrupted
+    flowtimer_stop(&flowTimer);
+#endif
     // stop timing
     now.setnow();
     reportstruct->packetTime.tv_sec = now.getSecs();
@@ -1017,6 +1569,39 @@ void Client::FinishTrafficActions(void) {
     }
     CloseReport( mSettings->reporthdr, reportstruct );
     EndReport( mSettings->reporthdr );
+    if (isFullReport(mSettings) && !isUDP(mSettings)) {
+	ReadServerReport();
+    }
+}
+
+/*
+ * --full-report over TCP, half close so the server sees the end of
+ * the test, then read the server's final report it writes back
+ */
+void Client::ReadServerReport(void) {
+    hdr_typelen typelen;
+    int len;
+    struct timeval timeout;
+    timeout.tv_sec = FULLREPORT_WAIT;
+    timeout.tv_usec = 0;
+    shutdown(mSettings->mSock, SHUT_WR);
+    if (setsockopt(mSettings->mSock, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout)) < 0) {
+	WARN_errno(1, "setsockopt SO_RCVTIMEO");
+    }
+    if ((recvn(mSettings->mSock, (char *) &typelen, sizeof(typelen), 0) != (int) sizeof(typelen)) || \
+	(ntohl(typelen.type) != SERVERFULLREPORT) || ((len = ntohl(typelen.length)) < (int) sizeof(server_fullreport)) || \
+	(len > FULLREPORT_MAXLEN)) {
+	fprintf(stderr, warn_no_full_report, procs_transferid(mSettings->mSock));
+	return;
+    }
+    char *report = new char[len];
+    memcpy(report, &typelen, sizeof(typelen));
+    if (recvn(mSettings->mSock, report + sizeof(typelen), len - sizeof(typelen), 0) == (int) (len - sizeof(typelen))) {
+	ReportServerTCP(mSettings, report, len);
+    } else {
+	fprintf(stderr, warn_no_full_report, procs_transferid(mSettings->mSock));
+    }
+    DELETE_ARRAY( report );
 }
 
 
@@ -1038,63 +1623,192 @@ void Client::FinalUDPHandshake(void) {
     if ( isMulticast( mSettings ) ) {
 	// Multicast threads only sends one negative sequence number packet
 	// and doesn't wait for a server ack
-	write(mSettings->mSock, mBuf, mSettings->mBufLen);
+	if (mcastGroups) {
+	    for (int ix = 0; ix < mSettings->mMcastGroups; ix++) {
+		WritePacketID(-mcastIDs[ix]);
+		sendto(mSettings->mSock, mBuf, mSettings->mBufLen, 0, (sockaddr*) &mcastGroups[ix], mSettings->size_peer);
+	    }
+	} else {
+	    write(mSettings->mSock, mBuf, mSettings->mBufLen);
+	}
+    } else if (spraySocks) {
+	SprayFIN();
     } else {
 	// Unicast send and wait for acks
-	write_UDP_FIN();
+	write_UDP_FIN(1, &mSettings->mSock, &reportstruct->packetID);
     }
 }
 
-void Client::write_UDP_FIN (void) {
-    int rc;
-    fd_set readSet;
-    struct timeval timeout;
+/*
+ * --sport-spray, print what went out per source port then run the
+ * end of test handshake over all of the sprayed sockets at once
+ */
+void Client::SprayFIN (void) {
+    for (int ix = 0; ix < mSettings->mSprayPorts; ix++) {
+	iperf_sockaddr sport;
+	Socklen_t size_sport = sizeof(sport);
+	getsockname(spraySocks[ix], (sockaddr*) &sport, &size_sport);
+	printf(report_sport_spray, spraySocks[ix], SockAddr_getPort(&sport), sprayIDs[ix] - sprayBase);
+    }
+    write_UDP_FIN(mSettings->mSprayPorts, spraySocks, sprayIDs);
+}
 
-    int count = 0;
-    while ( count < 10 ) {
-        count++;
-
-        // write data
-        write( mSettings->mSock, mBuf, mSettings->mBufLen );
-	// decrement the packet count
-	//
-	// Note: a negative packet id is used to tell the server
-        // this UDP stream is terminating.  The server will remove
-        // the sign.  So a decrement will be seen as increments by
-	// the server (e.g, -1000, -1001, -1002 as 1000, 1001, 1002)
-        // If the retries weren't decrement here the server can get out
-        // of order packets per these retries actually being received
-        // by the server (e.g. -1000, -1000, -1000)
-	WritePacketID(-(++reportstruct->packetID));
-
-        // wait until the socket is readable, or our timeout expires
-        FD_ZERO( &readSet );
-        FD_SET( mSettings->mSock, &readSet );
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 250000; // quarter second, 250 ms
-
-        rc = select( mSettings->mSock+1, &readSet, NULL, NULL, &timeout );
-        FAIL_errno( rc == SOCKET_ERROR, "select", mSettings );
-
-	if ( rc == 0 ) {
-            // select timed out
-            continue;
-        } else {
-            // socket ready to read, this packet size
-	    // is set by the server.  Assume it's large enough
-	    // to contain the final server packet
-            rc = read( mSettings->mSock, mBuf, MAXUDPBUF);
-	    WARN_errno( rc < 0, "read" );
-	    if ( rc < 0 ) {
-                break;
-            } else if ( rc >= (int) (sizeof(UDP_datagram) + sizeof(server_hdr)) ) {
-                ReportServerUDP( mSettings, (server_hdr*) ((UDP_datagram*)mBuf + 1) );
-            }
-            return;
-        }
+/*
+ * UDP FIN retransmit timer, RFC 6298 smoothing of the FIN to AckFIN
+ * round trips.  Shared by the client threads of the process so a
+ * flow's first FIN is timed by the flows that finished before it.
+ */
+static double finSrtt = -1.0;
+static double finRttvar = 0.0;
+
+static double udpfin_rto (void) {
+    double rto;
+    Mutex_Lock(&udpfinCond);
+    rto = (finSrtt < 0) ? UDPFIN_RTO_INIT : (finSrtt + 4 * finRttvar);
+    Mutex_Unlock(&udpfinCond);
+    if (rto < UDPFIN_RTO_MIN)
+	rto = UDPFIN_RTO_MIN;
+    return ((rto > UDPFIN_RTO_MAX) ? UDPFIN_RTO_MAX : rto);
+}
+
+static void udpfin_rtt_sample (double rtt) {
+    Mutex_Lock(&udpfinCond);
+    if (finSrtt < 0) {
+	finSrtt = rtt;
+	finRttvar = rtt / 2;
+    } else {
+	finRttvar = 0.75 * finRttvar + 0.25 * fabs(finSrtt - rtt);
+	finSrtt = 0.875 * finSrtt + 0.125 * rtt;
     }
+    Mutex_Unlock(&udpfinCond);
+}
+
+/*
+ * Unicast UDP end of test over n sockets, ids are the sockets' next
+ * datagram ids.  Every socket sends its FIN and all of them wait
+ * together for the server's AckFIN, which carries the final server
+ * report.  FINs still unacked when the retransmit timer fires are
+ * resent and the timer doubles.  A socket that has its AckFIN sends
+ * a FINACKACK so the server can stop lingering.  Only a read of the
+ * server report acks a socket's FIN, a socket whose read fails, e.g.
+ * no server on its port, stops waiting unacked.
+ *
+ * The wait covers the sockets of one thread.  The -P flows run it in
+ * their own threads at the same time, so a test's teardown is its
+ * slowest flow's rather than the sum; it's deliberately not pooled
+ * across the threads, that would tie each flow's end to the others'.
+ * flows/udp_fin_loss.py measures the teardown under loss.
+ */
+void Client::write_UDP_FIN (int n, int *socks, intmax_t *ids) {
+    int sock = mSettings->mSock;
+    iperf_sockaddr local = mSettings->local;
+    Socklen_t size_local = mSettings->size_local;
+    bool *acked = new bool[n];
+    bool *done = new bool[n];
+    // acks are read aside so mBuf still holds the FIN for retries,
+    // a --full-report rides the ack
+    int ackLen = (isFullReport(mSettings) ? (SIZEOF_UDPACKFIN + FULLREPORT_MAXLEN) : MAXUDPBUF);
+    char *ackBuf = new char[ackLen];
+    int waiting = n;
+    int count = 0;
+    double rto = udpfin_rto();
+    double rto_initial = rto;
+    Timestamp start, sent;
 
-    fprintf( stderr, warn_no_ack, mSettings->mSock, count );
+    for (int ix = 0; ix < n; ix++) {
+	acked[ix] = false;
+	done[ix] = false;
+    }
+    while (waiting && (count < UDPFIN_TRIES) && (now.subSec(start) < UDPFIN_BUDGET)) {
+	fd_set finSet;
+	int maxfd = 0;
+	count++;
+	FD_ZERO(&finSet);
+	for (int ix = 0; ix < n; ix++) {
+	    if (done[ix])
+		continue;
+	    // decrement the packet count
+	    //
+	    // Note: a negative packet id is used to tell the server
+	    // this UDP stream is terminating.  The server will remove
+	    // the sign.  So a decrement will be seen as increments by
+	    // the server (e.g, -1000, -1001, -1002 as 1000, 1001, 1002)
+	    // If the retries weren't decrement here the server can get out
+	    // of order packets per these retries actually being received
+	    // by the server (e.g. -1000, -1000, -1000)
+	    WritePacketID(-(ids[ix]++));
+	    write(socks[ix], mBuf, mSettings->mBufLen);
+	    FD_SET(socks[ix], &finSet);
+	    if (socks[ix] > maxfd)
+		maxfd = socks[ix];
+	}
+	sent.setnow();
+	// take the acks as they come until this round's timer is up
+	double wait = rto;
+	while (waiting && (wait > 0)) {
+	    fd_set readSet = finSet;
+	    struct timeval timeout;
+	    timeout.tv_sec = (long) wait;
+	    timeout.tv_usec = (long) ((wait - timeout.tv_sec) * rMillion);
+	    int rc = select(maxfd + 1, &readSet, NULL, NULL, &timeout);
+	    FAIL_errno( rc == SOCKET_ERROR, "select", mSettings );
+	    if (rc == 0)
+		break;
+	    now.setnow();
+	    for (int ix = 0; ix < n; ix++) {
+		if (done[ix] || !FD_ISSET(socks[ix], &readSet))
+		    continue;
+		// this packet size is set by the server, it carries
+		// the whole server_hdr
+		int len = read(socks[ix], ackBuf, ackLen);
+		if (len < 0) {
+		    if ((errno == EINTR) || (errno == EAGAIN))
+			continue;
+		    WARN_errno( 1, "read" );
+		} else if (len < (int) (sizeof(UDP_datagram) + sizeof(server_hdr))) {
+		    // not the server's report, e.g. a stray datagram
+		    continue;
+		} else {
+		    acked[ix] = true;
+		}
+		done[ix] = true;
+		FD_CLR(socks[ix], &finSet);
+		waiting--;
+		if (!acked[ix])
+		    continue;
+		// Karn, only acks of a first transmission time the round trip
+		if (count == 1)
+		    udpfin_rtt_sample(now.subSec(sent));
+		UDP_datagram *ackack = (UDP_datagram *) ackBuf;
+		memset(ackack, 0, sizeof(UDP_datagram));
+		ackack->tv_usec = htonl(UDP_FINACKACK);
+		write(socks[ix], ackBuf, sizeof(UDP_datagram));
+		// report each flow under its own socket and source port
+		mSettings->mSock = socks[ix];
+		mSettings->size_local = sizeof(iperf_sockaddr);
+		getsockname(socks[ix], (sockaddr*) &mSettings->local, &mSettings->size_local);
+		ReportServerUDP( mSettings, (server_hdr*) ((UDP_datagram*)ackBuf + 1), len - sizeof(UDP_datagram) );
+		mSettings->mSock = sock;
+		mSettings->local = local;
+		mSettings->size_local = size_local;
+	    }
+	    wait = rto - now.subSec(sent);
+	}
+	now.setnow();
+	rto *= 2;
+	if (rto > UDPFIN_RTO_MAX)
+	    rto = UDPFIN_RTO_MAX;
+    }
+    now.setnow();
+    for (int ix = 0; ix < n; ix++) {
+	if (!acked[ix])
+	    fprintf( stderr, warn_no_ack, socks[ix], count );
+    }
+    if (isEnhanced(mSettings))
+	printf(report_udp_fin, sock, 1e3 * now.subSec(start), count, 1e3 * rto_initial);
+    DELETE_ARRAY( acked );
+    DELETE_ARRAY( done );
+    DELETE_ARRAY( ackBuf );
 }
 // end write_UDP_FIN
 
@@ -0,0 +1,258 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * Energy.c
+ * RAPL energy accounting (--energy)
+ *
+ * The powercap intel-rapl zones (also used for AMD) count energy in
+ * microjoules per package, the package's DRAM is a subzone named
+ * "dram".  Other zones, e.g. psys, overlap the packages and are
+ * skipped.  The counters wrap at max_energy_range_uj, each sample
+ * accumulates the delta since the previous so a wrap between samples
+ * is taken.  The energy_uj files stay open, each sample is a pread()
+ * from offset zero.  They're root only on most kernels.
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "Energy.h"
+#include "util.h"
+#ifndef WIN32
+#include <dirent.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ENERGY_POWERCAP "/sys/class/powercap"
+#define ENERGY_MAXZONES 16
+
+typedef struct EnergyZone {
+    int fd;
+    int dram;
+    uintmax_t range;		// max_energy_range_uj, 0 unknown
+    uintmax_t last;		// raw counter at the last sample
+    uintmax_t total;		// accumulated uJ
+} EnergyZone;
+
+static struct {
+    EnergyZone zones[ENERGY_MAXZONES];
+    int nzones;
+    int hasdram;
+    EnergyMark prev, cur;
+} rapl = { .nzones = 0 };
+
+#ifndef WIN32
+static double energy_now (void) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec + (now.tv_usec / 1e6);
+}
+
+static int energy_read (int fd, uintmax_t *value) {
+    char buf[32];
+    ssize_t len = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0)
+	return 0;
+    buf[len] = '\0';
+    *value = strtoumax(buf, NULL, 10);
+    return 1;
+}
+
+static int energy_readfile (const char *zone, const char *file, char *buf, size_t buflen) {
+    char path[PATH_MAX];
+    ssize_t len;
+    int fd;
+    snprintf(path, sizeof(path), ENERGY_POWERCAP "/%s/%s", zone, file);
+    if ((fd = open(path, O_RDONLY)) < 0)
+	return 0;
+    len = read(fd, buf, buflen - 1);
+    close(fd);
+    if (len <= 0)
+	return 0;
+    buf[len] = '\0';
+    buf[strcspn(buf, "\n")] = '\0';
+    return 1;
+}
+
+static void energy_sample (EnergyMark *into) {
+    int ix;
+    into->time = energy_now();
+    into->package = 0;
+    into->dram = 0;
+    for (ix = 0; ix < rapl.nzones; ix++) {
+	EnergyZone *zone = &rapl.zones[ix];
+	uintmax_t raw;
+	// a failed read keeps the zone's total, as the marks are
+	// compared with later samples
+	if (energy_read(zone->fd, &raw)) {
+	    if (raw >= zone->last)
+		zone->total += raw - zone->last;
+	    else if (zone->range > zone->last)
+		zone->total += (zone->range - zone->last) + raw;
+	    zone->last = raw;
+	}
+	if (zone->dram)
+	    into->dram += zone->total;
+	else
+	    into->package += zone->total;
+    }
+}
+#endif
+
+/*
+ * Find the package and DRAM zones, open their counters and take the
+ * first sample of the intervals.  Without RAPL, or without permission to read it,
+ * warn and report nothing.
+ */
+void energy_open (void) {
+#ifndef WIN32
+    DIR *dir;
+    struct dirent *entry;
+    char name[64], value[32], path[PATH_MAX];
+    int denied = 0;
+
+    if ((dir = opendir(ENERGY_POWERCAP)) == NULL) {
+	fprintf(stderr, "WARNING: no RAPL energy counters (" ENERGY_POWERCAP "), --energy is ignored\n");
+	return;
+    }
+    while (((entry = readdir(dir)) != NULL) && (rapl.nzones < ENERGY_MAXZONES)) {
+	EnergyZone *zone = &rapl.zones[rapl.nzones];
+	// intel-rapl:<package> and its intel-rapl:<package>:<subzone>
+	if (strncmp(entry->d_name, "intel-rapl:", 11) != 0)
+	    continue;
+	if (!energy_readfile(entry->d_name, "name", name, sizeof(name)))
+	    continue;
+	if (strncmp(name, "package", 7) == 0)
+	    zone->dram = 0;
+	else if (strcmp(name, "dram") == 0)
+	    zone->dram = 1;
+	else
+	    continue;
+	snprintf(path, sizeof(path), ENERGY_POWERCAP "/%s/energy_uj", entry->d_name);
+	if ((zone->fd = open(path, O_RDONLY)) < 0) {
+	    if (errno == EACCES)
+		denied = 1;
+	    continue;
+	}
+	zone->range = 0;
+	if (energy_readfile(entry->d_name, "max_energy_range_uj", value, sizeof(value)))
+	    zone->range = strtoumax(value, NULL, 10);
+	if (!energy_read(zone->fd, &zone->last)) {
+	    close(zone->fd);
+	    continue;
+	}
+	zone->total = 0;
+	if (zone->dram)
+	    rapl.hasdram = 1;
+	rapl.nzones++;
+    }
+    closedir(dir);
+    if (!rapl.nzones) {
+	if (denied)
+	    fprintf(stderr, "WARNING: RAPL energy counters need root, --energy is ignored\n");
+	else
+	    fprintf(stderr, "WARNING: no RAPL energy counters (" ENERGY_POWERCAP "), --energy is ignored\n");
+	return;
+    }
+    energy_sample(&rapl.cur);
+    rapl.prev = rapl.cur;
+#else
+    fprintf(stderr, "WARNING: no RAPL energy counters, --energy is ignored\n");
+#endif
+}
+
+/*
+ * Mark the start of a flow, or of a sum of flows, the base of its
+ * final report.  Like the reports, only called by the reporter
+ * thread as a sample updates the zones' totals.
+ */
+void energy_mark (EnergyMark *mark) {
+#ifndef WIN32
+    if (rapl.nzones)
+	energy_sample(mark);
+#endif
+}
+
+/*
+ * Fill in the report for an interval, or the whole test from the
+ * base mark when final is set, returns 0 when there's nothing to
+ * report.  Like the softirqs a new interval sample is only taken
+ * once at least half the interval has passed since the last one.
+ */
+int energy_report (EnergyReport *report, EnergyMark *base, double interval, int final) {
+#ifndef WIN32
+    EnergyMark *from, *to, last;
+    if (!rapl.nzones)
+	return 0;
+    if (final) {
+	// a flow that ended before its report was ever processed
+	if (base->time <= 0)
+	    return 0;
+	energy_sample(&last);
+	from = base;
+	to = &last;
+    } else {
+	if ((energy_now() - rapl.cur.time) >= (interval / 2)) {
+	    rapl.prev = rapl.cur;
+	    energy_sample(&rapl.cur);
+	}
+	from = &rapl.prev;
+	to = &rapl.cur;
+    }
+    // the first interval of a late flow may come before a second sample
+    if (to->time <= from->time)
+	return 0;
+    report->seconds = to->time - from->time;
+    report->package = (to->package - from->package) / 1e6;
+    report->dram = (to->dram - from->dram) / 1e6;
+    report->hasdram = rapl.hasdram;
+    report->perjoule = 0;
+    report->sum = 0;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
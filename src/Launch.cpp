@@ -67,7 +67,50 @@
 #ifdef HAVE_MLOCKALL
 #include <sys/mman.h>
 #endif
+#ifdef HAVE_SCHED_DEADLINE
+#include <sys/syscall.h>
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+// glibc has no sched_setattr(), this is the kernel's struct sched_attr
+struct sched_dl_attr {
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;   // units are nanoseconds
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+};
+#endif
 static void set_scheduler(thread_Settings *thread) {
+#ifdef HAVE_SCHED_DEADLINE
+    // --sched-deadline, a runtime reservation every period which
+    // the kernel schedules ahead of all other tasks
+    if (thread->mSchedPeriod > 0) {
+	struct sched_dl_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.sched_policy = SCHED_DEADLINE;
+	attr.sched_runtime = (uint64_t) thread->mSchedRuntime * 1000;
+	attr.sched_deadline = (uint64_t) thread->mSchedDeadline * 1000;
+	attr.sched_period = (uint64_t) thread->mSchedPeriod * 1000;
+#ifdef HAVE_MLOCKALL
+	// before the switch, the faulting in would overrun the reservation
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+	    perror ("mlockall");
+	}
+#endif
+	if (syscall(SYS_sched_setattr, 0, &attr, 0) < 0) {
+	    // EPERM without CAP_SYS_NICE or with a CPU affinity, EBUSY
+	    // when admission control rejects the reservation
+	    perror("Client set SCHED_DEADLINE");
+	    thread->mSchedPeriod = 0;
+	}
+	return;
+    }
+#endif
 #if HAVE_SCHED_SETSCHEDULER
 	//如果设置为realtime，则更改调度
     if ( isRealtime( thread ) ) {
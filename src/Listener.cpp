@@ -83,6 +83,8 @@
 #include "version.h"
 #include "Locale.h"
 #include "SocketAddr.h"
+#include "verify.h"
+#include "probes.h"
 
 #if (defined HAVE_SSM_MULTICAST) && (defined HAVE_NET_IF_H)
 #include <net/if.h>
@@ -95,6 +97,9 @@ Listener::Listener( thread_Settings *inSettings ) {
 
     mClients = inSettings->mThreads;
     mBuf = NULL;
+    mcastGroups = NULL;
+    mcastSocks = NULL;
+    mcastSockCnt = 0;
     ListenSocket = INVALID_SOCKET;
     /*
      * These thread settings are stored in three places
@@ -139,7 +144,14 @@ Listener::~Listener() {
         int rc = close( ListenSocket );
         WARN_errno( rc == SOCKET_ERROR, "listener close" );
     }
+    // the pool's first socket is the listen socket
+    for ( int ix = 1; ix < mcastSockCnt; ix++ ) {
+	int rc = close( mcastSocks[ix] );
+	WARN_errno( rc == SOCKET_ERROR, "mcast pool close" );
+    }
     DELETE_ARRAY( mBuf );
+    DELETE_ARRAY( mcastGroups );
+    DELETE_ARRAY( mcastSocks );
 } // end ~Listener
 
 /* -------------------------------------------------------------------
@@ -166,6 +178,11 @@ void Listener::Run( void ) {
         UDPSingleServer();
     } else
 #endif
+#endif
+#ifdef HAVE_MULTICAST
+    if ( isUDP( mSettings ) && mcastGroups ) {
+        McastScaleServer();
+    } else
 #endif
     {
         bool client = false, UDP = isUDP( mSettings ), mCount = (mSettings->mThreads != 0);
@@ -383,6 +400,14 @@ void Listener::Listen( ) {
     int boolean = 1;
     Socklen_t len = sizeof(boolean);
     setsockopt( ListenSocket, SOL_SOCKET, SO_REUSEADDR, (char*) &boolean, len );
+#ifdef SO_REUSEPORT
+    // --processes, the workers' listeners share the port and the
+    // kernel spreads the connections across them
+    if ( mSettings->mProcesses > 1 ) {
+	int rc = setsockopt( ListenSocket, SOL_SOCKET, SO_REUSEPORT, (char*) &boolean, len );
+	WARN_errno( rc == SOCKET_ERROR, "so_reuseport" );
+    }
+#endif
 
     // bind socket to server address
 #ifdef WIN32
@@ -393,7 +418,16 @@ void Listener::Listen( ) {
     } else
 #endif
 	{
-	    rc = bind( ListenSocket, (sockaddr*) &mSettings->local, mSettings->size_local );
+	    iperf_sockaddr *bindaddr = &mSettings->local;
+	    iperf_sockaddr any;
+	    if ( SockAddr_isMulticast( &mSettings->local ) && (mSettings->mMcastGroups > 1) ) {
+		// the pool sockets share the port, the group of a
+		// packet is taken from its packet info
+		any = mSettings->local;
+		SockAddr_setAddressAny( &any );
+		bindaddr = &any;
+	    }
+	    rc = bind( ListenSocket, (sockaddr*) bindaddr, mSettings->size_local );
 	    FAIL_errno( rc == SOCKET_ERROR, "bind", mSettings );
 	}
 
@@ -418,7 +452,10 @@ void Listener::Listen( ) {
     // if multicast, join the group
     if ( SockAddr_isMulticast( &mSettings->local ) ) {
 #ifdef HAVE_MULTICAST
-	McastJoin( );
+	if ( mSettings->mMcastGroups > 1 )
+	    McastJoinGroups( );
+	else
+	    McastJoin( ListenSocket );
 #else
 	fprintf(stderr, "Multicast not supported");
 #endif // HAVE_MULTICAST
@@ -427,7 +464,10 @@ void Listener::Listen( ) {
 } // end Listen
 
 /* -------------------------------------------------------------------
- * Joins the multicast group or source and group (SSM S,G)
+ * Joins the multicast group or source and group (SSM S,G) on the socket
+ *
+ * With --mcast-groups a failed join isn't warned about or fatal, it
+ * returns SOCKET_ERROR with errno set for McastJoinGroups to record.
  *
  * taken from: https://www.ibm.com/support/knowledgecenter/en/SSLTBW_2.1.0/com.ibm.zos.v2r1.hale001/ipv6d0141001708.htm
  *
@@ -462,7 +502,7 @@ void Listener::Listen( ) {
  *
  * ------------------------------------------------------------------- */
 
-void Listener::McastJoin( ) {
+int Listener::McastJoin( int sock ) {
     // This is the older mulitcast join code.  Both SSM and binding the
     // an interface requires the newer socket options.  Using the older
     // code here will maintain compatiblity with previous iperf versions
@@ -476,8 +516,10 @@ void Listener::McastJoin( ) {
 
 	    mreq.imr_interface.s_addr = htonl( INADDR_ANY );
 
-	    int rc = setsockopt( ListenSocket, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+	    int rc = setsockopt( sock, IPPROTO_IP, IP_ADD_MEMBERSHIP,
 				 (char*) &mreq, sizeof(mreq));
+	    if ( mcastGroups )
+		return rc;
 	    WARN_errno( rc == SOCKET_ERROR, "multicast join" );
 
 	} else {
@@ -489,8 +531,10 @@ void Listener::McastJoin( ) {
 
 	    mreq.ipv6mr_interface = 0;
 
-	    int rc = setsockopt( ListenSocket, IPPROTO_IPV6, IPV6_ADD_MEMBERSHIP,
+	    int rc = setsockopt( sock, IPPROTO_IPV6, IPV6_ADD_MEMBERSHIP,
 				 (char*) &mreq, sizeof(mreq));
+	    if ( mcastGroups )
+		return rc;
 	    WARN_errno( rc == SOCKET_ERROR, "multicast v6 join" );
 #else
 	    fprintf(stderr, "Unfortunately, IPv6 multicast is not supported on this platform\n");
@@ -500,7 +544,6 @@ void Listener::McastJoin( ) {
 #ifdef HAVE_SSM_MULTICAST
 	// Here it's either an SSM S,G multicast join or a *,G with an interface specifier
 	// Use the newer socket options when these are specified
-	socklen_t socklen = sizeof(struct sockaddr_storage);
 	int iface=0;
 	int rc;
 
@@ -529,8 +572,7 @@ void Listener::McastJoin( ) {
 		source->sin6_family = AF_INET6;
 		group->sin6_family = AF_INET6;
 		/* Set the group */
-		rc=getsockname(ListenSocket,(struct sockaddr *)group, &socklen);
-		FAIL_errno( rc == SOCKET_ERROR, "mcast join source group getsockname",mSettings );
+		memcpy(&group->sin6_addr, SockAddr_get_in6_addr(&mSettings->local), sizeof(group->sin6_addr));
 		group->sin6_port = 0;    /* Ignored */
 
 		/* Set the source, apply the S,G */
@@ -542,9 +584,11 @@ void Listener::McastJoin( ) {
 #endif
 		rc = -1;
 #if HAVE_DECL_MCAST_JOIN_SOURCE_GROUP
-		rc = setsockopt(ListenSocket,IPPROTO_IPV6,MCAST_JOIN_SOURCE_GROUP, &group_source_req,
+		rc = setsockopt(sock,IPPROTO_IPV6,MCAST_JOIN_SOURCE_GROUP, &group_source_req,
 			    sizeof(group_source_req));
 #endif
+		if ( (rc == SOCKET_ERROR) && mcastGroups )
+		    return rc;
 		FAIL_errno( rc == SOCKET_ERROR, "mcast v6 join source group",mSettings);
 	    } else {
 		struct group_req group_req;
@@ -556,14 +600,15 @@ void Listener::McastJoin( ) {
 		group=(struct sockaddr_in6*)&group_req.gr_group;
 		group->sin6_family = AF_INET6;
 		/* Set the group */
-		rc=getsockname(ListenSocket,(struct sockaddr *)group, &socklen);
-		FAIL_errno( rc == SOCKET_ERROR, "mcast v6 join group getsockname",mSettings );
+		memcpy(&group->sin6_addr, SockAddr_get_in6_addr(&mSettings->local), sizeof(group->sin6_addr));
 		group->sin6_port = 0;    /* Ignored */
 		rc = -1;
 #if HAVE_DECL_MCAST_JOIN_GROUP
-		rc = setsockopt(ListenSocket,IPPROTO_IPV6,MCAST_JOIN_GROUP, &group_req,
+		rc = setsockopt(sock,IPPROTO_IPV6,MCAST_JOIN_GROUP, &group_req,
 				sizeof(group_source_req));
 #endif
+		if ( (rc == SOCKET_ERROR) && mcastGroups )
+		    return rc;
 		FAIL_errno( rc == SOCKET_ERROR, "mcast v6 join group",mSettings);
 	    }
 #else
@@ -595,8 +640,7 @@ void Listener::McastJoin( ) {
 		source->sin_family = AF_INET;
 		group->sin_family = AF_INET;
 		/* Set the group */
-		rc=getsockname(ListenSocket,(struct sockaddr *)group, &socklen);
-		FAIL_errno( rc == SOCKET_ERROR, "mcast join source group getsockname",mSettings );
+		memcpy(&group->sin_addr, SockAddr_get_in_addr(&mSettings->local), sizeof(group->sin_addr));
 		group->sin_port = 0;    /* Ignored */
 
 		/* Set the source, apply the S,G */
@@ -609,7 +653,7 @@ void Listener::McastJoin( ) {
 		rc = -1;
 
 #if HAVE_DECL_MCAST_JOIN_SOURCE_GROUP
-		rc = setsockopt(ListenSocket,IPPROTO_IP,MCAST_JOIN_SOURCE_GROUP, &group_source_req,
+		rc = setsockopt(sock,IPPROTO_IP,MCAST_JOIN_SOURCE_GROUP, &group_source_req,
 				sizeof(group_source_req));
 #endif
 
@@ -626,10 +670,12 @@ void Listener::McastJoin( ) {
 		    imr.imr_multiaddr = ((const struct sockaddr_in *)group)->sin_addr.s_addr;
 		    imr.imr_sourceaddr = ((const struct sockaddr_in *)source)->sin_addr.s_addr;
 #endif
-		    rc = setsockopt (ListenSocket, IPPROTO_IP, IP_ADD_SOURCE_MEMBERSHIP, (char*)(&imr), sizeof (imr));
+		    rc = setsockopt (sock, IPPROTO_IP, IP_ADD_SOURCE_MEMBERSHIP, (char*)(&imr), sizeof (imr));
 		}
 #endif
 #endif
+		if ( (rc == SOCKET_ERROR) && mcastGroups )
+		    return rc;
 		FAIL_errno( rc == SOCKET_ERROR, "mcast join source group",mSettings);
 	    } else {
 		struct group_req group_req;
@@ -641,14 +687,15 @@ void Listener::McastJoin( ) {
 		group=(struct sockaddr_in*)&group_req.gr_group;
 		group->sin_family = AF_INET;
 		/* Set the group */
-		rc=getsockname(ListenSocket,(struct sockaddr *)group, &socklen);
-		FAIL_errno( rc == SOCKET_ERROR, "mcast join group getsockname",mSettings );
+		memcpy(&group->sin_addr, SockAddr_get_in_addr(&mSettings->local), sizeof(group->sin_addr));
 		group->sin_port = 0;    /* Ignored */
 		rc = -1;
 #if HAVE_DECL_MCAST_JOIN_GROUP
-		rc = setsockopt(ListenSocket,IPPROTO_IP,MCAST_JOIN_GROUP, &group_req,
+		rc = setsockopt(sock,IPPROTO_IP,MCAST_JOIN_GROUP, &group_req,
 				sizeof(group_source_req));
 #endif
+		if ( (rc == SOCKET_ERROR) && mcastGroups )
+		    return rc;
 		FAIL_errno( rc == SOCKET_ERROR, "mcast join group",mSettings);
 	    }
 	}
@@ -657,6 +704,7 @@ void Listener::McastJoin( ) {
 	exit(-1);
 #endif
     }
+    return 0;
 }
 // end McastJoin
 
@@ -794,6 +842,168 @@ void Listener::McastSetTTL( int val ) {
 }
 // end McastSetTTL
 
+/* -------------------------------------------------------------------
+ * Groups one socket may join, the kernel refuses more with ENOBUFS
+ * ------------------------------------------------------------------- */
+static int mcast_max_memberships( void ) {
+#ifdef IP_MAX_MEMBERSHIPS
+    int max = IP_MAX_MEMBERSHIPS;
+#else
+    int max = 20;
+#endif
+#ifdef __linux__
+    FILE *fp = fopen( "/proc/sys/net/ipv4/igmp_max_memberships", "r" );
+    if ( fp ) {
+	int val;
+	if ( (fscanf( fp, "%d", &val ) == 1) && (val > 0) )
+	    max = val;
+	fclose( fp );
+    }
+#endif
+    return max;
+}
+
+/* -------------------------------------------------------------------
+ * Options of a pool socket: the group of a packet comes from its
+ * pktinfo, and only the groups joined on the socket itself are read
+ * from it.  A wildcard bound socket otherwise gets every group the
+ * host has joined.
+ * ------------------------------------------------------------------- */
+static void mcast_pool_options( int sock, bool isv6 ) {
+    int rc, on = 1, off = 0;
+    if ( !isv6 ) {
+#ifdef IP_PKTINFO
+	rc = setsockopt( sock, IPPROTO_IP, IP_PKTINFO, (char*) &on, sizeof(on));
+	WARN_errno( rc == SOCKET_ERROR, "ip pktinfo" );
+#else
+	fprintf(stderr, "IP_PKTINFO not supported, all the packets are reported against the first group\n");
+#endif
+#ifdef IP_MULTICAST_ALL
+	rc = setsockopt( sock, IPPROTO_IP, IP_MULTICAST_ALL, (char*) &off, sizeof(off));
+	WARN_errno( rc == SOCKET_ERROR, "ip multicast all" );
+#endif
+    }
+#if defined(HAVE_IPV6_MULTICAST) && defined(IPV6_RECVPKTINFO)
+      else {
+	rc = setsockopt( sock, IPPROTO_IPV6, IPV6_RECVPKTINFO, (char*) &on, sizeof(on));
+	WARN_errno( rc == SOCKET_ERROR, "ipv6 recvpktinfo" );
+#ifdef IPV6_MULTICAST_ALL
+	rc = setsockopt( sock, IPPROTO_IPV6, IPV6_MULTICAST_ALL, (char*) &off, sizeof(off));
+	WARN_errno( rc == SOCKET_ERROR, "ipv6 multicast all" );
+#endif
+    }
+#endif
+    (void) rc; (void) on; (void) off;
+}
+
+/* -------------------------------------------------------------------
+ * Opens the next socket of the --mcast-groups pool, bound like the
+ * listen socket to the wildcard address and the port.  The packets
+ * of a group are read from the socket that joined it.
+ * ------------------------------------------------------------------- */
+int Listener::McastPoolSocket( ) {
+    int rc, on = 1;
+    int domain = (SockAddr_isIPv6( &mSettings->local ) ? AF_INET6 : AF_INET);
+    int sock = socket( domain, SOCK_DGRAM, 0 );
+    if ( sock == INVALID_SOCKET ) {
+	WARN_errno( 1, "mcast pool socket" );
+	return INVALID_SOCKET;
+    }
+    int listensock = mSettings->mSock;
+    mSettings->mSock = sock;
+    SetSocketOptions( mSettings );
+    mSettings->mSock = listensock;
+    setsockopt( sock, SOL_SOCKET, SO_REUSEADDR, (char*) &on, sizeof(on) );
+#ifdef SO_REUSEPORT
+    if ( mSettings->mProcesses > 1 ) {
+	rc = setsockopt( sock, SOL_SOCKET, SO_REUSEPORT, (char*) &on, sizeof(on) );
+	WARN_errno( rc == SOCKET_ERROR, "so_reuseport" );
+    }
+#endif
+    iperf_sockaddr any = mSettings->local;
+    SockAddr_setAddressAny( &any );
+    rc = bind( sock, (sockaddr*) &any, mSettings->size_local );
+    if ( rc == SOCKET_ERROR ) {
+	WARN_errno( 1, "mcast pool bind" );
+	close( sock );
+	return INVALID_SOCKET;
+    }
+    mcast_pool_options( sock, (domain == AF_INET6) );
+    mcastSocks[mcastSockCnt++] = sock;
+    return sock;
+}
+
+/* -------------------------------------------------------------------
+ * Joins --mcast-groups consecutive groups starting at the -B group on
+ * a pool of sockets, the listen socket first, each holding at most
+ * igmp_max_memberships groups.  A group whose join fails is recorded
+ * as such, not timestamped, and reported at the end of the test.  The
+ * join time of the others is kept so the time to their first packet
+ * can be reported.
+ * ------------------------------------------------------------------- */
+
+void Listener::McastJoinGroups( ) {
+#ifdef HAVE_MULTICAST
+    iperf_sockaddr base = mSettings->local;
+    int ix, rc, sock, joins = 0, failed = 0, lasterr = 0;
+    int maxper = mcast_max_memberships();
+    char addr[REPORT_ADDRLEN];
+
+    if ( mcastGroups == NULL ) {
+	mcastGroups = new McastGroup[mSettings->mMcastGroups];
+	// ENOBUFS can cut a socket short, at worst a socket a group
+	mcastSocks = new int[mSettings->mMcastGroups + 1];
+    }
+    // the listen socket was bound by Listen(), it only needs the
+    // options of the pool
+    mcastSocks[0] = ListenSocket;
+    mcastSockCnt = 1;
+    mcast_pool_options( ListenSocket, SockAddr_isIPv6( &base ) );
+    sock = ListenSocket;
+    for ( ix = 0; ix < mSettings->mMcastGroups; ix++ ) {
+	mSettings->local = base;
+	SockAddr_incrAddress( &mSettings->local, ix );
+	mcastGroups[ix].server = NULL;
+	mcastGroups[ix].received = false;
+	mcastGroups[ix].sock = INVALID_SOCKET;
+	mcastGroups[ix].joinerr = 0;
+	if ( (sock == INVALID_SOCKET) || (joins == maxper) ) {
+	    mSettings->local = base;
+	    sock = McastPoolSocket( );
+	    SockAddr_incrAddress( &mSettings->local, ix );
+	    joins = 0;
+	}
+	rc = (sock != INVALID_SOCKET) ? McastJoin( sock ) : SOCKET_ERROR;
+	if ( (rc == SOCKET_ERROR) && (errno == ENOBUFS) && (joins > 0) ) {
+	    // a lower per socket limit than igmp_max_memberships, e.g.
+	    // the socket option memory, carry on with a fresh socket
+	    mSettings->local = base;
+	    sock = McastPoolSocket( );
+	    SockAddr_incrAddress( &mSettings->local, ix );
+	    joins = 0;
+	    rc = (sock != INVALID_SOCKET) ? McastJoin( sock ) : SOCKET_ERROR;
+	}
+	if ( rc == SOCKET_ERROR ) {
+	    mcastGroups[ix].joinerr = (errno ? errno : EINVAL);
+	    lasterr = mcastGroups[ix].joinerr;
+	    failed++;
+	    SockAddr_getHostAddress( &mSettings->local, addr, sizeof(addr) );
+	    fprintf( stderr, warn_mcast_join_failed, addr, strerror( mcastGroups[ix].joinerr ) );
+	} else {
+	    mcastGroups[ix].sock = sock;
+	    mcastGroups[ix].joined.setnow();
+	    joins++;
+	}
+    }
+    mSettings->local = base;
+    if ( failed == mSettings->mMcastGroups ) {
+	errno = lasterr;
+	FAIL_errno( 1, "mcast join", mSettings );
+    }
+#endif
+}
+// end McastJoinGroups
+
 /* -------------------------------------------------------------------
  * After Listen() has setup mSock, this will block
  * until a new connection arrives or until the -t value occurs
@@ -855,7 +1065,13 @@ void Listener::Accept( thread_Settings *server ) {
 		Mutex_Lock( &clients_mutex );
 		// Handle connection for UDP sockets.
 		exist = Iperf_present( &server->peer, clients);
-		if ( exist == NULL ) {
+		if ((exist == NULL) && (rc >= (int) sizeof(UDP_datagram)) && \
+		    (((int32_t) ntohl(((UDP_datagram *) mBuf)->id) < 0) || \
+		     ((rc == (int) sizeof(UDP_datagram)) && (ntohl(((UDP_datagram *) mBuf)->tv_usec) == UDP_FINACKACK)))) {
+		    // A FIN retry or FINACKACK of a flow whose server thread
+		    // is done, not a new flow
+		    server->mSock = INVALID_SOCKET;
+		} else if ( exist == NULL ) {
 		    // We have a new UDP flow so let's start the
 		    // process to handle it and in a new server thread (yet to be created)
 		    server->mSock = ListenSocket;
@@ -894,6 +1110,7 @@ void Listener::Accept( thread_Settings *server ) {
 	}
     }
     if (server->mSock != INVALID_SOCKET) {
+	IPERF_PROBE2(accept, server->mSock, (int) isUDP(mSettings));
 	if (!setsock_blocking(server->mSock, 1)) {
 	    WARN(1, "Failed setting socket to blocking mode");
 	}
@@ -1137,6 +1354,235 @@ void Listener::UDPSingleServer( ) {
     Settings_Destroy( server );
 }
 
+/* -------------------------------------------------------------------
+ * Map the destination address of a received packet, per its packet
+ * info, to the index of its group, -1 if it isn't one of ours
+ * ------------------------------------------------------------------- */
+int Listener::McastGroupIndex( struct msghdr *msg ) {
+    struct cmsghdr *cmsg;
+    long ix = -1;
+
+    for ( cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg) ) {
+#ifdef IP_PKTINFO
+	if ( (cmsg->cmsg_level == IPPROTO_IP) && (cmsg->cmsg_type == IP_PKTINFO) ) {
+	    struct in_pktinfo *info = (struct in_pktinfo *) CMSG_DATA(cmsg);
+	    ix = (long) ntohl( info->ipi_addr.s_addr ) - \
+		(long) ntohl( SockAddr_get_in_addr( &mSettings->local )->s_addr );
+	    break;
+	}
+#endif
+#if defined(HAVE_IPV6_MULTICAST) && defined(IPV6_RECVPKTINFO)
+	if ( (cmsg->cmsg_level == IPPROTO_IPV6) && (cmsg->cmsg_type == IPV6_PKTINFO) ) {
+	    struct in6_pktinfo *info = (struct in6_pktinfo *) CMSG_DATA(cmsg);
+	    struct in6_addr *base = SockAddr_get_in6_addr( &mSettings->local );
+	    uint32_t dst, first;
+	    // SockAddr_incrAddress only walks the low 32 bits
+	    if ( memcmp( &info->ipi6_addr, base, 12 ) == 0 ) {
+		memcpy( &dst, ((char *) &info->ipi6_addr) + 12, sizeof(dst) );
+		memcpy( &first, ((char *) base) + 12, sizeof(first) );
+		ix = (long) ntohl( dst ) - (long) ntohl( first );
+	    }
+	    break;
+	}
+#endif
+    }
+#ifndef IP_PKTINFO
+    ix = 0;
+#endif
+    return (((ix >= 0) && (ix < mSettings->mMcastGroups)) ? (int) ix : -1);
+}
+
+/* -------------------------------------------------------------------
+ * First packet of a group, set up its report as a flow of its own
+ * and print the join latency
+ * ------------------------------------------------------------------- */
+void Listener::McastGroupStart( McastGroup *group, int ix, iperf_sockaddr *peer, Socklen_t len, ReportStruct *reportstruct ) {
+    thread_Settings *server = NULL;
+    client_hdr *hdr = (client_hdr*) (((UDP_datagram*) mBuf) + 1);
+    char addr[REPORT_ADDRLEN];
+
+    Settings_Copy( mSettings, &server );
+    server->mThreadMode = kMode_Server;
+    memcpy( &server->peer, peer, len );
+    server->size_peer = len;
+    server->local = mSettings->local;
+    SockAddr_incrAddress( &server->local, ix );
+    if ( !isCompat( mSettings ) && (ntohl( hdr->base.flags ) & HEADER_SEQNO64B) ) {
+	setSeqNo64b( server );
+    }
+    Mutex_Lock( &groupCond );
+    groupID--;
+    server->mSock = -groupID;
+    Mutex_Unlock( &groupCond );
+
+    InitReport( server );
+    if ( server->reporthdr ) {
+	server->reporthdr->report.startTime = reportstruct->packetTime;
+	server->reporthdr->report.nextTime = reportstruct->packetTime;
+	TimeAdd( server->reporthdr->report.nextTime, server->reporthdr->report.intervalTime );
+    }
+    PostReport( server->reporthdr );
+    group->server = server;
+    group->received = true;
+
+    Timestamp first( reportstruct->packetTime.tv_sec, reportstruct->packetTime.tv_usec );
+    SockAddr_getHostAddress( &server->local, addr, sizeof(addr) );
+    printf( report_mcast_join_latency, server->mSock, addr, first.subSec( group->joined ) * 1e3 );
+}
+
+void Listener::McastGroupEnd( McastGroup *group, ReportStruct *reportstruct ) {
+    CloseReport( group->server->reporthdr, reportstruct );
+    EndReport( group->server->reporthdr );
+    if ( group->server->reporthdr ) {
+	FreeReport( group->server->reporthdr );
+	group->server->reporthdr = NULL;
+    }
+    Settings_Destroy( group->server );
+    group->server = NULL;
+}
+
+/* -------------------------------------------------------------------
+ * Receive loop of the multicast scale mode.  A single thread reads
+ * every group from the one socket and feeds each group's report, a
+ * negative sequence number ends that group's flow.
+ * ------------------------------------------------------------------- */
+void Listener::McastScaleServer( ) {
+    int rc, ix, sx, maxfd, silent = 0, unjoined = 0;
+    fd_set readset;
+    ReportStruct *reportstruct = new ReportStruct();
+    FAIL_errno( reportstruct == NULL, "No memory for report structure\n", mSettings );
+    bool mMode_Time = isServerModeTime( mSettings ) && !isDaemon( mSettings );
+    // setup termination variables
+    if ( mMode_Time ) {
+	mEndTime.setnow();
+	mEndTime.add( mSettings->mAmount / 100.0 );
+    }
+
+    while ( sInterupted == 0 ) {
+	struct timeval timeout, *timeoutp = NULL;
+	if (mMode_Time) {
+	    struct timeval t1;
+	    gettimeofday( &t1, NULL );
+	    if (mEndTime.before( t1)) {
+		break;
+	    }
+	    timeout.tv_sec = mSettings->mAmount / 100;
+	    timeout.tv_usec = (mSettings->mAmount % 100) * 10000;
+	    timeoutp = &timeout;
+	}
+	FD_ZERO(&readset);
+	maxfd = -1;
+	for ( sx = 0; sx < mcastSockCnt; sx++ ) {
+	    FD_SET(mcastSocks[sx], &readset);
+	    if ( mcastSocks[sx] > maxfd )
+		maxfd = mcastSocks[sx];
+	}
+	rc = select( maxfd + 1, &readset, NULL, NULL, timeoutp );
+	if ( rc == SOCKET_ERROR ) {
+	    if ( errno == EINTR )
+		continue;
+	    WARN_errno( 1, "select" );
+	    break;
+	}
+	if ( rc == 0 ) {
+	    break;
+	}
+	for ( sx = 0; sx < mcastSockCnt; sx++ ) {
+	    if ( FD_ISSET(mcastSocks[sx], &readset) )
+		McastScaleRead( mcastSocks[sx], reportstruct );
+	}
+    }
+    // close out the groups still running, e.g. per -t or a signal
+    gettimeofday( &(reportstruct->packetTime), NULL );
+    for ( ix = 0; ix < mSettings->mMcastGroups; ix++ ) {
+	if ( mcastGroups[ix].server ) {
+	    McastGroupEnd( &mcastGroups[ix], reportstruct );
+	} else if ( mcastGroups[ix].sock == INVALID_SOCKET ) {
+	    unjoined++;
+	} else if ( !mcastGroups[ix].received ) {
+	    silent++;
+	}
+    }
+    if ( unjoined ) {
+	printf( report_mcast_groups_unjoined, unjoined, mSettings->mMcastGroups );
+    }
+    if ( silent ) {
+	printf( report_mcast_groups_silent, silent, mSettings->mMcastGroups - unjoined );
+    }
+    delete reportstruct;
+} // end McastScaleServer
+
+/* -------------------------------------------------------------------
+ * Reads one datagram of --mcast-groups from a readable pool socket
+ * and accounts it to its group
+ * ------------------------------------------------------------------- */
+void Listener::McastScaleRead( int sock, ReportStruct *reportstruct ) {
+    int rc, ix;
+    bool terminate;
+    iperf_sockaddr peer;
+    struct iovec iov;
+    struct msghdr msg;
+    char control[256];
+    UDP_datagram *mBuf_UDP = (UDP_datagram*) mBuf;
+
+    iov.iov_base = mBuf;
+    iov.iov_len = mSettings->mBufLen;
+    memset( &msg, 0, sizeof(msg) );
+    msg.msg_name = &peer;
+    msg.msg_namelen = sizeof(peer);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    rc = recvmsg( sock, &msg, 0 );
+    if ( rc == SOCKET_ERROR ) {
+	WARN_errno( errno != EINTR, "recvmsg" );
+	return;
+    }
+    gettimeofday( &(reportstruct->packetTime), NULL );
+    // a group is only read from the socket that joined it, where
+    // IP_MULTICAST_ALL can't be cleared others would be seen twice
+    if ( (rc < (int) sizeof(UDP_datagram)) || ((ix = McastGroupIndex( &msg )) < 0) ||
+	 (mcastGroups[ix].sock != sock) ) {
+	return;
+    }
+    // the sequence number is 32 bits unless the client says otherwise,
+    // see Server::ReadPacketID
+    if ( mcastGroups[ix].server && isSeqNo64b( mcastGroups[ix].server ) ) {
+	reportstruct->packetID = ((uint32_t) ntohl( mBuf_UDP->id )) | ((uintmax_t) (ntohl( mBuf_UDP->id2 )) << 32);
+    } else {
+	reportstruct->packetID = (int32_t) ntohl( mBuf_UDP->id );
+    }
+    terminate = (reportstruct->packetID < 0);
+    if ( mcastGroups[ix].server == NULL ) {
+	// a FIN of a group already done, e.g. a retransmit
+	if ( terminate )
+	    return;
+	// like the accept of the threaded server, the first datagram
+	// starts the flow and isn't counted, the client's FIN evens it
+	McastGroupStart( &mcastGroups[ix], ix, &peer, msg.msg_namelen, reportstruct );
+	return;
+    }
+    if ( terminate ) {
+	reportstruct->packetID = -reportstruct->packetID;
+    }
+    reportstruct->sentTime.tv_sec = ntohl( mBuf_UDP->tv_sec );
+    reportstruct->sentTime.tv_usec = ntohl( mBuf_UDP->tv_usec );
+    reportstruct->packetLen = rc;
+    reportstruct->emptyreport = 0;
+    reportstruct->verifyblocks = 0;
+    // datagrams too short for a verify block are sent without one
+    if ( isVerify( mSettings ) && !terminate && (rc >= (VERIFY_UDP_OFFSET + VERIFY_MINLEN)) ) {
+	reportstruct->verifyblocks = 1;
+	reportstruct->verifycorrupt = !verify_block( mBuf + VERIFY_UDP_OFFSET, rc - VERIFY_UDP_OFFSET, (uint32_t) reportstruct->packetID );
+    }
+    ReportPacket( mcastGroups[ix].server->reporthdr, reportstruct );
+    if ( terminate ) {
+	McastGroupEnd( &mcastGroups[ix], reportstruct );
+    }
+} // end McastScaleRead
+
 int Listener::ReadClientHeader(client_hdr *hdr ) {
     uint32_t flags = 0;
     int testflags = 0;
@@ -1161,6 +1607,9 @@ int Listener::ReadClientHeader(client_hdr *hdr ) {
 	    if ((testflags & HEADER_L2LENCHECK) != 0) {
 		setL2LengthCheck(server);
 	    }
+	    if ((testflags & HEADER_UDP_INTENDED) != 0) {
+		setIntendedTime(server);
+	    }
 	    reporter_peerversion(server, ntohl(hdr->udp.version_u), ntohl(hdr->udp.version_l));
 	}
     } else {
@@ -1211,6 +1660,9 @@ int Listener::ReadClientHeader(client_hdr *hdr ) {
     // Handle flags that require an ack back to the client
     if ((flags & HEADER_EXTEND) != 0 ) {
 	reporter_peerversion(server, ntohl(hdr->extend.version_u), ntohl(hdr->extend.version_l));
+	if (ntohl(hdr->extend.flags) & FULLREPORT) {
+	    setFullReport(server);
+	}
 	//  Extended header successfully read. Ack the client with our version info now
 	if (!isMulticast(mSettings)) {
 	    ClientHeaderAck();
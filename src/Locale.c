@@ -90,11 +90,24 @@ Client/Server:\n\
   -M, --mss       #        set TCP maximum segment size (MTU - 40 bytes)\n\
   -N, --nodelay            set TCP no delay, disabling Nagle's Algorithm\n\
   -S, --tos       #        set the socket's IP_TOS (byte) field\n\
+      --sum-groups <levels> sum reports per group, levels are all,src,dst,tos,port[:<width>] (comma separated)\n\
+      --report-policy <p>  limit per flow interval reports, p is sum,top:<n>,bottom:<n>,by:bw|loss,changes:<pct>,anomalies\n\
+      --mcast-groups #     use # consecutive multicast groups starting at the -c/-B group address\n\
+      --processes #        split the work across # processes, each pinned to its share of the CPUs\n\
+      --cpu-dma-latency #  hold /dev/cpu_dma_latency at # usecs during the test and report the CPU frequency per interval\n\
+      --softirqs[=<ifs>]   report NET_RX/NET_TX softirqs and interface interrupts (comma separated ifs) of the busiest CPUs\n\
+      --energy             report RAPL package/DRAM energy, watts and bytes per joule (needs root)\n\
+      --perf-counters      report cycles, instructions, cache/branch misses and context switches per packet of the traffic thread and the reporter\n\
+      --verify             client sends CRC32C protected payloads, server counts corrupt blocks (set on both)\n\
+      --xdp[=#]            UDP over an AF_XDP socket on interface queue # (default 0), the server receives, the client sends\n\
 \n\
 Server specific:\n\
   -s, --server             run in server mode\n\
   -t, --time      #        time in seconds to listen for new connections as well as to receive traffic (default not set)\n\
       --udp-histogram #,#  enable UDP latency histogram(s) with bin width and count, e.g. 1,1000=1(ms),1000(bins)\n\
+      --read-bins #        use # log2 scaled TCP read size bins (-e), the last bin ends at --len (max 32)\n\
+      --rcvlowat #[kmKM]   set the socket's SO_RCVLOWAT, i.e. the minimum bytes for a read wakeup\n\
+      --tcp-framing        recover the client's TCP writes, reports per write latency, id gaps and sizes\n\
   -B, --bind <ip>[%<dev>]  bind to multicast address and optional device\n\
   -H, --ssm-host <ip>      set the SSM source, use with -B for (S,G) \n\
   -U, --single_udp         run in single threaded UDP mode\n\
@@ -129,6 +142,12 @@ Client specific:\n\
   -V, --ipv6_domain        Set the domain to IPv6 (send packets over IPv6)\n\
   -X, --peer-detect        perform server version detection and version exchange\n\
   -Z, --linux-congestion <algo>  set TCP congestion control algorithm (Linux only)\n\
+      --full-report        the server returns its full final report, i.e. TCP read stats and latency histograms\n\
+      --intended-time      UDP datagrams carry their scheduled send time, the server also reports latency from it\n\
+      --sched-deadline[=#] UDP sender threads use SCHED_DEADLINE, # usecs runtime per period (default derived)\n\
+      --sport-spray #[,hash] UDP sends over # sockets on distinct source ports, round robin or hashed\n\
+      --tx-ring[=#[,<mac>]] UDP sends prebuilt frames from an AF_PACKET TX_RING, # frames per send (default 64)\n\
+      --write-sizes <pdf>  TCP write sizes per fixed:<sizes>, uniform:<min>,<max>, lognormal:<mean>,<stdev> or cdf:<file>\n\
 \n\
 Miscellaneous:\n\
   -x, --reportexclude [CDMSV]   exclude C(connection) D(data) M(multicast) S(settings) V(server) reports\n\
@@ -253,6 +272,81 @@ const char report_bw_jitter_loss_format[] =
 const char report_sum_bw_jitter_loss_format[] =
 "[SUM] %4.1f-%4.1f sec  %ss  %ss/sec  %6.3f ms %4" PRIdMAX "/%5" PRIdMAX " (%.2g%%)\n";
 
+const char report_group_bw_format[] =
+"[SUM %s] %4.1f-%4.1f sec  %ss  %ss/sec\n";
+
+const char report_anomaly_stall_format[] =
+"[%3d] %4.1f-%4.1f sec  ANOMALY: flow stalled, no data\n";
+
+const char report_anomaly_loss_format[] =
+"[%3d] %4.1f-%4.1f sec  ANOMALY: loss spike %.2f%% (flow mean %.2f%%)\n";
+
+const char report_group_bw_jitter_loss_format[] =
+"[SUM %s] %4.1f-%4.1f sec  %ss  %ss/sec  %6.3f ms %4" PRIdMAX "/%5" PRIdMAX " (%.2g%%)\n";
+
+const char report_cpufreq_format[] =
+"[%3d] " IPERFTimeFrmt " sec  CPU %d at %.0f MHz, cpu_dma_latency %s\n";
+
+const char report_softirqs_format[] =
+"[%3d] " IPERFTimeFrmt " sec  Softirqs NET_RX/NET_TX/irqs: flow %s, hottest %s\n";
+
+const char report_softirqs_cpu[] =
+"CPU %d %" PRIuMAX "/%" PRIuMAX "/%" PRIuMAX;
+
+const char report_energy_format[] =
+"[%3d] " IPERFTimeFrmt " sec  Energy package/DRAM %.2f/%s J  %.1f W\n";
+
+const char report_energy_perjoule_format[] =
+"[%3d] " IPERFTimeFrmt " sec  Energy package/DRAM %.2f/%s J  %.1f W  %s/J\n";
+
+const char report_sum_energy_format[] =
+"[SUM] " IPERFTimeFrmt " sec  Energy package/DRAM %.2f/%s J  %.1f W  %s/J\n";
+
+const char report_perf_format[] =
+"[%3d] " IPERFTimeFrmt " sec  Perf%s cycles/instr/cache-miss/branch-miss per event %s, %s cycles/byte, %.0f cswitches (%jd events)\n";
+
+const char report_perf_reporter_format[] =
+"[%3d] " IPERFTimeFrmt " sec  Perf%s reporter cycles/instr/cache-miss/branch-miss per event %s, %.0f cswitches (%jd events)\n";
+
+const char report_ringlag_format[] =
+"[%3d] " IPERFTimeFrmt " sec  Ring residency p50/p90/p99/p99.9/max %s us (%jd events)\n";
+
+const char report_sum_ringlag_format[] =
+"[SUM] " IPERFTimeFrmt " sec  Ring residency all flows p50/p90/p99/p99.9/max %s us (%jd events)\n";
+
+const char report_cpu_dma_latency[] =
+"CPU DMA latency (PM QoS) held at %d us for the test\n";
+
+const char report_mcast_join_latency[] =
+"[%3d] multicast group %s first packet %.3f ms after join\n";
+
+const char report_mcast_groups_silent[] =
+"%d of %d joined multicast groups received no packets\n";
+
+const char report_mcast_groups_unjoined[] =
+"%d of %d multicast groups could not be joined\n";
+
+const char warn_mcast_join_failed[] =
+"WARNING: multicast group %s join failed: %s\n";
+
+const char report_udp_fin[] =
+"[%3d] UDP end of test handshake %0.3f ms, %d tries, initial rto %0.3f ms\n";
+
+const char report_sport_spray[] =
+"[%3d] sport %u sent %" PRIdMAX " datagrams\n";
+
+const char report_tx_ring[] =
+"[%3d] tx ring on %s, %d frames of %d bytes, %" PRIdMAX " kicks, %" PRIdMAX " rejected\n";
+
+const char warn_udp_frames[] =
+"WARNING: %s %s, using the UDP socket\n";
+
+const char report_xdp_tx[] =
+"[%3d] xdp on %s queue %d, %" PRIdMAX " frames sent, %" PRIdMAX " kicks\n";
+
+const char report_xdp_rx[] =
+"[%3d] xdp on %s queue %d (%s), %" PRIdMAX " frames received, %" PRIdMAX " via the socket\n";
+
 /* -------------------------------------------------------------------
  * Enhanced reports (per -e)
  * ------------------------------------------------------------------- */
@@ -275,11 +369,14 @@ const char report_sum_bw_enhanced_format[] =
 const char report_bw_read_enhanced_header[] =
 "[ ID] Interval" IPERFTimeSpace "Transfer    Bandwidth       Reads   Dist(bin=%.1fK)\n";
 
+const char report_bw_read_enhanced_log_header[] =
+"[ ID] Interval" IPERFTimeSpace "Transfer    Bandwidth       Reads   Dist(log2,max=%.1fK)\n";
+
 const char report_bw_read_enhanced_format[] =
-"[%3d] " IPERFTimeFrmt " sec  %ss  %ss/sec  %d    %d:%d:%d:%d:%d:%d:%d:%d\n";
+"[%3d] " IPERFTimeFrmt " sec  %ss  %ss/sec  %d    %s\n";
 
 const char report_sum_bw_read_enhanced_format[] =
-"[SUM] " IPERFTimeFrmt " sec  %ss  %ss/sec  %d    %d:%d:%d:%d:%d:%d:%d:%d\n";
+"[SUM] " IPERFTimeFrmt " sec  %ss  %ss/sec  %d    %s\n";
 
 const char report_triptime_enhanced_format[] =
 "[%3d] " IPERFTimeFrmt " trip-time (3WHS done->fin+finack) = %4.4f sec\n";
@@ -376,6 +473,24 @@ const char server_reporting[] =
 const char reportCSV_peer[] =
 "%s,%u,%s,%u";
 
+const char report_verify_format[] =
+"[%3d] " IPERFTimeFrmt " sec  Verified %" PRIdMAX " blocks, %" PRIdMAX " corrupt (CRC32C %s)\n";
+
+const char report_write_sizes_format[] =
+"[%3d] " IPERFTimeFrmt " sec  Write sizes %s\n";
+
+const char report_frame_format[] =
+"[%3d] " IPERFTimeFrmt " sec  Writes %" PRIdMAX " (%s) latency avg/min/max %.3f/%.3f/%.3f ms, %" PRIdMAX " id gaps, %" PRIdMAX " resyncs\n";
+
+const char report_intended_format[] =
+"[%3d] " IPERFTimeFrmt " sec  Latency from intended send avg/min/max %.3f/%.3f/%.3f ms, send lag avg/max %.3f/%.3f ms (%" PRIdMAX " pkts)\n";
+
+const char report_sched_deadline_format[] =
+"[%3d] " IPERFTimeFrmt " sec  SCHED_DEADLINE %d/%d/%d us, %" PRIdMAX " wakes late avg/min/max %.3f/%.3f/%.3f ms, %" PRIdMAX " deadline misses\n";
+
+const char report_frame_suppress_format[] =
+"[%3d] " IPERFTimeFrmt " sec  Writes %" PRIdMAX " (%s), %" PRIdMAX " id gaps, %" PRIdMAX " resyncs\n";
+
 const char report_l2length_error[] =
 "[%3d] " IPERFTimeFrmt " sec  %d datagrams received out-of-order\n";
 
@@ -386,6 +501,27 @@ const char reportCSV_bw_format[] =
 const char reportCSV_bw_jitter_loss_format[] =
 "%s,%s,%d,%.1f-%.1f,%" PRIdMAX ",%" PRIdMAX ",%.3f,%d,%d,%.3f,%d\n";
 
+const char reportCSV_anomaly_format[] =
+"%s,%s,%d,%.1f-%.1f,%s,%.3f,%.3f\n";
+
+const char reportCSV_cpufreq_format[] =
+"%s,%s,%d,%.1f-%.1f,cpufreq,%d,%.0f,%d\n";
+
+const char reportCSV_softirqs_format[] =
+"%s,%s,%d,%.1f-%.1f,softirqs,%d,%" PRIuMAX ",%" PRIuMAX ",%" PRIuMAX ",%s\n";
+
+const char reportCSV_softirqs_cpu[] =
+"%d:%" PRIuMAX ":%" PRIuMAX ":%" PRIuMAX;
+
+const char reportCSV_energy_format[] =
+"%s,%s,%d,%.1f-%.1f,energy,%.3f,%s,%.2f,%s\n";
+
+const char reportCSV_perf_format[] =
+"%s,%s,%d,%.1f-%.1f,perf,%jd,%.0f,%.0f,%.0f,%.0f,%.0f,%jd,%.0f,%.0f,%.0f,%.0f,%.0f\n";
+
+const char reportCSV_ringlag_format[] =
+"%s,%s,%d,%.1f-%.1f,ringlag,%jd,%.3f,%.3f,%.3f,%.3f,%.3f\n";
+
  /* -------------------------------------------------------------------
  * warnings
  * ------------------------------------------------------------------- */
@@ -409,6 +545,9 @@ const char warn_no_ack[]=
 const char warn_ack_failed[]=
 "[%3d] WARNING: ack of last datagram failed after %d tries.\n";
 
+const char warn_no_full_report[]=
+"[%3d] WARNING: did not receive the server's full report.\n";
+
 const char warn_fileopen_failed[]=
 "WARNING: Unable to open file stream for transfer\n\
 Using default data stream. \n";
@@ -0,0 +1,224 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * PerfCounters.c
+ * Hardware performance counters per thread (--perf-counters)
+ *
+ * Cycles, instructions, cache misses, branch misses and context
+ * switches are opened as one group so they count over the same time
+ * and are read together, the leader being the first that opens.
+ * Counters the CPU or the VM doesn't have are left out.  Under
+ * perf_event_paranoid > 1 only user space is counted.  When the PMU
+ * multiplexes the group the counts are scaled by time enabled over
+ * time running.
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "PerfCounters.h"
+#include "util.h"
+#ifdef HAVE_LINUX_PERF_EVENT_H
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static PerfGroup reporter_group = { .fd = -1 };
+static PerfReport reporter_interval;
+static double reporter_sampled = 0;
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} perf_events[PERF_COUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES}
+};
+
+static int perf_open_event (int event, int leader, int useronly) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = perf_events[event].type;
+    attr.config = perf_events[event].config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = useronly;
+    attr.exclude_hv = 1;
+    // this thread on any CPU
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+}
+
+static double perf_now (void) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec + (now.tv_usec / 1e6);
+}
+#endif
+
+void perf_group_init (PerfGroup *group) {
+    int ix;
+    memset(group, 0, sizeof(PerfGroup));
+    group->fd = -1;
+    for (ix = 0; ix < PERF_COUNTERS; ix++) {
+	group->fds[ix] = -1;
+	group->slot[ix] = -1;
+    }
+}
+
+int perf_group_open (PerfGroup *group) {
+#ifdef HAVE_LINUX_PERF_EVENT_H
+    static int warned = 0;
+    int ix, fd, err = 0;
+    for (ix = 0; ix < PERF_COUNTERS; ix++) {
+	fd = perf_open_event(ix, group->fd, group->useronly);
+	if ((fd < 0) && ((errno == EACCES) || (errno == EPERM)) && !group->useronly && (group->fd < 0)) {
+	    group->useronly = 1;
+	    fd = perf_open_event(ix, -1, 1);
+	}
+	if (fd < 0) {
+	    err = errno;
+	    continue;
+	}
+	if (group->fd < 0)
+	    group->fd = fd;
+	group->fds[ix] = fd;
+	group->slot[ix] = group->nslots++;
+    }
+    if ((group->fd < 0) && !warned) {
+	warned = 1;
+	fprintf(stderr, "WARNING: perf_event_open failed (%s), --perf-counters is ignored\n", strerror(err));
+    }
+    return (group->fd >= 0);
+#else
+    static int warned = 0;
+    if (!warned) {
+	warned = 1;
+	fprintf(stderr, "WARNING: no perf_event_open support, --perf-counters is ignored\n");
+    }
+    return 0;
+#endif
+}
+
+/*
+ * Fill in the deltas since the last interval read, or since the open
+ * when final is set, events is the running count of the group's
+ * thread's events
+ */
+int perf_group_read (PerfGroup *group, PerfReport *report, intmax_t events, int final) {
+#ifdef HAVE_LINUX_PERF_EVENT_H
+    // nr, time enabled, time running then the values in group order
+    uint64_t values[3 + PERF_COUNTERS];
+    double scale, count;
+    int ix;
+    if (group->fd < 0)
+	return 0;
+    if (read(group->fd, values, sizeof(values)) < (ssize_t) (3 * sizeof(uint64_t)))
+	return 0;
+    scale = (values[2] > 0) ? ((double) values[1] / values[2]) : 0;
+    for (ix = 0; ix < PERF_COUNTERS; ix++) {
+	if (group->slot[ix] < 0) {
+	    report->counts[ix] = -1;
+	    continue;
+	}
+	count = values[3 + group->slot[ix]] * scale;
+	report->counts[ix] = final ? count : (count - group->last[ix]);
+	if (!final)
+	    group->last[ix] = count;
+    }
+    report->events = final ? events : (events - group->lastevents);
+    if (!final)
+	group->lastevents = events;
+    report->useronly = group->useronly;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void perf_group_close (PerfGroup *group) {
+    int ix;
+    for (ix = 0; ix < PERF_COUNTERS; ix++) {
+	if (group->fds[ix] >= 0) {
+	    close(group->fds[ix]);
+	    group->fds[ix] = -1;
+	}
+    }
+    group->fd = -1;
+}
+
+void perf_reporter_open (void) {
+    perf_group_init(&reporter_group);
+    perf_group_open(&reporter_group);
+}
+
+/*
+ * The reporter's counts over the interval, or the whole run when
+ * final is set.  Like --softirqs a new read is only taken once at
+ * least half the interval has passed since the last one, so the flows
+ * reporting that interval share it.
+ */
+int perf_reporter_report (PerfReport *report, intmax_t events, double interval, int final) {
+#ifdef HAVE_LINUX_PERF_EVENT_H
+    double now;
+    if (final)
+	return perf_group_read(&reporter_group, report, events, 1);
+    now = perf_now();
+    if ((now - reporter_sampled) >= (interval / 2)) {
+	if (!perf_group_read(&reporter_group, &reporter_interval, events, 0))
+	    return 0;
+	reporter_sampled = now;
+    }
+    *report = reporter_interval;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
@@ -203,6 +203,16 @@ void SetSocketOptions( thread_Settings *inSettings ) {
             WARN_errno( rc == SOCKET_ERROR, "setsockopt TCP_NODELAY" );
         }
 #endif
+
+#ifdef SO_RCVLOWAT
+        // set the receive low water mark, accepted sockets inherit
+        // it from the listener, i.e. batch reader wakeups
+        if ( inSettings->mRcvLowat > 0 ) {
+            int rc = setsockopt( inSettings->mSock, SOL_SOCKET, SO_RCVLOWAT,
+                                 (char*) &inSettings->mRcvLowat, sizeof(inSettings->mRcvLowat) );
+            WARN_errno( rc == SOCKET_ERROR, "setsockopt SO_RCVLOWAT" );
+        }
+#endif
     }
 
 #if HAVE_DECL_SO_MAX_PACING_RATE
@@ -0,0 +1,317 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * Processes.c
+ * Multiple process scale out (--processes)
+ *
+ * At high flow counts one process serializes on its global locks
+ * and its single reporter thread.  The parent forks the workers,
+ * each pinned to its own share of the CPUs and running its share
+ * of the flows with its own reporter.  The workers' interval sums
+ * meet in an anonymous shared mapping, the parent only reads it.
+ * ------------------------------------------------------------------- */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "headers.h"
+#include "Settings.hpp"
+#include "Reporter.h"
+#include "PerfSocket.hpp"
+#include "Processes.h"
+#include "delay.h"
+#include "util.h"
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_FORK
+#include <sys/wait.h>
+#include <sys/resource.h>
+#endif
+#include <limits.h>
+#if defined(HAVE_SCHED_SETAFFINITY) && HAVE_DECL_CPU_SET
+#include <sched.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+ProcShared *procs_shared = NULL;
+int procs_index = -1;
+int procs_idspan = 1000;
+
+#if defined(HAVE_FORK) && defined(HAVE_SYS_MMAN_H) && defined(MAP_ANONYMOUS)
+/*
+ * Pin a worker to its contiguous share of the online CPUs, workers
+ * share CPUs only when there are more workers than CPUs
+ */
+static void procs_pin (int ix, int nprocs) {
+#if defined(HAVE_SCHED_SETAFFINITY) && HAVE_DECL_CPU_SET
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int cpu, per;
+    cpu_set_t set;
+    if (ncpu <= 1)
+	return;
+    per = (ncpu >= nprocs) ? (ncpu / nprocs) : 1;
+    CPU_ZERO(&set);
+    for (cpu = ix * per; cpu < (ix + 1) * per; cpu++) {
+	CPU_SET(cpu % ncpu, &set);
+    }
+    WARN_errno(sched_setaffinity(0, sizeof(set), &set) < 0, "sched_setaffinity");
+#endif
+}
+
+/*
+ * The transfer id span of a worker, the power of ten above any socket
+ * number it can have, i.e. RLIMIT_NOFILE, so worker * span + socket
+ * can't collide.  A limit too large for the ids to fit an int, e.g.
+ * unlimited, is lowered to the span.
+ */
+static void procs_span (int nprocs) {
+    struct rlimit rl;
+    int max = INT_MAX / nprocs;
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0) {
+	WARN_errno(1, "getrlimit --processes");
+	return;
+    }
+    while ((procs_idspan <= (max / 10)) && (rl.rlim_cur > (rlim_t) procs_idspan))
+	procs_idspan *= 10;
+    if (rl.rlim_cur > (rlim_t) procs_idspan) {
+	rl.rlim_cur = procs_idspan;
+	WARN_errno(setrlimit(RLIMIT_NOFILE, &rl) < 0, "setrlimit --processes");
+    }
+}
+
+// a worker's share of the -P flows
+static int procs_share (int threads, int nprocs, int ix) {
+    return (threads / nprocs) + ((ix < (threads % nprocs)) ? 1 : 0);
+}
+
+/*
+ * Print, in order, the intervals all the workers have published, or
+ * every published interval when all is set (the workers are gone.)
+ * A worker that published its final sum no longer holds back an
+ * interval.  A slot is read as a seqlock, a worker PROCS_SLOTS
+ * intervals ahead may be overwriting it, so the copy is only taken
+ * when the sequence is the same before and after it.
+ */
+static int procs_flush (MultiHeader *multihdr, ProcShared *shared, int next, int all) {
+    Transfer_Info sum, info;
+    int ix, cnt, ready, later;
+    while (1) {
+	cnt = 0;
+	ready = 1;
+	later = 0;
+	for (ix = 0; ix < shared->nprocs; ix++) {
+	    ProcWorker *worker = &shared->worker[ix];
+	    ProcSlot *slot = &worker->slots[next % PROCS_SLOTS];
+	    int seq;
+	    do {
+		seq = slot->seq;
+		__sync_synchronize();
+		if (seq == next + 1)
+		    memcpy(&info, &slot->info, sizeof(Transfer_Info));
+		__sync_synchronize();
+	    } while (seq != slot->seq);
+	    if (seq == next + 1) {
+		reporter_transfer_add(&sum, &info, (cnt++ == 0));
+	    } else if (seq > next + 1) {
+		later = 1;
+	    } else if (!worker->final.seq) {
+		ready = 0;
+	    }
+	}
+	if (!ready && !all)
+	    break;
+	if (cnt) {
+	    reporter_multiple_print(multihdr, &sum, 0);
+	} else if (!later) {
+	    break;
+	}
+	next++;
+    }
+    return next;
+}
+
+/*
+ * The parent: wait on the workers, printing the summed intervals as
+ * they complete, then the summed totals.  Returns non zero when a
+ * worker failed, i.e. exited non zero, was killed by a signal or, a
+ * client's, finished fewer flows than it ran, e.g. its connects were
+ * refused, as a failed flow only stops its own thread.
+ */
+static int procs_aggregate (thread_Settings *mSettings, ProcShared *shared, int nprocs) {
+    MultiHeader *multihdr = NULL;
+    Transfer_Info sum;
+    int ix, cnt = 0, next = 0, running = nprocs, status, failed = 0;
+
+    // servers have no sum reports, their parent only waits
+    if (mSettings->mThreadMode == kMode_Client) {
+	Mutex_Lock(&groupCond);
+	groupID--;
+	multihdr = InitMulti(mSettings, groupID);
+	Mutex_Unlock(&groupCond);
+    }
+    while (running > 0) {
+	pid_t pid = waitpid(-1, &status, WNOHANG);
+	if (pid > 0) {
+	    if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+		failed = 1;
+	    running--;
+	    continue;
+	} else if ((pid < 0) && (errno != EINTR)) {
+	    WARN_errno(1, "waitpid --processes");
+	    failed = 1;
+	    break;
+	}
+	if (multihdr && multihdr->report)
+	    next = procs_flush(multihdr, shared, next, 0);
+	// a tenth of the report interval, at most 10 ms
+	delay_loop(((mSettings->mInterval > 0) && (mSettings->mInterval < 0.1)) ? \
+		   (unsigned long) (mSettings->mInterval * 1e5) : 10000);
+    }
+    if (mSettings->mThreadMode == kMode_Client) {
+	for (ix = 0; ix < shared->nprocs; ix++) {
+	    if (shared->worker[ix].flowsdone < procs_share(mSettings->mThreads, nprocs, ix))
+		failed = 1;
+	}
+    }
+    if (multihdr && multihdr->report) {
+	procs_flush(multihdr, shared, next, 1);
+	for (ix = 0; ix < shared->nprocs; ix++) {
+	    if (shared->worker[ix].final.seq) {
+		reporter_transfer_add(&sum, &shared->worker[ix].final.info, (cnt++ == 0));
+	    }
+	}
+	if (cnt)
+	    reporter_multiple_print(multihdr, &sum, 1);
+    }
+    return failed;
+}
+#endif
+
+/*
+ * Fork the --processes workers.  Returns in the workers with
+ * mThreads set to the worker's share of the flows, the parent
+ * aggregates and exits, non zero when a worker failed.
+ */
+void procs_fork (thread_Settings *mSettings) {
+#if defined(HAVE_FORK) && defined(HAVE_SYS_MMAN_H) && defined(MAP_ANONYMOUS)
+    int ix, failed, nprocs = mSettings->mProcesses, threads = mSettings->mThreads;
+    size_t len = sizeof(ProcShared) + ((nprocs - 1) * sizeof(ProcWorker));
+    ProcShared *shared;
+    pid_t pid;
+
+    shared = (ProcShared *) mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+	WARN_errno(1, "mmap --processes");
+	return;
+    }
+    shared->nprocs = nprocs;
+    shared->interval = mSettings->mInterval;
+    procs_span(nprocs);
+    // don't let the workers inherit unflushed output
+    fflush(stdout);
+    fflush(stderr);
+    for (ix = 0; ix < nprocs; ix++) {
+	pid = fork();
+	if (pid == 0) {
+	    procs_shared = shared;
+	    procs_index = ix;
+	    if (mSettings->mThreadMode == kMode_Client) {
+		mSettings->mThreads = procs_share(threads, nprocs, ix);
+	    }
+	    procs_pin(ix, nprocs);
+	    // the workers share stdout, keep their lines whole
+	    setvbuf(stdout, NULL, _IOLBF, 0);
+	    return;
+	} else if (pid < 0) {
+	    WARN_errno(1, "fork");
+	    shared->nprocs = ix;
+	    break;
+	}
+    }
+    failed = procs_aggregate(mSettings, shared, shared->nprocs);
+    munmap(shared, len);
+    exit(failed ? 1 : 0);
+#else
+    fprintf(stderr, "WARNING: --processes not supported on this platform, running as a single process\n");
+#endif
+}
+
+/*
+ * Publish a worker's sum of its flows, called by the worker's
+ * reporter thread in place of printing the SUM report
+ */
+void procs_publish (Transfer_Info *stats, int final) {
+    ProcWorker *worker = &procs_shared->worker[procs_index];
+    ProcSlot *slot;
+    int seq;
+    if (final) {
+	slot = &worker->final;
+	seq = 1;
+    } else if (procs_shared->interval > 0) {
+	seq = (int) ((stats->startTime / procs_shared->interval) + 0.5) + 1;
+	slot = &worker->slots[(seq - 1) % PROCS_SLOTS];
+    } else {
+	return;
+    }
+    // empty while it's written, the parent reads the info once it
+    // sees the sequence, and again after its copy
+    slot->seq = 0;
+    __sync_synchronize();
+    memcpy(&slot->info, stats, sizeof(Transfer_Info));
+    __sync_synchronize();
+    slot->seq = seq;
+}
+
+/*
+ * Count a worker's flow that made its final report, the parent
+ * takes a worker with fewer than it ran as failed
+ */
+void procs_flowdone (void) {
+    __sync_fetch_and_add(&procs_shared->worker[procs_index].flowsdone, 1);
+}
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
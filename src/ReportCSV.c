@@ -55,12 +55,11 @@
 #include "Reporter.h"
 #include "report_CSV.h"
 #include "Locale.h"
+#include "Softirqs.h"
+#include "Energy.h"
 
 
-void CSV_stats( Transfer_Info *stats ) {
-    // $TIMESTAMP,$ID,$INTERVAL,$BYTE,$SPEED,$JITTER,$LOSS,$PACKET,$%LOSS
-    intmax_t speed = (intmax_t) ((stats->TotalLen > 0) ? (((double)stats->TotalLen * 8.0) / (stats->endTime -  stats->startTime)) : 0);
-    char timestamp[160];
+static void CSV_timestamp( char *timestamp, int enhanced ) {
     int milliseconds;
 #ifdef HAVE_CLOCK_GETTIME
     struct timespec t1;
@@ -73,13 +72,21 @@ void CSV_stats( Transfer_Info *stats ) {
 #endif
 
    // localtime is not thread safe.  It's only used by the reporter thread.  Use localtime_r if thread safe is ever needed.
-    if (!stats->mEnhanced) {
+    if (!enhanced) {
 	strftime(timestamp, 80, "%Y%m%d%H%M%S", localtime(&t1.tv_sec));
     } else {
 	char  buffer[80];
 	strftime(buffer, 80, "%Y%m%d%H%M%S", localtime(&t1.tv_sec));
 	snprintf(timestamp, 160, "%s.%.3d", buffer, milliseconds);
     }
+}
+
+void CSV_stats( Transfer_Info *stats ) {
+    // $TIMESTAMP,$ID,$INTERVAL,$BYTE,$SPEED,$JITTER,$LOSS,$PACKET,$%LOSS
+    intmax_t speed = (intmax_t) ((stats->TotalLen > 0) ? (((double)stats->TotalLen * 8.0) / (stats->endTime -  stats->startTime)) : 0);
+    char timestamp[160];
+
+    CSV_timestamp(timestamp, stats->mEnhanced);
     if ( stats->mUDP != (char)kMode_Server ) {
         // TCP Reporting
         printf( reportCSV_bw_format,
@@ -107,9 +114,140 @@ void CSV_stats( Transfer_Info *stats ) {
     }
     if ( stats->free == 1 && stats->reserved_delay != NULL ) {
         free( stats->reserved_delay );
+        stats->reserved_delay = NULL;
     }
 }
 
+/*
+ * Aggregation group reports use the peer fields for the group,
+ * i.e. "group,0,<level>=<key>,0", and an ID of -1
+ */
+void CSV_groupstats( Transfer_Info *stats, const char *label ) {
+    char peer[AGGR_LABELSIZE + 16];
+    void *reserved = stats->reserved_delay;
+    int isfree = stats->free;
+
+    snprintf(peer, sizeof(peer), "group,0,%s,0", label);
+    stats->reserved_delay = peer;
+    // the label is on the stack, don't let CSV_stats free it
+    stats->free = 0;
+    CSV_stats( stats );
+    stats->reserved_delay = reserved;
+    stats->free = isfree;
+}
+
+/*
+ * Anomaly rows are $TIMESTAMP,$PEER,$ID,$INTERVAL,stall|loss,$VALUE,$MEAN
+ */
+void CSV_anomaly( Transfer_Info *stats, int kind, double value, double mean ) {
+    char timestamp[160];
+
+    CSV_timestamp(timestamp, stats->mEnhanced);
+    printf( reportCSV_anomaly_format,
+	    timestamp,
+	    (stats->reserved_delay == NULL ? ",,," : stats->reserved_delay),
+	    stats->transferID,
+	    stats->startTime,
+	    stats->endTime,
+	    ((kind == ANOMALY_STALL) ? "stall" : "loss"),
+	    value, mean);
+}
+
+void CSV_cpufreq( Transfer_Info *stats, int cpu, double mhz, int dmalatency ) {
+    char timestamp[160];
+
+    CSV_timestamp(timestamp, stats->mEnhanced);
+    printf( reportCSV_cpufreq_format,
+	    timestamp,
+	    (stats->reserved_delay == NULL ? ",,," : stats->reserved_delay),
+	    stats->transferID,
+	    stats->startTime,
+	    stats->endTime,
+	    cpu, mhz, dmalatency);
+}
+
+void CSV_softirqs( Transfer_Info *stats, SoftirqReport *report ) {
+    char timestamp[160], hottest[80 * SOFTIRQS_HOTTEST];
+    int ix, len = 0;
+
+    CSV_timestamp(timestamp, stats->mEnhanced);
+    hottest[0] = '\0';
+    for (ix = 0; ix < report->nhot; ix++) {
+	SoftirqCpu *hot = &report->hot[ix];
+	if (ix)
+	    len += snprintf(&hottest[len], sizeof(hottest) - len, " ");
+	len += snprintf(&hottest[len], sizeof(hottest) - len, reportCSV_softirqs_cpu, hot->cpu,
+			hot->net_rx, hot->net_tx, hot->irqs);
+    }
+    printf( reportCSV_softirqs_format,
+	    timestamp,
+	    (stats->reserved_delay == NULL ? ",,," : stats->reserved_delay),
+	    stats->transferID,
+	    stats->startTime,
+	    stats->endTime,
+	    report->flow.cpu, report->flow.net_rx, report->flow.net_tx, report->flow.irqs,
+	    hottest);
+}
+
+void CSV_energy( Transfer_Info *stats, EnergyReport *report ) {
+    char timestamp[160], dram[32], perjoule[32];
+    double joules = report->package + report->dram;
+
+    CSV_timestamp(timestamp, stats->mEnhanced);
+    dram[0] = '\0';
+    if (report->hasdram)
+	snprintf(dram, sizeof(dram), "%.3f", report->dram);
+    // the bytes per joule only on the test's row, i.e. the sum's
+    perjoule[0] = '\0';
+    if (report->perjoule)
+	snprintf(perjoule, sizeof(perjoule), "%.0f", ((joules > 0) ? ((double) stats->TotalLen / joules) : 0));
+    printf( reportCSV_energy_format,
+	    timestamp,
+	    (stats->reserved_delay == NULL ? ",,," : stats->reserved_delay),
+	    stats->transferID,
+	    stats->startTime,
+	    stats->endTime,
+	    report->package, dram, joules / report->seconds, perjoule);
+}
+
+void CSV_perf( Transfer_Info *stats, PerfReport *flow, PerfReport *reporter ) {
+    char timestamp[160];
+    PerfReport none;
+    int ix;
+
+    CSV_timestamp(timestamp, stats->mEnhanced);
+    if (reporter == NULL) {
+	for (ix = 0; ix < PERF_COUNTERS; ix++)
+	    none.counts[ix] = -1;
+	none.events = 0;
+	reporter = &none;
+    }
+    printf( reportCSV_perf_format,
+	    timestamp,
+	    (stats->reserved_delay == NULL ? ",,," : stats->reserved_delay),
+	    stats->transferID,
+	    stats->startTime,
+	    stats->endTime,
+	    flow->events, flow->counts[PERF_CYCLES], flow->counts[PERF_INSTRUCTIONS],
+	    flow->counts[PERF_CACHEMISSES], flow->counts[PERF_BRANCHMISSES], flow->counts[PERF_CSWITCHES],
+	    reporter->events, reporter->counts[PERF_CYCLES], reporter->counts[PERF_INSTRUCTIONS],
+	    reporter->counts[PERF_CACHEMISSES], reporter->counts[PERF_BRANCHMISSES], reporter->counts[PERF_CSWITCHES]);
+}
+
+void CSV_ringlag( Transfer_Info *stats, RingLagReport *report ) {
+    char timestamp[160];
+
+    CSV_timestamp(timestamp, 1);
+    printf( reportCSV_ringlag_format,
+	    timestamp,
+	    (stats->reserved_delay == NULL ? ",,," : stats->reserved_delay),
+	    stats->transferID,
+	    stats->startTime,
+	    stats->endTime,
+	    report->cnt, report->quantiles[0], report->quantiles[1], report->quantiles[2],
+	    report->quantiles[3], report->max);
+}
+
 void *CSV_peer( Connection_Info *stats, int ID ) {
 
     // copy the inet_ntop into temp buffers, to avoid overwriting
@@ -59,12 +59,67 @@
 #include "Locale.h"
 #include "PerfSocket.hpp"
 #include "SocketAddr.h"
+#include "Processes.h"
+#include "Softirqs.h"
+#include "Energy.h"
+#include "verify.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define NETPOWERCONSTANT 1e-6
+/*
+ * Formats the read size bins as cnt:cnt:...
+ */
+static void reporter_readbins_snprintf( char *buf, int len, ReadStats *stats ) {
+    int ix, n = 0;
+    buf[0] = '\0';
+    for (ix = 0; (ix < stats->bincnt) && (n < len); ix++) {
+	n += snprintf(&buf[n], len - n, (ix ? ":%d" : "%d"), stats->bins[ix]);
+    }
+}
+
+/*
+ * Write size distributions of --tcp-framing and --write-sizes, only
+ * the populated log2 bins and each by its upper bound, e.g.
+ * 64K:1021 128K:20
+ */
+static void reporter_log2bins_snprintf( char *buf, int len, int *bins ) {
+    int ix, n = 0;
+    buf[0] = '\0';
+    for (ix = 0; (ix < LOG2_BINS) && (n < len); ix++) {
+	if (!bins[ix])
+	    continue;
+	if (ix < 10)
+	    n += snprintf(&buf[n], len - n, "%s%d:%d", (n ? " " : ""), 1 << ix, bins[ix]);
+	else if (ix < 20)
+	    n += snprintf(&buf[n], len - n, "%s%dK:%d", (n ? " " : ""), 1 << (ix - 10), bins[ix]);
+	else
+	    n += snprintf(&buf[n], len - n, "%s%dM:%d", (n ? " " : ""), 1 << (ix - 20), bins[ix]);
+    }
+}
+
+/*
+ * Resets the enhanced stats for the next report interval
+ */
+void reporter_resetstats( Transfer_Info *stats ) {
+    if (stats->mUDP) {
+	stats->transit.minTransit=stats->transit.lastTransit;
+	stats->transit.maxTransit=stats->transit.lastTransit;
+	stats->transit.sumTransit = stats->transit.lastTransit;
+	stats->transit.cntTransit = 0;
+	stats->transit.vdTransit = 0;
+	stats->transit.meanTransit = 0;
+	stats->transit.m2Transit = 0;
+#ifdef HAVE_ISOCHRONOUS
+	stats->isochstats.framecnt = 0;
+	stats->isochstats.framelostcnt = 0;
+	stats->isochstats.slipcnt = 0;
+#endif
+    }
+}
+
 /*
  * Prints transfer reports in default style
  */
@@ -72,6 +127,10 @@ void reporter_printstats( Transfer_Info *stats ) {
     static char header_printed = 0;
     double bytesxfered;
 
+    // --processes, the first worker prints the header for all
+    if (procs_index > 0)
+	header_printed = 1;
+
     //将TotalLen输出到buffer前半部分
     byte_snprintf( buffer, sizeof(buffer)/2, (double) stats->TotalLen,
                    toupper( (int)stats->mFormat));
@@ -103,22 +162,20 @@ void reporter_printstats( Transfer_Info *stats ) {
 	} else {
 		//增强性结果输出
 	    if( !header_printed ) {
-		printf((stats->mTCP == (char)kMode_Server ? report_bw_read_enhanced_header : report_bw_write_enhanced_header), (stats->sock_callstats.read.binsize/1024.0));
+		if (stats->mTCP == (char)kMode_Server)
+		    printf((stats->sock_callstats.read.binlog ? report_bw_read_enhanced_log_header : report_bw_read_enhanced_header), \
+			   (stats->sock_callstats.read.binsize/1024.0));
+		else
+		    printf("%s", report_bw_write_enhanced_header);
 		header_printed = 1;
 	    }
 	    if (stats->mTCP == (char)kMode_Server) {
+		char bins[READ_BINMAX * 12];
+		reporter_readbins_snprintf(bins, sizeof(bins), &stats->sock_callstats.read);
 		printf(report_bw_read_enhanced_format,
 		       stats->transferID, stats->startTime, stats->endTime,
 		       buffer, &buffer[sizeof(buffer)/2],
-		       stats->sock_callstats.read.cntRead,
-		       stats->sock_callstats.read.bins[0],
-		       stats->sock_callstats.read.bins[1],
-		       stats->sock_callstats.read.bins[2],
-		       stats->sock_callstats.read.bins[3],
-		       stats->sock_callstats.read.bins[4],
-		       stats->sock_callstats.read.bins[5],
-		       stats->sock_callstats.read.bins[6],
-		       stats->sock_callstats.read.bins[7]);
+		       stats->sock_callstats.read.cntRead, bins);
 		if (stats->tripTime > 0)
 		    printf(report_triptime_enhanced_format,
 		       stats->transferID, stats->startTime, stats->endTime,
@@ -153,6 +210,12 @@ void reporter_printstats( Transfer_Info *stats ) {
 			 netpower);
 		}
 #endif
+		if (stats->sock_callstats.write.sizebinned) {
+		    char bins[LOG2_BINS * 16];
+		    reporter_log2bins_snprintf(bins, sizeof(bins), stats->sock_callstats.write.sizebins);
+		    printf(report_write_sizes_format,
+			   stats->transferID, stats->startTime, stats->endTime, bins);
+		}
 	    }
 	}
     } else if ( stats->mUDP == (char)kMode_Client ) {
@@ -245,6 +308,9 @@ void reporter_printstats( Transfer_Info *stats ) {
 		if (stats->latency_histogram) {
 		    histogram_print(stats->latency_histogram, stats->startTime, stats->endTime,stats->free);
 		}
+		if (stats->intendedlatency_histogram) {
+		    histogram_print(stats->intendedlatency_histogram, stats->startTime, stats->endTime,stats->free);
+		}
 #ifdef HAVE_ISOCHRONOUS
 		if (stats->framelatency_histogram) {
 		    histogram_print(stats->framelatency_histogram, stats->startTime, stats->endTime,stats->free);
@@ -270,6 +336,17 @@ void reporter_printstats( Transfer_Info *stats ) {
 		    stats->transferID, stats->startTime,
 		    stats->endTime, stats->cntOutofOrder );
 	}
+	// same sanity check as the latencies above, unsynced clocks
+	// give no latency
+	if (stats->intended.cnt && (stats->intended.minLatency <= UNREALISTIC_LATENCYMINMAX) && \
+	    (stats->intended.minLatency >= UNREALISTIC_LATENCYMINMIN)) {
+	    printf( report_intended_format,
+		    stats->transferID, stats->startTime, stats->endTime,
+		    (stats->intended.sumLatency / stats->intended.cnt) * 1e3,
+		    stats->intended.minLatency * 1e3, stats->intended.maxLatency * 1e3,
+		    (stats->intended.sumLag / stats->intended.cnt) * 1e3, stats->intended.maxLag * 1e3,
+		    stats->intended.cnt);
+	}
 	if (stats->l2counts.cnt) {
 	    printf( report_l2statistics,
 		    stats->transferID, stats->startTime,
@@ -277,22 +354,40 @@ void reporter_printstats( Transfer_Info *stats ) {
 		    stats->l2counts.udpcsumerr, stats->l2counts.unknown);
 	}
     }
+    if (stats->verify.cnt) {
+	printf( report_verify_format,
+		stats->transferID, stats->startTime, stats->endTime,
+		stats->verify.cnt, stats->verify.corrupt, crc32c_impl());
+    }
+    if (stats->frames.cnt || stats->frames.resyncs) {
+	char bins[LOG2_BINS * 16];
+	reporter_log2bins_snprintf(bins, sizeof(bins), stats->frames.bins);
+	// same sanity check as the UDP latencies, unsynced clocks
+	// give no latency
+	if (!stats->frames.cntLatency || (stats->frames.minLatency > UNREALISTIC_LATENCYMINMAX) ||
+	    (stats->frames.minLatency < UNREALISTIC_LATENCYMINMIN)) {
+	    printf( report_frame_suppress_format,
+		    stats->transferID, stats->startTime, stats->endTime,
+		    stats->frames.cnt, bins, stats->frames.gaps, stats->frames.resyncs);
+	} else {
+	    printf( report_frame_format,
+		    stats->transferID, stats->startTime, stats->endTime,
+		    stats->frames.cnt, bins,
+		    (stats->frames.sumLatency / stats->frames.cntLatency) * 1e3,
+		    stats->frames.minLatency * 1e3, stats->frames.maxLatency * 1e3,
+		    stats->frames.gaps, stats->frames.resyncs);
+	}
+    }
+    if (stats->sched.wakes) {
+	printf( report_sched_deadline_format,
+		stats->transferID, stats->startTime, stats->endTime,
+		stats->sched.runtime, stats->sched.deadline, stats->sched.period,
+		stats->sched.wakes, (stats->sched.sumLate / stats->sched.wakes) * 1e3,
+		stats->sched.minLate * 1e3, stats->sched.maxLate * 1e3, stats->sched.misses);
+    }
     // Reset the enhanced stats for the next report interval
     if (stats->mEnhanced) {
-	if (stats->mUDP) {
-	    stats->transit.minTransit=stats->transit.lastTransit;
-	    stats->transit.maxTransit=stats->transit.lastTransit;
-	    stats->transit.sumTransit = stats->transit.lastTransit;
-	    stats->transit.cntTransit = 0;
-	    stats->transit.vdTransit = 0;
-	    stats->transit.meanTransit = 0;
-	    stats->transit.m2Transit = 0;
-#ifdef HAVE_ISOCHRONOUS
-	    stats->isochstats.framecnt = 0;
-	    stats->isochstats.framelostcnt = 0;
-	    stats->isochstats.slipcnt = 0;
-#endif
-	}
+	reporter_resetstats(stats);
     }
 
     if ( stats->free == 1) {
@@ -303,6 +398,10 @@ void reporter_printstats( Transfer_Info *stats ) {
 		histogram_delete(stats->latency_histogram);
 		stats->latency_histogram = NULL;
 	    }
+	    if (stats->intendedlatency_histogram) {
+		histogram_delete(stats->intendedlatency_histogram);
+		stats->intendedlatency_histogram = NULL;
+	    }
 #ifdef HAVE_ISOCHRONOUS
 	    if (stats->framelatency_histogram) {
 		histogram_delete(stats->framelatency_histogram);
@@ -368,18 +467,12 @@ void reporter_multistats( Transfer_Info *stats ) {
 			stats->sock_callstats.write.WriteErr,
 			stats->sock_callstats.write.TCPretry);
 	    } else {
+		char bins[READ_BINMAX * 12];
+		reporter_readbins_snprintf(bins, sizeof(bins), &stats->sock_callstats.read);
 		printf( report_sum_bw_read_enhanced_format,
 			stats->startTime, stats->endTime,
 			buffer, &buffer[sizeof(buffer)/2],
-			stats->sock_callstats.read.cntRead,
-			stats->sock_callstats.read.bins[0],
-			stats->sock_callstats.read.bins[1],
-			stats->sock_callstats.read.bins[2],
-			stats->sock_callstats.read.bins[3],
-			stats->sock_callstats.read.bins[4],
-			stats->sock_callstats.read.bins[5],
-			stats->sock_callstats.read.bins[6],
-			stats->sock_callstats.read.bins[7]);
+			stats->sock_callstats.read.cntRead, bins);
 	    }
 	}
     }
@@ -393,6 +486,143 @@ void reporter_multistats( Transfer_Info *stats ) {
     }
 }
 
+/*
+ * Prints aggregation group (--sum-groups) reports in default style
+ */
+void reporter_groupstats( Transfer_Info *stats, const char *label ) {
+
+    byte_snprintf( buffer, sizeof(buffer)/2, (double) stats->TotalLen,
+                   toupper( (int)stats->mFormat));
+    byte_snprintf( &buffer[sizeof(buffer)/2], sizeof(buffer)/2,
+                   ((double) stats->TotalLen) / (stats->endTime - stats->startTime),
+                   stats->mFormat);
+
+    if (stats->mUDP == (char)kMode_Server) {
+	printf(report_group_bw_jitter_loss_format, label,
+	       stats->startTime, stats->endTime,
+	       buffer, &buffer[sizeof(buffer)/2],
+	       stats->jitter*1000.0, stats->cntError, stats->cntDatagrams,
+	       (stats->cntDatagrams ? (100.0 * stats->cntError) / stats->cntDatagrams : 0.0));
+    } else {
+	printf(report_group_bw_format, label,
+	       stats->startTime, stats->endTime,
+	       buffer, &buffer[sizeof(buffer)/2]);
+    }
+}
+
+/*
+ * Prints anomaly lines (--report-policy anomalies) in default style
+ */
+void reporter_anomaly( Transfer_Info *stats, int kind, double value, double mean ) {
+    if (kind == ANOMALY_STALL) {
+	printf(report_anomaly_stall_format, stats->transferID,
+	       stats->startTime, stats->endTime);
+    } else {
+	printf(report_anomaly_loss_format, stats->transferID,
+	       stats->startTime, stats->endTime, value, mean);
+    }
+}
+
+void reporter_cpufreq( Transfer_Info *stats, int cpu, double mhz, int dmalatency ) {
+    char held[32];
+    if (dmalatency >= 0)
+	snprintf(held, sizeof(held), "%d us", dmalatency);
+    else
+	snprintf(held, sizeof(held), "not held");
+    printf(report_cpufreq_format, stats->transferID,
+	   stats->startTime, stats->endTime, cpu, mhz, held);
+}
+
+void reporter_softirqs( Transfer_Info *stats, SoftirqReport *report ) {
+    char flow[80], hottest[80 * SOFTIRQS_HOTTEST];
+    int ix, len = 0;
+    if (report->flow.cpu >= 0)
+	snprintf(flow, sizeof(flow), report_softirqs_cpu, report->flow.cpu,
+		 report->flow.net_rx, report->flow.net_tx, report->flow.irqs);
+    else
+	snprintf(flow, sizeof(flow), "CPU unknown");
+    snprintf(hottest, sizeof(hottest), "none");
+    for (ix = 0; ix < report->nhot; ix++) {
+	SoftirqCpu *hot = &report->hot[ix];
+	if (ix)
+	    len += snprintf(&hottest[len], sizeof(hottest) - len, ", ");
+	len += snprintf(&hottest[len], sizeof(hottest) - len, report_softirqs_cpu, hot->cpu,
+			hot->net_rx, hot->net_tx, hot->irqs);
+    }
+    printf(report_softirqs_format, stats->transferID,
+	   stats->startTime, stats->endTime, flow, hottest);
+}
+
+void reporter_energy( Transfer_Info *stats, EnergyReport *report ) {
+    char dram[32], perjoule[40];
+    double joules = report->package + report->dram;
+    if (report->hasdram)
+	snprintf(dram, sizeof(dram), "%.2f", report->dram);
+    else
+	snprintf(dram, sizeof(dram), "-");
+    if (!report->perjoule) {
+	printf(report_energy_format, stats->transferID, stats->startTime, stats->endTime,
+	       report->package, dram, joules / report->seconds);
+	return;
+    }
+    if (joules > 0)
+	byte_snprintf(perjoule, sizeof(perjoule), (double) stats->TotalLen / joules, toupper((int) stats->mFormat));
+    else
+	snprintf(perjoule, sizeof(perjoule), "- Bytes");
+    if (report->sum)
+	printf(report_sum_energy_format, stats->startTime, stats->endTime,
+	       report->package, dram, joules / report->seconds, perjoule);
+    else
+	printf(report_energy_perjoule_format, stats->transferID, stats->startTime, stats->endTime,
+	       report->package, dram, joules / report->seconds, perjoule);
+}
+
+// cycles/instructions/cache misses/branch misses per event, - not counted
+static void reporter_perfevents( char *buf, size_t len, PerfReport *report ) {
+    static const char *fmt[PERF_CSWITCHES] = { "%.0f", "%.0f", "%.2f", "%.3f" };
+    int ix, n = 0;
+    for (ix = 0; ix < PERF_CSWITCHES; ix++) {
+	if (ix)
+	    n += snprintf(&buf[n], len - n, "/");
+	if ((report->counts[ix] < 0) || (report->events <= 0))
+	    n += snprintf(&buf[n], len - n, "-");
+	else
+	    n += snprintf(&buf[n], len - n, fmt[ix], report->counts[ix] / report->events);
+    }
+}
+
+void reporter_perf( Transfer_Info *stats, PerfReport *flow, PerfReport *reporter ) {
+    char events[80], perbyte[32];
+    reporter_perfevents(events, sizeof(events), flow);
+    if ((flow->counts[PERF_CYCLES] >= 0) && (stats->TotalLen > 0))
+	snprintf(perbyte, sizeof(perbyte), "%.2f", flow->counts[PERF_CYCLES] / stats->TotalLen);
+    else
+	snprintf(perbyte, sizeof(perbyte), "-");
+    printf(report_perf_format, stats->transferID, stats->startTime, stats->endTime,
+	   (flow->useronly ? "(user)" : ""), events, perbyte, flow->counts[PERF_CSWITCHES], flow->events);
+    if (reporter) {
+	reporter_perfevents(events, sizeof(events), reporter);
+	printf(report_perf_reporter_format, stats->transferID, stats->startTime, stats->endTime,
+	       (reporter->useronly ? "(user)" : ""), events, reporter->counts[PERF_CSWITCHES], reporter->events);
+    }
+}
+
+/*
+ * Packet ring residency quantiles, of a flow or the SUM of them
+ */
+void reporter_ringlag( Transfer_Info *stats, RingLagReport *report ) {
+    char quantiles[80];
+    int ix, n = 0;
+    for (ix = 0; ix < RINGLAG_QUANTILES; ix++)
+	n += snprintf(&quantiles[n], sizeof(quantiles) - n, "%.1f/", report->quantiles[ix]);
+    snprintf(&quantiles[n], sizeof(quantiles) - n, "%.1f", report->max);
+    if (report->sum)
+	printf(report_sum_ringlag_format, stats->startTime, stats->endTime, quantiles, report->cnt);
+    else
+	printf(report_ringlag_format, stats->transferID, stats->startTime, stats->endTime,
+	       quantiles, report->cnt);
+}
+
 /*
  * Prints server transfer reports in default style
  */
@@ -641,7 +871,7 @@ void reporter_peerversion (thread_Settings *inSettings, int upper, int lower) {
 
 void reporter_reportMSS( int inMSS, thread_Settings *inSettings ) {
     if ( inMSS <= 0 ) {
-        printf( report_mss_unsupported, inSettings->mSock );
+        printf( report_mss_unsupported, procs_transferid(inSettings->mSock) );
     } else {
         char* net;
         int mtu = 0;
@@ -668,7 +898,7 @@ void reporter_reportMSS( int inMSS, thread_Settings *inSettings ) {
         }
 
         printf( report_mss,
-                inSettings->mSock, inMSS, mtu, net );
+                procs_transferid(inSettings->mSock), inMSS, mtu, net );
     }
 }
 // end ReportMSS
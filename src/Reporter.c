@@ -49,6 +49,9 @@
  *
  * ________________________________________________________________ */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include <math.h>
 #include "headers.h"
 #include "Settings.hpp"
@@ -59,7 +62,20 @@
 #include "PerfSocket.hpp"
 #include "SocketAddr.h"
 #include "histogram.h"
+#include "pool.h"
+#include "probes.h"
+#include "batch.h"
 #include "delay.h"
+#include "Processes.h"
+#include "Softirqs.h"
+#include "Energy.h"
+#ifdef HAVE_SCHED_GETCPU
+#include <sched.h>
+#endif
+#if defined(HAVE_X86INTRIN_H) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define HAVE_RINGLAG_TSC 1
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -116,14 +132,87 @@ report_statistics multiple_reports[kReport_MAXIMUM] = {
     CSV_stats
 };
 
+report_groupstatistics group_reports[kReport_MAXIMUM] = {
+    reporter_groupstats,
+    CSV_groupstats
+};
+
+report_anomaly anomaly_reports[kReport_MAXIMUM] = {
+    reporter_anomaly,
+    CSV_anomaly
+};
+
+report_cpufreq cpufreq_reports[kReport_MAXIMUM] = {
+    reporter_cpufreq,
+    CSV_cpufreq
+};
+
+report_softirqs softirq_reports[kReport_MAXIMUM] = {
+    reporter_softirqs,
+    CSV_softirqs
+};
+
+report_energy energy_reports[kReport_MAXIMUM] = {
+    reporter_energy,
+    CSV_energy
+};
+
+report_perf perf_reports[kReport_MAXIMUM] = {
+    reporter_perf,
+    CSV_perf
+};
+
+report_ringlag ringlag_reports[kReport_MAXIMUM] = {
+    reporter_ringlag,
+    CSV_ringlag
+};
+
 char buffer[SNBUFFERSIZE]; // Buffer for printing
 ReportHeader *ReportRoot = NULL;
 static int num_multi_slots = 0;
+static intmax_t reporter_perfevents = 0;	// packets the reporter thread handled
+static uint64_t ringlag_tick0;			// the residency clock calibration start
+static double ringlag_sec0;
 extern Condition ReportCond;
+// Aggregation groups and the report policy membership are shared by
+// traffic threads (join) and the reporter thread (accumulate/release),
+// aggrgroupCond protects both
+static AggrGroup *AggrRoot = NULL;
+extern Mutex aggrgroupCond;
+
+/*
+ * The top/bottom N report policies select flows per interval using
+ * bounded heaps, so the cost per interval is O(flows * log N) rather
+ * than a sort of all flows.  Other than members, which is updated
+ * under aggrgroupCond, only the reporter thread touches these.
+ */
+typedef struct PolicyEntry {
+    Transfer_Info info;
+    char peer[(2 * REPORT_ADDRLEN) + 16];
+    double key;
+} PolicyEntry;
+
+typedef struct PolicyWindow {
+    double startTime;
+    int offers;     // flows offered in this interval
+    int need;       // flows expected in this interval
+    int members;    // flows using a top/bottom policy
+    PolicyEntry *top;
+    int topcnt;
+    int topmax;
+    PolicyEntry *bottom;
+    int bottomcnt;
+    int bottommax;
+} PolicyWindow;
+
+static PolicyWindow policywindow = {-1, 0, 0, 0, NULL, 0, 0, NULL, 0, 0};
 int reporter_process_report ( ReportHeader *report );
 void process_report ( ReportHeader *report );
 int reporter_handle_packet( ReportHeader *report, ReportStruct *packet);
 int reporter_condprintstats( ReporterData *stats, MultiHeader *multireport, int force );
+void reporter_handle_group_reports( ReporterData *data, Transfer_Info *stats, int force );
+void reporter_policy_interval( ReporterData *data, Transfer_Info *stats );
+void reporter_policy_leave( ReporterData *data );
 int reporter_print( ReporterData *stats, int type, int end );
 void PrintMSS( ReporterData *stats );
 
@@ -132,10 +221,34 @@ static void InitDataReport(struct thread_Settings *mSettings);
 static void gettcpistats(ReporterData *stats, int final);
 #endif
 static PacketRing * init_packetring(int count);
+static void init_readstats(ReadStats *stats, thread_Settings *agent);
+static int ringlag_report(RingLagReport *report, RingLagStats *lag);
+static int reporter_batch_packet(ReportHeader *reporthdr, ReportStruct *packet);
+static void reporter_batch_flush(ReportHeader *reporthdr);
+static void reporter_printenergysum( MultiHeader *multireport, int final );
+static void reporter_printringlagsum( MultiHeader *multireport );
+
+/*
+ * TCP read size bins, by default BINCOUNT linear bins, with
+ * --read-bins log2 bins which resolve small reads much better
+ */
+static void init_readstats (ReadStats *stats, thread_Settings *agent) {
+    if (agent->mReadBins > 0) {
+	stats->bincnt = agent->mReadBins;
+	stats->binsize = agent->mBufLen;
+	stats->binlog = 1;
+    } else {
+	stats->bincnt = BINCOUNT;
+	stats->binsize = agent->mBufLen / BINCOUNT;
+	stats->binlog = 0;
+    }
+}
 
 MultiHeader* InitMulti( thread_Settings *agent, int inID) {
     MultiHeader *multihdr = NULL;
-    if ( agent->mThreads > 1 || agent->mThreadMode == kMode_Server ) {
+    // a --processes worker always sums, even a single flow, as the
+    // parent aggregates the workers' sums
+    if ( agent->mThreads > 1 || agent->mThreadMode == kMode_Server || procs_shared ) {
         if ( isMultipleReport( agent ) ) {
 	    if (agent->mThreadMode == kMode_Client) {
 		num_multi_slots = (agent->mMode == kTest_DualTest) ? ((agent->mThreads * 2) + 1) : (agent->mThreads  + 1);
@@ -143,10 +256,10 @@ MultiHeader* InitMulti( thread_Settings *agent, int inID) {
 		num_multi_slots = (((agent->mThreads * 2) + 1) > NUM_MULTI_SLOTS) ? ((agent->mThreads * 2) + 1) : NUM_MULTI_SLOTS;
 	    }
 	    // printf ("Alloc %d multislots\n", num_multi_slots);
-            multihdr = calloc((sizeof(MultiHeader) +  sizeof(ReporterData) +
-			       num_multi_slots * sizeof(Transfer_Info)), sizeof(char*));
+            multihdr = pool_getz(POOL_MULTIHDR, (sizeof(MultiHeader) +  sizeof(ReporterData) +
+						 num_multi_slots * sizeof(Transfer_Info)));
         } else {
-            multihdr = calloc(sizeof(MultiHeader), sizeof(char*));
+            multihdr = pool_getz(POOL_MULTIHDR, sizeof(MultiHeader));
         }
         if ( multihdr != NULL ) {
             memset( multihdr, 0, sizeof(MultiHeader) );
@@ -188,7 +301,9 @@ MultiHeader* InitMulti( thread_Settings *agent, int inID) {
                 data->info.mFormat = agent->mFormat;
                 data->info.mTTL = agent->mTTL;
 		if (data->mThreadMode == kMode_Server)
-		    data->info.sock_callstats.read.binsize = data->mBufLen / 8;
+		    init_readstats(&data->info.sock_callstats.read, agent);
+		if (isEnergy(agent))
+		    data->energy = 1;
                 if ( isEnhanced( agent ) ) {
 		    data->info.mEnhanced = 1;
 		} else {
@@ -263,7 +378,7 @@ static void free_packetring(PacketRing *pr) {
   if (pr->awaitcounter > 1000) fprintf(stderr, "WARN: Reporter thread may be too slow, await counter=%d, " \
                                 "consider increasing NUM_REPORT_STRUCTS\n", pr->awaitcounter);
   Condition_Destroy(&pr->await_consumer);
-  if (pr->data) free(pr->data);
+  pool_put(pr);
 }
 
 void FreeReport(ReportHeader *reporthdr) {
@@ -272,9 +387,17 @@ void FreeReport(ReportHeader *reporthdr) {
     }
     if (reporthdr) {
       free_packetring(reporthdr->packetring);
+      if (reporthdr->report.perfopened)
+	  perf_group_close(&reporthdr->report.perf);
+      if (reporthdr->report.fullreportbuf) {
+	free(reporthdr->report.fullreportbuf);
+      }
       if (reporthdr->report.info.latency_histogram) {
         histogram_delete(reporthdr->report.info.latency_histogram);
       }
+      if (reporthdr->report.info.intendedlatency_histogram) {
+        histogram_delete(reporthdr->report.info.intendedlatency_histogram);
+      }
 #ifdef HAVE_ISOCHRONOUS
       if (reporthdr->report.info.framelatency_histogram) {
         histogram_delete(reporthdr->report.info.framelatency_histogram);
@@ -283,15 +406,100 @@ void FreeReport(ReportHeader *reporthdr) {
 #ifdef HAVE_THREAD_DEBUG
       thread_debug("Free report hdr %p delay counter=%d", (void *)reporthdr, reporthdr->delaycounter);
 #endif
-      free(reporthdr);
+      pool_put(reporthdr);
     }
 }
 
+/*
+ * Build the key of the aggregation group for a given level.  Source
+ * is the sending host, i.e. the local address on the client and
+ * the peer address on the server.  Port is the server's port.
+ */
+static void aggr_label (thread_Settings *mSettings, int level, char *label) {
+    iperf_sockaddr *src, *dst;
+    char addr[REPORT_ADDRLEN];
+    if (mSettings->mThreadMode == kMode_Client) {
+	src = &mSettings->local;
+	dst = &mSettings->peer;
+    } else {
+	src = &mSettings->peer;
+	dst = &mSettings->local;
+    }
+    switch (level) {
+    case AGGR_SRC :
+	SockAddr_getHostAddress(src, addr, sizeof(addr));
+	snprintf(label, AGGR_LABELSIZE, "src=%s", addr);
+	break;
+    case AGGR_DST :
+	SockAddr_getHostAddress(dst, addr, sizeof(addr));
+	snprintf(label, AGGR_LABELSIZE, "dst=%s", addr);
+	break;
+    case AGGR_TOS :
+	snprintf(label, AGGR_LABELSIZE, "tos=0x%02x", mSettings->mTOS);
+	break;
+    case AGGR_PORT :
+	{
+	    int width = (mSettings->mAggrPortWidth > 0) ? mSettings->mAggrPortWidth : 1;
+	    int lower = SockAddr_getPort(dst);
+	    lower -= (lower % width);
+	    if (width == 1)
+		snprintf(label, AGGR_LABELSIZE, "port=%d", lower);
+	    else
+		snprintf(label, AGGR_LABELSIZE, "port=%d-%d", lower, lower + width - 1);
+	}
+	break;
+    case AGGR_ALL :
+    default :
+	snprintf(label, AGGR_LABELSIZE, "all");
+	break;
+    }
+}
+
+/*
+ * Join the flow to one group per configured level, creating
+ * the groups on first use
+ */
+static void aggr_join (thread_Settings *mSettings, ReporterData *data) {
+    int level, ix;
+    char label[AGGR_LABELSIZE];
+    AggrGroup *group;
+
+    data->aggrlast = -1;
+    Mutex_Lock(&aggrgroupCond);
+    for (level = AGGR_ALL; level <= AGGR_PORT; level <<= 1) {
+	if (!(mSettings->mAggrLevels & level))
+	    continue;
+	aggr_label(mSettings, level, label);
+	for (group = AggrRoot; group != NULL; group = group->next) {
+	    if ((group->level == level) && !strcmp(group->label, label))
+		break;
+	}
+	if (group == NULL) {
+	    group = (AggrGroup *) calloc(1, sizeof(AggrGroup));
+	    if (group == NULL) {
+		Mutex_Unlock(&aggrgroupCond);
+		FAIL(1, "Out of Memory!!\n", mSettings);
+		return;
+	    }
+	    memcpy(group->label, label, AGGR_LABELSIZE);
+	    group->level = level;
+	    group->mode = mSettings->mReportMode;
+	    for (ix = 0; ix < AGGR_SLOTS; ix++)
+		group->slots[ix].startTime = -1;
+	    group->next = AggrRoot;
+	    AggrRoot = group;
+	}
+	group->members++;
+	data->aggr[data->aggrcnt++] = group;
+    }
+    Mutex_Unlock(&aggrgroupCond);
+}
+
 void InitDataReport(thread_Settings *mSettings) {
     /*
      * Create in one big chunk
      */
-    ReportHeader *reporthdr = (ReportHeader *) calloc(1, sizeof(ReportHeader));
+    ReportHeader *reporthdr = (ReportHeader *) pool_getz(POOL_REPORTHDR, sizeof(ReportHeader));
     ReporterData *data = NULL;
 
     if ( reporthdr != NULL ) {
@@ -309,7 +517,7 @@ void InitDataReport(thread_Settings *mSettings) {
 	data->lastError = INITIAL_PACKETID;
 	data->lastDatagrams = INITIAL_PACKETID;
 	data->PacketID = INITIAL_PACKETID;
-	data->info.transferID = mSettings->mSock;
+	data->info.transferID = procs_transferid(mSettings->mSock);
 	data->info.groupID = (mSettings->multihdr != NULL ? mSettings->multihdr->groupID : -1);
 	data->type = TRANSFER_REPORT;
 	if ( mSettings->mInterval != 0.0 ) {
@@ -331,8 +539,10 @@ void InitDataReport(thread_Settings *mSettings) {
 	data->mode = mSettings->mReportMode;
 	data->info.mFormat = mSettings->mFormat;
 	data->info.mTTL = mSettings->mTTL;
-	if (data->mThreadMode == kMode_Server)
-	    data->info.sock_callstats.read.binsize = data->mBufLen / 8;
+	if (data->mThreadMode == kMode_Server) {
+	    init_readstats(&data->info.sock_callstats.read, mSettings);
+	    data->fullreport = isFullReport(mSettings);
+	}
 	if ( isUDP( mSettings ) ) {
 	    gettimeofday(&data->IPGstart, NULL);
 	    reporthdr->report.info.mUDP = (char)mSettings->mThreadMode;
@@ -351,6 +561,12 @@ void InitDataReport(thread_Settings *mSettings) {
 							       (mSettings->mRXunits ? 1e6 : 1e3), \
 							       mSettings->mRXci_lower, mSettings->mRXci_upper, data->info.transferID, name);
 	    }
+	    if (isRxHistogram(mSettings) && isIntendedTime(mSettings)) {
+		char name[] = "I8";
+		data->info.intendedlatency_histogram =  histogram_init(mSettings->mRXbins,mSettings->mRXbinsize,0,\
+								     (mSettings->mRXunits ? 1e6 : 1e3), \
+								     mSettings->mRXci_lower, mSettings->mRXci_upper, data->info.transferID, name);
+	    }
 #ifdef HAVE_ISOCHRONOUS
 	    if (isRxHistogram(mSettings) && isIsochronous(mSettings)) {
 		char name[] = "F8";
@@ -371,6 +587,43 @@ void InitDataReport(thread_Settings *mSettings) {
 	    data->info.mIsochronous = 0;
 	}
 #endif
+	if (mSettings->mAggrLevels && (reporthdr->packet_handler != NULL))
+	    aggr_join(mSettings, data);
+	if (mSettings->mReportPolicy && (mSettings->mInterval != 0.0)) {
+	    data->policy = mSettings->mReportPolicy;
+	    data->policytopn = mSettings->mPolicyTopN;
+	    data->policybottomn = mSettings->mPolicyBottomN;
+	    data->policychange = mSettings->mPolicyChangePct;
+	    data->policylast = -1;
+	    data->policylastbw = -1;
+	    if (data->policy & (RPOLICY_TOPN | RPOLICY_BOTTOMN)) {
+		Mutex_Lock(&aggrgroupCond);
+		policywindow.members++;
+		Mutex_Unlock(&aggrgroupCond);
+		data->policyjoined = 1;
+	    }
+	}
+	if (isCpuDmaLatency(mSettings)) {
+	    data->cpufreq = 1;
+	    data->cpu = -1;
+	    data->cpudmalatency = mSettings->mCpuDmaLatency;
+	}
+	if (isSoftirqs(mSettings)) {
+	    data->softirqs = 1;
+	    data->cpu = -1;
+	}
+	if (isEnergy(mSettings))
+	    data->energy = 1;
+	perf_group_init(&data->perf);
+	if (isPerfCounters(mSettings))
+	    data->perfcounters = 1;
+	if ((data->mThreadMode == kMode_Client) && mSettings->mWriteSizes)
+	    data->info.sock_callstats.write.sizebinned = 1;
+	if ((data->mThreadMode == kMode_Client) && (mSettings->mSchedPeriod > 0)) {
+	    data->info.sched.runtime = mSettings->mSchedRuntime;
+	    data->info.sched.deadline = mSettings->mSchedDeadline;
+	    data->info.sched.period = mSettings->mSchedPeriod;
+	}
     } else {
 	FAIL(1, "Out of Memory!!\n", mSettings);
     }
@@ -408,7 +661,7 @@ void InitConnectionReport (thread_Settings *mSettings) {
 	 * We don't have a Data Report structure in which to hang
 	 * the connection report so allocate a minimal one
 	 */
-	reporthdr = calloc( sizeof(ReportHeader), sizeof(char*) );
+	reporthdr = pool_getz(POOL_REPORTHDR, sizeof(ReportHeader));
 	if (reporthdr == NULL ) {
 	    FAIL(1, "Out of Memory!!\n", mSettings);
 	}
@@ -417,7 +670,7 @@ void InitConnectionReport (thread_Settings *mSettings) {
     }
     // Fill out known fields for the connection report
     data = &reporthdr->report;
-    data->info.transferID = mSettings->mSock;
+    data->info.transferID = procs_transferid(mSettings->mSock);
     data->info.groupID = -1;
     data->type |= CONNECTION_REPORT;
     data->connection.peer = mSettings->peer;
@@ -492,8 +745,11 @@ void PostReport (ReportHeader *reporthdr) {
 
 static PacketRing * init_packetring (int count) {
   PacketRing *pr = NULL;
-  if ((pr = (PacketRing *) calloc(1, sizeof(PacketRing)))) {
-      pr->data = (ReportStruct *) calloc(count, sizeof(ReportStruct));
+  // the ring and its report structs in one chunk, the structs are
+  // always written before read so only the ring itself needs zeroing
+  if ((pr = (PacketRing *) pool_get(POOL_PACKETRING, sizeof(PacketRing) + (count * sizeof(ReportStruct))))) {
+      memset(pr, 0, sizeof(PacketRing));
+      pr->data = (ReportStruct *) (pr + 1);
 #ifdef HAVE_THREAD_DEBUG
       thread_debug("Init %d element packet ring %p", count, (void *)pr);
 #endif
@@ -512,10 +768,61 @@ static PacketRing * init_packetring (int count) {
   return (pr);
 }
 
+/*
+ * The ring residency clock, the TSC where there is one as it's a few
+ * cycles to read, else the monotonic clock in nsecs.  Ticks are only
+ * converted when reported, at the rate measured against the monotonic
+ * clock since the reporter started, a constant rate TSC synchronized
+ * across the CPUs is assumed (any x86 of the last decade or so.)
+ */
+static inline uint64_t ringlag_now (void) {
+#ifdef HAVE_RINGLAG_TSC
+    return __rdtsc();
+#elif defined(HAVE_CLOCK_GETTIME)
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((uint64_t) t.tv_sec * 1000000000) + t.tv_nsec;
+#else
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return (((uint64_t) t.tv_sec * rMillion) + t.tv_usec) * 1000;
+#endif
+}
+
+static double ringlag_seconds (void) {
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + (t.tv_nsec / 1e9);
+#else
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec + (t.tv_usec / (double) rMillion);
+#endif
+}
+
+static void ringlag_calibrate (void) {
+    ringlag_tick0 = ringlag_now();
+    ringlag_sec0 = ringlag_seconds();
+}
+
+static double ringlag_tickspersec (void) {
+    double elapsed = ringlag_seconds() - ringlag_sec0;
+    uint64_t ticks = ringlag_now() - ringlag_tick0;
+    if ((elapsed <= 0) || !ringlag_sec0)
+	return 1e9;
+    return ticks / elapsed;
+}
+
 static inline void enqueue_packetring(ReportHeader* agent, ReportStruct *metapacket) {
   PacketRing *pr = agent->packetring;
+  int stalled = 0;
   while (((pr->producer == pr->maxcount) && (pr->consumer == 0)) || \
 	 ((pr->producer + 1) == pr->consumer)) {
+    if (!stalled) {
+      stalled = 1;
+      IPERF_PROBE2(ring_stall, pr, pr->awaitcounter);
+    }
     // Signal the consumer thread to process a full queue
     Condition_Signal(pr->awake_consumer);
     // Wait for the consumer to create some queue space
@@ -535,15 +842,20 @@ static inline void enqueue_packetring(ReportHeader* agent, ReportStruct *metapac
     Condition_TimedWait(&pr->await_consumer, 1);
     Condition_Unlock(pr->await_consumer);
   }
+  if (stalled)
+    IPERF_PROBE2(ring_unstall, pr, pr->awaitcounter);
   int writeindex;
   if ((pr->producer + 1) == pr->maxcount)
     writeindex = 0;
   else
     writeindex = (pr->producer  + 1);
 
+  if (agent->report.info.mEnhanced)
+    metapacket->enqueued = ringlag_now();
   /* Next two lines must be maintained as is */
   memcpy((agent->packetring->data + writeindex), metapacket, sizeof(ReportStruct));
   pr->producer = writeindex;
+  IPERF_PROBE4(ring_enqueue, pr, writeindex, metapacket->packetID, metapacket->packetLen);
 }
 
 static inline ReportStruct *dequeue_packetring(ReportHeader* agent) {
@@ -561,6 +873,8 @@ static inline ReportStruct *dequeue_packetring(ReportHeader* agent) {
     readindex = (pr->consumer + 1);
   //取出readindex位置处的packet
   packet = (agent->packetring->data + readindex);
+  // the probe reads the slot before it's released to the producer
+  IPERF_PROBE4(ring_dequeue, pr, readindex, packet->packetID, packet->packetLen);
   // advance the consumer pointer last
   //更新readindex
   pr->consumer = readindex;
@@ -603,6 +917,17 @@ static inline int getcount_packetring(ReportHeader *agent) {
  */
 void ReportPacket( ReportHeader* agent, ReportStruct *packet ) {
     if ( agent != NULL ) {
+#ifdef HAVE_SCHED_GETCPU
+	// --cpu-dma-latency and --softirqs, track the CPU the traffic
+	// thread runs on
+	if ( agent->report.cpufreq || agent->report.softirqs )
+	    agent->report.cpu = sched_getcpu();
+#endif
+	// --perf-counters, the group counts the thread that opens it
+	if ( agent->report.perfcounters && !agent->report.perfopened ) {
+	    perf_group_open(&agent->report.perf);
+	    agent->report.perfopened = 1;
+	}
         enqueue_packetring(agent, packet);
 #ifndef HAVE_THREAD
         /*
@@ -659,6 +984,22 @@ void EndReport( ReportHeader *agent ) {
     }
 }
 
+/*
+ * The reporter is through with a transfer report, release its traffic
+ * thread from EndReport.  That thread may free the report as soon as
+ * it sees consumerdone so this is the reporter's last touch of it.
+ * Signaling here, rather than only on the ring going empty, keeps
+ * EndReport from sleeping out its timed wait at every test's end.
+ */
+static void reporter_consumerdone( ReportHeader *reporthdr ) {
+    if (reporthdr->packetring) {
+	Condition_Lock(reporthdr->packetring->await_consumer);
+	reporthdr->packetring->consumerdone = 1;
+	Condition_Signal(&reporthdr->packetring->await_consumer);
+	Condition_Unlock(reporthdr->packetring->await_consumer);
+    }
+}
+
 /*
  * GetReport is called by the agent after a CloseReport
  * to get the final stats generated by the reporterthread
@@ -684,13 +1025,13 @@ ReportHeader *ReportSettings( thread_Settings *agent ) {
          * Populate and optionally create a new settings report
          */
 	 if (!reporthdr)
-	    reporthdr = calloc(sizeof(ReportHeader), sizeof(char*));
+	    reporthdr = pool_getz(POOL_REPORTHDR, sizeof(ReportHeader));
 	 if (reporthdr) {
 #ifdef HAVE_THREAD_DEBUG
     thread_debug("Init settings report %p", reporthdr);
 #endif
             ReporterData *data = &reporthdr->report;
-            data->info.transferID = agent->mSock;
+            data->info.transferID = procs_transferid(agent->mSock);
             data->info.groupID = -1;
             data->mHost = agent->mHost;
             data->mLocalhost = agent->mLocalhost;
@@ -731,35 +1072,257 @@ ReportHeader *ReportSettings( thread_Settings *agent ) {
     return reporthdr;
 }
 
+#define FULLREPORT_PUT64(hi, lo, v) do { (hi) = htonl((uint32_t) (((uintmax_t) (v)) >> 32)); \
+	(lo) = htonl((uint32_t) (((uintmax_t) (v)) & 0xFFFFFFFF)); } while (0)
+#define FULLREPORT_GET64(hi, lo) ((intmax_t) ((((uintmax_t) ntohl(hi)) << 32) | ntohl(lo)))
+
+/*
+ * --full-report, encode the server's final report for the client.
+ * Called on the final stats before their print releases the
+ * histograms.  The histograms send only their populated bins.
+ */
+static void reporter_encode_fullreport( ReporterData *stats ) {
+    Transfer_Info *info = &stats->info;
+    histogram_t *hist[2];
+    int nhist = 0, len, ix, hx, flags;
+
+    if (info->latency_histogram)
+	hist[nhist++] = info->latency_histogram;
+#ifdef HAVE_ISOCHRONOUS
+    if (info->framelatency_histogram)
+	hist[nhist++] = info->framelatency_histogram;
+#endif
+    len = sizeof(server_fullreport);
+    for (hx = 0; hx < nhist; hx++) {
+	len += sizeof(server_histogram);
+	for (ix = 0; ix < (int) hist[hx]->bincount; ix++) {
+	    if (hist[hx]->mybins[ix])
+		len += 2 * sizeof(int32_t);
+	}
+    }
+    if (len > FULLREPORT_MAXLEN)
+	len = FULLREPORT_MAXLEN;
+    if (stats->fullreportbuf)
+	free(stats->fullreportbuf);
+    stats->fullreportlen = 0;
+    if ((stats->fullreportbuf = (char *) calloc(1, len)) == NULL)
+	return;
+
+    server_fullreport *rpt = (server_fullreport *) stats->fullreportbuf;
+    flags = (info->mUDP ? FULLREPORT_UDP : FULLREPORT_TCP);
+    if (info->mEnhanced)
+	flags |= FULLREPORT_ENHANCED;
+    rpt->typelen.type = htonl(SERVERFULLREPORT);
+    rpt->typelen.length = htonl(len);
+    rpt->flags = htonl(flags);
+    FULLREPORT_PUT64(rpt->total_len1, rpt->total_len2, info->TotalLen);
+    rpt->stop_sec = htonl((long) info->endTime);
+    rpt->stop_usec = htonl((long) ((info->endTime - (long) info->endTime) * rMillion));
+    if (info->mTCP == (char)kMode_Server) {
+	ReadStats *read = &info->sock_callstats.read;
+	rpt->triptime_sec = htonl((long) info->tripTime);
+	rpt->triptime_usec = htonl((long) ((info->tripTime - (long) info->tripTime) * rMillion));
+	rpt->reads = htonl(read->cntRead);
+	rpt->read_binsize = htonl(read->binsize);
+	rpt->read_bincnt = htonl(read->bincnt);
+	rpt->read_binlog = htonl(read->binlog);
+	for (ix = 0; (ix < read->bincnt) && (ix < READ_BINMAX); ix++)
+	    rpt->read_bins[ix] = htonl(read->bins[ix]);
+    }
+    FULLREPORT_PUT64(rpt->verify_cnt1, rpt->verify_cnt2, info->verify.cnt);
+    FULLREPORT_PUT64(rpt->verify_corrupt1, rpt->verify_corrupt2, info->verify.corrupt);
+    FULLREPORT_PUT64(rpt->l2_cnt1, rpt->l2_cnt2, info->l2counts.cnt);
+    rpt->l2_unknown = htonl((long) info->l2counts.unknown);
+    rpt->l2_udpcsumerr = htonl((long) info->l2counts.udpcsumerr);
+    rpt->l2_lengtherr = htonl((long) info->l2counts.lengtherr);
+    FULLREPORT_PUT64(rpt->frame_cnt1, rpt->frame_cnt2, info->frames.cnt);
+    rpt->frame_gaps = htonl((long) info->frames.gaps);
+    rpt->frame_resyncs = htonl((long) info->frames.resyncs);
+    rpt->frame_cntlatency = htonl((long) info->frames.cntLatency);
+    rpt->frame_minlatency = htonl((long) (info->frames.minLatency * rMillion));
+    rpt->frame_maxlatency = htonl((long) (info->frames.maxLatency * rMillion));
+    FULLREPORT_PUT64(rpt->frame_sumlatency1, rpt->frame_sumlatency2, (intmax_t) (info->frames.sumLatency * rMillion));
+    for (ix = 0; ix < LOG2_BINS; ix++)
+	rpt->frame_bins[ix] = htonl(info->frames.bins[ix]);
+
+    char *p = stats->fullreportbuf + sizeof(server_fullreport);
+    char *end = stats->fullreportbuf + len;
+    for (hx = 0; (hx < nhist) && ((p + sizeof(server_histogram)) <= end); hx++) {
+	histogram_t *h = hist[hx];
+	server_histogram *sh = (server_histogram *) p;
+	int32_t *pair = (int32_t *) (sh + 1);
+	int bins = 0, dropped = 0;
+	for (ix = 0; ix < (int) h->bincount; ix++) {
+	    if (!h->mybins[ix])
+		continue;
+	    if ((char *) (pair + 2) > end) {
+		dropped += h->mybins[ix];
+		continue;
+	    }
+	    *pair++ = htonl(ix);
+	    *pair++ = htonl(h->mybins[ix]);
+	    bins++;
+	}
+	sh->bincount = htonl(h->bincount);
+	sh->binwidth = htonl(h->binwidth);
+	sh->units = htonl((long) h->units);
+	sh->populationcnt = htonl(h->populationcnt);
+	sh->loweroutofbounds = htonl(h->cntloweroutofbounds);
+	sh->upperoutofbounds = htonl(h->cntupperoutofbounds + dropped);
+	sh->ci_lower = htonl((long) (h->ci_lower * 100));
+	sh->ci_upper = htonl((long) (h->ci_upper * 100));
+	strncpy(sh->name, h->myname, FULLREPORT_NAMELEN - 1);
+	sh->bins = htonl(bins);
+	p = (char *) pair;
+    }
+    rpt->histograms = htonl(hx);
+    stats->fullreportlen = len;
+}
+
+/*
+ * Fill the relayed stats in from a --full-report, returns 0 when the
+ * report made sense.  The UDP totals come with the server_hdr.
+ */
+static int reporter_decode_fullreport( Transfer_Info *stats, const char *buf, int len ) {
+    const server_fullreport *rpt = (const server_fullreport *) buf;
+    int ix, hx, flags, nhist;
+
+    if ((len < (int) sizeof(server_fullreport)) || (ntohl(rpt->typelen.type) != SERVERFULLREPORT) || \
+	((int) ntohl(rpt->typelen.length) > len))
+	return -1;
+    len = ntohl(rpt->typelen.length);
+    flags = ntohl(rpt->flags);
+    if (flags & FULLREPORT_TCP) {
+	ReadStats *read = &stats->sock_callstats.read;
+	stats->mEnhanced = ((flags & FULLREPORT_ENHANCED) != 0);
+	stats->TotalLen = FULLREPORT_GET64(rpt->total_len1, rpt->total_len2);
+	stats->startTime = 0;
+	stats->endTime = ntohl(rpt->stop_sec) + ntohl(rpt->stop_usec) / (double)rMillion;
+	stats->tripTime = ntohl(rpt->triptime_sec) + ntohl(rpt->triptime_usec) / (double)rMillion;
+	read->cntRead = ntohl(rpt->reads);
+	read->binsize = ntohl(rpt->read_binsize);
+	read->bincnt = ntohl(rpt->read_bincnt);
+	if ((read->bincnt < 0) || (read->bincnt > READ_BINMAX))
+	    read->bincnt = 0;
+	read->binlog = ntohl(rpt->read_binlog);
+	for (ix = 0; ix < read->bincnt; ix++)
+	    read->bins[ix] = ntohl(rpt->read_bins[ix]);
+    } else {
+	stats->l2counts.cnt = FULLREPORT_GET64(rpt->l2_cnt1, rpt->l2_cnt2);
+	stats->l2counts.unknown = ntohl(rpt->l2_unknown);
+	stats->l2counts.udpcsumerr = ntohl(rpt->l2_udpcsumerr);
+	stats->l2counts.lengtherr = ntohl(rpt->l2_lengtherr);
+    }
+    stats->verify.cnt = FULLREPORT_GET64(rpt->verify_cnt1, rpt->verify_cnt2);
+    stats->verify.corrupt = FULLREPORT_GET64(rpt->verify_corrupt1, rpt->verify_corrupt2);
+    stats->frames.cnt = FULLREPORT_GET64(rpt->frame_cnt1, rpt->frame_cnt2);
+    stats->frames.gaps = ntohl(rpt->frame_gaps);
+    stats->frames.resyncs = ntohl(rpt->frame_resyncs);
+    stats->frames.cntLatency = ntohl(rpt->frame_cntlatency);
+    stats->frames.minLatency = ntohl(rpt->frame_minlatency) / (double)rMillion;
+    stats->frames.maxLatency = ntohl(rpt->frame_maxlatency) / (double)rMillion;
+    stats->frames.sumLatency = FULLREPORT_GET64(rpt->frame_sumlatency1, rpt->frame_sumlatency2) / (double)rMillion;
+    for (ix = 0; ix < LOG2_BINS; ix++)
+	stats->frames.bins[ix] = ntohl(rpt->frame_bins[ix]);
+
+    const char *p = buf + sizeof(server_fullreport);
+    const char *end = buf + len;
+    nhist = ntohl(rpt->histograms);
+    for (hx = 0; (hx < nhist) && ((p + sizeof(server_histogram)) <= end); hx++) {
+	server_histogram sh;
+	char name[FULLREPORT_NAMELEN];
+	histogram_t *h;
+	int bins, bincount;
+	memcpy(&sh, p, sizeof(sh));
+	p += sizeof(sh);
+	bins = ntohl(sh.bins);
+	bincount = ntohl(sh.bincount);
+	if ((bins < 0) || (bincount <= 0) || (bins > bincount) || (bins > (int) ((end - p) / (2 * sizeof(int32_t)))))
+	    break;
+	memcpy(name, sh.name, FULLREPORT_NAMELEN);
+	name[FULLREPORT_NAMELEN - 1] = '\0';
+	h = histogram_init(bincount, ntohl(sh.binwidth), 0, (float) ntohl(sh.units), ntohl(sh.ci_lower) / 100.0, \
+			   ntohl(sh.ci_upper) / 100.0, stats->transferID, name);
+	if (!h)
+	    break;
+	h->populationcnt = ntohl(sh.populationcnt);
+	h->cntloweroutofbounds = ntohl(sh.loweroutofbounds);
+	h->cntupperoutofbounds = ntohl(sh.upperoutofbounds);
+	for (ix = 0; ix < bins; ix++, p += 2 * sizeof(int32_t)) {
+	    int32_t pair[2];
+	    memcpy(pair, p, sizeof(pair));
+	    if ((int) ntohl(pair[0]) < bincount)
+		h->mybins[ntohl(pair[0])] = ntohl(pair[1]);
+	}
+	if (!stats->latency_histogram) {
+	    stats->latency_histogram = h;
+#ifdef HAVE_ISOCHRONOUS
+	} else if (!stats->framelatency_histogram) {
+	    stats->framelatency_histogram = h;
+#endif
+	} else {
+	    histogram_delete(h);
+	}
+    }
+    // the final print releases the histograms
+    stats->free = 1;
+    return 0;
+}
+
+/*
+ * A report of the server's stats for the client to print, the
+ * server's final report relayed per the UDP AckFIN or --full-report
+ */
+static ReportHeader *reporter_relay_report( thread_Settings *agent ) {
+    /*
+     * Create in one big chunk
+     */
+    ReportHeader *reporthdr = pool_getz(POOL_REPORTHDR, sizeof(ReportHeader));
+    if ( !reporthdr ) {
+	FAIL(1, "Out of Memory!!\n", agent);
+    }
+#ifdef HAVE_THREAD_DEBUG
+    thread_debug("Init server relay report %p size %ld\n", (void *)reporthdr, sizeof(ReportHeader));
+#endif
+    Transfer_Info *stats = &reporthdr->report.info;
+    stats->transferID = procs_transferid(agent->mSock);
+    stats->groupID = (agent->multihdr != NULL ? agent->multihdr->groupID \
+		      : -1);
+    reporthdr->report.type = SERVER_RELAY_REPORT;
+    reporthdr->report.mode = agent->mReportMode;
+    stats->mFormat = agent->mFormat;
+    reporthdr->report.connection.peer = agent->local;
+    reporthdr->report.connection.size_peer = agent->size_local;
+    reporthdr->report.connection.local = agent->peer;
+    reporthdr->report.connection.size_local = agent->size_peer;
+    return reporthdr;
+}
+
+static void reporter_relay_post( ReportHeader *reporthdr ) {
+#ifdef HAVE_THREAD
+    PostReport(reporthdr);
+#else
+    /*
+     * Process the report in this thread
+     */
+    reporthdr->next = NULL;
+    process_report ( reporthdr );
+#endif
+}
+
 /*
  * ReportServerUDP will generate a report of the UDP
  * statistics as reported by the server on the client
- * side.
+ * side.  len is what came from the server_hdr on, longer
+ * with a --full-report.
  */
-void ReportServerUDP( thread_Settings *agent, server_hdr *server ) {
+void ReportServerUDP( thread_Settings *agent, server_hdr *server, int len ) {
     unsigned int flags = ntohl(server->base.flags);
     // printf("Server flags = 0x%X\n", flags);
     if (isServerReport(agent) && ((flags & HEADER_VERSION1) != 0)) {
-	/*
-	 * Create in one big chunk
-	 */
-	ReportHeader *reporthdr = calloc( sizeof(ReportHeader), sizeof(char*));
+	ReportHeader *reporthdr = reporter_relay_report(agent);
 	Transfer_Info *stats = &reporthdr->report.info;
 
-	if ( !reporthdr ) {
-	    FAIL(1, "Out of Memory!!\n", agent);
-	}
-#ifdef HAVE_THREAD_DEBUG
-	thread_debug("Init server relay report %p size %ld\n", (void *)reporthdr, sizeof(ReportHeader));
-#endif
-
-	stats->transferID = agent->mSock;
-	stats->groupID = (agent->multihdr != NULL ? agent->multihdr->groupID \
-			  : -1);
-
-	reporthdr->report.type = SERVER_RELAY_REPORT;
-	reporthdr->report.mode = agent->mReportMode;
-	stats->mFormat = agent->mFormat;
 	stats->jitter = ntohl( server->base.jitter1 );
 	stats->jitter += ntohl( server->base.jitter2 ) / (double)rMillion;
 #ifdef HAVE_INT64_T
@@ -803,20 +1366,27 @@ void ReportServerUDP( thread_Settings *agent, server_hdr *server ) {
 	    stats->IPGsum = ntohl( server->extend.IPGsum );
 	}
 	stats->mUDP = (char)kMode_Server;
-	reporthdr->report.connection.peer = agent->local;
-	reporthdr->report.connection.size_peer = agent->size_local;
-	reporthdr->report.connection.local = agent->peer;
-	reporthdr->report.connection.size_local = agent->size_peer;
+	if ((flags & HEADER_FULLREPORT) && (len > (int) sizeof(server_hdr))) {
+	    reporter_decode_fullreport(stats, (char *) (server + 1), len - sizeof(server_hdr));
+	}
+	reporter_relay_post(reporthdr);
+    }
+}
 
-#ifdef HAVE_THREAD
-	PostReport(reporthdr);
-#else
-	/*
-	 * Process the report in this thread
-	 */
-	reporthdr->next = NULL;
-	process_report ( reporthdr );
-#endif
+/*
+ * ReportServerTCP prints the server's final TCP report, per
+ * --full-report, on the client side
+ */
+void ReportServerTCP( thread_Settings *agent, const char *report, int len ) {
+    if (isServerReport(agent)) {
+	ReportHeader *reporthdr = reporter_relay_report(agent);
+	Transfer_Info *stats = &reporthdr->report.info;
+	stats->mTCP = (char)kMode_Server;
+	if (reporter_decode_fullreport(stats, report, len) != 0) {
+	    pool_put(reporthdr);
+	    return;
+	}
+	reporter_relay_post(reporthdr);
     }
 }
 
@@ -885,6 +1455,9 @@ void reporter_spawn( thread_Settings *thread ) {
 	Condition_Unlock(thread->multihdr->await_reporter);
 	Condition_Broadcast(&thread->multihdr->await_reporter);
     }
+    if (isPerfCounters(thread))
+	perf_reporter_open();
+    ringlag_calibrate();
     do {
         Condition_Lock ( ReportCond );
         if ( ReportRoot == NULL ) {
@@ -925,7 +1498,9 @@ void reporter_spawn( thread_Settings *thread ) {
 #ifdef HAVE_THREAD_DEBUG
 		  thread_debug("Free %p in rs", (void *) tmp);
 #endif
-		    free(tmp);
+		    pool_put(tmp);
+		} else {
+		    reporter_consumerdone(tmp);
 		}
                 Condition_Unlock ( ReportCond );
                 if (ReportRoot)
@@ -952,12 +1527,15 @@ void process_report ( ReportHeader *report ) {
 	    if (report->report.info.latency_histogram) {
 		histogram_delete(report->report.info.latency_histogram);
 	    }
+	    if (report->report.info.intendedlatency_histogram) {
+		histogram_delete(report->report.info.intendedlatency_histogram);
+	    }
 #ifdef HAVE_ISOCHRONOUS
 	    if (report->report.info.framelatency_histogram) {
 		histogram_delete(report->report.info.framelatency_histogram);
 	    }
 #endif
-            free( report );
+            pool_put( report );
         }
     }
 }
@@ -996,7 +1574,9 @@ int reporter_process_report ( ReportHeader *reporthdr ) {
 #ifdef HAVE_THREAD_DEBUG
 	      thread_debug("Free %p in rpr", (void *) tmp);
 #endif
-	      free(tmp);
+	      pool_put(tmp);
+	    } else {
+	      reporter_consumerdone(tmp);
 	    }
         }
     }
@@ -1033,6 +1613,15 @@ int reporter_process_report ( ReportHeader *reporthdr ) {
         // the system is likely CPU bound and iperf is now likely
         // becoming a CPU bound test vs a network i/o bound test
 	apply_consumption_detector();
+	// The energy base of the flow's final report, and of the sum's
+	// at its first flow, is the flow's start
+	if ( reporthdr->report.energy && (reporthdr->report.energybase.time <= 0) ) {
+	    energy_mark( &reporthdr->report.energybase );
+	    if ( (reporthdr->multireport != NULL) && (reporthdr->multireport->report != NULL) &&
+		 (reporthdr->multireport->report->energybase.time <= 0) ) {
+		reporthdr->multireport->report->energybase = reporthdr->report.energybase;
+	    }
+	}
         // If there are more packets to process then handle them
 	ReportStruct *packet = NULL;
         while ((packet = dequeue_packetring(reporthdr))) {
@@ -1042,15 +1631,24 @@ int reporter_process_report ( ReportHeader *reporthdr ) {
 	    // thrashing,
 	    consumption_detector.accounted_packets--;
 	    if (reporthdr->packet_handler) {
+		// plain UDP server datagrams are accounted per batch
+		if (reporter_batch_packet(reporthdr, packet))
+		    continue;
+		reporter_batch_flush(reporthdr);
 	        /*报告结果*/
 	        int event_lastpacket = (*reporthdr->packet_handler)(reporthdr, packet);
 		if (event_lastpacket) {
+#ifndef HAVE_THREAD
 		    reporthdr->packetring->consumerdone = 1;
+#endif
+		    // threaded, the traffic thread is released once the
+		    // report is off the job queue, see reporter_consumerdone
 		    reporthdr->delaycounter = consumption_detector.delay_counter;
 		    need_free = 1;
 		}
 	    }
 	}
+	reporter_batch_flush(reporthdr);
     }
     // need_free is a poor implementation.  It's done this way
     // because of the recursion.  It also signals two things,
@@ -1065,6 +1663,192 @@ int reporter_process_report ( ReportHeader *reporthdr ) {
  * Updates connection stats
  */
 #define L2DROPFILTERCOUNTER 100
+/*
+ * Bin of a size in the log2 distributions, bin n holds (2^(n-1), 2^n]
+ */
+static inline int log2_bin( intmax_t size ) {
+    int bin = 0;
+    while ((bin < LOG2_BINS - 1) && (size > (1 << bin)))
+	bin++;
+    return bin;
+}
+
+/*
+ * Bin of a ring residency in ticks, below 2^RINGLAG_SUBBITS one bin per
+ * tick, above it 2^RINGLAG_SUBBITS bins per octave
+ */
+static inline int ringlag_bin( uint64_t ticks ) {
+    int msb, bin;
+    if (ticks < (1 << RINGLAG_SUBBITS))
+	return (int) ticks;
+    msb = 63 - __builtin_clzll(ticks);
+    bin = ((msb - RINGLAG_SUBBITS + 1) << RINGLAG_SUBBITS) + \
+	(int) ((ticks >> (msb - RINGLAG_SUBBITS)) & ((1 << RINGLAG_SUBBITS) - 1));
+    return ((bin < RINGLAG_BINS) ? bin : RINGLAG_BINS - 1);
+}
+
+// the least tick count of a bin
+static uint64_t ringlag_binlower( int bin ) {
+    int msb;
+    if (bin < (1 << RINGLAG_SUBBITS))
+	return (uint64_t) bin;
+    msb = (bin >> RINGLAG_SUBBITS) + RINGLAG_SUBBITS - 1;
+    return ((uint64_t) ((1 << RINGLAG_SUBBITS) | (bin & ((1 << RINGLAG_SUBBITS) - 1)))) << (msb - RINGLAG_SUBBITS);
+}
+
+static inline void ringlag_insert( RingLagStats *lag, uint64_t ticks ) {
+    lag->bins[ringlag_bin(ticks)]++;
+    if (ticks > lag->max)
+	lag->max = ticks;
+    lag->cnt++;
+}
+
+/*
+ * -e, how long the packet sat in the ring after the traffic thread
+ * stamped it, i.e. how stale the reporter's view of the flow is
+ */
+static void reporter_handle_ringlag( ReporterData *data, ReportStruct *packet ) {
+    uint64_t now, ticks;
+    if (!packet->enqueued)
+	return;
+    now = ringlag_now();
+    ticks = ((now > packet->enqueued) ? now - packet->enqueued : 0);
+    if (!ringlag_sec0)
+	ringlag_calibrate();
+    ringlag_insert(&data->ringlag, ticks);
+}
+
+/*
+ * The residency quantiles, each the upper edge of the bin it falls in
+ * so never under reported, capped by the max seen
+ */
+static int ringlag_report( RingLagReport *report, RingLagStats *lag ) {
+    static const double quantiles[RINGLAG_QUANTILES] = {0.5, 0.9, 0.99, 0.999};
+    double usecspertick;
+    intmax_t running = 0;
+    int ix, bin = 0;
+
+    if (!lag->cnt)
+	return 0;
+    usecspertick = 1e6 / ringlag_tickspersec();
+    report->cnt = lag->cnt;
+    report->max = lag->max * usecspertick;
+    report->sum = 0;
+    for (ix = 0; ix < RINGLAG_QUANTILES; ix++) {
+	intmax_t rank = (intmax_t) ceil(quantiles[ix] * lag->cnt);
+	while ((bin < RINGLAG_BINS) && ((running + lag->bins[bin]) < rank))
+	    running += lag->bins[bin++];
+	report->quantiles[ix] = ((bin < RINGLAG_BINS - 1) ? ringlag_binlower(bin + 1) : lag->max) * usecspertick;
+	if (report->quantiles[ix] > report->max)
+	    report->quantiles[ix] = report->max;
+    }
+    return 1;
+}
+
+/*
+ * --sched-deadline, how late the sender woke up for its frame or datagram
+ */
+static void reporter_handle_wake( Transfer_Info *stats, ReportStruct *packet ) {
+    SchedStats *sched = &stats->sched;
+    double late = packet->wakelate;
+
+    if (!sched->wakes || (late < sched->minLate))
+	sched->minLate = late;
+    if (!sched->wakes || (late > sched->maxLate))
+	sched->maxLate = late;
+    if (!sched->tot_wakes || (late < sched->totminLate))
+	sched->totminLate = late;
+    if (!sched->tot_wakes || (late > sched->totmaxLate))
+	sched->totmaxLate = late;
+    sched->sumLate += late;
+    sched->totsumLate += late;
+    sched->wakes++;
+    sched->tot_wakes++;
+}
+
+/*
+ * --intended-time, the datagram's latency from when the sender's
+ * schedule said it should go out, so a stalled sender's backlog counts
+ * against latency rather than going unmeasured (coordinated omission.)
+ * The pacer may send a little ahead of its schedule, such a datagram
+ * counts from its send time.
+ */
+static void reporter_handle_intended( Transfer_Info *stats, ReportStruct *packet ) {
+    IntendedStats *intended = &stats->intended;
+    double lag = TimeDifference(packet->sentTime, packet->intendedTime);
+    double latency;
+
+    if (lag < 0)
+	lag = 0;
+    latency = TimeDifference(packet->packetTime, packet->sentTime) + lag;
+
+    if (!intended->cnt || (latency < intended->minLatency))
+	intended->minLatency = latency;
+    if (!intended->cnt || (latency > intended->maxLatency))
+	intended->maxLatency = latency;
+    if (!intended->cnt || (lag > intended->maxLag))
+	intended->maxLag = lag;
+    if (!intended->tot_cnt || (latency < intended->totminLatency))
+	intended->totminLatency = latency;
+    if (!intended->tot_cnt || (latency > intended->totmaxLatency))
+	intended->totmaxLatency = latency;
+    if (!intended->tot_cnt || (lag > intended->totmaxLag))
+	intended->totmaxLag = lag;
+    intended->sumLatency += latency;
+    intended->totsumLatency += latency;
+    intended->sumLag += lag;
+    intended->totsumLag += lag;
+    intended->cnt++;
+    intended->tot_cnt++;
+    if (stats->intendedlatency_histogram) {
+	histogram_insert(stats->intendedlatency_histogram, latency);
+    }
+}
+
+/*
+ * A client write recovered by the server's TCP framing parser, the
+ * packet carries the write's id, size and client timestamp
+ */
+static void reporter_handle_frame( Transfer_Info *stats, ReportStruct *packet ) {
+    FrameStats *frames = &stats->frames;
+    double latency;
+    int bin;
+
+    frames->resyncs += packet->frameresyncs;
+    frames->tot_resyncs += packet->frameresyncs;
+    if (!packet->framelen)
+	return;
+    if (frames->tot_cnt && (packet->packetID != frames->nextid)) {
+	intmax_t gap = packet->packetID - frames->nextid;
+	gap = (gap > 0) ? gap : 1;
+	frames->gaps += gap;
+	frames->tot_gaps += gap;
+    }
+    frames->nextid = packet->packetID + 1;
+    // clients stamp each write as it's submitted, see
+    // Client::StampTcpWrite, writes without -e or -i go unstamped
+    if (packet->sentTime.tv_sec) {
+	latency = TimeDifference(packet->packetTime, packet->sentTime);
+	if (!frames->cntLatency || (latency < frames->minLatency))
+	    frames->minLatency = latency;
+	if (!frames->cntLatency || (latency > frames->maxLatency))
+	    frames->maxLatency = latency;
+	if (!frames->totcntLatency || (latency < frames->totminLatency))
+	    frames->totminLatency = latency;
+	if (!frames->totcntLatency || (latency > frames->totmaxLatency))
+	    frames->totmaxLatency = latency;
+	frames->sumLatency += latency;
+	frames->totsumLatency += latency;
+	frames->cntLatency++;
+	frames->totcntLatency++;
+    }
+    frames->cnt++;
+    frames->tot_cnt++;
+    bin = log2_bin(packet->framelen);
+    frames->bins[bin]++;
+    frames->totbins[bin]++;
+}
+
 int reporter_handle_packet( ReportHeader *reporthdr, ReportStruct *packet) {
     ReporterData *data = &reporthdr->report;
     Transfer_Info *stats = &reporthdr->report.info;
@@ -1073,6 +1857,10 @@ int reporter_handle_packet( ReportHeader *reporthdr, ReportStruct *packet) {
 
     data->packetTime = packet->packetTime;
     stats->socket = packet->socket;
+    data->perfevents++;
+    reporter_perfevents++;
+    if (stats->mEnhanced)
+	reporter_handle_ringlag(data, packet);
     if ( packet->packetID < 0 ) {
         finished = 1;
         if ( reporthdr->report.mThreadMode != kMode_Client ) {
@@ -1092,6 +1880,18 @@ int reporter_handle_packet( ReportHeader *reporthdr, ReportStruct *packet) {
 	    } else {
 		stats->sock_callstats.write.WriteCnt++;
 		stats->sock_callstats.write.totWriteCnt++;
+		if (stats->sock_callstats.write.sizebinned) {
+		    int bin = log2_bin(packet->packetLen);
+		    stats->sock_callstats.write.sizebins[bin]++;
+		    stats->sock_callstats.write.totsizebins[bin]++;
+		}
+	    }
+	    if (packet->wakes) {
+		reporter_handle_wake(stats, packet);
+	    }
+	    if (packet->deadlinemiss) {
+		stats->sched.misses++;
+		stats->sched.tot_misses++;
 	    }
 	// Next are server l2 errors, filter out first n L2 errors
 	// due to BPF AF_PACKET race
@@ -1111,6 +1911,17 @@ int reporter_handle_packet( ReportHeader *reporthdr, ReportStruct *packet) {
 		stats->l2counts.tot_udpcsumerr++;
 	    }
 	}
+	// Server payload verification, --verify
+	if (packet->verifyblocks) {
+	    stats->verify.cnt += packet->verifyblocks;
+	    stats->verify.tot_cnt += packet->verifyblocks;
+	    stats->verify.corrupt += packet->verifycorrupt;
+	    stats->verify.tot_corrupt += packet->verifycorrupt;
+	}
+	// Client writes recovered by the server, --tcp-framing
+	if (packet->framelen || packet->frameresyncs) {
+	    reporter_handle_frame(stats, packet);
+	}
 	// These are valid packets that need standard iperf accounting
 	if (!packet->emptyreport) {
 	    // update fields common to TCP and UDP, client and server
@@ -1176,6 +1987,9 @@ int reporter_handle_packet( ReportHeader *reporthdr, ReportStruct *packet) {
 		    if (stats->latency_histogram) {
 			histogram_insert(stats->latency_histogram, transit);
 		    }
+		    if (packet->intended) {
+			reporter_handle_intended(stats, packet);
+		    }
 
 		    // packet loss occured if the datagram numbers aren't sequential
 		    if ( packet->packetID != data->PacketID + 1 ) {
@@ -1252,8 +2066,17 @@ int reporter_handle_packet( ReportHeader *reporthdr, ReportStruct *packet) {
 		// mean min max tests
 		stats->sock_callstats.read.cntRead++;
 		stats->sock_callstats.read.totcntRead++;
-		bin = (int)floor((packet->packetLen -1)/stats->sock_callstats.read.binsize);
-		if (bin < BINCOUNT) {
+		if (stats->sock_callstats.read.binlog) {
+		    int upper = stats->sock_callstats.read.binsize;
+		    bin = stats->sock_callstats.read.bincnt - 1;
+		    while ((bin > 0) && (packet->packetLen <= (upper >> 1))) {
+			upper >>= 1;
+			bin--;
+		    }
+		} else {
+		    bin = (int)floor((packet->packetLen -1)/stats->sock_callstats.read.binsize);
+		}
+		if (bin < stats->sock_callstats.read.bincnt) {
 		    stats->sock_callstats.read.bins[bin]++;
 		    stats->sock_callstats.read.totbins[bin]++;
 		}
@@ -1276,13 +2099,118 @@ int reporter_handle_packet( ReportHeader *reporthdr, ReportStruct *packet) {
     return reporter_condprintstats( &reporthdr->report, reporthdr->multireport, finished );
 }
 
+/*
+ * UDP server datagrams which need only the common accounting, past
+ * the flow's first and not closing an interval, are gathered as a
+ * struct of arrays slice and accounted by the batch kernels, see
+ * batch.h.  Anything else flushes the slice first and goes through
+ * reporter_handle_packet.
+ */
+static PacketBatch reporter_batch;
+
+static int reporter_batch_packet( ReportHeader *reporthdr, ReportStruct *packet ) {
+    ReporterData *data = &reporthdr->report;
+    Transfer_Info *stats = &reporthdr->report.info;
+    PacketBatch *batch = &reporter_batch;
+    int ix;
+
+    if ((reporthdr->packet_handler != reporter_handle_packet) || (stats->mUDP != kMode_Server) ||
+	(packet->packetID < 0) || packet->emptyreport || packet->l2errors || packet->verifyblocks ||
+	packet->framelen || packet->frameresyncs || packet->intended || packet->wakes || packet->deadlinemiss ||
+#ifdef HAVE_ISOCHRONOUS
+	packet->frameID ||
+#endif
+	!stats->transit.totcntTransit ||
+	((data->intervalTime.tv_sec || data->intervalTime.tv_usec) &&
+	 (TimeDifference(data->nextTime, packet->packetTime) < 0)))
+	return 0;
+
+    stats->socket = packet->socket;
+    data->perfevents++;
+    reporter_perfevents++;
+    if (stats->mEnhanced)
+	reporter_handle_ringlag(data, packet);
+    ix = batch->cnt++;
+    batch->id[ix] = packet->packetID;
+    batch->len[ix] = packet->packetLen;
+    batch->txsec[ix] = packet->sentTime.tv_sec;
+    batch->txusec[ix] = packet->sentTime.tv_usec;
+    batch->rxsec[ix] = packet->packetTime.tv_sec;
+    batch->rxusec[ix] = packet->packetTime.tv_usec;
+    if (batch->cnt == BATCH_MAX)
+	reporter_batch_flush(reporthdr);
+    return 1;
+}
+
+static void reporter_batch_flush( ReportHeader *reporthdr ) {
+    ReporterData *data = &reporthdr->report;
+    Transfer_Info *stats = &reporthdr->report.info;
+    PacketBatch *batch = &reporter_batch;
+    BatchStats bstats;
+    int ix, n = batch->cnt;
+
+    if (!n)
+	return;
+    bstats.jitter = stats->jitter;
+    bstats.lastTransit = stats->transit.lastTransit;
+    batch_stats(batch, &bstats);
+
+    data->packetTime.tv_sec = (long) batch->rxsec[n - 1];
+    data->packetTime.tv_usec = (long) batch->rxusec[n - 1];
+    data->TotalLen += bstats.bytes;
+    data->cntDatagrams += n;
+    // the inter packet gaps sum to the span since the last datagram
+    stats->IPGsum += TimeDifference(data->packetTime, data->IPGstart);
+    stats->IPGcnt += n;
+    data->IPGstart = data->packetTime;
+    if (stats->latency_histogram) {
+	for (ix = 0; ix < n; ix++)
+	    histogram_insert(stats->latency_histogram, batch->transit[ix]);
+    }
+    if (bstats.inorder && (batch->id[0] == data->PacketID + 1)) {
+	data->PacketID = batch->id[n - 1];
+    } else {
+	for (ix = 0; ix < n; ix++) {
+	    if (batch->id[ix] != data->PacketID + 1) {
+		if (batch->id[ix] < data->PacketID + 1) {
+		    data->cntOutofOrder++;
+		} else {
+		    data->cntError += batch->id[ix] - data->PacketID - 1;
+		}
+	    }
+	    if (batch->id[ix] > data->PacketID) {
+		data->PacketID = batch->id[ix];
+	    }
+	}
+    }
+    stats->jitter = bstats.jitter;
+    batch_merge(&stats->transit.meanTransit, &stats->transit.m2Transit, &stats->transit.vdTransit,
+		stats->transit.cntTransit, n, &bstats);
+    batch_merge(&stats->transit.totmeanTransit, &stats->transit.totm2Transit, &stats->transit.totvdTransit,
+		stats->transit.totcntTransit, n, &bstats);
+    stats->transit.sumTransit += bstats.sumTransit;
+    stats->transit.totsumTransit += bstats.sumTransit;
+    stats->transit.cntTransit += n;
+    stats->transit.totcntTransit += n;
+    if (bstats.minTransit < stats->transit.minTransit)
+	stats->transit.minTransit = bstats.minTransit;
+    if (bstats.minTransit < stats->transit.totminTransit)
+	stats->transit.totminTransit = bstats.minTransit;
+    if (bstats.maxTransit > stats->transit.maxTransit)
+	stats->transit.maxTransit = bstats.maxTransit;
+    if (bstats.maxTransit > stats->transit.totmaxTransit)
+	stats->transit.totmaxTransit = bstats.maxTransit;
+    stats->transit.lastTransit = bstats.lastTransit;
+    batch->cnt = 0;
+}
+
 /*
  * Handles summing of threads
  */
 void reporter_handle_multiple_reports( MultiHeader *reporthdr, Transfer_Info *stats, int force ) {
     if ( reporthdr != NULL ) {
     	//仅多个threads情况下，汇总reports生效
-        if ( reporthdr->threads > 1 ) {
+        if ( (reporthdr->threads > 1) || (procs_shared && (reporthdr->threads > 0)) ) {
             int i;
             Transfer_Info *current = NULL;
             // Search for start Time
@@ -1317,7 +2245,10 @@ void reporter_handle_multiple_reports( MultiHeader *reporthdr, Transfer_Info *st
 		if (stats->mTCP == kMode_Server) {
 		    int ix;
 		    current->sock_callstats.read.cntRead = stats->sock_callstats.read.cntRead;
-		    for (ix = 0; ix < 8; ix++) {
+		    current->sock_callstats.read.bincnt = stats->sock_callstats.read.bincnt;
+		    current->sock_callstats.read.binsize = stats->sock_callstats.read.binsize;
+		    current->sock_callstats.read.binlog = stats->sock_callstats.read.binlog;
+		    for (ix = 0; ix < stats->sock_callstats.read.bincnt; ix++) {
 			current->sock_callstats.read.bins[ix] = stats->sock_callstats.read.bins[ix];
 		    }
 		} else {
@@ -1339,7 +2270,7 @@ void reporter_handle_multiple_reports( MultiHeader *reporthdr, Transfer_Info *st
 		if (stats->mTCP == kMode_Server) {
 		    int ix;
 		    current->sock_callstats.read.cntRead += stats->sock_callstats.read.cntRead;
-		    for (ix = 0; ix < 8; ix++) {
+		    for (ix = 0; ix < stats->sock_callstats.read.bincnt; ix++) {
 			current->sock_callstats.read.bins[ix] += stats->sock_callstats.read.bins[ix];
 		    }
 		} else {
@@ -1358,20 +2289,351 @@ void reporter_handle_multiple_reports( MultiHeader *reporthdr, Transfer_Info *st
                     current->jitter = stats->jitter;
                 }
                 current->free++;
-                if ( current->free == reporthdr->threads ) {
-                    void *reserved = reporthdr->report->info.reserved_delay;
-                    current->free = force;
-                    memcpy( &reporthdr->report->info, current, sizeof(Transfer_Info) );
-                    current->startTime = -1;
-                    reporthdr->report->info.reserved_delay = reserved;
+            }
+            if ( current->free == reporthdr->threads ) {
+                void *reserved = reporthdr->report->info.reserved_delay;
+                current->free = force;
+                memcpy( &reporthdr->report->info, current, sizeof(Transfer_Info) );
+                current->startTime = -1;
+                reporthdr->report->info.reserved_delay = reserved;
+                if ( procs_shared ) {
+                    // the parent process prints the sum over all the workers
+                    procs_publish( &reporthdr->report->info, force );
+                } else {
                     //输出汇总信息
                     reporter_print( reporthdr->report, MULTIPLE_REPORT, force );
+                    reporter_printenergysum( reporthdr, force );
+                    if ( force ) {
+                        reporter_printringlagsum( reporthdr );
+                    }
                 }
             }
         }
     }
 }
 
+/*
+ * Print a sum of flows through a multiple report header, e.g. the
+ * --processes parent which has no reporter thread of its own
+ */
+void reporter_multiple_print( MultiHeader *reporthdr, Transfer_Info *stats, int force ) {
+    void *reserved = reporthdr->report->info.reserved_delay;
+    stats->transferID = reporthdr->groupID;
+    stats->free = force;
+    memcpy( &reporthdr->report->info, stats, sizeof(Transfer_Info) );
+    reporthdr->report->info.reserved_delay = reserved;
+    reporter_print( reporthdr->report, MULTIPLE_REPORT, force );
+}
+
+/*
+ * Sum a flow's interval (or final) stats into another, e.g. an
+ * aggregation group slot or the sum of the --processes workers
+ */
+void reporter_transfer_add (Transfer_Info *current, Transfer_Info *stats, int first) {
+    if (first) {
+	memset(current, 0, sizeof(Transfer_Info));
+	current->transferID = -1;
+	current->groupID = stats->groupID;
+	current->startTime = stats->startTime;
+	current->endTime = stats->endTime;
+	current->mFormat = stats->mFormat;
+	current->mEnhanced = stats->mEnhanced;
+	current->mUDP = stats->mUDP;
+	current->mTCP = stats->mTCP;
+	current->sock_callstats.read.bincnt = stats->sock_callstats.read.bincnt;
+	current->sock_callstats.read.binsize = stats->sock_callstats.read.binsize;
+	current->sock_callstats.read.binlog = stats->sock_callstats.read.binlog;
+    }
+    current->cntDatagrams += stats->cntDatagrams;
+    current->cntError += stats->cntError;
+    current->cntOutofOrder += stats->cntOutofOrder;
+    current->TotalLen += stats->TotalLen;
+    current->IPGcnt += stats->IPGcnt;
+    // IPGsum is the sample period, not a per flow quantity
+    if ( current->IPGsum < stats->IPGsum ) {
+	current->IPGsum = stats->IPGsum;
+    }
+    if (stats->mTCP == kMode_Server) {
+	int ix;
+	current->sock_callstats.read.cntRead += stats->sock_callstats.read.cntRead;
+	for (ix = 0; ix < stats->sock_callstats.read.bincnt; ix++) {
+	    current->sock_callstats.read.bins[ix] += stats->sock_callstats.read.bins[ix];
+	}
+    } else {
+	current->sock_callstats.write.WriteErr += stats->sock_callstats.write.WriteErr;
+	current->sock_callstats.write.WriteCnt += stats->sock_callstats.write.WriteCnt;
+#ifdef HAVE_STRUCT_TCP_INFO_TCPI_TOTAL_RETRANS
+	if (stats->mTCP == kMode_Client) {
+	    current->sock_callstats.write.TCPretry += stats->sock_callstats.write.TCPretry;
+	}
+#endif
+    }
+    if ( current->endTime < stats->endTime ) {
+	current->endTime = stats->endTime;
+    }
+    if ( current->jitter < stats->jitter ) {
+	current->jitter = stats->jitter;
+    }
+}
+
+/*
+ * Print the group's pending intervals in time order.  An interval is
+ * printed once all expected members contributed to it, or always when
+ * flushall is set (e.g. all slots are in use.)
+ */
+static void aggr_flush (AggrGroup *group, int flushall) {
+    while (1) {
+	int ix, oldest = -1;
+	for (ix = 0; ix < AGGR_SLOTS; ix++) {
+	    if ((group->slotcnt[ix] > 0) && \
+		((oldest < 0) || (group->slots[ix].startTime < group->slots[oldest].startTime)))
+		oldest = ix;
+	}
+	if ((oldest < 0) || (!flushall && (group->slotcnt[oldest] < group->slotneed[oldest])))
+	    break;
+	group->slots[oldest].free = 0;
+	group_reports[group->mode](&group->slots[oldest], group->label);
+	group->slots[oldest].startTime = -1;
+	group->slotcnt[oldest] = 0;
+	if (flushall == 1)
+	    break;
+    }
+}
+
+/*
+ * Handles summing of flows into their aggregation groups (--sum-groups)
+ */
+void reporter_handle_group_reports( ReporterData *data, Transfer_Info *stats, int force ) {
+    int i, ix;
+    Mutex_Lock(&aggrgroupCond);
+    for (i = 0; i < data->aggrcnt; i++) {
+	AggrGroup *group = data->aggr[i];
+	if (force) {
+	    reporter_transfer_add(&group->final, stats, (group->finals++ == 0));
+	    group->members--;
+	    // stop waiting on this flow for intervals past its last one
+	    for (ix = 0; ix < AGGR_SLOTS; ix++) {
+		if ((group->slotcnt[ix] > 0) && (group->slots[ix].startTime > data->aggrlast))
+		    group->slotneed[ix]--;
+	    }
+	    aggr_flush(group, (group->members == 0) ? 2 : 0);
+	    if (group->members == 0) {
+		// the last member is done, print the group's totals and release it
+		group->final.free = 1;
+		group_reports[group->mode](&group->final, group->label);
+		AggrGroup **prev;
+		for (prev = &AggrRoot; *prev != NULL; prev = &(*prev)->next) {
+		    if (*prev == group) {
+			*prev = group->next;
+			break;
+		    }
+		}
+		free(group);
+	    }
+	} else {
+	    int slot = -1;
+	    for (ix = 0; ix < AGGR_SLOTS; ix++) {
+		if ((group->slotcnt[ix] > 0) && (group->slots[ix].startTime == stats->startTime)) {
+		    slot = ix;
+		    break;
+		}
+	    }
+	    if (slot < 0) {
+		// no free slot means a member stalled, print its oldest interval partial
+		for (ix = 0; (slot < 0); ix = (ix + 1) % AGGR_SLOTS) {
+		    if (group->slotcnt[ix] == 0)
+			slot = ix;
+		    else if (ix == AGGR_SLOTS - 1)
+			aggr_flush(group, 1);
+		}
+	    }
+	    if (group->slotcnt[slot] == 0)
+		group->slotneed[slot] = group->members;
+	    reporter_transfer_add(&group->slots[slot], stats, (group->slotcnt[slot]++ == 0));
+	    aggr_flush(group, 0);
+	}
+    }
+    if (!force)
+	data->aggrlast = stats->startTime;
+    Mutex_Unlock(&aggrgroupCond);
+}
+
+/*
+ * Bounded min heap on key, the root is the entry to replace next.
+ * The bottom N heap stores negated keys.
+ */
+static void policy_heap_offer (PolicyEntry *heap, int *cnt, int max, Transfer_Info *stats, const char *peer, double key) {
+    PolicyEntry tmp;
+    int ix, child;
+    if (*cnt < max) {
+	// sift up from the new leaf
+	ix = (*cnt)++;
+	while ((ix > 0) && (heap[(ix - 1) / 2].key > key)) {
+	    heap[ix] = heap[(ix - 1) / 2];
+	    ix = (ix - 1) / 2;
+	}
+    } else if (key > heap[0].key) {
+	// replace the root and sift down
+	ix = 0;
+	while ((child = (2 * ix) + 1) < *cnt) {
+	    if ((child + 1 < *cnt) && (heap[child + 1].key < heap[child].key))
+		child++;
+	    if (heap[child].key >= key)
+		break;
+	    heap[ix] = heap[child];
+	    ix = child;
+	}
+    } else {
+	return;
+    }
+    tmp.info = *stats;
+    tmp.info.reserved_delay = NULL;
+    tmp.info.latency_histogram = NULL;
+    tmp.info.intendedlatency_histogram = NULL;
+#ifdef HAVE_ISOCHRONOUS
+    tmp.info.framelatency_histogram = NULL;
+#endif
+    tmp.peer[0] = '\0';
+    if (peer != NULL) {
+	strncpy(tmp.peer, peer, sizeof(tmp.peer) - 1);
+	tmp.peer[sizeof(tmp.peer) - 1] = '\0';
+    }
+    tmp.key = key;
+    heap[ix] = tmp;
+}
+
+static int policy_entry_cmp (const void *a, const void *b) {
+    double ka = ((const PolicyEntry *) a)->key;
+    double kb = ((const PolicyEntry *) b)->key;
+    return ((ka < kb) ? 1 : ((ka > kb) ? -1 : 0));
+}
+
+static void policy_entry_print (PolicyEntry *entry, int mode) {
+    if (entry->peer[0] != '\0')
+	entry->info.reserved_delay = entry->peer;
+    statistics_reports[mode]( &entry->info );
+    entry->info.reserved_delay = NULL;
+}
+
+/*
+ * Print the selected flows of the current interval, top N by
+ * decreasing key then bottom N by increasing key
+ */
+static void policy_flush (int mode) {
+    PolicyWindow *w = &policywindow;
+    int ix, jx;
+    qsort(w->top, w->topcnt, sizeof(PolicyEntry), policy_entry_cmp);
+    qsort(w->bottom, w->bottomcnt, sizeof(PolicyEntry), policy_entry_cmp);
+    for (ix = 0; ix < w->topcnt; ix++) {
+	policy_entry_print(&w->top[ix], mode);
+    }
+    for (ix = 0; ix < w->bottomcnt; ix++) {
+	// with few flows the same flow may be in both sets
+	for (jx = 0; jx < w->topcnt; jx++) {
+	    if (w->top[jx].info.transferID == w->bottom[ix].info.transferID)
+		break;
+	}
+	if (jx == w->topcnt)
+	    policy_entry_print(&w->bottom[ix], mode);
+    }
+    w->topcnt = 0;
+    w->bottomcnt = 0;
+    w->offers = 0;
+    w->startTime = -1;
+}
+
+/*
+ * Handles a flow's interval report per the --report-policy, i.e.
+ * instead of printing it unconditionally
+ */
+void reporter_policy_interval( ReporterData *data, Transfer_Info *stats ) {
+    PolicyWindow *w = &policywindow;
+    double bw = ((stats->endTime > stats->startTime) ? (stats->TotalLen / (stats->endTime - stats->startTime)) : 0);
+    double loss = (((stats->mUDP == kMode_Server) && (stats->cntDatagrams > 0)) ? \
+		   ((100.0 * stats->cntError) / stats->cntDatagrams) : 0);
+    int printed = 0;
+
+    if (data->policy & RPOLICY_ANOMALIES) {
+	if (stats->TotalLen == 0) {
+	    anomaly_reports[data->mode]( stats, ANOMALY_STALL, 0, 0 );
+	} else if ((loss > ANOMALY_MINLOSS) && (loss > (ANOMALY_LOSSFACTOR * data->policylossmean))) {
+	    anomaly_reports[data->mode]( stats, ANOMALY_LOSS, loss, data->policylossmean );
+	}
+	data->policyintervals++;
+	data->policylossmean += (loss - data->policylossmean) / data->policyintervals;
+    }
+    if (data->policy & RPOLICY_CHANGES) {
+	// the first interval is the baseline
+	if (data->policylastbw < 0) {
+	    data->policylastbw = bw;
+	} else if (fabs(bw - data->policylastbw) > ((data->policylastbw * data->policychange) / 100.0)) {
+	    statistics_reports[data->mode]( stats );
+	    data->policylastbw = bw;
+	    printed = 1;
+	}
+    }
+    if (data->policy & (RPOLICY_TOPN | RPOLICY_BOTTOMN)) {
+	double key = ((data->policy & RPOLICY_BYLOSS) ? loss : bw);
+	if ((w->topmax < data->policytopn) || (w->bottommax < data->policybottomn)) {
+	    if (w->topmax < data->policytopn) {
+		w->top = (PolicyEntry *) realloc(w->top, data->policytopn * sizeof(PolicyEntry));
+		w->topmax = (w->top != NULL) ? data->policytopn : 0;
+	    }
+	    if (w->bottommax < data->policybottomn) {
+		w->bottom = (PolicyEntry *) realloc(w->bottom, data->policybottomn * sizeof(PolicyEntry));
+		w->bottommax = (w->bottom != NULL) ? data->policybottomn : 0;
+	    }
+	}
+	if (stats->startTime > w->startTime) {
+	    // a new interval, anything pending is as complete as it gets
+	    if (w->offers > 0)
+		policy_flush(data->mode);
+	    w->startTime = stats->startTime;
+	    Mutex_Lock(&aggrgroupCond);
+	    w->need = w->members;
+	    Mutex_Unlock(&aggrgroupCond);
+	}
+	if (stats->startTime == w->startTime) {
+	    // a flow already printed per the changes policy still counts as offered
+	    if (!printed && (data->policy & RPOLICY_TOPN))
+		policy_heap_offer(w->top, &w->topcnt, w->topmax, stats, data->info.reserved_delay, key);
+	    if (!printed && (data->policy & RPOLICY_BOTTOMN))
+		policy_heap_offer(w->bottom, &w->bottomcnt, w->bottommax, stats, data->info.reserved_delay, -key);
+	    if (++w->offers >= w->need)
+		policy_flush(data->mode);
+	}
+	data->policylast = stats->startTime;
+    }
+    if (stats->mEnhanced) {
+	reporter_resetstats( stats );
+    }
+}
+
+/*
+ * A flow with a top/bottom policy finished, stop waiting on it
+ */
+void reporter_policy_leave( ReporterData *data ) {
+    PolicyWindow *w = &policywindow;
+    int members;
+    data->policyjoined = 0;
+    Mutex_Lock(&aggrgroupCond);
+    members = --w->members;
+    Mutex_Unlock(&aggrgroupCond);
+    if ((w->offers > 0) && (w->startTime > data->policylast))
+	w->need--;
+    if ((w->offers > 0) && ((w->offers >= w->need) || (members == 0)))
+	policy_flush(data->mode);
+    if (members == 0) {
+	free(w->top);
+	free(w->bottom);
+	w->top = NULL;
+	w->bottom = NULL;
+	w->topmax = 0;
+	w->bottommax = 0;
+	w->startTime = -1;
+    }
+}
+
 #ifdef HAVE_STRUCT_TCP_INFO_TCPI_TOTAL_RETRANS
 static void gettcpistats (ReporterData *stats, int final) {
     static int cnt = 0;
@@ -1413,6 +2675,127 @@ static void gettcpistats (ReporterData *stats, int final) {
     }
 }
 #endif
+/*
+ * Current frequency of a CPU in MHz per cpufreq, else per
+ * /proc/cpuinfo, 0 when unknown
+ */
+static double reporter_cpu_mhz( int cpu ) {
+    char path[80], line[160];
+    double mhz = 0;
+    FILE *fp;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", cpu);
+    if ((fp = fopen(path, "r")) != NULL) {
+	long khz;
+	if (fscanf(fp, "%ld", &khz) == 1)
+	    mhz = khz / 1000.0;
+	fclose(fp);
+    } else if ((fp = fopen("/proc/cpuinfo", "r")) != NULL) {
+	int current = -1;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+	    if (sscanf(line, "processor : %d", &current) == 1)
+		continue;
+	    if ((current == cpu) && (sscanf(line, "cpu MHz : %lf", &mhz) == 1))
+		break;
+	}
+	fclose(fp);
+    }
+    return mhz;
+}
+
+/*
+ * Report the frequency of the traffic thread's CPU along with the
+ * held cpu_dma_latency, --cpu-dma-latency.  Printed ahead of the
+ * flow's report as the final CSV report releases the peer string.
+ */
+static void reporter_printcpufreq( ReporterData *stats ) {
+    int cpu = stats->cpu;
+    if ( stats->cpufreq && (cpu >= 0) ) {
+	cpufreq_reports[stats->mode]( &stats->info, cpu, reporter_cpu_mhz(cpu), stats->cpudmalatency );
+    }
+}
+
+/*
+ * Report the busiest softirq CPUs and the traffic thread's CPU over
+ * the interval, or the whole test when final, --softirqs
+ */
+static void reporter_printsoftirqs( ReporterData *stats, int final ) {
+    SoftirqReport report;
+    double interval = stats->intervalTime.tv_sec + (stats->intervalTime.tv_usec / (double) rMillion);
+    if ( stats->softirqs && softirqs_report( &report, interval, stats->cpu, final ) ) {
+	softirq_reports[stats->mode]( &stats->info, &report );
+    }
+}
+
+/*
+ * Report the RAPL energy over the interval, or the flow's whole
+ * test when final, --energy.  The energy is the host's so the bytes
+ * per joule are only the test's, i.e. on the SUM report, or the
+ * flow's own when there is no SUM.
+ */
+static void reporter_printenergy( ReporterData *stats, MultiHeader *multireport, int final ) {
+    EnergyReport report;
+    double interval = stats->intervalTime.tv_sec + (stats->intervalTime.tv_usec / (double) rMillion);
+    if ( stats->energy && energy_report( &report, &stats->energybase, interval, final ) ) {
+	report.perjoule = !(isMultipleReport(stats) && (multireport != NULL) &&
+			    ((multireport->threads > 1) || procs_shared));
+	energy_reports[stats->mode]( &stats->info, &report );
+    }
+}
+
+static void reporter_printenergysum( MultiHeader *multireport, int final ) {
+    EnergyReport report;
+    ReporterData *stats = multireport->report;
+    double interval = stats->intervalTime.tv_sec + (stats->intervalTime.tv_usec / (double) rMillion);
+    if ( stats->energy && energy_report( &report, &stats->energybase, interval, final ) ) {
+	report.perjoule = 1;
+	report.sum = 1;
+	energy_reports[stats->mode]( &stats->info, &report );
+    }
+}
+
+/*
+ * Report the traffic thread's counters per event over the interval,
+ * or the whole test when final, next to the reporter thread's,
+ * --perf-counters
+ */
+static void reporter_printperf( ReporterData *stats, int final ) {
+    PerfReport flow, reporter;
+    double interval = stats->intervalTime.tv_sec + (stats->intervalTime.tv_usec / (double) rMillion);
+    if ( stats->perfcounters && perf_group_read( &stats->perf, &flow, stats->perfevents, final ) ) {
+	int haveReporter = perf_reporter_report( &reporter, reporter_perfevents, interval, final );
+	perf_reports[stats->mode]( &stats->info, &flow, (haveReporter ? &reporter : NULL) );
+    }
+}
+
+/*
+ * The flow's ring residency over the whole test, -e, its bins are
+ * added to the sum's which is printed with the final SUM report
+ */
+static void reporter_printringlag( ReporterData *stats, MultiHeader *multireport ) {
+    RingLagReport report;
+    if ( stats->info.mEnhanced && ringlag_report( &report, &stats->ringlag ) ) {
+	ringlag_reports[stats->mode]( &stats->info, &report );
+	if ( isMultipleReport(stats) && (multireport != NULL) && (multireport->report != NULL) ) {
+	    RingLagStats *sum = &multireport->report->ringlag;
+	    int ix;
+	    for (ix = 0; ix < RINGLAG_BINS; ix++)
+		sum->bins[ix] += stats->ringlag.bins[ix];
+	    if (stats->ringlag.max > sum->max)
+		sum->max = stats->ringlag.max;
+	    sum->cnt += stats->ringlag.cnt;
+	}
+    }
+}
+
+static void reporter_printringlagsum( MultiHeader *multireport ) {
+    RingLagReport report;
+    ReporterData *stats = multireport->report;
+    if ( stats->info.mEnhanced && ringlag_report( &report, &stats->ringlag ) ) {
+	report.sum = 1;
+	ringlag_reports[stats->mode]( &stats->info, &report );
+    }
+}
+
 /*
  * Prints reports conditionally
  */
@@ -1456,17 +2839,49 @@ int reporter_condprintstats( ReporterData *stats, MultiHeader *multireport, int
 	    stats->info.transit.m2Transit = stats->info.transit.totm2Transit;
 	    stats->info.transit.vdTransit = stats->info.transit.totvdTransit;
 	}
+	stats->info.verify.cnt = stats->info.verify.tot_cnt;
+	stats->info.verify.corrupt = stats->info.verify.tot_corrupt;
+	if (stats->info.frames.tot_cnt || stats->info.frames.tot_resyncs) {
+	    int ix;
+	    stats->info.frames.cnt = stats->info.frames.tot_cnt;
+	    stats->info.frames.gaps = stats->info.frames.tot_gaps;
+	    stats->info.frames.resyncs = stats->info.frames.tot_resyncs;
+	    stats->info.frames.cntLatency = stats->info.frames.totcntLatency;
+	    stats->info.frames.minLatency = stats->info.frames.totminLatency;
+	    stats->info.frames.maxLatency = stats->info.frames.totmaxLatency;
+	    stats->info.frames.sumLatency = stats->info.frames.totsumLatency;
+	    for (ix = 0; ix < LOG2_BINS; ix++) {
+		stats->info.frames.bins[ix] = stats->info.frames.totbins[ix];
+	    }
+	}
+	if (stats->info.intended.tot_cnt) {
+	    stats->info.intended.cnt = stats->info.intended.tot_cnt;
+	    stats->info.intended.minLatency = stats->info.intended.totminLatency;
+	    stats->info.intended.maxLatency = stats->info.intended.totmaxLatency;
+	    stats->info.intended.sumLatency = stats->info.intended.totsumLatency;
+	    stats->info.intended.maxLag = stats->info.intended.totmaxLag;
+	    stats->info.intended.sumLag = stats->info.intended.totsumLag;
+	}
+	if (stats->info.sched.tot_wakes) {
+	    stats->info.sched.wakes = stats->info.sched.tot_wakes;
+	    stats->info.sched.misses = stats->info.sched.tot_misses;
+	    stats->info.sched.minLate = stats->info.sched.totminLate;
+	    stats->info.sched.maxLate = stats->info.sched.totmaxLate;
+	    stats->info.sched.sumLate = stats->info.sched.totsumLate;
+	}
 	if ((stats->info.mTCP == kMode_Client) || (stats->info.mUDP == kMode_Client)) {
 	    stats->info.sock_callstats.write.WriteErr = stats->info.sock_callstats.write.totWriteErr;
 	    stats->info.sock_callstats.write.WriteCnt = stats->info.sock_callstats.write.totWriteCnt;
 	    if (stats->info.mTCP == kMode_Client) {
 		stats->info.sock_callstats.write.TCPretry = stats->info.sock_callstats.write.totTCPretry;
+		memcpy(stats->info.sock_callstats.write.sizebins, stats->info.sock_callstats.write.totsizebins,
+		       sizeof(stats->info.sock_callstats.write.sizebins));
 	    }
 	}
 	if (stats->info.mTCP == kMode_Server) {
 	    int ix;
 	    stats->info.sock_callstats.read.cntRead = stats->info.sock_callstats.read.totcntRead;
-	    for (ix = 0; ix < 8; ix++) {
+	    for (ix = 0; ix < stats->info.sock_callstats.read.bincnt; ix++) {
 		stats->info.sock_callstats.read.bins[ix] = stats->info.sock_callstats.read.totbins[ix];
 	    }
 	    if (stats->clientStartTime.tv_sec > 0)
@@ -1488,10 +2903,28 @@ int reporter_condprintstats( ReporterData *stats, MultiHeader *multireport, int
 	    stats->info.isochstats.slipcnt = stats->isochstats.slipcnt;
 	}
 #endif
+        if ( stats->fullreport ) {
+            reporter_encode_fullreport( stats );
+        }
+        reporter_printcpufreq( stats );
+        reporter_printsoftirqs( stats, 1 );
+        reporter_printenergy( stats, multireport, 1 );
+        reporter_printperf( stats, 1 );
+        reporter_printringlag( stats, multireport );
         reporter_print( stats, TRANSFER_REPORT, force );
+        if ( procs_shared ) {
+            procs_flowdone();
+        }
         if ( isMultipleReport(stats) ) {
             reporter_handle_multiple_reports( multireport, &stats->info, force );
         }
+        if ( stats->aggrcnt ) {
+            reporter_handle_group_reports( stats, &stats->info, force );
+            stats->aggrcnt = 0;
+        }
+        if ( stats->policyjoined ) {
+            reporter_policy_leave( stats );
+        }
     } else while ((stats->intervalTime.tv_sec != 0 ||
                    stats->intervalTime.tv_usec != 0) &&
                   TimeDifference( stats->nextTime,
@@ -1512,7 +2945,14 @@ int reporter_condprintstats( ReporterData *stats, MultiHeader *multireport, int
 		emptystats.info.mEnhanced = stats->info.mEnhanced;
 		emptystats.info.transferID = stats->info.transferID;
 		emptystats.info.groupID = stats->info.groupID;
-		reporter_print( &emptystats, TRANSFER_REPORT, 0);
+		if ( stats->policy ) {
+		    reporter_policy_interval( stats, &emptystats.info );
+		} else {
+		    reporter_print( &emptystats, TRANSFER_REPORT, 0);
+		}
+		if ( stats->aggrcnt ) {
+		    reporter_handle_group_reports( stats, &emptystats.info, 0 );
+		}
 		ignore_pktevent = 0;
 		continue;
 	    } else {
@@ -1535,15 +2975,32 @@ int reporter_condprintstats( ReporterData *stats, MultiHeader *multireport, int
 		stats->lastDatagrams = ((stats->info.mUDP == kMode_Server) ? stats->PacketID : stats->cntDatagrams);
 		stats->info.TotalLen = stats->TotalLen - stats->lastTotal;
 		stats->lastTotal = stats->TotalLen;
+		IPERF_PROBE4(interval, stats->info.transferID, (int64_t) (stats->info.endTime * rMillion),
+			     (int64_t) stats->info.TotalLen, (int64_t) stats->info.cntDatagrams);
 		stats->info.free = 0;
+		// a --report-policy limits the per flow interval lines, so
+		// these go too, the energy is still on the SUM's
+		if ( !stats->policy ) {
+		    reporter_printcpufreq( stats );
+		    reporter_printsoftirqs( stats, 0 );
+		    reporter_printenergy( stats, multireport, 0 );
+		    reporter_printperf( stats, 0 );
+		}
 		//显示各transfer的report信息
-		reporter_print( stats, TRANSFER_REPORT, force );
+		if ( stats->policy ) {
+		    reporter_policy_interval( stats, &stats->info );
+		} else {
+		    reporter_print( stats, TRANSFER_REPORT, force );
+		}
 	    }
 
 	    //显示汇总信息
 	    if ( isMultipleReport(stats) ) {
 	        reporter_handle_multiple_reports( multireport, &stats->info, force );
 	    }
+	    if ( stats->aggrcnt ) {
+	        reporter_handle_group_reports( stats, &stats->info, force );
+	    }
 
 	    /*
 	     * Reset transfer stats now that both the individual and SUM reports
@@ -1559,18 +3016,35 @@ int reporter_condprintstats( ReporterData *stats, MultiHeader *multireport, int
 		    stats->info.l2counts.lengtherr = 0;
 		}
 	    }
+	    stats->info.verify.cnt = 0;
+	    stats->info.verify.corrupt = 0;
+	    if (stats->info.frames.tot_cnt || stats->info.frames.tot_resyncs) {
+		stats->info.frames.cnt = 0;
+		stats->info.frames.gaps = 0;
+		stats->info.frames.resyncs = 0;
+		stats->info.frames.cntLatency = 0;
+		stats->info.frames.sumLatency = 0;
+		memset(stats->info.frames.bins, 0, sizeof(stats->info.frames.bins));
+	    }
+	    stats->info.sched.wakes = 0;
+	    stats->info.sched.misses = 0;
+	    stats->info.sched.sumLate = 0;
+	    stats->info.intended.cnt = 0;
+	    stats->info.intended.sumLatency = 0;
+	    stats->info.intended.sumLag = 0;
 	    if (stats->info.mEnhanced) {
 		if ((stats->info.mTCP == (char)kMode_Client) || (stats->info.mUDP == (char)kMode_Client)) {
 		    stats->info.sock_callstats.write.WriteCnt = 0;
 		    stats->info.sock_callstats.write.WriteErr = 0;
 		    stats->info.sock_callstats.write.WriteErr = 0;
+		    memset(stats->info.sock_callstats.write.sizebins, 0, sizeof(stats->info.sock_callstats.write.sizebins));
 #ifdef HAVE_STRUCT_TCP_INFO_TCPI_TOTAL_RETRANS
 		    stats->info.sock_callstats.write.up_to_date = 0;
 #endif
 		} else if (stats->info.mTCP == (char)kMode_Server) {
 		    int ix;
 		    stats->info.sock_callstats.read.cntRead = 0;
-		    for (ix = 0; ix < 8; ix++) {
+		    for (ix = 0; ix < stats->info.sock_callstats.read.bincnt; ix++) {
 			stats->info.sock_callstats.read.bins[ix] = 0;
 		    }
 		}
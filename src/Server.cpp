@@ -64,8 +64,14 @@
 #include "delay.h"
 #include "PerfSocket.hpp"
 #include "SocketAddr.h"
+#include "probes.h"
+#include "Processes.h"
 #if defined(HAVE_LINUX_FILTER_H) && defined(HAVE_AF_PACKET)
 #include "checksums.h"
+#include "tx_ring.h"
+#endif
+#ifdef HAVE_AF_XDP
+#include <poll.h>
 #endif
 
 /* -------------------------------------------------------------------
@@ -80,6 +86,13 @@ Server::Server( thread_Settings *inSettings ) {
     mBuf = NULL;
     myJob = NULL;
     mySocket = inSettings->mSock;
+#ifdef HAVE_AF_XDP
+    xsk = NULL;
+#endif
+#ifdef HAVE_FLOWTIMER
+    flowTimer.armed = 0;
+    flowTimer.expired = 0;
+#endif
 #if defined(HAVE_LINUX_FILTER_H) && defined(HAVE_AF_PACKET)
     myDropSocket = inSettings->mSockDrop;
     if (isL2LengthCheck(mSettings)) {
@@ -90,7 +103,7 @@ Server::Server( thread_Settings *inSettings ) {
     }
 #endif
     // initialize buffer, length checking done by the Listener
-    mBuf = new char[((mSettings->mBufLen > SIZEOF_MAXHDRMSG) ? mSettings->mBufLen : SIZEOF_MAXHDRMSG)];
+    mBuf = new char[((mSettings->mBufLen > SIZEOF_MAXHDRMSG) ? mSettings->mBufLen : SIZEOF_MAXHDRMSG) + SIZEOF_UDPACKFIN];
     FAIL_errno( mBuf == NULL, "No memory for buffer\n", mSettings );
     SockAddr_Ifrname(mSettings);
 }
@@ -116,12 +129,25 @@ Server::~Server() {
         WARN_errno( rc == SOCKET_ERROR, "server close drop" );
         myDropSocket = INVALID_SOCKET;
     }
+#endif
+#ifdef HAVE_AF_XDP
+    if (xsk) {
+	xdp_sock_close(xsk);
+	delete xsk;
+    }
+#endif
+#ifdef HAVE_FLOWTIMER
+    flowtimer_stop(&flowTimer);
 #endif
     DELETE_ARRAY( mBuf );
     FreeReport(myJob);
 }
 
 bool Server::InProgress (void) {
+#ifdef HAVE_FLOWTIMER
+    if (flowTimer.expired)
+	return false;
+#endif
     if (sInterupted ||
 	((isServerModeTime(mSettings)/*需要持续一段时间*/ || (isModeTime(mSettings) && isReverse(mSettings))) && mEndTime.before(reportstruct->packetTime)))
 	return false;
@@ -133,6 +159,35 @@ bool Server::InProgress (void) {
  * Sends termination flag several times at the end.
  * Does not close the socket.
  * ------------------------------------------------------------------- */
+/*
+ * Report the client writes that end within this read, --tcp-framing.
+ * Each goes to the reporter as its own empty packet so the read
+ * accounting is unchanged.
+ */
+void Server::ReportFrames (const char *buf, int len) {
+    ReportStruct framereport;
+    TcpFrame frame;
+    intmax_t resyncs = frameParser.resyncs;
+
+    memset(&framereport, 0, sizeof(ReportStruct));
+    framereport.emptyreport = 1;
+    framereport.socket = reportstruct->socket;
+    framereport.packetTime = reportstruct->packetTime;
+    while (tcpframe_next(&frameParser, &buf, &len, &frame)) {
+	framereport.packetID = frame.id;
+	framereport.framelen = frame.len;
+	framereport.sentTime = frame.sent;
+	framereport.frameresyncs = (int) (frameParser.resyncs - resyncs);
+	resyncs = frameParser.resyncs;
+	ReportPacket(mSettings->reporthdr, &framereport);
+    }
+    if (frameParser.resyncs != resyncs) {
+	framereport.framelen = 0;
+	framereport.frameresyncs = (int) (frameParser.resyncs - resyncs);
+	ReportPacket(mSettings->reporthdr, &framereport);
+    }
+}
+
 void Server::RunTCP( void ) {
     long currLen;
     intmax_t totLen = 0;
@@ -167,7 +222,7 @@ void Server::RunTCP( void ) {
 #ifdef WIN32
 		    (WSAGetLastError() != WSAEWOULDBLOCK)
 #else
-		    (errno != EAGAIN && errno != EWOULDBLOCK)
+		    (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
 #endif // WIN32
 		    ) {
 			//读取出错或者关闭
@@ -178,10 +233,18 @@ void Server::RunTCP( void ) {
 	    totLen += currLen;
 	    if (isBWSet(mSettings))
 		tokens -= currLen;
+	    if (isVerify(mSettings) && (currLen > 0)) {
+		verify_stream(&verifyStream, mBuf, currLen, &reportstruct->verifyblocks, &reportstruct->verifycorrupt);
+	    }
+	    if (isTcpFraming(mSettings) && (currLen > 0)) {
+		ReportFrames(mBuf, currLen);
+	    }
 	    if (0.0 != mSettings->mInterval) {
 	    	//执行间隔report
 	      reportstruct->packetLen = currLen;
 	      ReportPacket( mSettings->reporthdr, reportstruct );
+	      reportstruct->verifyblocks = 0;
+	      reportstruct->verifycorrupt = 0;
 	    }
 	    // Check for reverse and amount where
 	    // the server stops after receiving
@@ -199,12 +262,17 @@ void Server::RunTCP( void ) {
 
     //接收停止，执行report
     // stop timing
+#ifdef HAVE_FLOWTIMER
+    flowtimer_stop(&flowTimer);
+#endif
     now.setnow();
     reportstruct->packetTime.tv_sec = now.getSecs();
     reportstruct->packetTime.tv_usec = now.getUsecs();
 
     if(0.0 == mSettings->mInterval) {
     	//执行report
+	// the last read was the 0 byte one that flagged the loop's end
+	reportstruct->emptyreport = 0;
 	reportstruct->packetLen = totLen;
 	ReportPacket( mSettings->reporthdr, reportstruct );
     }
@@ -214,6 +282,11 @@ void Server::RunTCP( void ) {
     Iperf_delete( &(mSettings->peer), &clients );
     Mutex_Unlock( &clients_mutex );
     EndReport( mSettings->reporthdr );
+    if (isFullReport(mSettings) && mSettings->reporthdr && mSettings->reporthdr->report.fullreportbuf) {
+	// the client reads the final report after its half close
+	int rc = writen(mSettings->mSock, mSettings->reporthdr->report.fullreportbuf, mSettings->reporthdr->report.fullreportlen);
+	WARN_errno( rc < 0, "write full report" );
+    }
 }
 
 void Server::InitKernelTimeStamping (void) {
@@ -261,6 +334,14 @@ void Server::InitTrafficLoop (void) {
 	reportstruct->packetID = 0;
 	reportstruct->l2len = 0;
 	reportstruct->l2errors = 0x0;
+	reportstruct->verifyblocks = 0;
+	reportstruct->verifycorrupt = 0;
+    }
+    if (isVerify(mSettings)) {
+	verify_stream_init(&verifyStream);
+    }
+    if (isTcpFraming(mSettings)) {
+	tcpframe_init(&frameParser);
     }
     if (mSettings->mBufLen < (int) sizeof(UDP_datagram)) {
        mSettings->mBufLen = sizeof( UDP_datagram );
@@ -297,7 +378,17 @@ void Server::InitTrafficLoop (void) {
 	}
     }
     if (isServerModeTime(mSettings) || (isModeTime(mSettings) && isReverse(mSettings))) {
-#ifdef HAVE_SETITIMER
+        mEndTime.setnow();
+        mEndTime.add( mSettings->mAmount / 100.0 );
+#ifdef HAVE_FLOWTIMER
+	// this thread's own timer, see Client::InitTrafficLoop
+	struct timeval deadline;
+	deadline.tv_sec = mEndTime.getSecs();
+	deadline.tv_usec = mEndTime.getUsecs();
+	if (flowtimer_start(&flowTimer, &deadline) < 0) {
+	    WARN_errno( 1, "flow timer" );
+	}
+#elif defined(HAVE_SETITIMER)
         int err;
         struct itimerval it;
 	memset (&it, 0, sizeof (it));
@@ -307,8 +398,6 @@ void Server::InitTrafficLoop (void) {
 	err = setitimer( ITIMER_REAL, &it, NULL );
 	FAIL_errno( err != 0, "setitimer", mSettings );
 #endif
-        mEndTime.setnow();
-        mEndTime.add( mSettings->mAmount / 100.0 );
     }
 
     if (isTripTime(mSettings)) {
@@ -350,7 +439,7 @@ int Server::ReadWithRxTimestamp (int *readerr) {
 #ifdef WIN32
 	    (WSAGetLastError() != WSAEWOULDBLOCK)
 #else
-	    (errno != EAGAIN && errno != EWOULDBLOCK)
+	    (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
 #endif
 	    ) {
 	    WARN_errno( currLen, "recvmsg");
@@ -364,6 +453,7 @@ int Server::ReadWithRxTimestamp (int *readerr) {
 	reportstruct->packetTime.tv_sec = now.getSecs();
 	reportstruct->packetTime.tv_usec = now.getUsecs();
     }
+    IPERF_PROBE3(rx_read, mSettings->mSock, currLen, tsdone);
     return currLen;
 }
 
@@ -545,12 +635,188 @@ void Server::Isoch_processing (int rxlen) {
  * Sends termination flag several times at the end.
  * Does not close the socket.
  * ------------------------------------------------------------------- */
+/*
+ * Account the datagram in mBuf, rxlen bytes, returns true when it's
+ * the last one the client sent
+ */
+bool Server::UDPPacket (int rxlen) {
+    bool lastpacket = false;
+    if (isL2LengthCheck(mSettings)) {
+	reportstruct->l2len = rxlen;
+	// L2 processing will set the reportstruct packet length with the length found in the udp header
+	// and also set the expected length in the report struct.  The reporter thread
+	// will do the compare and account and print l2 errors
+	reportstruct->l2errors = 0x0;
+	L2_processing();
+    } else {
+	// Normal UDP rx, set the length to the socket received length
+	reportstruct->packetLen = rxlen;
+    }
+    if (!(reportstruct->l2errors & L2UNKNOWN)) {
+	// ReadPacketID returns true if this is the last UDP packet sent by the client
+	// aslo sets the packet rx time in the reportstruct
+	lastpacket = ReadPacketID();
+	if (isIsochronous(mSettings)) {
+	    Isoch_processing(rxlen);
+	}
+	// the FINs carry no intended send time
+	reportstruct->intended = 0;
+	if (isIntendedTime(mSettings) && !lastpacket && \
+	    (rxlen >= (int) (UDP_INTENDED_OFFSET + sizeof(UDP_intended_payload)))) {
+	    struct UDP_intended_payload *mBuf_intended = (struct UDP_intended_payload *) (mBuf + mSettings->l4payloadoffset + UDP_INTENDED_OFFSET);
+	    reportstruct->intended = 1;
+	    reportstruct->intendedTime.tv_sec = ntohl(mBuf_intended->tv_sec);
+	    reportstruct->intendedTime.tv_usec = ntohl(mBuf_intended->tv_usec);
+	}
+	// id 0, the FINs and datagrams too short for one, e.g. a short
+	// isochronous burst tail, carry no verify block, see Client.cpp
+	if (isVerify(mSettings) && !lastpacket && (reportstruct->packetID > 0) && \
+	    (rxlen >= (VERIFY_UDP_OFFSET + VERIFY_MINLEN))) {
+	    reportstruct->verifyblocks = 1;
+	    reportstruct->verifycorrupt = !verify_block(mBuf + VERIFY_UDP_OFFSET, rxlen - VERIFY_UDP_OFFSET, (uint32_t) reportstruct->packetID);
+	}
+    }
+    return lastpacket;
+}
+
+#ifdef HAVE_AF_XDP
+/*
+ * Open the AF_XDP socket on the flow's interface and attach the
+ * program redirecting the flow's datagrams to it
+ */
+bool Server::XdpInit (void) {
+    struct sockaddr_in local;
+    socklen_t len = sizeof(local);
+    // with --l2checks mSock is the packet socket
+    int udpsock = (isL2LengthCheck(mSettings) && (mSettings->mSockDrop > 0)) ? mSettings->mSockDrop : mSettings->mSock;
+    const char *why = NULL;
+
+    if ((getsockname(udpsock, (struct sockaddr *) &local, &len) < 0) || (local.sin_family != AF_INET) || \
+	SockAddr_isIPv6(&mSettings->peer) || !mSettings->mIfrname) {
+	why = "needs an IPv4 interface";
+    } else if (isIsochronous(mSettings) || isVerify(mSettings)) {
+	why = "doesn't do --isochronous or --verify flows";
+    } else {
+	xsk = new xdp_sock;
+	if (xdp_sock_open(xsk, mSettings->mIfrname, mSettings->mXdpQueue, 1) != 0) {
+	    why = "can't open an AF_XDP socket (needs CAP_NET_RAW and a queue no other socket is bound to)";
+	} else if (xdp_sock_attach(xsk, mSettings->mIfrname, &local, (struct sockaddr_in *) &mSettings->peer) != 0) {
+	    why = "can't attach the XDP program (needs CAP_BPF or another program is attached)";
+	    xdp_sock_close(xsk);
+	}
+	if (why) {
+	    delete xsk;
+	    xsk = NULL;
+	}
+    }
+    if (why) {
+	fprintf(stderr, warn_udp_frames, "--xdp", why);
+	return false;
+    }
+    return true;
+}
+
+/*
+ * UDP receive loop over the AF_XDP socket, a batch of frames per pass.
+ * Datagrams still reaching the UDP socket, i.e. queued before the
+ * program was attached or received on another queue, are read the
+ * usual way.  Returns true on the client's last datagram.
+ */
+bool Server::RunUDPXdp (int *readerr) {
+    bool lastpacket = false;
+    char *sockBuf = mBuf;
+    int l4offset = mSettings->l4offset;
+    int l4payloadoffset = mSettings->l4payloadoffset;
+    intmax_t viasock = 0;
+    struct pollfd pfd[2];
+    int msecs = -1;
+
+    // wake up as the socket read timeout would
+    if (mSettings->mInterval) {
+	msecs = (int) (mSettings->mInterval * 1e3) / 2;
+    } else if (isServerModeTime(mSettings)) {
+	msecs = (mSettings->mAmount * 10) / 2;
+    }
+    pfd[0].fd = xsk->sock;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = mSettings->mSock;
+    pfd[1].events = POLLIN;
+    // datagrams queued on the socket before the attach go first
+    bool backlog = true;
+    while (InProgress() && !*readerr && !lastpacket) {
+	int n = xdp_sock_rx_peek(xsk, XDP_SOCK_BATCH);
+	if (!n || backlog) {
+	    pfd[0].revents = pfd[1].revents = 0;
+	    int rc = poll(pfd, 2, (backlog ? 0 : msecs));
+	    if ((rc < 0) && (errno != EINTR)) {
+		WARN_errno(1, "xdp poll");
+		*readerr = 1;
+	    } else if (pfd[1].revents & POLLIN) {
+		reportstruct->emptyreport = 0;
+		int rxlen = ReadWithRxTimestamp(readerr);
+		if (!*readerr && (rxlen > 0)) {
+		    viasock++;
+		    lastpacket = UDPPacket(rxlen);
+		}
+		ReportPacket(mSettings->reporthdr, reportstruct);
+	    } else if (backlog) {
+		backlog = false;
+	    } else if (rc <= 0) {
+		// nothing arrived, keep the interval reports going
+		now.setnow();
+		reportstruct->packetTime.tv_sec = now.getSecs();
+		reportstruct->packetTime.tv_usec = now.getUsecs();
+		reportstruct->emptyreport = 1;
+		ReportPacket(mSettings->reporthdr, reportstruct);
+	    }
+	    continue;
+	}
+	// one receive time per batch
+	now.setnow();
+	reportstruct->packetTime.tv_sec = now.getSecs();
+	reportstruct->packetTime.tv_usec = now.getUsecs();
+	// the frames are L2, the datagram follows the headers
+	mSettings->l4offset = sizeof(struct ether_header) + sizeof(struct iphdr);
+	mSettings->l4payloadoffset = TXRING_UDP4_PAYLOAD;
+	int ix;
+	for (ix = 0; (ix < n) && !lastpacket; ix++) {
+	    int len;
+	    mBuf = (char *) xdp_sock_rx_frame(xsk, ix, &len);
+	    reportstruct->emptyreport = 0;
+	    if (!isL2LengthCheck(mSettings)) {
+		// the program matched the headers, the UDP length is the datagram's
+		len = ntohs(((struct udphdr *) (mBuf + mSettings->l4offset))->len) - sizeof(struct udphdr);
+	    }
+	    lastpacket = UDPPacket(len);
+	    ReportPacket(mSettings->reporthdr, reportstruct);
+	}
+	mBuf = sockBuf;
+	mSettings->l4offset = l4offset;
+	mSettings->l4payloadoffset = l4payloadoffset;
+	xdp_sock_rx_release(xsk, ix);
+    }
+    if (isEnhanced(mSettings)) {
+	printf(report_xdp_rx, procs_transferid(mSettings->mSock), mSettings->mIfrname, xsk->queue, (xsk->skbmode ? "generic" : "native"),
+	       xsk->frames, viasock);
+    }
+    // the end of test handshake takes the UDP socket
+    xdp_sock_close(xsk);
+    delete xsk;
+    xsk = NULL;
+    return lastpacket;
+}
+#endif
+
 void Server::RunUDP( void ) {
     int rxlen;
     int readerr = 0;
     bool lastpacket = 0;
 
     InitTrafficLoop();
+#ifdef HAVE_AF_XDP
+    if (isXdp(mSettings) && XdpInit())
+	lastpacket = RunUDPXdp(&readerr);
+#endif
 
     // Exit loop on three conditions
     // 1) Fatal read error
@@ -568,30 +834,16 @@ void Server::RunUDP( void ) {
 	// will also set empty report or not
 	rxlen=ReadWithRxTimestamp(&readerr);
 	if (!readerr && (rxlen > 0)) {
-	    if (isL2LengthCheck(mSettings)) {
-		reportstruct->l2len = rxlen;
-		// L2 processing will set the reportstruct packet length with the length found in the udp header
-		// and also set the expected length in the report struct.  The reporter thread
-		// will do the compare and account and print l2 errors
-		reportstruct->l2errors = 0x0;
-		L2_processing();
-	    } else {
-		// Normal UDP rx, set the length to the socket received length
-		reportstruct->packetLen = rxlen;
-	    }
-	    if (!(reportstruct->l2errors & L2UNKNOWN)) {
-		// ReadPacketID returns true if this is the last UDP packet sent by the client
-		// aslo sets the packet rx time in the reportstruct
-		lastpacket = ReadPacketID();
-		if (isIsochronous(mSettings)) {
-		    Isoch_processing(rxlen);
-		}
-	    }
+	    lastpacket = UDPPacket(rxlen);
 	}
 
 	ReportPacket(mSettings->reporthdr, reportstruct);
+	reportstruct->verifyblocks = 0;
 
     }
+#ifdef HAVE_FLOWTIMER
+    flowtimer_stop(&flowTimer);
+#endif
 
     CloseReport( mSettings->reporthdr, reportstruct );
 
@@ -605,7 +857,7 @@ void Server::RunUDP( void ) {
     Iperf_delete( &(mSettings->peer), &clients );
     Mutex_Unlock( &clients_mutex );
 
-    DELETE_PTR( reportstruct );
+    // reportstruct is the packet ring's metapacket, freed with the report
     EndReport( mSettings->reporthdr );
 }
 // end Recv
@@ -614,12 +866,26 @@ void Server::RunUDP( void ) {
  * Send an AckFIN (a datagram acknowledging a FIN) on the socket,
  * then select on the socket for some time. If additional datagrams
  * come in, probably our AckFIN was lost and they are re-transmitted
- * termination datagrams, so re-transmit our AckFIN.
+ * termination datagrams, so re-transmit our AckFIN.  The client's
+ * FINACKACK says it has the AckFIN, stop waiting then.
  * ------------------------------------------------------------------- */
 
 void Server::write_UDP_AckFIN( ) {
 
     int rc;
+    // the AckFIN carries the whole server_hdr even when -l is shorter
+    int ackLen = (mSettings->mBufLen > SIZEOF_UDPACKFIN) ? mSettings->mBufLen : SIZEOF_UDPACKFIN;
+    Transfer_Info *stats = GetReport( mSettings->reporthdr );
+    // --full-report, the server's final report follows the server_hdr
+    char *ackBuf = NULL;
+    int fulllen = 0;
+    if (mSettings->reporthdr && mSettings->reporthdr->report.fullreportbuf) {
+	fulllen = mSettings->reporthdr->report.fullreportlen;
+	if (ackLen < (SIZEOF_UDPACKFIN + fulllen))
+	    ackLen = SIZEOF_UDPACKFIN + fulllen;
+	ackBuf = new char[ackLen]();
+	memcpy(ackBuf + SIZEOF_UDPACKFIN, mSettings->reporthdr->report.fullreportbuf, fulllen);
+    }
 
     fd_set readSet;
     FD_ZERO( &readSet );
@@ -634,12 +900,13 @@ void Server::write_UDP_AckFIN( ) {
         server_hdr *hdr;
 
         UDP_Hdr = (UDP_datagram*) mBuf;
-        if (mSettings->mBufLen > (int) (sizeof(UDP_datagram) + sizeof(server_hdr))) {
+        {
 	    int flags = (!isEnhanced(mSettings) ? HEADER_VERSION1 : (HEADER_VERSION1 | HEADER_EXTEND));
 #ifdef HAVE_INT64_T
 	    flags |=  HEADER_SEQNO64B;
 #endif
-            Transfer_Info *stats = GetReport( mSettings->reporthdr );
+	    if (ackBuf)
+		flags |= HEADER_FULLREPORT;
             hdr = (server_hdr*) (UDP_Hdr+1);
 	    hdr->base.flags        = htonl((long) flags);
 #ifdef HAVE_INT64_T
@@ -681,12 +948,17 @@ void Server::write_UDP_AckFIN( ) {
         }
 
         // write data
+	char *ack = mBuf;
+	if (ackBuf) {
+	    memcpy(ackBuf, mBuf, SIZEOF_UDPACKFIN);
+	    ack = ackBuf;
+	}
 #if defined(HAVE_LINUX_FILTER_H) && defined(HAVE_AF_PACKET)
 	// If in l2mode, use the AF_INET socket to write this packet
 	//
-	write(((mSettings->mSockDrop > 0 ) ? mSettings->mSockDrop : mSettings->mSock), mBuf, mSettings->mBufLen);
+	write(((mSettings->mSockDrop > 0 ) ? mSettings->mSockDrop : mSettings->mSock), ack, ackLen);
 #else
-	write(mSettings->mSock, mBuf, mSettings->mBufLen);
+	write(mSettings->mSock, ack, ackLen);
 #endif
         // wait until the socket is readable, or our timeout expires
         FD_SET( mSettings->mSock, &readSet );
@@ -698,6 +970,7 @@ void Server::write_UDP_AckFIN( ) {
 
         if ( rc == 0 ) {
             // select timed out
+            DELETE_ARRAY( ackBuf );
             return;
         } else {
             // socket ready to read
@@ -706,11 +979,19 @@ void Server::write_UDP_AckFIN( ) {
             if ( rc <= 0 ) {
                 // Connection closed or errored
                 // Stop using it.
+                DELETE_ARRAY( ackBuf );
                 return;
             }
+	    if ((rc == (int) sizeof(UDP_datagram)) && (UDP_Hdr->id == 0) && (UDP_Hdr->id2 == 0) && \
+		(ntohl(UDP_Hdr->tv_usec) == UDP_FINACKACK)) {
+		// the client has the AckFIN
+		DELETE_ARRAY( ackBuf );
+		return;
+	    }
         }
     }
 
-    fprintf( stderr, warn_ack_failed, mSettings->mSock, count );
+    DELETE_ARRAY( ackBuf );
+    fprintf( stderr, warn_ack_failed, procs_transferid(mSettings->mSock), count );
 }
 // end write_UDP_AckFIN
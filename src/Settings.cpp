@@ -61,6 +61,7 @@
 
 #define HEADERS()
 
+#include <math.h>
 #include "headers.h"
 #include "Settings.hpp"
 #include "Locale.h"
@@ -68,9 +69,12 @@
 #include "util.h"
 #include "version.h"
 #include "gnu_getopt.h"
+#include "Processes.h"
+#include "verify.h"
+#include "pdfs.h"
+#include "tx_ring.h"
 #ifdef HAVE_ISOCHRONOUS
 #include "isochronous.hpp"
-#include "pdfs.h"
 #endif
 
 static int reversetest = 0;
@@ -86,6 +90,25 @@ static int writeack = 0;
 //采用-t时间为<0的数时，生效，无终止运行
 static int infinitetime = 0;
 static int connectonly = 0;
+static int sumgroups = 0;
+static int reportpolicy = 0;
+static int readbins = 0;
+static int mcastgroups = 0;
+static int sportspray = 0;
+static int txring = 0;
+static int xdp = 0;
+static int processes = 0;
+static int cpudmalatency = 0;
+static int scheddeadline = 0;
+static int softirqs = 0;
+static int energy = 0;
+static int perfcounters = 0;
+static int verify = 0;
+static int tcpframing = 0;
+static int fullreport = 0;
+static int intendedtime = 0;
+static int writesizes = 0;
+static int rcvlowat = 0;
 #ifdef HAVE_ISOCHRONOUS
 static int burstipg = 0;
 static int burstipg_set = 0;
@@ -164,6 +187,25 @@ const struct option long_options[] =
 {"write-ack", no_argument, &writeack, 1},
 {"connect-only", optional_argument, &connectonly, 1},
 {"bidir", no_argument, &bidirtest, 1},
+{"sum-groups", required_argument, &sumgroups, 1},
+{"report-policy", required_argument, &reportpolicy, 1},
+{"read-bins", required_argument, &readbins, 1},
+{"mcast-groups", required_argument, &mcastgroups, 1},
+{"sport-spray", required_argument, &sportspray, 1},
+{"tx-ring", optional_argument, &txring, 1},
+{"xdp", optional_argument, &xdp, 1},
+{"processes", required_argument, &processes, 1},
+{"cpu-dma-latency", required_argument, &cpudmalatency, 1},
+{"sched-deadline", optional_argument, &scheddeadline, 1},
+{"softirqs", optional_argument, &softirqs, 1},
+{"energy", no_argument, &energy, 1},
+{"perf-counters", no_argument, &perfcounters, 1},
+{"verify", no_argument, &verify, 1},
+{"tcp-framing", no_argument, &tcpframing, 1},
+{"full-report", no_argument, &fullreport, 1},
+{"intended-time", no_argument, &intendedtime, 1},
+{"write-sizes", required_argument, &writesizes, 1},
+{"rcvlowat", required_argument, &rcvlowat, 1},
 #ifdef HAVE_ISOCHRONOUS
 {"ipg", required_argument, &burstipg, 1},
 {"isochronous", optional_argument, &isochronous, 1},
@@ -319,6 +361,26 @@ void Settings_Copy( thread_Settings *from, thread_Settings **into ) {
 	(*into)->mRxHistogramStr = new char[ strlen(from->mRxHistogramStr) + 1];
         strcpy( (*into)->mRxHistogramStr, from->mRxHistogramStr );
     }
+    if ( from->mSumGroupsStr != NULL ) {
+	(*into)->mSumGroupsStr = new char[ strlen(from->mSumGroupsStr) + 1];
+        strcpy( (*into)->mSumGroupsStr, from->mSumGroupsStr );
+    }
+    if ( from->mReportPolicyStr != NULL ) {
+	(*into)->mReportPolicyStr = new char[ strlen(from->mReportPolicyStr) + 1];
+        strcpy( (*into)->mReportPolicyStr, from->mReportPolicyStr );
+    }
+    if ( from->mSoftirqIfaces != NULL ) {
+	(*into)->mSoftirqIfaces = new char[ strlen(from->mSoftirqIfaces) + 1];
+        strcpy( (*into)->mSoftirqIfaces, from->mSoftirqIfaces );
+    }
+    if ( from->mWriteSizes != NULL ) {
+	(*into)->mWriteSizes = new char[ strlen(from->mWriteSizes) + 1];
+        strcpy( (*into)->mWriteSizes, from->mWriteSizes );
+    }
+    if ( from->mTxRingMac != NULL ) {
+	(*into)->mTxRingMac = new char[ strlen(from->mTxRingMac) + 1];
+        strcpy( (*into)->mTxRingMac, from->mTxRingMac );
+    }
     if ( from->mSSMMulticastStr != NULL ) {
 	(*into)->mSSMMulticastStr = new char[ strlen(from->mSSMMulticastStr) + 1];
         strcpy( (*into)->mSSMMulticastStr, from->mSSMMulticastStr );
@@ -366,6 +428,11 @@ void Settings_Destroy( thread_Settings *mSettings) {
     DELETE_ARRAY( mSettings->mFileName  );
     DELETE_ARRAY( mSettings->mOutputFileName );
     DELETE_ARRAY( mSettings->mRxHistogramStr );
+    DELETE_ARRAY( mSettings->mSumGroupsStr );
+    DELETE_ARRAY( mSettings->mReportPolicyStr );
+    DELETE_ARRAY( mSettings->mSoftirqIfaces );
+    DELETE_ARRAY( mSettings->mWriteSizes );
+    DELETE_ARRAY( mSettings->mTxRingMac );
     DELETE_ARRAY( mSettings->mSSMMulticastStr);
     FREE_ARRAY( mSettings->mIfrname);
     FREE_ARRAY( mSettings->mIfrnametx);
@@ -874,6 +941,133 @@ void Settings_Interpret( char option, const char *optarg, thread_Settings *mExtS
 		    strcpy(mExtSettings->mRxHistogramStr, optarg);
 		}
 	    }
+	    if (sumgroups) {
+		sumgroups = 0;
+		mExtSettings->mSumGroupsStr = new char[ strlen( optarg ) + 1 ];
+		strcpy(mExtSettings->mSumGroupsStr, optarg);
+	    }
+	    if (readbins) {
+		readbins = 0;
+		mExtSettings->mReadBins = atoi(optarg);
+		if ((mExtSettings->mReadBins < 1) || (mExtSettings->mReadBins > READ_BINMAX)) {
+		    fprintf(stderr, "WARNING: --read-bins must be between 1 and %d, using %d\n", READ_BINMAX, READ_BINMAX);
+		    mExtSettings->mReadBins = READ_BINMAX;
+		}
+	    }
+	    if (mcastgroups) {
+		mcastgroups = 0;
+		mExtSettings->mMcastGroups = atoi(optarg);
+	    }
+	    if (sportspray) {
+		const char *comma = strchr(optarg, ',');
+		sportspray = 0;
+		mExtSettings->mSprayPorts = atoi(optarg);
+		mExtSettings->mSprayHash = (comma && !strcmp(comma + 1, "hash"));
+		if (comma && !mExtSettings->mSprayHash && strcmp(comma + 1, "rr"))
+		    fprintf(stderr, "WARNING: --sport-spray %s, expected rr or hash, using rr\n", comma + 1);
+		if (mExtSettings->mSprayPorts > SPRAY_MAX) {
+		    fprintf(stderr, "WARNING: --sport-spray limited to %d sockets\n", SPRAY_MAX);
+		    mExtSettings->mSprayPorts = SPRAY_MAX;
+		}
+	    }
+	    if (txring) {
+		txring = 0;
+		mExtSettings->mTxRing = TXRING_BATCH;
+		DELETE_ARRAY(mExtSettings->mTxRingMac);
+		if (optarg) {
+		    const char *comma = strchr(optarg, ',');
+		    if (atoi(optarg) > 0)
+			mExtSettings->mTxRing = atoi(optarg);
+		    if (comma) {
+			mExtSettings->mTxRingMac = new char[ strlen( comma + 1 ) + 1 ];
+			strcpy(mExtSettings->mTxRingMac, comma + 1);
+		    }
+		}
+		if (mExtSettings->mTxRing > TXRING_MAXBATCH) {
+		    fprintf(stderr, "WARNING: --tx-ring limited to %d frames per kick\n", TXRING_MAXBATCH);
+		    mExtSettings->mTxRing = TXRING_MAXBATCH;
+		}
+	    }
+	    if (xdp) {
+		xdp = 0;
+		setXdp(mExtSettings);
+		mExtSettings->mXdpQueue = (optarg ? atoi(optarg) : 0);
+		if (mExtSettings->mXdpQueue < 0)
+		    mExtSettings->mXdpQueue = 0;
+	    }
+	    if (cpudmalatency) {
+		cpudmalatency = 0;
+		setCpuDmaLatency(mExtSettings);
+		mExtSettings->mCpuDmaLatency = atoi(optarg);
+		if (mExtSettings->mCpuDmaLatency < 0)
+		    mExtSettings->mCpuDmaLatency = 0;
+	    }
+	    if (scheddeadline) {
+		scheddeadline = 0;
+		// the reservation is derived per the sender's pacing
+		mExtSettings->mSchedPeriod = -1;
+		mExtSettings->mSchedRuntime = (optarg ? atoi(optarg) : 0);
+		if (mExtSettings->mSchedRuntime < 0)
+		    mExtSettings->mSchedRuntime = 0;
+	    }
+	    if (softirqs) {
+		softirqs = 0;
+		setSoftirqs(mExtSettings);
+		setEnhanced(mExtSettings);
+		if (optarg) {
+		    mExtSettings->mSoftirqIfaces = new char[ strlen( optarg ) + 1 ];
+		    strcpy(mExtSettings->mSoftirqIfaces, optarg);
+		}
+	    }
+	    if (energy) {
+		energy = 0;
+		setEnergy(mExtSettings);
+		setEnhanced(mExtSettings);
+	    }
+	    if (perfcounters) {
+		perfcounters = 0;
+		setPerfCounters(mExtSettings);
+		setEnhanced(mExtSettings);
+	    }
+	    if (verify) {
+		verify = 0;
+		setVerify(mExtSettings);
+	    }
+	    if (tcpframing) {
+		tcpframing = 0;
+		setTcpFraming(mExtSettings);
+	    }
+	    if (fullreport) {
+		fullreport = 0;
+		setFullReport(mExtSettings);
+	    }
+	    if (intendedtime) {
+		intendedtime = 0;
+		setIntendedTime(mExtSettings);
+	    }
+	    if (writesizes) {
+		writesizes = 0;
+		DELETE_ARRAY(mExtSettings->mWriteSizes);
+		mExtSettings->mWriteSizes = new char[ strlen( optarg ) + 1 ];
+		strcpy(mExtSettings->mWriteSizes, optarg);
+	    }
+	    if (processes) {
+		processes = 0;
+		mExtSettings->mProcesses = atoi(optarg);
+		if (mExtSettings->mProcesses > PROCS_MAX) {
+		    fprintf(stderr, "WARNING: --processes limited to %d\n", PROCS_MAX);
+		    mExtSettings->mProcesses = PROCS_MAX;
+		}
+	    }
+	    if (rcvlowat) {
+		rcvlowat = 0;
+		mExtSettings->mRcvLowat = byte_atoi(optarg);
+	    }
+	    if (reportpolicy) {
+		reportpolicy = 0;
+		mExtSettings->mReportPolicyStr = new char[ strlen( optarg ) + 1 ];
+		strcpy(mExtSettings->mReportPolicyStr, optarg);
+	    }
 	    if (reversetest) {
 		reversetest = 0;
 		setReverse(mExtSettings);
@@ -1043,6 +1237,189 @@ void Settings_ModalOptions( thread_Settings *mExtSettings ) {
 	    }
 	}
     }
+    if ((mExtSettings->mProcesses > 1) && (mExtSettings->mThreadMode == kMode_Client)) {
+	// each worker would start its own listener for these
+	if ((mExtSettings->mMode != kTest_Normal) || isReverse(mExtSettings) || isBidir(mExtSettings)) {
+	    fprintf(stderr, "WARNING: option --processes is not supported with -d, -r, -R or --bidir and is ignored\n");
+	    mExtSettings->mProcesses = 0;
+	} else if (mExtSettings->mThreads < mExtSettings->mProcesses) {
+	    // no idle workers, at least one flow each
+	    mExtSettings->mProcesses = mExtSettings->mThreads;
+	}
+    }
+    if (mExtSettings->mSprayPorts > 1) {
+	// every datagram carries the test flags, a dual test would
+	// start one reverse flow per sprayed port
+	if (!isUDP(mExtSettings) || (mExtSettings->mThreadMode != kMode_Client) || isMulticast(mExtSettings) ||
+	    (mExtSettings->mMode != kTest_Normal) || isIsochronous(mExtSettings) || isReverse(mExtSettings)) {
+	    fprintf(stderr, "WARNING: option --sport-spray requires a unicast UDP client without -d, -r, -R or --isochronous and is ignored\n");
+	    mExtSettings->mSprayPorts = 0;
+	}
+    }
+    if (mExtSettings->mTxRing) {
+#if defined(HAVE_LINUX_FILTER_H) && defined(HAVE_AF_PACKET)
+	// the frames are built once, only the datagram header changes
+	if (!isUDP(mExtSettings) || (mExtSettings->mThreadMode != kMode_Client) || isIPV6(mExtSettings) || \
+	    isMulticast(mExtSettings) || (mExtSettings->mMode != kTest_Normal) || isIsochronous(mExtSettings) || \
+	    isReverse(mExtSettings) || (mExtSettings->mSprayPorts > 1) || isVerify(mExtSettings) || \
+	    isFileInput(mExtSettings) || isSTDIN(mExtSettings)) {
+	    fprintf(stderr, "WARNING: option --tx-ring requires a unicast IPv4 UDP client without -d, -r, -R, -F, -I, --isochronous, --sport-spray or --verify and is ignored\n");
+	    mExtSettings->mTxRing = 0;
+	    DELETE_ARRAY(mExtSettings->mTxRingMac);
+	} else {
+	    unsigned char mac[6];
+	    if (mExtSettings->mTxRingMac && (tx_ring_parse_mac(mExtSettings->mTxRingMac, mac) != 0)) {
+		fprintf(stderr, "WARNING: --tx-ring MAC %s is not xx:xx:xx:xx:xx:xx, using the neighbor table\n", mExtSettings->mTxRingMac);
+		DELETE_ARRAY(mExtSettings->mTxRingMac);
+	    }
+	}
+#else
+	fprintf(stderr, "WARNING: option --tx-ring is not supported on this platform and is ignored\n");
+	mExtSettings->mTxRing = 0;
+	DELETE_ARRAY(mExtSettings->mTxRingMac);
+#endif
+    }
+    if (isXdp(mExtSettings)) {
+#ifdef HAVE_AF_XDP
+	if (!isUDP(mExtSettings) || isIPV6(mExtSettings) || isMulticast(mExtSettings)) {
+	    fprintf(stderr, "WARNING: option --xdp requires unicast IPv4 UDP and is ignored\n");
+	    unsetXdp(mExtSettings);
+	} else if ((mExtSettings->mThreadMode == kMode_Client) && \
+		   ((mExtSettings->mMode != kTest_Normal) || isIsochronous(mExtSettings) || isReverse(mExtSettings) || \
+		    (mExtSettings->mSprayPorts > 1) || isVerify(mExtSettings) || isFileInput(mExtSettings) || isSTDIN(mExtSettings))) {
+	    fprintf(stderr, "WARNING: option --xdp on a client is not supported with -d, -r, -R, -F, -I, --isochronous, --sport-spray or --verify and is ignored\n");
+	    unsetXdp(mExtSettings);
+	} else if ((mExtSettings->mThreadMode == kMode_Client) && mExtSettings->mTxRing) {
+	    fprintf(stderr, "WARNING: option --tx-ring is ignored with --xdp\n");
+	    mExtSettings->mTxRing = 0;
+	    DELETE_ARRAY(mExtSettings->mTxRingMac);
+	}
+#else
+	fprintf(stderr, "WARNING: option --xdp is not supported on this platform and is ignored\n");
+	unsetXdp(mExtSettings);
+#endif
+    }
+    if ((mExtSettings->mMcastGroups > 1) && !isUDP(mExtSettings)) {
+	fprintf(stderr, "WARNING: option --mcast-groups requires UDP (-u) and is ignored\n");
+	mExtSettings->mMcastGroups = 0;
+    }
+    if (isVerify(mExtSettings)) {
+	// UDP verify blocks follow the iperf headers of the datagram
+	int minlen = (isUDP(mExtSettings) ? VERIFY_UDP_OFFSET : 0) + VERIFY_MINLEN;
+	if (mExtSettings->mBufLen < minlen) {
+	    fprintf(stderr, "WARNING: option --verify requires a -l of at least %d and is ignored\n", minlen);
+	    unsetVerify(mExtSettings);
+	} else if (isFileInput(mExtSettings) || isSTDIN(mExtSettings) || isL2LengthCheck(mExtSettings)) {
+	    fprintf(stderr, "WARNING: option --verify is not supported with -F, -I or --l2checks and is ignored\n");
+	    unsetVerify(mExtSettings);
+	}
+    }
+    if (mExtSettings->mWriteSizes) {
+	size_pdf pdf;
+	if (isUDP(mExtSettings) || (mExtSettings->mThreadMode != kMode_Client) || isFileInput(mExtSettings) || isSTDIN(mExtSettings)) {
+	    fprintf(stderr, "WARNING: option --write-sizes requires a TCP client without -F or -I and is ignored\n");
+	    DELETE_ARRAY(mExtSettings->mWriteSizes);
+	} else if (size_pdf_parse(&pdf, mExtSettings->mWriteSizes) != 0) {
+	    fprintf(stderr, "WARNING: --write-sizes %s is not fixed:<sizes>, uniform:<min>,<max>, lognormal:<mean>,<stdev> or cdf:<file> and is ignored\n", mExtSettings->mWriteSizes);
+	    DELETE_ARRAY(mExtSettings->mWriteSizes);
+	} else {
+	    // -l becomes the largest write, it also caps lognormal draws
+	    if (pdf.maxsize > mExtSettings->mBufLen)
+		mExtSettings->mBufLen = pdf.maxsize;
+	    size_pdf_free(&pdf);
+	}
+    }
+    if (isTcpFraming(mExtSettings)) {
+	// verify blocks replace the write headers
+	if (isUDP(mExtSettings) || isVerify(mExtSettings)) {
+	    fprintf(stderr, "WARNING: option --tcp-framing requires TCP without --verify and is ignored\n");
+	    unsetTcpFraming(mExtSettings);
+	}
+    }
+    if (isIntendedTime(mExtSettings)) {
+	// the frame engines only rewrite the datagram header per frame
+	if (!isUDP(mExtSettings) || (mExtSettings->mThreadMode != kMode_Client) || isCompat(mExtSettings) || \
+	    mExtSettings->mTxRing || isXdp(mExtSettings) || \
+	    (mExtSettings->mBufLen < (int) (UDP_INTENDED_OFFSET + sizeof(UDP_intended_payload)))) {
+	    fprintf(stderr, "WARNING: option --intended-time requires a UDP client without -C, --tx-ring or --xdp and -l of at least %d and is ignored\n", \
+		    (int) (UDP_INTENDED_OFFSET + sizeof(UDP_intended_payload)));
+	    unsetIntendedTime(mExtSettings);
+	}
+    }
+    if (isFullReport(mExtSettings)) {
+	// the request rides the extended header, which the UDP test
+	// flags of --isochronous, --l2checks and --intended-time share
+	if ((mExtSettings->mThreadMode != kMode_Client) || isCompat(mExtSettings) || isMulticast(mExtSettings) || \
+	    (mExtSettings->mMode != kTest_Normal) || isReverse(mExtSettings) || isBidir(mExtSettings) || \
+	    (isUDP(mExtSettings) && (isIsochronous(mExtSettings) || isL2LengthCheck(mExtSettings) || isIntendedTime(mExtSettings)))) {
+	    fprintf(stderr, "WARNING: option --full-report requires a unicast client without -C, -d, -r, -R, --bidir, --isochronous, --l2checks or --intended-time and is ignored\n");
+	    unsetFullReport(mExtSettings);
+	}
+    }
+    // Aggregation group settings, format is a comma separated list
+    // of levels, e.g. --sum-groups all,src,dst,tos,port:100
+    if (mExtSettings->mSumGroupsStr) {
+	char *tmp = new char [strlen(mExtSettings->mSumGroupsStr) + 1];
+	strcpy(tmp, mExtSettings->mSumGroupsStr);
+	mExtSettings->mAggrLevels = 0;
+	mExtSettings->mAggrPortWidth = 1;
+	for (results = strtok(tmp, ","); results != NULL; results = strtok(NULL, ",")) {
+	    if (!strcmp(results, "all")) {
+		mExtSettings->mAggrLevels |= AGGR_ALL;
+	    } else if (!strcmp(results, "src") || !strcmp(results, "host")) {
+		mExtSettings->mAggrLevels |= AGGR_SRC;
+	    } else if (!strcmp(results, "dst")) {
+		mExtSettings->mAggrLevels |= AGGR_DST;
+	    } else if (!strcmp(results, "tos")) {
+		mExtSettings->mAggrLevels |= AGGR_TOS;
+	    } else if (!strncmp(results, "port", 4)) {
+		mExtSettings->mAggrLevels |= AGGR_PORT;
+		if ((results[4] == ':') && (atoi(&results[5]) > 0))
+		    mExtSettings->mAggrPortWidth = atoi(&results[5]);
+	    } else {
+		fprintf(stderr, "WARNING: unknown --sum-groups level '%s' ignored, valid levels are all,src,dst,tos,port[:<width>]\n", results);
+	    }
+	}
+	delete [] tmp;
+	if (!isMultipleReport(mExtSettings)) {
+	    fprintf(stderr, "WARNING: option --sum-groups ignored as SUM reports are excluded (-x m)\n");
+	    mExtSettings->mAggrLevels = 0;
+	}
+    }
+    // Interval report policy settings, a comma separated list, e.g.
+    // --report-policy top:10,bottom:5,by:loss,changes:20,anomalies
+    if (mExtSettings->mReportPolicyStr) {
+	char *tmp = new char [strlen(mExtSettings->mReportPolicyStr) + 1];
+	strcpy(tmp, mExtSettings->mReportPolicyStr);
+	mExtSettings->mReportPolicy = 0;
+	for (results = strtok(tmp, ","); results != NULL; results = strtok(NULL, ",")) {
+	    if (!strncmp(results, "top:", 4) && (atoi(&results[4]) > 0)) {
+		mExtSettings->mReportPolicy |= RPOLICY_TOPN;
+		mExtSettings->mPolicyTopN = atoi(&results[4]);
+	    } else if (!strncmp(results, "bottom:", 7) && (atoi(&results[7]) > 0)) {
+		mExtSettings->mReportPolicy |= RPOLICY_BOTTOMN;
+		mExtSettings->mPolicyBottomN = atoi(&results[7]);
+	    } else if (!strcmp(results, "by:loss")) {
+		mExtSettings->mReportPolicy |= RPOLICY_BYLOSS;
+	    } else if (!strcmp(results, "by:bw")) {
+		mExtSettings->mReportPolicy &= ~RPOLICY_BYLOSS;
+	    } else if (!strncmp(results, "changes:", 8) && (atof(&results[8]) > 0)) {
+		mExtSettings->mReportPolicy |= RPOLICY_CHANGES;
+		mExtSettings->mPolicyChangePct = atof(&results[8]);
+	    } else if (!strcmp(results, "anomalies")) {
+		mExtSettings->mReportPolicy |= RPOLICY_ANOMALIES;
+	    } else if (!strcmp(results, "sum")) {
+		mExtSettings->mReportPolicy |= RPOLICY_SUMONLY;
+	    } else {
+		fprintf(stderr, "WARNING: unknown --report-policy '%s' ignored, valid policies are sum,top:<n>,bottom:<n>,by:bw|loss,changes:<pct>,anomalies\n", results);
+	    }
+	}
+	delete [] tmp;
+	if (mExtSettings->mReportPolicy == RPOLICY_BYLOSS)
+	    mExtSettings->mReportPolicy = 0;
+	if (mExtSettings->mReportPolicy)
+	    mExtSettings->mReportPolicy |= RPOLICY_SUMONLY;
+    }
     // L2 settings
     if (l2checks && isUDP(mExtSettings)) {
 	l2checks = 0;
@@ -1093,6 +1470,48 @@ void Settings_ModalOptions( thread_Settings *mExtSettings ) {
 	}
     }
 #endif
+    if (mExtSettings->mSchedPeriod) {
+#ifdef HAVE_SCHED_DEADLINE
+	// a deadline task can't start threads, and only senders have a period
+	if (!isUDP(mExtSettings) || (mExtSettings->mThreadMode != kMode_Client) || (mExtSettings->mMode != kTest_Normal) || \
+	    isReverse(mExtSettings) || isBidir(mExtSettings) || mExtSettings->mTxRing || isXdp(mExtSettings)) {
+	    fprintf(stderr, "WARNING: option --sched-deadline requires a UDP client without -d, -r, -R, --bidir, --tx-ring or --xdp and is ignored\n");
+	    mExtSettings->mSchedPeriod = 0;
+	} else {
+	    double period, pkts;
+#ifdef HAVE_ISOCHRONOUS
+	    if (isIsochronous(mExtSettings)) {
+		// a burst per frame
+		period = 1e6 / mExtSettings->mFPS;
+		pkts = ceil((mExtSettings->mMean / (mExtSettings->mFPS * 8)) / mExtSettings->mBufLen);
+	    } else
+#endif
+	    {
+		// the datagrams written each period at the -b rate
+		double ipg = (mExtSettings->mUDPRateUnits == kRate_BW) ? \
+		    ((mExtSettings->mBufLen * 8e6) / mExtSettings->mUDPRate) : (1e6 / mExtSettings->mUDPRate);
+		period = (ipg > SCHED_DL_MINPERIOD) ? ipg : SCHED_DL_MINPERIOD;
+		pkts = ceil(period / ipg);
+	    }
+	    if (pkts < 1)
+		pkts = 1;
+	    mExtSettings->mSchedPeriod = (int) period;
+	    mExtSettings->mSchedDeadline = mExtSettings->mSchedPeriod;
+	    // a write per datagram and one timer wake up per period
+	    if (!mExtSettings->mSchedRuntime)
+		mExtSettings->mSchedRuntime = (int) ((pkts * SCHED_DL_PKTCOST) + SCHED_DL_WAKECOST);
+	    if (mExtSettings->mSchedRuntime > (int) (period * SCHED_DL_MAXUTIL))
+		mExtSettings->mSchedRuntime = (int) (period * SCHED_DL_MAXUTIL);
+	    if (isRealtime(mExtSettings)) {
+		fprintf(stderr, "WARNING: option -z is ignored with --sched-deadline\n");
+		unsetRealtime(mExtSettings);
+	    }
+	}
+#else
+	fprintf(stderr, "WARNING: option --sched-deadline is not supported on this platform and is ignored\n");
+	mExtSettings->mSchedPeriod = 0;
+#endif
+    }
     // Check for further mLocalhost (-B) and <dev> requests
     // full addresses look like 192.168.1.1:6001%eth0 or [2001:e30:1401:2:d46e:b891:3082:b939]:6001%eth0
     iperf_sockaddr tmp;
@@ -1318,6 +1737,8 @@ void Settings_GenerateClientSettings( thread_Settings *server,
         (*client)->mMode       = ((flags & RUN_NOW) == 0 ?
 				  kTest_TradeOff : kTest_DualTest);
         (*client)->mThreadMode = kMode_Client;
+	// the server's --xdp only receives
+	unsetXdp((*client));
 	if ((flags & HEADER_EXTEND) != 0 ) {
 	    if ( !isBWSet(server) ) {
 		(*client)->mUDPRate = ntohl(hdr->extend.mRate);
@@ -1394,7 +1815,7 @@ int Settings_GenerateClientHdr( thread_Settings *client, client_hdr *hdr ) {
 	 */
 	hdr->udp.tlvoffset = htons((sizeof(client_hdr_udp_tests) + sizeof(client_hdr_v1) + sizeof(UDP_datagram)));
 
-	if (isL2LengthCheck(client) || isIsochronous(client)) {
+	if (isL2LengthCheck(client) || isIsochronous(client) || isIntendedTime(client)) {
 	    flags |= HEADER_UDPTESTS;
 	    uint16_t testflags = 0;
 
@@ -1407,6 +1828,10 @@ int Settings_GenerateClientHdr( thread_Settings *client, client_hdr *hdr ) {
 		hdr->udp.tlvoffset = htons((sizeof(UDP_isoch_payload) + sizeof(client_hdr_udp_tests) + sizeof(client_hdr_v1) + sizeof(UDP_datagram)));
 		testflags |= HEADER_UDP_ISOCH;
 	    }
+	    if (isIntendedTime(client)) {
+		hdr->udp.tlvoffset = htons(UDP_INTENDED_OFFSET + sizeof(UDP_intended_payload));
+		testflags |= HEADER_UDP_INTENDED;
+	    }
 	    // Write flags to header so the listener can determine the tests requested
 	    hdr->udp.testflags = htons(testflags);
 	    hdr->udp.version_u = htonl(IPERF_VERSION_MAJORHEX);
@@ -1424,6 +1849,10 @@ int Settings_GenerateClientHdr( thread_Settings *client, client_hdr *hdr ) {
 	flags |= HEADER_EXTEND;
         extendflags |= BIDIR;
     }
+    if (isFullReport(client)) {
+	flags |= HEADER_EXTEND;
+	extendflags |= FULLREPORT;
+    }
     hdr->base.flags = htonl(flags);
     if (flags & HEADER_EXTEND) {
 	if (isBWSet(client)) {
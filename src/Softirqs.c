@@ -0,0 +1,306 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * Softirqs.c
+ * Softirq and interrupt accounting (--softirqs)
+ *
+ * Network receive often saturates the softirq processing of a single
+ * CPU well before the traffic threads run out of CPU.  The NET_RX and
+ * NET_TX softirq counts and the test interfaces' interrupt counts are
+ * sampled per CPU, the reports list the busiest CPUs next to the CPU
+ * the flow's traffic thread last ran on.  The /proc files stay open,
+ * each sample is a pread() from offset zero.
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "Settings.hpp"
+#include "Softirqs.h"
+#include "util.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct SoftirqCounts {
+    uintmax_t *net_rx;
+    uintmax_t *net_tx;
+    uintmax_t *irqs;
+} SoftirqCounts;
+
+static struct {
+    int softirqfd;
+    int irqfd;
+    char *buf;
+    size_t buflen;
+    int ncpu;			// columns of the /proc files
+    int *cpuid;			// CPU number per column
+    char **ifaces;
+    int nifaces;
+    double lastsample;
+    SoftirqCounts base, prev, cur, final;
+} sirq = { .softirqfd = -1, .irqfd = -1 };
+
+#ifndef WIN32
+static double softirqs_now (void) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec + (now.tv_usec / 1e6);
+}
+
+/*
+ * Read a whole /proc file into sirq.buf, growing the buffer until the
+ * file fits
+ */
+static char *softirqs_read (int fd) {
+    ssize_t len;
+    while (1) {
+	len = pread(fd, sirq.buf, sirq.buflen - 1, 0);
+	if (len < 0) {
+	    return NULL;
+	} else if ((size_t) len < (sirq.buflen - 1)) {
+	    break;
+	}
+	sirq.buflen *= 2;
+	sirq.buf = (char *) realloc(sirq.buf, sirq.buflen);
+	FAIL_errno(sirq.buf == NULL, "No memory for softirqs", NULL);
+    }
+    sirq.buf[len] = '\0';
+    return sirq.buf;
+}
+
+/*
+ * Parse the "CPU0 CPU1 ..." header, the columns skip offline CPUs
+ */
+static int softirqs_columns (const char *line) {
+    int ncpu = 0, cpu;
+    const char *p = line;
+    while ((p = strstr(p, "CPU")) != NULL) {
+	p += 3;
+	if (sscanf(p, "%d", &cpu) == 1) {
+	    if (sirq.cpuid)
+		sirq.cpuid[ncpu] = cpu;
+	    ncpu++;
+	}
+	if (*p == '\n')
+	    break;
+    }
+    return ncpu;
+}
+
+/*
+ * Parse up to ncpu counts, added into the counts when add is set,
+ * only skipped when into is NULL.  Returns where the counts end.
+ */
+static char *softirqs_counts (char *p, uintmax_t *into, int add) {
+    int col;
+    char *end;
+    for (col = 0; col < sirq.ncpu; col++) {
+	uintmax_t value = strtoumax(p, &end, 10);
+	if (end == p)
+	    break;
+	if (into != NULL)
+	    into[col] = add ? (into[col] + value) : value;
+	p = end;
+    }
+    return p;
+}
+
+static void softirqs_sample (SoftirqCounts *into) {
+    char *text, *line, *next;
+    if ((text = softirqs_read(sirq.softirqfd)) != NULL) {
+	for (line = strchr(text, '\n'); line != NULL; line = next) {
+	    char *name;
+	    if ((next = strchr(++line, '\n')) != NULL)
+		*next = '\0';
+	    name = line + strspn(line, " ");
+	    if (strncmp(name, "NET_RX:", 7) == 0) {
+		softirqs_counts(name + 7, into->net_rx, 0);
+	    } else if (strncmp(name, "NET_TX:", 7) == 0) {
+		softirqs_counts(name + 7, into->net_tx, 0);
+	    }
+	}
+    }
+    memset(into->irqs, 0, sizeof(uintmax_t) * sirq.ncpu);
+    if ((sirq.irqfd >= 0) && ((text = softirqs_read(sirq.irqfd)) != NULL)) {
+	for (line = strchr(text, '\n'); line != NULL; line = next) {
+	    char *counts, *action;
+	    int ix;
+	    if ((next = strchr(++line, '\n')) != NULL)
+		*next = '\0';
+	    if ((counts = strchr(line, ':')) == NULL)
+		continue;
+	    // the interface name is part of the action, after the counts
+	    action = softirqs_counts(++counts, NULL, 0);
+	    for (ix = 0; ix < sirq.nifaces; ix++) {
+		if (strstr(action, sirq.ifaces[ix]) != NULL) {
+		    softirqs_counts(counts, into->irqs, 1);
+		    break;
+		}
+	    }
+	}
+    }
+}
+#endif
+
+/*
+ * Open the /proc files and take the baseline sample.  The interfaces
+ * are the --softirqs list, else the -B or -c bound device; without
+ * any only the softirqs are counted.
+ */
+void softirqs_open (thread_Settings *mSettings) {
+#ifndef WIN32
+    const char *ifaces = mSettings->mSoftirqIfaces;
+    char *header, *end;
+    SoftirqCounts *counts[4] = { &sirq.base, &sirq.prev, &sirq.cur, &sirq.final };
+    int ix;
+
+    if ((sirq.softirqfd = open("/proc/softirqs", O_RDONLY)) < 0) {
+	WARN_errno(1, "/proc/softirqs");
+	return;
+    }
+    sirq.buflen = 4096;
+    sirq.buf = (char *) malloc(sirq.buflen);
+    FAIL_errno(sirq.buf == NULL, "No memory for softirqs", mSettings);
+    if ((header = softirqs_read(sirq.softirqfd)) == NULL) {
+	WARN_errno(1, "/proc/softirqs");
+	goto fail;
+    }
+    if ((end = strchr(header, '\n')) != NULL)
+	*end = '\0';
+    if ((sirq.ncpu = softirqs_columns(header)) <= 0)
+	goto fail;
+    sirq.cpuid = (int *) malloc(sizeof(int) * sirq.ncpu);
+    FAIL_errno(sirq.cpuid == NULL, "No memory for softirqs", mSettings);
+    softirqs_columns(header);
+    for (ix = 0; ix < 4; ix++) {
+	uintmax_t *block = (uintmax_t *) calloc(3 * sirq.ncpu, sizeof(uintmax_t));
+	FAIL_errno(block == NULL, "No memory for softirqs", mSettings);
+	counts[ix]->net_rx = block;
+	counts[ix]->net_tx = block + sirq.ncpu;
+	counts[ix]->irqs = block + (2 * sirq.ncpu);
+    }
+
+    if (ifaces == NULL)
+	ifaces = (mSettings->mIfrname ? mSettings->mIfrname : mSettings->mIfrnametx);
+    if (ifaces != NULL) {
+	char *list = strdup(ifaces), *tok, *save = NULL;
+	FAIL_errno(list == NULL, "No memory for softirqs", mSettings);
+	for (tok = strtok_r(list, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+	    sirq.ifaces = (char **) realloc(sirq.ifaces, sizeof(char *) * (sirq.nifaces + 1));
+	    FAIL_errno(sirq.ifaces == NULL, "No memory for softirqs", mSettings);
+	    sirq.ifaces[sirq.nifaces++] = tok;
+	}
+	if ((sirq.nifaces > 0) && ((sirq.irqfd = open("/proc/interrupts", O_RDONLY)) < 0)) {
+	    WARN_errno(1, "/proc/interrupts");
+	}
+    }
+    softirqs_sample(&sirq.base);
+    memcpy(sirq.cur.net_rx, sirq.base.net_rx, sizeof(uintmax_t) * 3 * sirq.ncpu);
+    sirq.lastsample = softirqs_now();
+    return;
+
+  fail:
+    close(sirq.softirqfd);
+    sirq.softirqfd = -1;
+#endif
+}
+
+/*
+ * Fill in the report for an interval, or the whole test when final
+ * is set, returns 0 when there's nothing to report.  Flows report
+ * their intervals at different times, a new sample is only taken
+ * once at least half the interval has passed since the last one.
+ */
+int softirqs_report (SoftirqReport *report, double interval, int cpu, int final) {
+#ifndef WIN32
+    SoftirqCounts *from, *to;
+    int col, ix;
+    if (sirq.softirqfd < 0)
+	return 0;
+    if (final) {
+	softirqs_sample(&sirq.final);
+	from = &sirq.base;
+	to = &sirq.final;
+    } else {
+	double now = softirqs_now();
+	if ((now - sirq.lastsample) >= (interval / 2)) {
+	    memcpy(sirq.prev.net_rx, sirq.cur.net_rx, sizeof(uintmax_t) * 3 * sirq.ncpu);
+	    softirqs_sample(&sirq.cur);
+	    sirq.lastsample = now;
+	}
+	from = &sirq.prev;
+	to = &sirq.cur;
+    }
+    report->nhot = 0;
+    report->flow.cpu = -1;
+    for (col = 0; col < sirq.ncpu; col++) {
+	SoftirqCpu delta;
+	delta.cpu = sirq.cpuid[col];
+	delta.net_rx = to->net_rx[col] - from->net_rx[col];
+	delta.net_tx = to->net_tx[col] - from->net_tx[col];
+	delta.irqs = to->irqs[col] - from->irqs[col];
+	if (delta.cpu == cpu)
+	    report->flow = delta;
+	if ((delta.net_rx + delta.net_tx) == 0)
+	    continue;
+	// insertion into the hottest, largest first
+	for (ix = report->nhot; ix > 0; ix--) {
+	    SoftirqCpu *hot = &report->hot[ix - 1];
+	    if ((hot->net_rx + hot->net_tx) >= (delta.net_rx + delta.net_tx))
+		break;
+	    if (ix < SOFTIRQS_HOTTEST)
+		report->hot[ix] = *hot;
+	}
+	if (ix < SOFTIRQS_HOTTEST) {
+	    report->hot[ix] = delta;
+	    if (report->nhot < SOFTIRQS_HOTTEST)
+		report->nhot++;
+	}
+    }
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
@@ -0,0 +1,269 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * batch.c
+ * Batch statistics for the reporter's UDP server accounting, see
+ * batch.h
+ *
+ * Both kernels keep 4 lanes, lane n takes the elements n mod 4 of the
+ * slice up to its last multiple of 4, the lanes are summed pairwise
+ * and the rest of the slice added in order, so they round alike.
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "batch.h"
+#include <math.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+#define LANES 4
+
+static double batch_jitterpow[BATCH_MAX + 1];	// (15/16)^n
+static void (*batch_fn)(PacketBatch *, BatchStats *) = batch_stats_sw;
+static const char *batch_name = "c";
+
+static inline double lanesum (const double *lane) {
+    return (lane[0] + lane[1]) + (lane[2] + lane[3]);
+}
+
+/*
+ * The per slice results once the lanes are reduced, shared by the
+ * kernels.  d0 is the first datagram's transit difference against
+ * the datagram before the slice, sj the weighted sum of the rest.
+ */
+static void batch_finish (PacketBatch *batch, BatchStats *stats, double mean, double sm2, double d0, double sj) {
+    int n = batch->cnt;
+    stats->meanUsecs = mean;
+    stats->m2Usecs = sm2;
+    stats->jitter = (batch_jitterpow[n] * stats->jitter) + ((batch_jitterpow[n - 1] * d0) + sj) / 16.0;
+    stats->lastTransit = batch->transit[n - 1];
+}
+
+void batch_stats_sw (PacketBatch *batch, BatchStats *stats) {
+    int n = batch->cnt, n4 = n & ~(LANES - 1), m = n - 1, m4 = m & ~(LANES - 1), ix, lane;
+    double sumt[LANES], sumu[LANES], mint[LANES], maxt[LANES], m2[LANES], jit[LANES];
+    double *t = batch->transit, mean, d;
+
+    stats->bytes = 0;
+    stats->inorder = 1;
+    for (ix = 0; ix < n; ix++) {
+	t[ix] = (batch->rxsec[ix] - batch->txsec[ix]) + (batch->rxusec[ix] - batch->txusec[ix]) / 1e6;
+	stats->bytes += batch->len[ix];
+	if (ix && (batch->id[ix] != batch->id[ix - 1] + 1))
+	    stats->inorder = 0;
+    }
+    for (lane = 0; lane < LANES; lane++) {
+	sumt[lane] = sumu[lane] = m2[lane] = jit[lane] = 0;
+	mint[lane] = HUGE_VAL;
+	maxt[lane] = -HUGE_VAL;
+    }
+    for (ix = 0; ix < n4; ix++) {
+	lane = ix & (LANES - 1);
+	sumt[lane] += t[ix];
+	sumu[lane] += t[ix] * 1e6;
+	if (t[ix] < mint[lane])
+	    mint[lane] = t[ix];
+	if (t[ix] > maxt[lane])
+	    maxt[lane] = t[ix];
+    }
+    stats->sumTransit = lanesum(sumt);
+    mean = lanesum(sumu);
+    stats->minTransit = fmin(fmin(mint[0], mint[1]), fmin(mint[2], mint[3]));
+    stats->maxTransit = fmax(fmax(maxt[0], maxt[1]), fmax(maxt[2], maxt[3]));
+    for (ix = n4; ix < n; ix++) {
+	stats->sumTransit += t[ix];
+	mean += t[ix] * 1e6;
+	if (t[ix] < stats->minTransit)
+	    stats->minTransit = t[ix];
+	if (t[ix] > stats->maxTransit)
+	    stats->maxTransit = t[ix];
+    }
+    mean /= n;
+    for (ix = 0; ix < n4; ix++) {
+	d = t[ix] * 1e6 - mean;
+	m2[ix & (LANES - 1)] += d * d;
+    }
+    for (ix = 0; ix < m4; ix++) {
+	jit[ix & (LANES - 1)] += batch_jitterpow[m - 1 - ix] * fabs(t[ix + 1] - t[ix]);
+    }
+    {
+	double sm2 = lanesum(m2), sj = lanesum(jit);
+	for (ix = n4; ix < n; ix++) {
+	    d = t[ix] * 1e6 - mean;
+	    sm2 += d * d;
+	}
+	for (ix = m4; ix < m; ix++) {
+	    sj += batch_jitterpow[m - 1 - ix] * fabs(t[ix + 1] - t[ix]);
+	}
+	batch_finish(batch, stats, mean, sm2, fabs(t[0] - stats->lastTransit), sj);
+    }
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("avx2")))
+static void batch_stats_avx2 (PacketBatch *batch, BatchStats *stats) {
+    int n = batch->cnt, n4 = n & ~(LANES - 1), m = n - 1, m4 = m & ~(LANES - 1), ix;
+    const __m256d million = _mm256_set1_pd(1e6), sign = _mm256_set1_pd(-0.0);
+    const __m256i one = _mm256_set1_epi64x(1);
+    __m256d sumt = _mm256_setzero_pd(), sumu = _mm256_setzero_pd(), m2 = _mm256_setzero_pd();
+    __m256d jit = _mm256_setzero_pd(), mean4;
+    __m256d mint = _mm256_set1_pd(HUGE_VAL), maxt = _mm256_set1_pd(-HUGE_VAL);
+    __m256i bytes = _mm256_setzero_si256();
+    double *t = batch->transit, lane[LANES], mean, d;
+    int64_t blane[LANES];
+    int mismatch = 0;
+
+    for (ix = 0; ix < n4; ix += LANES) {
+	__m256d sd = _mm256_sub_pd(_mm256_loadu_pd(&batch->rxsec[ix]), _mm256_loadu_pd(&batch->txsec[ix]));
+	__m256d ud = _mm256_sub_pd(_mm256_loadu_pd(&batch->rxusec[ix]), _mm256_loadu_pd(&batch->txusec[ix]));
+	__m256d tr = _mm256_add_pd(sd, _mm256_div_pd(ud, million));
+	_mm256_storeu_pd(&t[ix], tr);
+	sumt = _mm256_add_pd(sumt, tr);
+	sumu = _mm256_add_pd(sumu, _mm256_mul_pd(tr, million));
+	mint = _mm256_min_pd(mint, tr);
+	maxt = _mm256_max_pd(maxt, tr);
+	bytes = _mm256_add_epi64(bytes, _mm256_loadu_si256((const __m256i *) &batch->len[ix]));
+    }
+    for (ix = 0; ix < m4; ix += LANES) {
+	__m256i next = _mm256_loadu_si256((const __m256i *) &batch->id[ix + 1]);
+	__m256i prev = _mm256_add_epi64(_mm256_loadu_si256((const __m256i *) &batch->id[ix]), one);
+	mismatch |= (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(next, prev))) != 0xF);
+    }
+    _mm256_storeu_si256((__m256i *) blane, bytes);
+    stats->bytes = (blane[0] + blane[1]) + (blane[2] + blane[3]);
+    stats->inorder = !mismatch;
+    _mm256_storeu_pd(lane, sumt);
+    stats->sumTransit = lanesum(lane);
+    _mm256_storeu_pd(lane, sumu);
+    mean = lanesum(lane);
+    _mm256_storeu_pd(lane, mint);
+    stats->minTransit = fmin(fmin(lane[0], lane[1]), fmin(lane[2], lane[3]));
+    _mm256_storeu_pd(lane, maxt);
+    stats->maxTransit = fmax(fmax(lane[0], lane[1]), fmax(lane[2], lane[3]));
+    for (ix = n4; ix < n; ix++) {
+	t[ix] = (batch->rxsec[ix] - batch->txsec[ix]) + (batch->rxusec[ix] - batch->txusec[ix]) / 1e6;
+	stats->bytes += batch->len[ix];
+	stats->sumTransit += t[ix];
+	mean += t[ix] * 1e6;
+	if (t[ix] < stats->minTransit)
+	    stats->minTransit = t[ix];
+	if (t[ix] > stats->maxTransit)
+	    stats->maxTransit = t[ix];
+    }
+    for (ix = m4; ix < m; ix++) {
+	if (batch->id[ix + 1] != batch->id[ix] + 1)
+	    stats->inorder = 0;
+    }
+    mean /= n;
+    mean4 = _mm256_set1_pd(mean);
+    for (ix = 0; ix < n4; ix += LANES) {
+	__m256d dv = _mm256_sub_pd(_mm256_mul_pd(_mm256_loadu_pd(&t[ix]), million), mean4);
+	m2 = _mm256_add_pd(m2, _mm256_mul_pd(dv, dv));
+    }
+    // weights (15/16)^(m-1-ix) for the lanes, i.e. the table reversed
+    for (ix = 0; ix < m4; ix += LANES) {
+	__m256d dv = _mm256_andnot_pd(sign, _mm256_sub_pd(_mm256_loadu_pd(&t[ix + 1]), _mm256_loadu_pd(&t[ix])));
+	__m256d w = _mm256_permute4x64_pd(_mm256_loadu_pd(&batch_jitterpow[m - LANES - ix]), 0x1B);
+	jit = _mm256_add_pd(jit, _mm256_mul_pd(w, dv));
+    }
+    {
+	double sm2, sj;
+	_mm256_storeu_pd(lane, m2);
+	sm2 = lanesum(lane);
+	_mm256_storeu_pd(lane, jit);
+	sj = lanesum(lane);
+	for (ix = n4; ix < n; ix++) {
+	    d = t[ix] * 1e6 - mean;
+	    sm2 += d * d;
+	}
+	for (ix = m4; ix < m; ix++) {
+	    sj += batch_jitterpow[m - 1 - ix] * fabs(t[ix + 1] - t[ix]);
+	}
+	batch_finish(batch, stats, mean, sm2, fabs(t[0] - stats->lastTransit), sj);
+    }
+}
+#endif
+
+/*
+ * Build the jitter weights and pick the kernel, call before the
+ * reporter runs
+ */
+void batch_init (void) {
+    int ix;
+    batch_jitterpow[0] = 1.0;
+    for (ix = 1; ix <= BATCH_MAX; ix++)
+	batch_jitterpow[ix] = batch_jitterpow[ix - 1] * (15.0 / 16.0);
+    batch_fn = batch_stats_sw;
+#if defined(__x86_64__) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+	batch_fn = batch_stats_avx2;
+	batch_name = "avx2";
+    }
+#endif
+}
+
+const char *batch_impl (void) {
+    return batch_name;
+}
+
+/*
+ * Transits and statistics of a slice of at least one datagram, set
+ * stats->jitter and stats->lastTransit to carry on from before calling
+ */
+void batch_stats (PacketBatch *batch, BatchStats *stats) {
+    (*batch_fn)(batch, stats);
+}
+
+/*
+ * Merge a slice's transit moments (usecs) into a running Welford mean
+ * and M2 over cnt datagrams, and set vd as the per packet path would,
+ * the last datagram's deviation from the mean before it
+ */
+void batch_merge (double *mean, double *m2, double *vd, int cnt, int n, BatchStats *stats) {
+    int total = cnt + n;
+    double delta = stats->meanUsecs - *mean;
+    double last = stats->lastTransit * 1e6;
+    *mean += delta * n / total;
+    *m2 += stats->m2Usecs + (delta * delta * cnt * n / total);
+    *vd = ((total > 1) ? last - ((*mean * total - last) / (total - 1)) : last);
+}
@@ -0,0 +1,360 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * checkbatch.c
+ * The reporter's batch UDP statistics against its per packet path:
+ * a synthetic flow with loss, reordering and latency spikes is
+ * accounted both ways, with interval resets, and must agree, the
+ * transits, min/max and bytes exactly and the sums, moments and
+ * jitter to a relative 1e-9.  The kernels must agree bit for bit.
+ * Then the cost of each per datagram.
+ *
+ * Usage: checkbatch [-n datagrams] [-b batch size] [-i interval datagrams]
+ * ------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include "headers.h"
+#include "batch.h"
+
+#define TOLERANCE 1e-9
+
+// the reporter's UDP server transit state, see reporter_handle_packet
+typedef struct Flow {
+    intmax_t bytes;
+    int cnt;
+    double sum;
+    double min;
+    double max;
+    double mean;
+    double m2;
+    double vd;
+    double jitter;
+    double lastTransit;
+} Flow;
+
+typedef struct Datagram {
+    intmax_t id;
+    intmax_t len;
+    struct timeval sent;
+    struct timeval rcvd;
+} Datagram;
+
+static uint64_t rng = 88172645463325252ULL;
+static double maxerr = 0;
+
+static double uniform (void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (rng >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double now (void) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return t1.tv_sec + (t1.tv_nsec / 1e9);
+}
+
+static void timeval_add (struct timeval *tv, double secs) {
+    long usecs = tv->tv_usec + (long) (secs * 1e6);
+    tv->tv_sec += usecs / 1000000;
+    tv->tv_usec = usecs % 1000000;
+}
+
+/*
+ * 10 usecs apart, 200 usecs of latency plus exponential noise, a
+ * 5 msec spike per 10000, a lost datagram per 1000 and a swapped
+ * pair per 2000
+ */
+static void generate (Datagram *d, int cnt) {
+    struct timeval sent = {1600000000, 999000};
+    intmax_t id = 1;
+    int ix;
+    for (ix = 0; ix < cnt; ix++) {
+	if (uniform() < 0.001)
+	    id++;
+	d[ix].id = id++;
+	d[ix].len = 1470 - (int) (uniform() * 64);
+	d[ix].sent = sent;
+	d[ix].rcvd = sent;
+	timeval_add(&d[ix].rcvd, 200e-6 - (log(1.0 - uniform()) * 20e-6) + ((uniform() < 0.0001) ? 5e-3 : 0));
+	timeval_add(&sent, 10e-6 + uniform() * 2e-6);
+    }
+    for (ix = 1; ix < cnt; ix++) {
+	if (uniform() < 0.0005) {
+	    intmax_t tmp = d[ix].id;
+	    d[ix].id = d[ix - 1].id;
+	    d[ix - 1].id = tmp;
+	}
+    }
+}
+
+// the first datagram of the flow, as reporter_handle_packet
+static void flow_first (Flow *f, Datagram *d) {
+    double transit = (d->rcvd.tv_sec - d->sent.tv_sec) + (d->rcvd.tv_usec - d->sent.tv_usec) / 1e6;
+    double usecs = transit * 1e6;
+    memset(f, 0, sizeof(Flow));
+    f->bytes = d->len;
+    f->cnt = 1;
+    f->sum = f->min = f->max = transit;
+    f->mean = f->vd = usecs;
+    f->m2 = usecs * usecs;
+    f->lastTransit = transit;
+}
+
+// an interval report, as reporter_resetstats
+static void flow_reset (Flow *f) {
+    f->min = f->max = f->sum = f->lastTransit;
+    f->cnt = 0;
+    f->vd = f->mean = f->m2 = 0;
+}
+
+// the per packet path
+static void flow_packet (Flow *f, Datagram *d) {
+    double transit = (d->rcvd.tv_sec - d->sent.tv_sec) + (d->rcvd.tv_usec - d->sent.tv_usec) / 1e6;
+    double delta = transit - f->lastTransit, usecs;
+    if (delta < 0.0)
+	delta = -delta;
+    f->jitter += (delta - f->jitter) / (16.0);
+    f->sum += transit;
+    f->cnt++;
+    if (transit < f->min)
+	f->min = transit;
+    if (transit > f->max)
+	f->max = transit;
+    usecs = transit * 1e6;
+    f->vd = usecs - f->mean;
+    f->mean = f->mean + (f->vd / f->cnt);
+    f->m2 = f->m2 + (f->vd * (usecs - f->mean));
+    f->lastTransit = transit;
+    f->bytes += d->len;
+}
+
+static void gather (PacketBatch *batch, Datagram *d, int cnt) {
+    int ix;
+    for (ix = 0; ix < cnt; ix++) {
+	batch->id[ix] = d[ix].id;
+	batch->len[ix] = d[ix].len;
+	batch->txsec[ix] = d[ix].sent.tv_sec;
+	batch->txusec[ix] = d[ix].sent.tv_usec;
+	batch->rxsec[ix] = d[ix].rcvd.tv_sec;
+	batch->rxusec[ix] = d[ix].rcvd.tv_usec;
+    }
+    batch->cnt = cnt;
+}
+
+// the batch path, as the reporter's batch flush
+static void flow_batch (Flow *f, PacketBatch *batch, BatchStats *stats, void (*kernel)(PacketBatch *, BatchStats *)) {
+    stats->jitter = f->jitter;
+    stats->lastTransit = f->lastTransit;
+    (*kernel)(batch, stats);
+    batch_merge(&f->mean, &f->m2, &f->vd, f->cnt, batch->cnt, stats);
+    f->cnt += batch->cnt;
+    f->sum += stats->sumTransit;
+    if (stats->minTransit < f->min)
+	f->min = stats->minTransit;
+    if (stats->maxTransit > f->max)
+	f->max = stats->maxTransit;
+    f->jitter = stats->jitter;
+    f->lastTransit = stats->lastTransit;
+    f->bytes += stats->bytes;
+}
+
+static int close_enough (const char *what, double ref, double val, double scale) {
+    double err = fabs(ref - val) / fmax(fabs(ref), scale);
+    if (err > maxerr)
+	maxerr = err;
+    if (err > TOLERANCE) {
+	fprintf(stderr, "%s %.17g vs per packet %.17g, relative error %.3g\n", what, val, ref, err);
+	return 0;
+    }
+    return 1;
+}
+
+static int compare (Flow *ref, Flow *f, const char *when) {
+    int ok = 1;
+    if ((ref->bytes != f->bytes) || (ref->cnt != f->cnt) || (ref->min != f->min) || (ref->max != f->max)) {
+	fprintf(stderr, "%s: bytes/cnt/min/max differ\n", when);
+	ok = 0;
+    }
+    ok &= close_enough("sum", ref->sum, f->sum, 1e-12);
+    ok &= close_enough("mean", ref->mean, f->mean, 1e-12);
+    ok &= close_enough("m2", ref->m2, f->m2, 1e-12);
+    ok &= close_enough("vd", ref->vd, f->vd, fabs(ref->mean));
+    ok &= close_enough("jitter", ref->jitter, f->jitter, 1e-12);
+    if (ref->lastTransit != f->lastTransit) {
+	fprintf(stderr, "%s: last transit differs\n", when);
+	ok = 0;
+    }
+    if (!ok)
+	fprintf(stderr, "mismatch %s\n", when);
+    return ok;
+}
+
+int main (int argc, char **argv) {
+    int c, cnt = 2000000, batchsize = BATCH_MAX, interval = 100000;
+    int ix, jx, n, inorder, ok = 1;
+    Datagram *d;
+    PacketBatch *batch, *batch_c;
+    BatchStats stats, stats_c;
+    Flow ref, flow;
+    double start, elapsed;
+    char label[32];
+
+    while ((c=getopt(argc, argv, "n:b:i:")) != -1)
+	switch (c) {
+	case 'n':
+	    cnt = atoi(optarg);
+	    break;
+	case 'b':
+	    batchsize = atoi(optarg);
+	    break;
+	case 'i':
+	    interval = atoi(optarg);
+	    break;
+	case '?':
+	    fprintf(stderr,"Usage -n datagrams, -b batch size, -i datagrams per interval\n");
+	    return 1;
+	default:
+	    abort();
+	}
+    if ((cnt < 2) || (batchsize < 1) || (batchsize > BATCH_MAX) || (interval < 1)) {
+	fprintf(stderr, "need at least 2 datagrams, a batch size of 1 to %d and an interval\n", BATCH_MAX);
+	return 1;
+    }
+    d = (Datagram *) malloc(cnt * sizeof(Datagram));
+    batch = (PacketBatch *) malloc(sizeof(PacketBatch));
+    batch_c = (PacketBatch *) malloc(sizeof(PacketBatch));
+    if (!d || !batch || !batch_c) {
+	fprintf(stderr, "no memory\n");
+	return 1;
+    }
+    batch_init();
+    generate(d, cnt);
+    fprintf(stdout, "%d datagrams, batches of up to %d, %d per interval, batch kernel %s\n",
+	    cnt, batchsize, interval, batch_impl());
+
+    // agreement, random batch sizes which never span an interval
+    flow_first(&ref, &d[0]);
+    flow_first(&flow, &d[0]);
+    for (ix = 1; (ix < cnt) && ok; ix += n) {
+	if ((ix % interval) == 0) {
+	    if (!(ok = compare(&ref, &flow, "at an interval")))
+		break;
+	    flow_reset(&ref);
+	    flow_reset(&flow);
+	}
+	n = 1 + (int) (uniform() * batchsize);
+	if (n > cnt - ix)
+	    n = cnt - ix;
+	if (n > interval - (ix % interval))
+	    n = interval - (ix % interval);
+	gather(batch, &d[ix], n);
+	*batch_c = *batch;
+	inorder = 1;
+	for (jx = 0; jx < n; jx++) {
+	    flow_packet(&ref, &d[ix + jx]);
+	    if (jx && (d[ix + jx].id != d[ix + jx - 1].id + 1))
+		inorder = 0;
+	}
+	{
+	    Flow flow_c = flow;
+	    flow_batch(&flow, batch, &stats, batch_stats);
+	    flow_batch(&flow_c, batch_c, &stats_c, batch_stats_sw);
+	    if (memcmp(&flow, &flow_c, sizeof(Flow)) || memcmp(batch->transit, batch_c->transit, n * sizeof(double)) ||
+		(stats.inorder != stats_c.inorder)) {
+		fprintf(stderr, "the %s and c kernels differ at datagram %d\n", batch_impl(), ix);
+		ok = 0;
+	    }
+	    if (stats.inorder != inorder) {
+		fprintf(stderr, "in order %d vs per packet %d at datagram %d\n", stats.inorder, inorder, ix);
+		ok = 0;
+	    }
+	}
+	for (jx = 0; jx < n; jx++) {
+	    double transit = (d[ix + jx].rcvd.tv_sec - d[ix + jx].sent.tv_sec) + \
+		(d[ix + jx].rcvd.tv_usec - d[ix + jx].sent.tv_usec) / 1e6;
+	    if (transit != batch->transit[jx]) {
+		fprintf(stderr, "transit %.17g vs per packet %.17g at datagram %d\n", batch->transit[jx], transit, ix + jx);
+		ok = 0;
+	    }
+	}
+    }
+    if (ok)
+	ok = compare(&ref, &flow, "at the end");
+    fprintf(stdout, "agreement: %s, largest relative error %.3g\n", (ok ? "ok" : "FAILED"), maxerr);
+    if (!ok)
+	return 1;
+
+    // cost, fixed size batches and no intervals
+    flow_first(&ref, &d[0]);
+    start = now();
+    for (ix = 1; ix < cnt; ix++)
+	flow_packet(&ref, &d[ix]);
+    elapsed = now() - start;
+    fprintf(stdout, "%-22s %7.2f ns/datagram\n", "per packet", elapsed * 1e9 / (cnt - 1));
+    flow_first(&flow, &d[0]);
+    start = now();
+    for (ix = 1; ix < cnt; ix += n) {
+	n = ((cnt - ix) < batchsize) ? (cnt - ix) : batchsize;
+	gather(batch, &d[ix], n);
+	flow_batch(&flow, batch, &stats, batch_stats);
+    }
+    elapsed = now() - start;
+    snprintf(label, sizeof(label), "batch (%s)", batch_impl());
+    fprintf(stdout, "%-22s %7.2f ns/datagram\n", label, elapsed * 1e9 / (cnt - 1));
+    flow_first(&flow, &d[0]);
+    start = now();
+    for (ix = 1; ix < cnt; ix += n) {
+	n = ((cnt - ix) < batchsize) ? (cnt - ix) : batchsize;
+	gather(batch, &d[ix], n);
+	flow_batch(&flow, batch, &stats, batch_stats_sw);
+    }
+    elapsed = now() - start;
+    fprintf(stdout, "%-22s %7.2f ns/datagram\n", "batch (c)", elapsed * 1e9 / (cnt - 1));
+    // keep the loops from being optimized out
+    return ((ref.jitter + flow.jitter) < 0) ? 2 : 0;
+}
@@ -0,0 +1,171 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * checkcsv.c
+ * csv_analyzer against a -y C capture fixture of known totals.  Each
+ * flow's final report must be told from its intervals whatever the
+ * -i, bucket width and chunking, so no bytes are counted twice and
+ * no interval is taken for a final report.  The SUM and --sum-groups
+ * rows are not flows.
+ *
+ * Usage: checkcsv [-v]
+ * ------------------------------------------------------------------- */
+#define CSV_ANALYZER_NOMAIN
+#include "csv_analyzer.c"
+
+/*
+ * A TCP -P 2 -i 1 client with its SUM and a --sum-groups all row,
+ * a UDP -i 2 server and a TCP client without -i, 3 seconds each and
+ * interleaved the way the reporter prints them
+ */
+static const char fixture[] =
+"20201018120001,10.0.0.1,40000,10.0.0.2,5001,3,0.0-1.0,1250000,10000000\n"
+"20201018120001,10.0.0.1,40002,10.0.0.2,5001,4,0.0-1.0,1000000,8000000\n"
+"20201018120001,::,0,::,0,-1,0.0-1.0,2250000,18000000\n"
+"20201018120001,group,0,all,0,-1,0.0-1.0,2250000,18000000\n"
+"20201018120002,10.0.0.1,40000,10.0.0.2,5001,3,1.0-2.0,1250000,10000000\n"
+"20201018120002,10.0.0.2,5001,10.0.0.1,50000,5,0.0-2.0,2500000,10000000,0.120,3,1700,0.176,0\n"
+"20201018120002,10.0.0.1,40002,10.0.0.2,5001,4,1.0-2.0,1000000,8000000\n"
+"20201018120002,::,0,::,0,-1,1.0-2.0,2250000,18000000\n"
+"20201018120003,10.0.0.1,40000,10.0.0.2,5001,3,2.0-3.0,1249970,9999760\n"
+"20201018120003,10.0.0.1,40002,10.0.0.2,5001,4,2.0-3.0,999000,7992000\n"
+"20201018120003,::,0,::,0,-1,2.0-3.0,2248970,17991760\n"
+"20201018120003,10.0.0.1,40000,10.0.0.2,5001,3,0.0-3.0,3749970,9999920\n"
+"20201018120003,10.0.0.1,40002,10.0.0.2,5001,4,0.0-3.0,2999000,7997333\n"
+"20201018120003,::,0,::,0,-1,0.0-3.0,6748970,17997253\n"
+"20201018120003,10.0.0.2,5001,10.0.0.1,50000,5,2.0-3.0,1250000,10000000,0.250,1,850,0.118,0\n"
+"20201018120003,10.0.0.2,5001,10.0.0.1,50000,5,0.0-3.0,3750000,10000000,0.250,4,2550,0.157,0\n"
+"20201018120003,10.0.0.1,40004,10.0.0.2,5001,6,0.0-3.0,3000000,8000000\n";
+
+typedef struct expect_t {
+    const char *key;
+    double finalbytes;
+    int intervals;
+    double bytes;        // of the intervals
+    intmax_t lost;
+    intmax_t datagrams;
+} expect_t;
+
+static const expect_t expect[] = {
+    {"10.0.0.1,40000,10.0.0.2,5001,3", 3749970, 3, 3749970, 0, 0},
+    {"10.0.0.1,40002,10.0.0.2,5001,4", 2999000, 3, 2999000, 0, 0},
+    {"10.0.0.2,5001,10.0.0.1,50000,5", 3750000, 2, 3750000, 4, 2550},
+    {"10.0.0.1,40004,10.0.0.2,5001,6", 3000000, 0, 0, 0, 0},
+};
+#define EXPECTCNT ((int) (sizeof(expect) / sizeof(expect_t)))
+#define EXPECTSUMS 5
+
+static int verbose = 0;
+
+static int check (double width, size_t chunksize, int threads) {
+    table_t t;
+    int ix, jx, used, errors = 0;
+    double cellbytes = 0, bytes = 0;
+
+    bucketwidth = width;
+    minchunksize = chunksize;
+    table_init(&t);
+    used = analyze(fixture, sizeof(fixture) - 1, threads, &t);
+    if (t.flowcnt != EXPECTCNT) {
+	fprintf(stdout, "-b %g chunks of %zu: %d flows, expected %d\n", width, chunksize, t.flowcnt, EXPECTCNT);
+	errors++;
+    }
+    if (t.sums != EXPECTSUMS) {
+	fprintf(stdout, "-b %g chunks of %zu: %" PRIdMAX " sum rows, expected %d\n", width, chunksize, t.sums, EXPECTSUMS);
+	errors++;
+    }
+    for (ix = 0; ix < EXPECTCNT; ix++) {
+	const expect_t *e = &expect[ix];
+	flow_t *f = NULL;
+	for (jx = 0; jx < t.flowcnt; jx++) {
+	    if (!strcmp(t.flows[jx].key, e->key))
+		f = &t.flows[jx];
+	}
+	if (!f || !f->havefinal || (f->finalbytes != e->finalbytes) || (f->intervals != e->intervals) || \
+	    (f->bytes != e->bytes) || (f->lost != e->lost) || (f->datagrams != e->datagrams)) {
+	    fprintf(stdout, "-b %g chunks of %zu: flow %s final %.0f intervals %d bytes %.0f lost/total %" PRIdMAX "/%" PRIdMAX \
+		    ", expected final %.0f intervals %d bytes %.0f lost/total %" PRIdMAX "/%" PRIdMAX "\n",
+		    width, chunksize, e->key, (f && f->havefinal ? f->finalbytes : -1), (f ? f->intervals : -1),
+		    (f ? f->bytes : -1), (f ? f->lost : -1), (f ? f->datagrams : -1),
+		    e->finalbytes, e->intervals, e->bytes, e->lost, e->datagrams);
+	    errors++;
+	}
+	bytes += e->bytes;
+    }
+    for (ix = 0; ix < t.cellcnt; ix++)
+	cellbytes += t.cells[ix].bytes;
+    if (cellbytes != bytes) {
+	fprintf(stdout, "-b %g chunks of %zu: buckets hold %.0f bytes, expected %.0f\n", width, chunksize, cellbytes, bytes);
+	errors++;
+    }
+    if (verbose)
+	fprintf(stdout, "-b %g chunks of %zu: %d chunks %d threads %d buckets %s\n", width, chunksize, chunkcnt, used,
+		t.cellcnt, (errors ? "FAILED" : "ok"));
+    table_free(&t);
+    return errors;
+}
+
+int main (int argc, char **argv) {
+    // bucket widths either side of -i, and chunkings from a line
+    // per chunk, so records land in different workers, to the whole
+    static const double widths[] = {0.5, 1.0, 1.5, 2.0, 5.0};
+    static const size_t chunksizes[] = {1, 100, 500, MINCHUNKSIZE};
+    int c, ix, jx, errors = 0, checks = 0;
+
+    while ((c=getopt(argc, argv, "v")) != -1)
+	switch (c) {
+	case 'v':
+	    verbose = 1;
+	    break;
+	default:
+	    fprintf(stderr, "usage: checkcsv [-v]\n");
+	    exit(1);
+	}
+    for (ix = 0; ix < (int) (sizeof(widths) / sizeof(double)); ix++) {
+	for (jx = 0; jx < (int) (sizeof(chunksizes) / sizeof(size_t)); jx++) {
+	    errors += check(widths[ix], chunksizes[jx], 4);
+	    checks++;
+	}
+    }
+    free(chunks);
+    fprintf(stdout, "final report detection: %s, %d of %d analyses\n", (errors ? "FAILED" : "ok"), checks - errors, checks);
+    return (errors ? 1 : 0);
+}
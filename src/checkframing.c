@@ -0,0 +1,217 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * checkframing.c
+ * Check the --tcp-framing parser against a stream of client writes
+ * read back in pieces of every kind: byte by byte, split headers,
+ * random sizes and in one read.  The stream opens with bytes that
+ * aren't a write, like the client's test headers, and holds a short
+ * write sent without a header, which has to cost exactly one resync.
+ *
+ * Usage: checkframing [-n writes] [-s seed] [-v]
+ * ------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "headers.h"
+#include "tcp_framing.h"
+
+#define MAXWRITE 3000
+
+static char *stream;
+static int streamlen;
+static TcpFrame *writes;
+static int nwrites;
+
+static void put_write (intmax_t id, int len) {
+    TCP_datagram hdr;
+    int ix;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.typelen.type = htonl(HEADER_TIMESTAMP);
+    hdr.typelen.length = htonl(len);
+    hdr.id = htonl((uint32_t) (id & 0xFFFFFFFF));
+    hdr.id2 = htonl((uint32_t) (id >> 32));
+    hdr.tv_sec = htonl(1600000000 + nwrites);
+    hdr.tv_usec = htonl((nwrites * 7919) % 1000000);
+    memcpy(stream + streamlen, &hdr, sizeof(hdr));
+    // the body is skipped so any bytes do, header look alikes included
+    for (ix = sizeof(hdr); ix < len; ix++)
+	stream[streamlen + ix] = (char) rand();
+    streamlen += len;
+    writes[nwrites].id = id;
+    writes[nwrites].len = len;
+    writes[nwrites].sent.tv_sec = 1600000000 + nwrites;
+    writes[nwrites].sent.tv_usec = (nwrites * 7919) % 1000000;
+    nwrites++;
+}
+
+/*
+ * Parse the stream in reads of the sizes readlen returns and compare
+ * the writes found with the ones put.  Returns the mismatches.
+ */
+static int check (const char *what, int (*readlen)(void), int verbose) {
+    TcpFrameParser parser;
+    TcpFrame frame;
+    const char *buf;
+    int pos = 0, got = 0, errors = 0, len, reads = 0;
+
+    tcpframe_init(&parser);
+    while (pos < streamlen) {
+	len = readlen();
+	if (len > (streamlen - pos))
+	    len = streamlen - pos;
+	buf = stream + pos;
+	pos += len;
+	reads++;
+	while (tcpframe_next(&parser, &buf, &len, &frame)) {
+	    if (got >= nwrites) {
+		errors++;
+		continue;
+	    }
+	    if ((frame.id != writes[got].id) || (frame.len != writes[got].len) || \
+		(frame.sent.tv_sec != writes[got].sent.tv_sec) || \
+		(frame.sent.tv_usec != writes[got].sent.tv_usec)) {
+		if (verbose)
+		    fprintf(stderr, "%s: write %d is id %" PRIdMAX " len %d, expected id %" PRIdMAX " len %d\n", \
+			    what, got, frame.id, frame.len, writes[got].id, writes[got].len);
+		errors++;
+	    }
+	    got++;
+	}
+	if (len != 0) {
+	    fprintf(stderr, "%s: %d bytes of a read left over\n", what, len);
+	    errors++;
+	}
+    }
+    if (got != nwrites) {
+	fprintf(stderr, "%s: %d of %d writes found\n", what, got, nwrites);
+	errors++;
+    }
+    if (parser.resyncs != 1) {
+	fprintf(stderr, "%s: %" PRIdMAX " resyncs, expected 1\n", what, parser.resyncs);
+	errors++;
+    }
+    fprintf(stdout, "%-22s %8d reads  %s\n", what, reads, (errors ? "FAILED" : "ok"));
+    return errors;
+}
+
+static int read_byte (void) {
+    return 1;
+}
+
+static int read_hdrsplit (void) {
+    // never a whole header in one read
+    return sizeof(TCP_datagram) - 1;
+}
+
+static int read_small (void) {
+    return 1 + (rand() % 64);
+}
+
+static int read_random (void) {
+    return 1 + (rand() % (4 * MAXWRITE));
+}
+
+static int read_all (void) {
+    return streamlen;
+}
+
+int main (int argc, char **argv) {
+    int c, ix, count = 20000, verbose = 0, errors = 0;
+    unsigned int seed = 1;
+    intmax_t id;
+
+    while ((c=getopt(argc, argv, "n:s:v")) != -1)
+	switch (c) {
+	case 'n':
+	    count = atoi(optarg);
+	    break;
+	case 's':
+	    seed = (unsigned int) atoi(optarg);
+	    break;
+	case 'v':
+	    verbose = 1;
+	    break;
+	case '?':
+	    fprintf(stderr,"Usage -n writes, -s random seed, -v verbose\n");
+	    return 1;
+	default:
+	    abort();
+	}
+    if (count < 2) {
+	fprintf(stderr, "at least 2 writes\n");
+	return 1;
+    }
+    srand(seed);
+    stream = (char *) calloc((size_t) (count + 2), MAXWRITE);
+    writes = (TcpFrame *) calloc((size_t) count, sizeof(TcpFrame));
+    if (!stream || !writes) {
+	fprintf(stderr, "no memory\n");
+	return 1;
+    }
+    // the test headers the client may open with, no header type word
+    streamlen = 24;
+#ifdef HAVE_INT64_T
+    // cross into the id2 word
+    id = ((intmax_t) 1 << 32) - (count / 2);
+#else
+    id = 0;
+#endif
+    for (ix = 0; ix < count; ix++) {
+	if (ix == count / 2) {
+	    // a write too short for a header, the client sends the
+	    // bytes after its header space
+	    streamlen += sizeof(TCP_datagram) / 2;
+	}
+	put_write(id++, sizeof(TCP_datagram) + (rand() % (MAXWRITE - sizeof(TCP_datagram) + 1)));
+    }
+    fprintf(stdout, "%d writes, %d bytes\n", nwrites, streamlen);
+    errors += check("byte reads", read_byte, verbose);
+    errors += check("split header reads", read_hdrsplit, verbose);
+    errors += check("small reads", read_small, verbose);
+    errors += check("random reads", read_random, verbose);
+    errors += check("one read", read_all, verbose);
+    free(stream);
+    free(writes);
+    return (errors ? 1 : 0);
+}
@@ -60,6 +60,7 @@
 #include <time.h>
 #include <math.h>
 #include <unistd.h>
+#include <limits.h>
 #include "headers.h"
 #include "util.h"
 #include "pdfs.h"
@@ -93,8 +94,11 @@ int main (int argc, char **argv) {
     int random = FALSE;
     double total;
     double binwidth=1.0;
+    char *sizes = NULL;
+    size_pdf sizepdf;
+    pdf_rand r;
 
-    while ((c=getopt(argc, argv, "b:c:lm:prsv:w:")) != -1)
+    while ((c=getopt(argc, argv, "b:c:d:lm:prsv:w:")) != -1)
 	switch (c) {
 	case 'b':
 	    bincount = atoi(optarg);
@@ -102,6 +106,9 @@ int main (int argc, char **argv) {
 	case 'c':
 	    count = atoi(optarg);
 	    break;
+	case 'd':
+	    sizes = optarg;
+	    break;
 	case 'l':
 	    gaussian = FALSE;
 	    break;
@@ -125,7 +132,7 @@ int main (int argc, char **argv) {
 	    break;
 	case '?':
 	default:
-	    fprintf(stderr,"Usage -b bins, -c count, -l log normal, -m mean, -p print, -s speed only, -v variance");
+	    fprintf(stderr,"Usage -b bins, -c count, -d write sizes pdf, -l log normal, -m mean, -p print, -s speed only, -v variance");
 	    exit(-1);
 	}
     if (bincount > MAXBINS) {
@@ -146,7 +153,27 @@ int main (int argc, char **argv) {
     struct timeval t1;
     gettimeofday( &t1, NULL );
 #endif
-    if (gaussian) {
+    if (sizes) {
+	// --write-sizes draws per the per thread generator
+	if (size_pdf_parse(&sizepdf, sizes) != 0) {
+	    fprintf(stderr, "Bad write sizes pdf %s\n", sizes);
+	    exit(-1);
+	}
+	pdf_rand_seed(&r, (uint64_t) (random ? t : 1));
+	for( i = 0 ; i < count ; i++ )  {
+	    int result = round(size_pdf_draw(&sizepdf, &r, INT_MAX)/binwidth);
+	    if (!speedonly) {
+		if (result >= 0 && result < (MAXBINS - 1)) {
+		    histogram[result]++;
+		    if (result < minbin)
+			minbin = result;
+		    if (result > maxbin)
+			maxbin = result;
+		}
+	    }
+	}
+	size_pdf_free(&sizepdf);
+    } else if (gaussian) {
 	for( i = 0 ; i < count ; i++ )  {
 	    int result = round(normal(mean,variance)/binwidth);
 	    if (!speedonly) {
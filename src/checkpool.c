@@ -0,0 +1,220 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * checkpool.c
+ * Allocator time of the report objects under flow churn, pools vs
+ * malloc.  Each flow is a thread, like a server's, which takes its
+ * data report, packet ring and histograms and puts them back when done,
+ * and hands its connection and settings reports to a reporter thread
+ * which puts those.  Time in the allocator includes the page faults of
+ * fresh memory, the run time includes those taken by the traffic.
+ *
+ * Usage: checkpool [-P concurrent flows] [-n flows]
+ * ------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "headers.h"
+#include "Settings.hpp"
+#include "Reporter.h"
+#include "histogram.h"
+#include "pool.h"
+
+#define QUEUELEN 1024
+#define RINGSIZE (sizeof(PacketRing) + NUM_REPORT_STRUCTS * sizeof(ReportStruct))
+
+static int use_malloc = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static void *queue[QUEUELEN];
+static int queue_head = 0, queue_count = 0, done = 0;
+static double alloc_ns = 0;
+static long objects = 0;
+
+static double now (void) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return t1.tv_sec + (t1.tv_nsec / 1e9);
+}
+
+static void *obj_get (int pool, size_t size, int zero, double *ns) {
+    double start = now();
+    void *p;
+    if (use_malloc)
+	p = zero ? calloc(1, size) : malloc(size);
+    else
+	p = zero ? pool_getz(pool, size) : pool_get(pool, size);
+    *ns += (now() - start) * 1e9;
+    if (!p) {
+	fprintf(stderr, "no memory\n");
+	exit(1);
+    }
+    return p;
+}
+
+static void obj_put (void *p, double *ns) {
+    double start = now();
+    if (use_malloc)
+	free(p);
+    else
+	pool_put(p);
+    *ns += (now() - start) * 1e9;
+}
+
+static void tally (double ns, long count) {
+    pthread_mutex_lock(&lock);
+    alloc_ns += ns;
+    objects += count;
+    pthread_mutex_unlock(&lock);
+}
+
+static void *reporter (void *arg) {
+    double ns = 0;
+    void *p;
+    (void) arg;
+    pthread_mutex_lock(&lock);
+    while (queue_count || !done) {
+	if (!queue_count) {
+	    pthread_cond_wait(&queue_cond, &lock);
+	    continue;
+	}
+	p = queue[queue_head];
+	queue_head = (queue_head + 1) % QUEUELEN;
+	queue_count--;
+	pthread_cond_broadcast(&queue_cond);
+	pthread_mutex_unlock(&lock);
+	obj_put(p, &ns);
+	pthread_mutex_lock(&lock);
+    }
+    alloc_ns += ns;
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+static void *flow (void *arg) {
+    double ns = 0;
+    void *data, *ring, *hist[2], *oneshot;
+    int ix;
+    (void) arg;
+    data = obj_get(POOL_REPORTHDR, sizeof(ReportHeader), 1, &ns);
+    ring = obj_get(POOL_PACKETRING, RINGSIZE, 0, &ns);
+    // the traffic fills the ring at least once
+    memset(ring, 0, RINGSIZE);
+    for (ix = 0; ix < 2; ix++)
+	hist[ix] = obj_get(POOL_HISTOGRAM, HISTOGRAM_SIZE(1000, 2), 0, &ns);
+    for (ix = 0; ix < 2; ix++) {
+	oneshot = obj_get(POOL_REPORTHDR, sizeof(ReportHeader), 1, &ns);
+	pthread_mutex_lock(&lock);
+	while (queue_count == QUEUELEN)
+	    pthread_cond_wait(&queue_cond, &lock);
+	queue[(queue_head + queue_count) % QUEUELEN] = oneshot;
+	queue_count++;
+	pthread_cond_broadcast(&queue_cond);
+	pthread_mutex_unlock(&lock);
+    }
+    for (ix = 0; ix < 2; ix++)
+	obj_put(hist[ix], &ns);
+    obj_put(ring, &ns);
+    obj_put(data, &ns);
+    tally(ns, 6);
+    return NULL;
+}
+
+static void run (const char *what, int parallel, int flows) {
+    pthread_t rthread, *threads;
+    double start;
+    int ix, jx, n;
+    alloc_ns = 0;
+    objects = 0;
+    done = 0;
+    if ((threads = (pthread_t *) malloc(parallel * sizeof(pthread_t))) == NULL) {
+	fprintf(stderr, "no memory\n");
+	exit(1);
+    }
+    start = now();
+    pthread_create(&rthread, NULL, reporter, NULL);
+    for (ix = 0; ix < flows; ix += parallel) {
+	n = ((flows - ix) < parallel) ? (flows - ix) : parallel;
+	for (jx = 0; jx < n; jx++)
+	    pthread_create(&threads[jx], NULL, flow, NULL);
+	for (jx = 0; jx < n; jx++)
+	    pthread_join(threads[jx], NULL);
+    }
+    pthread_mutex_lock(&lock);
+    done = 1;
+    pthread_cond_broadcast(&queue_cond);
+    pthread_mutex_unlock(&lock);
+    pthread_join(rthread, NULL);
+    fprintf(stdout, "%-8s %ld objects  %7.0f ns/object in the allocator  %7.3f sec\n", \
+	    what, objects, alloc_ns / objects, now() - start);
+    free(threads);
+}
+
+int main (int argc, char **argv) {
+    int c, parallel = 4, flows = 10000;
+
+    while ((c=getopt(argc, argv, "P:n:")) != -1)
+	switch (c) {
+	case 'P':
+	    parallel = atoi(optarg);
+	    break;
+	case 'n':
+	    flows = atoi(optarg);
+	    break;
+	case '?':
+	    fprintf(stderr,"Usage -P concurrent flows, -n flows to run\n");
+	    return 1;
+	default:
+	    abort();
+	}
+    if ((parallel <= 0) || (flows <= 0)) {
+	fprintf(stderr, "flows must be positive\n");
+	return 1;
+    }
+    pool_init();
+    fprintf(stdout, "%d flows, %d at a time, 6 objects each\n", flows, parallel);
+    use_malloc = 1;
+    run("malloc", parallel, flows);
+    use_malloc = 0;
+    run("pools", parallel, flows);
+    pool_debug();
+    return 0;
+}
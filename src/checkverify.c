@@ -0,0 +1,127 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * checkverify.c
+ * Cost of --verify per GB: the client's block fill and the
+ * receiver's CRC32C, per the table and the CRC instructions
+ *
+ * Usage: checkverify [-l blocklen] [-g GBytes]
+ * ------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "headers.h"
+#include "verify.h"
+
+static double now (void) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return t1.tv_sec + (t1.tv_nsec / 1e9);
+}
+
+static void report (const char *what, double secs, double gbytes) {
+    fprintf(stdout, "%-22s %7.3f sec/GB  %7.2f GBytes/sec\n", what, secs / gbytes, gbytes / secs);
+}
+
+int main (int argc, char **argv) {
+    int c, blocklen = 128 * 1024;
+    double gbytes = 1.0, start;
+    long ix, blocks;
+    uint32_t crc = 0;
+    char *block;
+
+    while ((c=getopt(argc, argv, "l:g:")) != -1)
+	switch (c) {
+	case 'l':
+	    blocklen = atoi(optarg);
+	    break;
+	case 'g':
+	    gbytes = atof(optarg);
+	    break;
+	case '?':
+	    fprintf(stderr,"Usage -l block length, -g GBytes to run\n");
+	    return 1;
+	default:
+	    abort();
+	}
+    if ((blocklen < VERIFY_MINLEN) || (gbytes <= 0)) {
+	fprintf(stderr, "block length must be at least %d\n", VERIFY_MINLEN);
+	return 1;
+    }
+    if ((block = (char *) malloc(blocklen)) == NULL) {
+	fprintf(stderr, "no memory\n");
+	return 1;
+    }
+    crc32c_init();
+    blocks = (long) ((gbytes * 1e9) / blocklen);
+    gbytes = (double) blocks * blocklen / 1e9;
+    fprintf(stdout, "%ld blocks of %d bytes, CRC32C per %s\n", blocks, blocklen, crc32c_impl());
+
+    start = now();
+    for (ix = 0; ix < blocks; ix++)
+	verify_fill(block, blocklen, ix);
+    report("fill (client)", now() - start, gbytes);
+
+    start = now();
+    for (ix = 0; ix < blocks; ix++)
+	crc = crc32c(crc, block, blocklen);
+    report("crc32c", now() - start, gbytes);
+
+    start = now();
+    for (ix = 0; ix < blocks; ix++)
+	crc = crc32c_table(crc, block, blocklen);
+    report("crc32c (table)", now() - start, gbytes);
+
+    // the receive path, fill once and verify as if per datagram
+    verify_fill(block, blocklen, 0);
+    start = now();
+    for (ix = 0; ix < blocks; ix++) {
+	if (!verify_block(block, blocklen, 0)) {
+	    fprintf(stderr, "verify failed\n");
+	    return 1;
+	}
+    }
+    report("verify (server)", now() - start, gbytes);
+    // keep the crc loops from being optimized out
+    return (crc == 0x12345678) ? 2 : 0;
+}
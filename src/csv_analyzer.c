@@ -0,0 +1,779 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * csv_analyzer.c
+ * Offline analyzer for iperf interval output captured with -y C
+ *
+ * The input file is memory mapped and cut into newline aligned
+ * chunks.  Worker threads pull chunks and accumulate per flow,
+ * per time bucket cells into private tables which are merged
+ * once all chunks are consumed, so there is no locking on the
+ * parse path.  Output is a text summary (loss episodes,
+ * throughput/jitter percentiles, loss correlation across flows)
+ * plus a time bucketed table in CSV or JSON.  The SUM and --sum-groups
+ * rows are counted but not taken as flows, their bytes are the flows'.
+ *
+ * usage: csv_analyzer [-b bucket_sec] [-s start] [-e end]
+ *                     [-j threads] [-f csv|json] [-o outfile] <file>
+ * ------------------------------------------------------------------- */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "headers.h"
+
+#define MAXFIELDS 16
+#define FLOWKEYLEN 128
+#define CHUNKS_PER_THREAD 4
+#define MINCHUNKSIZE (1 << 20)
+
+// CSV field layout per reportCSV_bw_format and reportCSV_bw_jitter_loss_format,
+// the peer string (CSV_peer) expands to four fields
+enum {
+    F_TIMESTAMP = 0,
+    F_LOCALADDR,
+    F_LOCALPORT,
+    F_REMOTEADDR,
+    F_REMOTEPORT,
+    F_ID,
+    F_INTERVAL,
+    F_BYTES,
+    F_SPEED,
+    F_JITTER,
+    F_LOST,
+    F_DATAGRAMS,
+    F_LOSSPCT,
+    F_OUTOFORDER,
+    F_MINTCP = F_SPEED + 1,
+    F_MINUDP = F_OUTOFORDER + 1
+};
+
+// A record whose interval starts at zero, either a flow's first
+// interval or its final (summary) report, told apart once the whole
+// file is parsed
+typedef struct record_t {
+    intmax_t pos;        // offset in the file
+    double start;
+    double end;
+    double bytes;
+    double speed;
+    double jitter;
+    intmax_t lost;
+    intmax_t datagrams;
+} record_t;
+
+typedef struct flow_t {
+    char key[FLOWKEYLEN];
+    unsigned int hash;
+    int isudp;
+    intmax_t lastpos;    // offset of the flow's last record
+    record_t *zeros;     // records starting at zero
+    int zerocnt;
+    int zeromax;
+    // totals from the interval records
+    double bytes;
+    intmax_t lost;
+    intmax_t datagrams;
+    double maxjitter;
+    int intervals;
+    // totals from the final (summary) record if present
+    int havefinal;
+    double finalbytes;
+    double finalspeed;
+    intmax_t finallost;
+    intmax_t finaldatagrams;
+} flow_t;
+
+typedef struct cell_t {
+    int flow;
+    int bucket;
+    double bytes;
+    double speedsum;
+    double maxjitter;
+    intmax_t lost;
+    intmax_t datagrams;
+    int samples;
+} cell_t;
+
+typedef struct table_t {
+    flow_t *flows;
+    int flowcnt;
+    int flowmax;
+    int *flowindex;   // open addressed hash of flow keys
+    int flowindexsize;
+    cell_t *cells;
+    int cellcnt;
+    int cellmax;
+    int *cellindex;   // open addressed hash of (flow, bucket)
+    int cellindexsize;
+    intmax_t lines;
+    intmax_t skipped;
+    intmax_t sums;    // SUM and aggregation group rows
+} table_t;
+
+typedef struct chunk_t {
+    const char *start;
+    const char *end;
+} chunk_t;
+
+typedef struct worker_t {
+    pthread_t tid;
+    table_t table;
+} worker_t;
+
+static double bucketwidth = 1.0;
+static double windowstart = 0.0;
+static double windowend = -1.0;
+static size_t minchunksize = MINCHUNKSIZE;
+static const char *mapbase = NULL;
+static chunk_t *chunks = NULL;
+static int chunkcnt = 0;
+static int nextchunk = 0;
+
+static void *xcalloc (size_t n, size_t size) {
+    void *p = calloc(n, size);
+    if (!p) {
+	fprintf(stderr, "csv_analyzer: out of memory\n");
+	exit(1);
+    }
+    return p;
+}
+
+static unsigned int hash_str (const char *s, int len) {
+    // FNV-1a
+    unsigned int h = 2166136261u;
+    int ix;
+    for (ix = 0; ix < len; ix++) {
+	h ^= (unsigned char) s[ix];
+	h *= 16777619u;
+    }
+    return h;
+}
+
+static inline unsigned int hash_cell (int flow, int bucket) {
+    unsigned int h = (unsigned int) flow * 2654435761u;
+    return h ^ ((unsigned int) bucket * 40503u);
+}
+
+static void table_init (table_t *t) {
+    memset(t, 0, sizeof(table_t));
+    t->flowmax = 64;
+    t->flows = xcalloc(t->flowmax, sizeof(flow_t));
+    t->flowindexsize = 128;
+    t->flowindex = xcalloc(t->flowindexsize, sizeof(int));
+    t->cellmax = 1024;
+    t->cells = xcalloc(t->cellmax, sizeof(cell_t));
+    t->cellindexsize = 2048;
+    t->cellindex = xcalloc(t->cellindexsize, sizeof(int));
+}
+
+static void table_free (table_t *t) {
+    int ix;
+    for (ix = 0; ix < t->flowcnt; ix++)
+	free(t->flows[ix].zeros);
+    free(t->flows);
+    free(t->flowindex);
+    free(t->cells);
+    free(t->cellindex);
+}
+
+// index entries hold (slot + 1) so zero means empty
+static void rehash_flows (table_t *t) {
+    int ix;
+    free(t->flowindex);
+    t->flowindexsize *= 2;
+    t->flowindex = xcalloc(t->flowindexsize, sizeof(int));
+    for (ix = 0; ix < t->flowcnt; ix++) {
+	unsigned int pos = t->flows[ix].hash & (t->flowindexsize - 1);
+	while (t->flowindex[pos])
+	    pos = (pos + 1) & (t->flowindexsize - 1);
+	t->flowindex[pos] = ix + 1;
+    }
+}
+
+static int lookup_flow (table_t *t, const char *key, int len) {
+    unsigned int h, pos;
+    flow_t *f;
+    if (len >= FLOWKEYLEN)
+	len = FLOWKEYLEN - 1;
+    h = hash_str(key, len);
+    pos = h & (t->flowindexsize - 1);
+    while (t->flowindex[pos]) {
+	f = &t->flows[t->flowindex[pos] - 1];
+	if ((f->hash == h) && !strncmp(f->key, key, len) && (f->key[len] == '\0'))
+	    return (t->flowindex[pos] - 1);
+	pos = (pos + 1) & (t->flowindexsize - 1);
+    }
+    if (t->flowcnt == t->flowmax) {
+	t->flowmax *= 2;
+	t->flows = realloc(t->flows, t->flowmax * sizeof(flow_t));
+	if (!t->flows) {
+	    fprintf(stderr, "csv_analyzer: out of memory\n");
+	    exit(1);
+	}
+    }
+    f = &t->flows[t->flowcnt];
+    memset(f, 0, sizeof(flow_t));
+    memcpy(f->key, key, len);
+    f->key[len] = '\0';
+    f->hash = h;
+    f->lastpos = -1;
+    t->flowindex[pos] = ++t->flowcnt;
+    if ((t->flowcnt * 2) > t->flowindexsize)
+	rehash_flows(t);
+    return (t->flowcnt - 1);
+}
+
+static void rehash_cells (table_t *t) {
+    int ix;
+    free(t->cellindex);
+    t->cellindexsize *= 2;
+    t->cellindex = xcalloc(t->cellindexsize, sizeof(int));
+    for (ix = 0; ix < t->cellcnt; ix++) {
+	unsigned int pos = hash_cell(t->cells[ix].flow, t->cells[ix].bucket) & (t->cellindexsize - 1);
+	while (t->cellindex[pos])
+	    pos = (pos + 1) & (t->cellindexsize - 1);
+	t->cellindex[pos] = ix + 1;
+    }
+}
+
+static cell_t *lookup_cell (table_t *t, int flow, int bucket) {
+    unsigned int pos = hash_cell(flow, bucket) & (t->cellindexsize - 1);
+    cell_t *c;
+    while (t->cellindex[pos]) {
+	c = &t->cells[t->cellindex[pos] - 1];
+	if ((c->flow == flow) && (c->bucket == bucket))
+	    return c;
+	pos = (pos + 1) & (t->cellindexsize - 1);
+    }
+    if (t->cellcnt == t->cellmax) {
+	t->cellmax *= 2;
+	t->cells = realloc(t->cells, t->cellmax * sizeof(cell_t));
+	if (!t->cells) {
+	    fprintf(stderr, "csv_analyzer: out of memory\n");
+	    exit(1);
+	}
+    }
+    c = &t->cells[t->cellcnt];
+    memset(c, 0, sizeof(cell_t));
+    c->flow = flow;
+    c->bucket = bucket;
+    t->cellindex[pos] = ++t->cellcnt;
+    if ((t->cellcnt * 2) > t->cellindexsize)
+	rehash_cells(t);
+    return c;
+}
+
+static void add_zero (flow_t *f, record_t *rec) {
+    if (f->zerocnt == f->zeromax) {
+	f->zeromax = (f->zeromax ? (f->zeromax * 2) : 2);
+	f->zeros = realloc(f->zeros, f->zeromax * sizeof(record_t));
+	if (!f->zeros) {
+	    fprintf(stderr, "csv_analyzer: out of memory\n");
+	    exit(1);
+	}
+    }
+    f->zeros[f->zerocnt++] = *rec;
+}
+
+static void add_interval (table_t *t, int flow, record_t *rec) {
+    flow_t *f = &t->flows[flow];
+    if ((rec->start < windowstart) || ((windowend >= 0) && (rec->end > windowend)))
+	return;
+    cell_t *c = lookup_cell(t, flow, (int) floor(rec->start / bucketwidth));
+    f->intervals++;
+    f->bytes += rec->bytes;
+    c->bytes += rec->bytes;
+    c->speedsum += rec->speed;
+    c->samples++;
+    if (f->isudp) {
+	c->lost += rec->lost;
+	c->datagrams += rec->datagrams;
+	f->lost += rec->lost;
+	f->datagrams += rec->datagrams;
+	if (rec->jitter > c->maxjitter)
+	    c->maxjitter = rec->jitter;
+	if (rec->jitter > f->maxjitter)
+	    f->maxjitter = rec->jitter;
+    }
+}
+
+/*
+ * Parse one CSV record in place, no copies are made of the mapped data
+ */
+static void parse_line (table_t *t, const char *line, const char *eol) {
+    const char *field[MAXFIELDS];
+    int flen[MAXFIELDS];
+    int nf = 0;
+    const char *p = line;
+    record_t rec;
+    int flow;
+    flow_t *f;
+
+    t->lines++;
+    field[0] = p;
+    while ((p < eol) && (nf < MAXFIELDS)) {
+	if (*p == ',') {
+	    flen[nf] = p - field[nf];
+	    if (++nf < MAXFIELDS)
+		field[nf] = p + 1;
+	}
+	p++;
+    }
+    if (nf < MAXFIELDS) {
+	flen[nf] = eol - field[nf];
+	nf++;
+    }
+    if ((nf != F_MINTCP) && (nf != F_MINUDP)) {
+	t->skipped++;
+	return;
+    }
+    if (sscanf(field[F_INTERVAL], "%lf-%lf", &rec.start, &rec.end) != 2) {
+	t->skipped++;
+	return;
+    }
+    // a SUM, ID -1 with an any address peer, or a --sum-groups
+    // row, "group,0,<label>,0", sums flows already accounted
+    if ((field[F_ID][0] == '-') || ((flen[F_LOCALADDR] == 5) && !strncmp(field[F_LOCALADDR], "group", 5))) {
+	t->sums++;
+	return;
+    }
+    rec.pos = line - mapbase;
+    rec.bytes = strtod(field[F_BYTES], NULL);
+    rec.speed = strtod(field[F_SPEED], NULL);
+    rec.jitter = 0.0;
+    rec.lost = 0;
+    rec.datagrams = 0;
+    // the flow key is the peer tuple plus transfer id, fields 1 through 5
+    flow = lookup_flow(t, field[F_LOCALADDR], (field[F_ID] + flen[F_ID]) - field[F_LOCALADDR]);
+    f = &t->flows[flow];
+    f->isudp = (nf == F_MINUDP);
+    if (f->isudp) {
+	rec.jitter = strtod(field[F_JITTER], NULL);
+	rec.lost = strtoimax(field[F_LOST], NULL, 10);
+	rec.datagrams = strtoimax(field[F_DATAGRAMS], NULL, 10);
+    }
+    if (rec.pos > f->lastpos)
+	f->lastpos = rec.pos;
+    // Whether a record starting at zero is the final report depends
+    // on what follows it, possibly in another worker's chunk
+    if (rec.start == 0.0)
+	add_zero(f, &rec);
+    else
+	add_interval(t, flow, &rec);
+}
+
+/*
+ * Once all chunks are merged, a flow's final report is its last
+ * record in the file when that starts at zero.  Its other records
+ * starting at zero are first intervals.  A flow with only a final
+ * report, i.e. no -i, has no intervals.
+ */
+static void resolve_finals (table_t *t) {
+    int ix, jx;
+    for (ix = 0; ix < t->flowcnt; ix++) {
+	for (jx = 0; jx < t->flows[ix].zerocnt; jx++) {
+	    flow_t *f = &t->flows[ix];
+	    record_t *rec = &f->zeros[jx];
+	    if (rec->pos == f->lastpos) {
+		f->havefinal = 1;
+		f->finalbytes = rec->bytes;
+		f->finalspeed = rec->speed;
+		f->finallost = rec->lost;
+		f->finaldatagrams = rec->datagrams;
+	    } else {
+		add_interval(t, ix, rec);
+	    }
+	}
+    }
+}
+
+static void *worker (void *arg) {
+    worker_t *w = (worker_t *) arg;
+    int ix;
+    while ((ix = __sync_fetch_and_add(&nextchunk, 1)) < chunkcnt) {
+	const char *p = chunks[ix].start;
+	const char *end = chunks[ix].end;
+	while (p < end) {
+	    const char *eol = memchr(p, '\n', end - p);
+	    if (!eol)
+		eol = end;
+	    if ((eol > p) && (eol[-1] == '\r'))
+		parse_line(&w->table, p, eol - 1);
+	    else if (eol > p)
+		parse_line(&w->table, p, eol);
+	    p = eol + 1;
+	}
+    }
+    return NULL;
+}
+
+/*
+ * Merge a worker's private table into the global one.
+ * Worker flow indices are remapped via the flow key.
+ */
+static void merge_table (table_t *to, table_t *from) {
+    int ix, jx;
+    int *remap = xcalloc(from->flowcnt + 1, sizeof(int));
+    for (ix = 0; ix < from->flowcnt; ix++) {
+	flow_t *src = &from->flows[ix];
+	int flow = lookup_flow(to, src->key, strlen(src->key));
+	flow_t *dst = &to->flows[flow];
+	remap[ix] = flow;
+	dst->isudp |= src->isudp;
+	if (src->lastpos > dst->lastpos)
+	    dst->lastpos = src->lastpos;
+	for (jx = 0; jx < src->zerocnt; jx++)
+	    add_zero(dst, &src->zeros[jx]);
+	dst->bytes += src->bytes;
+	dst->lost += src->lost;
+	dst->datagrams += src->datagrams;
+	dst->intervals += src->intervals;
+	if (src->maxjitter > dst->maxjitter)
+	    dst->maxjitter = src->maxjitter;
+    }
+    for (ix = 0; ix < from->cellcnt; ix++) {
+	cell_t *src = &from->cells[ix];
+	cell_t *dst = lookup_cell(to, remap[src->flow], src->bucket);
+	dst->bytes += src->bytes;
+	dst->speedsum += src->speedsum;
+	dst->lost += src->lost;
+	dst->datagrams += src->datagrams;
+	dst->samples += src->samples;
+	if (src->maxjitter > dst->maxjitter)
+	    dst->maxjitter = src->maxjitter;
+    }
+    to->lines += from->lines;
+    to->skipped += from->skipped;
+    to->sums += from->sums;
+    free(remap);
+}
+
+/*
+ * Parse the mapped capture with up to the given number of worker
+ * threads into global, returns the number of threads used
+ */
+static int analyze (const char *map, size_t len, int threads, table_t *global) {
+    size_t chunksize = len / (threads * CHUNKS_PER_THREAD);
+    const char *p = map;
+    const char *end = map + len;
+    worker_t *workers;
+    int ix;
+
+    // Cut the file into newline aligned chunks
+    mapbase = map;
+    free(chunks);
+    chunkcnt = 0;
+    nextchunk = 0;
+    if (chunksize < minchunksize)
+	chunksize = minchunksize;
+    chunks = xcalloc((len / chunksize) + 2, sizeof(chunk_t));
+    while (p < end) {
+	const char *q = p + chunksize;
+	if (q >= end) {
+	    q = end;
+	} else {
+	    const char *eol = memchr(q, '\n', end - q);
+	    q = (eol ? eol + 1 : end);
+	}
+	chunks[chunkcnt].start = p;
+	chunks[chunkcnt].end = q;
+	chunkcnt++;
+	p = q;
+    }
+    if (threads > chunkcnt)
+	threads = chunkcnt;
+    workers = xcalloc(threads, sizeof(worker_t));
+    for (ix = 0; ix < threads; ix++) {
+	table_init(&workers[ix].table);
+	if (pthread_create(&workers[ix].tid, NULL, worker, &workers[ix])) {
+	    perror("pthread_create");
+	    exit(1);
+	}
+    }
+    for (ix = 0; ix < threads; ix++) {
+	pthread_join(workers[ix].tid, NULL);
+	merge_table(global, &workers[ix].table);
+	table_free(&workers[ix].table);
+    }
+    free(workers);
+    resolve_finals(global);
+    return threads;
+}
+
+#ifndef CSV_ANALYZER_NOMAIN
+static int cmp_double (const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+static int cmp_cell (const void *a, const void *b) {
+    const cell_t *x = (const cell_t *) a;
+    const cell_t *y = (const cell_t *) b;
+    if (x->bucket != y->bucket)
+	return (x->bucket - y->bucket);
+    return (x->flow - y->flow);
+}
+
+static int cmp_cell_flow (const void *a, const void *b) {
+    const cell_t *x = (const cell_t *) a;
+    const cell_t *y = (const cell_t *) b;
+    if (x->flow != y->flow)
+	return (x->flow - y->flow);
+    return (x->bucket - y->bucket);
+}
+
+// nearest rank percentile over a sorted array
+static double percentile (double *sorted, int n, double pct) {
+    int rank;
+    if (n <= 0)
+	return 0.0;
+    rank = (int) ceil((pct / 100.0) * n) - 1;
+    if (rank < 0)
+	rank = 0;
+    if (rank >= n)
+	rank = n - 1;
+    return sorted[rank];
+}
+
+static void usage (void) {
+    fprintf(stderr, "usage: csv_analyzer [-b bucket_sec] [-s start_sec] [-e end_sec] [-j threads] [-f csv|json] [-o outfile] <iperf -y C output>\n");
+}
+
+int main (int argc, char **argv) {
+    int c, ix, jx;
+    int threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    int json = 0;
+    char *outname = NULL;
+    FILE *out = stdout;
+    struct stat st;
+    const char *map;
+    int fd;
+    table_t global;
+
+    while ((c = getopt(argc, argv, "b:e:f:hj:o:s:")) != -1) {
+	switch (c) {
+	case 'b':
+	    bucketwidth = atof(optarg);
+	    break;
+	case 'e':
+	    windowend = atof(optarg);
+	    break;
+	case 'f':
+	    json = (strcmp(optarg, "json") == 0);
+	    break;
+	case 'j':
+	    threads = atoi(optarg);
+	    break;
+	case 'o':
+	    outname = optarg;
+	    break;
+	case 's':
+	    windowstart = atof(optarg);
+	    break;
+	case 'h':
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if ((optind >= argc) || (bucketwidth <= 0)) {
+	usage();
+	exit(1);
+    }
+    if (threads < 1)
+	threads = 1;
+    if ((fd = open(argv[optind], O_RDONLY)) < 0) {
+	perror(argv[optind]);
+	exit(1);
+    }
+    if (fstat(fd, &st) < 0) {
+	perror("fstat");
+	exit(1);
+    }
+    if (st.st_size == 0) {
+	fprintf(stderr, "csv_analyzer: %s is empty\n", argv[optind]);
+	exit(1);
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+	perror("mmap");
+	exit(1);
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise((void *) map, st.st_size, MADV_SEQUENTIAL);
+#endif
+    table_init(&global);
+    threads = analyze(map, st.st_size, threads, &global);
+    munmap((void *) map, st.st_size);
+    close(fd);
+
+    if (outname && !(out = fopen(outname, "w"))) {
+	perror(outname);
+	exit(1);
+    }
+    qsort(global.cells, global.cellcnt, sizeof(cell_t), cmp_cell);
+
+    /*
+     * Per bucket output, each bucket row aggregates all flows and gives
+     * percentiles of the per flow throughput and jitter
+     */
+    {
+	double *speeds = xcalloc(global.flowcnt + 1, sizeof(double));
+	double *jitters = xcalloc(global.flowcnt + 1, sizeof(double));
+	int lossyflows_total = 0, correlated = 0, buckets = 0;
+	if (json) {
+	    fprintf(out, "{\"bucket_width\":%g,\"buckets\":[", bucketwidth);
+	} else {
+	    fprintf(out, "start,end,flows,bytes,bits_per_sec,speed_p50,speed_p95,speed_p99,speed_min,lost,datagrams,loss_pct,jitter_p50,jitter_p95,jitter_max,lossy_flows\n");
+	}
+	for (ix = 0; ix < global.cellcnt; ix = jx) {
+	    int bucket = global.cells[ix].bucket;
+	    int n = 0, nj = 0, lossy = 0;
+	    double bytes = 0, speed = 0;
+	    intmax_t lost = 0, datagrams = 0;
+	    for (jx = ix; (jx < global.cellcnt) && (global.cells[jx].bucket == bucket); jx++) {
+		cell_t *cell = &global.cells[jx];
+		double flowspeed = cell->speedsum / cell->samples;
+		bytes += cell->bytes;
+		speed += flowspeed;
+		speeds[n++] = flowspeed;
+		if (global.flows[cell->flow].isudp) {
+		    jitters[nj++] = cell->maxjitter;
+		    lost += cell->lost;
+		    datagrams += cell->datagrams;
+		    if (cell->lost > 0)
+			lossy++;
+		}
+	    }
+	    qsort(speeds, n, sizeof(double), cmp_double);
+	    qsort(jitters, nj, sizeof(double), cmp_double);
+	    if (lossy > 1)
+		correlated++;
+	    lossyflows_total += lossy;
+	    if (json) {
+		fprintf(out, "%s{\"start\":%.3f,\"end\":%.3f,\"flows\":%d,\"bytes\":%.0f,\"bits_per_sec\":%.0f," \
+			"\"speed_p50\":%.0f,\"speed_p95\":%.0f,\"speed_p99\":%.0f,\"speed_min\":%.0f," \
+			"\"lost\":%" PRIdMAX ",\"datagrams\":%" PRIdMAX ",\"loss_pct\":%.3f," \
+			"\"jitter_p50\":%.3f,\"jitter_p95\":%.3f,\"jitter_max\":%.3f,\"lossy_flows\":%d}",
+			(buckets ? "," : ""), bucket * bucketwidth, (bucket + 1) * bucketwidth, n, bytes, speed,
+			percentile(speeds, n, 50), percentile(speeds, n, 95), percentile(speeds, n, 99), speeds[0],
+			lost, datagrams, (datagrams ? (100.0 * lost) / datagrams : 0.0),
+			percentile(jitters, nj, 50), percentile(jitters, nj, 95), (nj ? jitters[nj - 1] : 0.0), lossy);
+	    } else {
+		fprintf(out, "%.3f,%.3f,%d,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%" PRIdMAX ",%" PRIdMAX ",%.3f,%.3f,%.3f,%.3f,%d\n",
+			bucket * bucketwidth, (bucket + 1) * bucketwidth, n, bytes, speed,
+			percentile(speeds, n, 50), percentile(speeds, n, 95), percentile(speeds, n, 99), speeds[0],
+			lost, datagrams, (datagrams ? (100.0 * lost) / datagrams : 0.0),
+			percentile(jitters, nj, 50), percentile(jitters, nj, 95), (nj ? jitters[nj - 1] : 0.0), lossy);
+	    }
+	    buckets++;
+	}
+	if (json)
+	    fprintf(out, "]}\n");
+
+	/*
+	 * Summary, written to stderr when the bucket table goes to stdout
+	 * so the two can be separated
+	 */
+	{
+	    FILE *sum = (out == stdout) ? stderr : stdout;
+	    int episodes = 0, longest = 0;
+	    int prevflow = -1, prevbucket = 0, run = 0;
+	    // loss episodes are runs of consecutive lossy buckets per flow,
+	    // the bucket table is done so re-sort the cells by flow
+	    qsort(global.cells, global.cellcnt, sizeof(cell_t), cmp_cell_flow);
+	    for (ix = 0; ix < global.cellcnt; ix++) {
+		cell_t *cell = &global.cells[ix];
+		if ((cell->flow != prevflow) || (cell->bucket != prevbucket + 1) || (cell->lost == 0)) {
+		    if (run > longest)
+			longest = run;
+		    run = 0;
+		}
+		if (cell->lost > 0) {
+		    if (run == 0)
+			episodes++;
+		    run++;
+		}
+		prevflow = cell->flow;
+		prevbucket = cell->bucket;
+	    }
+	    if (run > longest)
+		longest = run;
+	    fprintf(sum, "Records: %" PRIdMAX " (%" PRIdMAX " skipped, %" PRIdMAX " sums) Flows: %d Buckets: %d of %.3f sec using %d threads/%d chunks\n",
+		    global.lines, global.skipped, global.sums, global.flowcnt, buckets, bucketwidth, threads, chunkcnt);
+	    fprintf(sum, "Loss episodes: %d (longest %d buckets), buckets with correlated loss (>1 flow): %d, lossy flow-buckets: %d\n",
+		    episodes, longest, correlated, lossyflows_total);
+	    for (ix = 0; ix < global.flowcnt; ix++) {
+		flow_t *f = &global.flows[ix];
+		if (f->havefinal) {
+		    fprintf(sum, "Flow %s: final %.0f bytes %.0f bits/sec", f->key, f->finalbytes, f->finalspeed);
+		    if (f->isudp)
+			fprintf(sum, " lost/total %" PRIdMAX "/%" PRIdMAX, f->finallost, f->finaldatagrams);
+		} else {
+		    fprintf(sum, "Flow %s: %d intervals %.0f bytes", f->key, f->intervals, f->bytes);
+		    if (f->isudp)
+			fprintf(sum, " lost/total %" PRIdMAX "/%" PRIdMAX, f->lost, f->datagrams);
+		}
+		if (f->isudp)
+		    fprintf(sum, " max jitter %.3f ms", f->maxjitter);
+		fprintf(sum, "\n");
+	    }
+	}
+	free(speeds);
+	free(jitters);
+    }
+    if (out != stdout)
+	fclose(out);
+    table_free(&global);
+    free(chunks);
+    return 0;
+}
+#endif
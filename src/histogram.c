@@ -47,17 +47,19 @@
  */
 #include "headers.h"
 #include "histogram.h"
+#include "pool.h"
 
 histogram_t *histogram_init(unsigned int bincount, unsigned int binwidth, float offset, float units,\
 			    double ci_lower, double ci_upper, unsigned int id, char *name) {
-    histogram_t *this = (histogram_t *) malloc(sizeof(histogram_t));
-    this->mybins = (unsigned int *) malloc(sizeof(unsigned int) * bincount);
-    this->myname = (char *) malloc(sizeof(strlen(name)));
-    this->outbuf = (char *) malloc(120 + (32*bincount) + strlen(name));
-    if (!this->outbuf || !this || !this->mybins || !this->myname) {
+    size_t namelen = strlen(name);
+    histogram_t *this = (histogram_t *) pool_get(POOL_HISTOGRAM, HISTOGRAM_SIZE(bincount, namelen));
+    if (!this) {
 	fprintf(stderr,"Malloc failure in histogram init\n");
 	return(NULL);
     }
+    this->mybins = (unsigned int *) (this + 1);
+    this->myname = (char *) (this->mybins + bincount);
+    this->outbuf = this->myname + namelen + 1;
     memset(this->mybins, 0, bincount * sizeof(unsigned int));
     strcpy(this->myname, name);
     this->id = id;
@@ -78,11 +80,7 @@ histogram_t *histogram_init(unsigned int bincount, unsigned int binwidth, float
 void histogram_delete(histogram_t *h) {
     if (h->prev)
 	histogram_delete(h->prev);
-    if (h->mybins)
-	free(h->mybins);
-    if (h->myname)
-	free(h->myname);
-    free(h);
+    pool_put(h);
 }
 
 // value is units seconds
@@ -94,7 +92,7 @@ int histogram_insert(histogram_t *h, float value) {
     if (bin < 0) {
 	h->cntloweroutofbounds++;
 	return(-1);
-    } else if (bin > (int) h->bincount) {
+    } else if (bin >= (int) h->bincount) {
 	h->cntupperoutofbounds++;
 	return(-2);
     }
@@ -56,6 +56,8 @@ using namespace Isochronous;
 FrameCounter::FrameCounter(double value)  : frequency(value) {
     period = (unsigned int) (1000000 / frequency);
     lastcounter = 0;
+    slip = 0;
+    late = 0;
 }
 
 unsigned int FrameCounter::get(long *ticks_remaining) {
@@ -78,11 +80,15 @@ unsigned int FrameCounter::wait_tick(void) {
     if (!lastcounter) {
 	reset();
 	framecounter = 1;
+	late = 0;
     } else {
 	framecounter = get(&remaining);
 	if ((framecounter - lastcounter) > 1)
 	    slip++;
     	delay_loop(remaining);
+	// the tick waited for is the start of frame framecounter + 1
+	Timestamp wakeTime;
+	late = -startTime.subUsec(wakeTime) - (long) framecounter * period;
 	framecounter ++;
     }
     lastcounter = framecounter;
@@ -70,6 +70,12 @@
 #include "Listener.hpp"
 #include "List.h"
 #include "util.h"
+#include "Processes.h"
+#include "Softirqs.h"
+#include "Energy.h"
+#include "verify.h"
+#include "pool.h"
+#include "batch.h"
 
 #ifdef WIN32
 #include "service.h"
@@ -80,6 +86,8 @@
  * ------------------------------------------------------------------- */
 // Function called at exit to clean up as much as possible
 void cleanup( void );
+// Holds the PM QoS cpu_dma_latency request per --cpu-dma-latency
+static void cpu_dma_latency_hold( thread_Settings *mSettings );
 
 /* -------------------------------------------------------------------
  * global variables
@@ -92,6 +100,10 @@ extern "C" {
     int groupID = 0;
     // Mutex to protect access to the above ID
     Mutex groupCond;
+    // Protects the --sum-groups aggregation group list
+    Mutex aggrgroupCond;
+    // Protects the UDP FIN round trip estimate shared by client threads
+    Mutex udpfinCond;
     // Condition used to signal the reporter thread
     // when a packet ring is full.  Shouldn't really
     // be needed but is "belts and suspeners"
@@ -107,6 +119,8 @@ nthread_t sThread;
 // The main thread uses this function to wait
 // for all other threads to complete
 void waitUntilQuit( void );
+// The PM QoS request lasts as long as this stays open
+static int sCpuDmaLatencyFd = -1;
 
 /* -------------------------------------------------------------------
  * main()
@@ -143,7 +157,11 @@ int main( int argc, char **argv ) {
     // Initialize global mutexes and conditions
     Condition_Initialize ( &ReportCond );
     Mutex_Initialize( &groupCond );
+    Mutex_Initialize( &aggrgroupCond );
+    Mutex_Initialize( &udpfinCond );
     Mutex_Initialize( &clients_mutex );
+    pool_init( );
+    batch_init( );
 
     // Initialize the thread subsystem
     thread_init( );
@@ -192,6 +210,28 @@ int main( int argc, char **argv ) {
 	return 0;
     }
 
+    if ( isCpuDmaLatency( ext_gSettings ) ) {
+	cpu_dma_latency_hold( ext_gSettings );
+    }
+
+    if ( isVerify( ext_gSettings ) ) {
+	crc32c_init( );
+    }
+
+    if ( isSoftirqs( ext_gSettings ) ) {
+	softirqs_open( ext_gSettings );
+    }
+
+    if ( isEnergy( ext_gSettings ) ) {
+	energy_open();
+    }
+
+    // Split into worker processes before any threads exist, only
+    // the workers return, the parent sums their reports and exits
+    if ( ext_gSettings->mProcesses > 1 ) {
+	procs_fork( ext_gSettings );
+    }
+
     unsetReport(ext_gSettings);
     switch (ext_gSettings->mThreadMode) {
     case kMode_Client :
@@ -202,6 +242,10 @@ int main( int argc, char **argv ) {
         // initialize client(s)
 		//	初始化客户端
         client_init( ext_gSettings );
+	// only the first worker prints the client settings
+	if ( procs_index > 0 ) {
+	    unsetReport( ext_gSettings );
+	}
 	ReporterThreadMode = kMode_ReporterClient;
 	break;
     case kMode_Listener :
@@ -293,6 +337,31 @@ void Sig_Interupt( int inSigno ) {
 #endif
 }
 
+/* -------------------------------------------------------------------
+ * Writes the --cpu-dma-latency value to /dev/cpu_dma_latency.  The
+ * kernel keeps the CPUs out of C-states with a longer exit latency
+ * for as long as the file is held open, i.e. for the whole test.
+ * A failure only warns, the reports then say the value isn't held.
+ * ------------------------------------------------------------------- */
+
+static void cpu_dma_latency_hold( thread_Settings *mSettings ) {
+#ifndef WIN32
+    int32_t value = mSettings->mCpuDmaLatency;
+    int fd = open( "/dev/cpu_dma_latency", O_RDWR );
+    if ( (fd < 0) || (write( fd, &value, sizeof(value) ) != sizeof(value)) ) {
+	WARN_errno( 1, "cpu_dma_latency" );
+	if ( fd >= 0 )
+	    close( fd );
+	mSettings->mCpuDmaLatency = -1;
+	return;
+    }
+    sCpuDmaLatencyFd = fd;
+    printf( report_cpu_dma_latency, value );
+#else
+    mSettings->mCpuDmaLatency = -1;
+#endif
+}
+
 /* -------------------------------------------------------------------
  * Any necesary cleanup before Iperf quits. Called at program exit,
  * either by exit() or terminating main().
@@ -306,6 +375,15 @@ void cleanup( void ) {
     // clean up the list of clients
     Iperf_destroy ( &clients );
 
+    // release the PM QoS request
+    if ( sCpuDmaLatencyFd >= 0 ) {
+	close( sCpuDmaLatencyFd );
+	sCpuDmaLatencyFd = -1;
+    }
+
+#ifdef HAVE_THREAD_DEBUG
+    pool_debug( );
+#endif
     // shutdown the thread subsystem
     thread_destroy( );
 } // end cleanup
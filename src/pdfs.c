@@ -57,6 +57,7 @@
 #include <time.h>
 #include <math.h>
 #include "headers.h"
+#include "util.h"
 #include "pdfs.h"
 
 #define FALSE 0
@@ -98,3 +99,177 @@ float lognormal(float mu, float sigma) {
     float sigma_prime = sqrt(log((phi * phi)/(mu * mu)));
     return (exp(normal(mu_prime,sigma_prime)));
 }
+
+void pdf_rand_seed(pdf_rand *r, uint64_t seed) {
+    // the state must not be zero
+    r->state = seed ? seed : 0x9E3779B97F4A7C15ULL;
+    r->spare = FALSE;
+}
+
+static inline uint64_t pdf_rand_next(pdf_rand *r) {
+    r->state ^= r->state >> 12;
+    r->state ^= r->state << 25;
+    r->state ^= r->state >> 27;
+    return r->state * 0x2545F4914F6CDD1DULL;
+}
+
+double pdf_rand_unit(pdf_rand *r) {
+    // top 53 bits, uniform on [0,1)
+    return (pdf_rand_next(r) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static float box_muller_r(pdf_rand *r) {
+    float x1, x2, w;
+    if (r->spare) {
+	r->spare = FALSE;
+	return r->y2;
+    }
+    do {
+	x1 = 2.0 * pdf_rand_unit(r) - 1.0;
+	x2 = 2.0 * pdf_rand_unit(r) - 1.0;
+	w = x1 * x1 + x2 * x2;
+    } while (w >= 1.0 || w == 0.0);
+    w = sqrt( (-2.0 * log( w ) ) / w );
+    r->y2 = x2 * w;
+    r->spare = TRUE;
+    return (x1 * w);
+}
+
+float lognormal_r(pdf_rand *r, float mu, float sigma) {
+    float phi = sqrt((mu * mu) + (sigma * sigma));
+    float mu_prime = log(((mu * mu)/phi));
+    float sigma_prime = sqrt(log((phi * phi)/(mu * mu)));
+    return (exp(box_muller_r(r) * sigma_prime + mu_prime));
+}
+
+static int size_pdf_list(size_pdf *pdf, const char *list) {
+    char *tmp = strdup(list), *tok, *save = NULL;
+    pdf->sizes = (int *) calloc(SIZEPDF_MAXPOINTS, sizeof(int));
+    if (!tmp || !pdf->sizes) {
+	free(tmp);
+	return -1;
+    }
+    for (tok = strtok_r(tmp, ",", &save); tok && (pdf->cnt < SIZEPDF_MAXPOINTS); tok = strtok_r(NULL, ",", &save)) {
+	int size = byte_atoi(tok);
+	if (size <= 0)
+	    break;
+	pdf->sizes[pdf->cnt++] = size;
+	if (size > pdf->maxsize)
+	    pdf->maxsize = size;
+    }
+    free(tmp);
+    return ((pdf->cnt > 0) && !tok) ? 0 : -1;
+}
+
+static int size_pdf_cdf(size_pdf *pdf, const char *filename) {
+    FILE *fd;
+    char line[128];
+    double last = 0.0;
+    int ix;
+    if ((fd = fopen(filename, "r")) == NULL) {
+	fprintf(stderr, "write sizes cdf file %s: %s\n", filename, strerror(errno));
+	return -1;
+    }
+    pdf->sizes = (int *) calloc(SIZEPDF_MAXPOINTS, sizeof(int));
+    pdf->cdf = (double *) calloc(SIZEPDF_MAXPOINTS, sizeof(double));
+    while (pdf->sizes && pdf->cdf && fgets(line, sizeof(line), fd)) {
+	char size[64];
+	double p;
+	if ((line[0] == '#') || (sscanf(line, "%63s %lf", size, &p) != 2))
+	    continue;
+	// probabilities must rise to 1.0
+	if ((pdf->cnt == SIZEPDF_MAXPOINTS) || (byte_atoi(size) <= 0) || (p < last) || (p > 1.0)) {
+	    pdf->cnt = 0;
+	    break;
+	}
+	pdf->sizes[pdf->cnt] = byte_atoi(size);
+	pdf->cdf[pdf->cnt++] = last = p;
+	if (pdf->sizes[pdf->cnt - 1] > pdf->maxsize)
+	    pdf->maxsize = pdf->sizes[pdf->cnt - 1];
+    }
+    fclose(fd);
+    if (!pdf->cnt || (last <= 0.0)) {
+	fprintf(stderr, "write sizes cdf file %s: expected lines of <size> <rising probability>\n", filename);
+	return -1;
+    }
+    // normalize, a file may end short of 1.0
+    for (ix = 0; ix < pdf->cnt; ix++)
+	pdf->cdf[ix] /= last;
+    return 0;
+}
+
+int size_pdf_parse(size_pdf *pdf, const char *spec) {
+    const char *args = strchr(spec, ':');
+    int rc = -1;
+    memset(pdf, 0, sizeof(size_pdf));
+    if (!args++)
+	return -1;
+    if (strncmp(spec, "fixed:", 6) == 0) {
+	pdf->type = SIZEPDF_FIXED;
+	rc = size_pdf_list(pdf, args);
+    } else if (strncmp(spec, "cdf:", 4) == 0) {
+	pdf->type = SIZEPDF_CDF;
+	rc = size_pdf_cdf(pdf, args);
+    } else if ((strncmp(spec, "uniform:", 8) == 0) || (strncmp(spec, "lognormal:", 10) == 0)) {
+	pdf->type = (spec[0] == 'u') ? SIZEPDF_UNIFORM : SIZEPDF_LOGNORMAL;
+	if (((rc = size_pdf_list(pdf, args)) == 0) && (pdf->cnt == 2)) {
+	    pdf->a = pdf->sizes[0];
+	    pdf->b = pdf->sizes[1];
+	    if (pdf->type == SIZEPDF_LOGNORMAL)
+		pdf->maxsize = 0;
+	    else if (pdf->a > pdf->b)
+		rc = -1;
+	} else {
+	    rc = -1;
+	}
+    }
+    if (rc)
+	size_pdf_free(pdf);
+    return rc;
+}
+
+void size_pdf_free(size_pdf *pdf) {
+    free(pdf->sizes);
+    free(pdf->cdf);
+    pdf->sizes = NULL;
+    pdf->cdf = NULL;
+    pdf->cnt = 0;
+}
+
+/*
+ * Draw the next write size, clamped to [1, cap]
+ */
+int size_pdf_draw(size_pdf *pdf, pdf_rand *r, int cap) {
+    int size = cap;
+    switch (pdf->type) {
+    case SIZEPDF_FIXED :
+	size = pdf->sizes[(pdf->cnt > 1) ? (int) (pdf_rand_unit(r) * pdf->cnt) : 0];
+	break;
+    case SIZEPDF_UNIFORM :
+	size = (int) (pdf->a + pdf_rand_unit(r) * (pdf->b - pdf->a + 1));
+	break;
+    case SIZEPDF_LOGNORMAL :
+	size = (int) round(lognormal_r(r, pdf->a, pdf->b));
+	break;
+    case SIZEPDF_CDF :
+    {
+	// first point whose cumulative probability covers the draw
+	double u = pdf_rand_unit(r);
+	int lo = 0, hi = pdf->cnt - 1;
+	while (lo < hi) {
+	    int mid = (lo + hi) / 2;
+	    if (pdf->cdf[mid] > u)
+		hi = mid;
+	    else
+		lo = mid + 1;
+	}
+	size = pdf->sizes[lo];
+	break;
+    }
+    default :
+	break;
+    }
+    if (size < 1)
+	size = 1;
+    return (size > cap) ? cap : size;
+}
@@ -0,0 +1,325 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * pool.c
+ * Typed object pools: per-thread caches over a shared depot
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "Mutex.h"
+#include "Settings.hpp"
+#include "Reporter.h"
+#include "histogram.h"
+#include "pool.h"
+
+#define POOL_LIVE 0x4c495645	// "LIVE"
+#define POOL_FREE 0x46524545	// "FREE"
+
+// the header ahead of every object, keeps the object aligned like malloc
+typedef union pool_obj {
+    struct {
+	union pool_obj *next;
+	uint32_t magic;
+	uint16_t pool;
+	uint16_t oversize;
+    } hdr;
+    long double align;
+} pool_obj;
+
+typedef struct pool_t {
+    const char *name;
+    size_t size;
+    int cachemax;		// objects per thread
+    int depotmax;
+    pool_obj *depot;
+    pool_stats stats;		// gets and puts of exited threads
+} pool_t;
+
+static pool_t pools[POOL_MAX] = {
+    {"reporthdr", sizeof(ReportHeader), 8, 64, NULL, {0}},
+    {"multihdr", sizeof(MultiHeader) + sizeof(ReporterData) + NUM_MULTI_SLOTS * sizeof(Transfer_Info), 2, 8, NULL, {0}},
+    {"packetring", sizeof(PacketRing) + NUM_REPORT_STRUCTS * sizeof(ReportStruct), 1, 4, NULL, {0}},
+    // 1000 bins is the --rx-histogram default, names are up to a full report's
+    {"histogram", HISTOGRAM_SIZE(1000, FULLREPORT_NAMELEN - 1), 4, 16, NULL, {0}}
+};
+static Mutex pool_mutex;
+
+#if defined(HAVE_POSIX_THREAD)
+typedef struct pool_cache {
+    pool_obj *head[POOL_MAX];
+    int count[POOL_MAX];
+    intmax_t gets[POOL_MAX];
+    intmax_t puts[POOL_MAX];
+    struct pool_cache *next;
+} pool_cache;
+
+static pthread_key_t pool_key;
+static pool_cache *pool_caches = NULL;	// all threads' caches, for the stats
+
+// return objects to the depot, or to malloc when it's full, down to keep
+static void pool_flush (pool_cache *cache, int id, int keep) {
+    pool_t *pool = &pools[id];
+    pool_obj *obj;
+    Mutex_Lock(&pool_mutex);
+    while (cache->count[id] > keep) {
+	obj = cache->head[id];
+	cache->head[id] = obj->hdr.next;
+	cache->count[id]--;
+	if (pool->stats.depot < pool->depotmax) {
+	    obj->hdr.next = pool->depot;
+	    pool->depot = obj;
+	    pool->stats.depot++;
+	} else {
+	    free(obj);
+	    pool->stats.frees++;
+	}
+    }
+    Mutex_Unlock(&pool_mutex);
+}
+
+static void pool_refill (pool_cache *cache, int id) {
+    pool_t *pool = &pools[id];
+    pool_obj *obj;
+    int batch = (pool->cachemax > 1) ? (pool->cachemax / 2) : 1;
+    Mutex_Lock(&pool_mutex);
+    while (batch-- && pool->depot) {
+	obj = pool->depot;
+	pool->depot = obj->hdr.next;
+	pool->stats.depot--;
+	obj->hdr.next = cache->head[id];
+	cache->head[id] = obj;
+	cache->count[id]++;
+    }
+    Mutex_Unlock(&pool_mutex);
+}
+
+static void pool_cache_release (void *arg) {
+    pool_cache *cache = (pool_cache *) arg;
+    pool_cache **pp;
+    int ix;
+    for (ix = 0; ix < POOL_MAX; ix++)
+	pool_flush(cache, ix, 0);
+    Mutex_Lock(&pool_mutex);
+    for (ix = 0; ix < POOL_MAX; ix++) {
+	pools[ix].stats.gets += cache->gets[ix];
+	pools[ix].stats.puts += cache->puts[ix];
+    }
+    for (pp = &pool_caches; *pp; pp = &(*pp)->next) {
+	if (*pp == cache) {
+	    *pp = cache->next;
+	    break;
+	}
+    }
+    Mutex_Unlock(&pool_mutex);
+    free(cache);
+}
+
+static pool_cache *pool_cache_self (void) {
+    pool_cache *cache = (pool_cache *) pthread_getspecific(pool_key);
+    if (!cache && (cache = (pool_cache *) calloc(1, sizeof(pool_cache)))) {
+	pthread_setspecific(pool_key, cache);
+	Mutex_Lock(&pool_mutex);
+	cache->next = pool_caches;
+	pool_caches = cache;
+	Mutex_Unlock(&pool_mutex);
+    }
+    return cache;
+}
+#endif
+
+void pool_init (void) {
+    Mutex_Initialize(&pool_mutex);
+#if defined(HAVE_POSIX_THREAD)
+    pthread_key_create(&pool_key, pool_cache_release);
+#endif
+}
+
+void *pool_get (int id, size_t size) {
+    pool_t *pool = &pools[id];
+    pool_obj *obj = NULL;
+    if (size > pool->size) {
+	// not worth caching, malloc'd but still tracked
+	if ((obj = (pool_obj *) malloc(sizeof(pool_obj) + size)) == NULL)
+	    return NULL;
+	obj->hdr.oversize = 1;
+	Mutex_Lock(&pool_mutex);
+	pool->stats.gets++;
+	pool->stats.mallocs++;
+	pool->stats.oversize++;
+	Mutex_Unlock(&pool_mutex);
+    } else {
+#if defined(HAVE_POSIX_THREAD)
+	pool_cache *cache = pool_cache_self();
+	if (cache) {
+	    if (!cache->head[id])
+		pool_refill(cache, id);
+	    if ((obj = cache->head[id]) != NULL) {
+		cache->head[id] = obj->hdr.next;
+		cache->count[id]--;
+	    }
+	    cache->gets[id]++;
+	}
+	if (!obj) {
+	    if ((obj = (pool_obj *) malloc(sizeof(pool_obj) + pool->size)) == NULL)
+		return NULL;
+	    Mutex_Lock(&pool_mutex);
+	    if (!cache)
+		pool->stats.gets++;
+	    pool->stats.mallocs++;
+	    Mutex_Unlock(&pool_mutex);
+	}
+#else
+	Mutex_Lock(&pool_mutex);
+	if ((obj = pool->depot) != NULL) {
+	    pool->depot = obj->hdr.next;
+	    pool->stats.depot--;
+	}
+	pool->stats.gets++;
+	Mutex_Unlock(&pool_mutex);
+	if (!obj) {
+	    if ((obj = (pool_obj *) malloc(sizeof(pool_obj) + pool->size)) == NULL)
+		return NULL;
+	    Mutex_Lock(&pool_mutex);
+	    pool->stats.mallocs++;
+	    Mutex_Unlock(&pool_mutex);
+	}
+#endif
+	obj->hdr.oversize = 0;
+    }
+    obj->hdr.next = NULL;
+    obj->hdr.magic = POOL_LIVE;
+    obj->hdr.pool = id;
+    return (void *) (obj + 1);
+}
+
+void *pool_getz (int id, size_t size) {
+    void *p = pool_get(id, size);
+    if (p)
+	memset(p, 0, size);
+    return p;
+}
+
+void pool_put (void *p) {
+    pool_obj *obj;
+    pool_t *pool;
+    if (!p)
+	return;
+    obj = ((pool_obj *) p) - 1;
+    if ((obj->hdr.magic != POOL_LIVE) || (obj->hdr.pool >= POOL_MAX)) {
+	// leaked rather than risk freeing what isn't ours
+	fprintf(stderr, "ERROR: pool put of %s object %p\n", \
+		((obj->hdr.magic == POOL_FREE) ? "an already put" : "a foreign"), p);
+	Mutex_Lock(&pool_mutex);
+	pools[(obj->hdr.pool < POOL_MAX) ? obj->hdr.pool : POOL_REPORTHDR].stats.badputs++;
+	Mutex_Unlock(&pool_mutex);
+	return;
+    }
+    pool = &pools[obj->hdr.pool];
+    obj->hdr.magic = POOL_FREE;
+    if (obj->hdr.oversize) {
+	free(obj);
+	Mutex_Lock(&pool_mutex);
+	pool->stats.puts++;
+	pool->stats.frees++;
+	Mutex_Unlock(&pool_mutex);
+	return;
+    }
+#if defined(HAVE_POSIX_THREAD)
+    pool_cache *cache = pool_cache_self();
+    if (cache) {
+	int id = obj->hdr.pool;
+	obj->hdr.next = cache->head[id];
+	cache->head[id] = obj;
+	cache->count[id]++;
+	cache->puts[id]++;
+	if (cache->count[id] > pool->cachemax)
+	    pool_flush(cache, id, pool->cachemax / 2);
+	return;
+    }
+#endif
+    Mutex_Lock(&pool_mutex);
+    pool->stats.puts++;
+    if (pool->stats.depot < pool->depotmax) {
+	obj->hdr.next = pool->depot;
+	pool->depot = obj;
+	pool->stats.depot++;
+    } else {
+	free(obj);
+	pool->stats.frees++;
+    }
+    Mutex_Unlock(&pool_mutex);
+}
+
+void pool_thread_flush (void) {
+#if defined(HAVE_POSIX_THREAD)
+    pool_cache *cache = (pool_cache *) pthread_getspecific(pool_key);
+    int ix;
+    if (cache) {
+	for (ix = 0; ix < POOL_MAX; ix++)
+	    pool_flush(cache, ix, 0);
+    }
+#endif
+}
+
+void pool_getstats (int id, pool_stats *stats) {
+    Mutex_Lock(&pool_mutex);
+    *stats = pools[id].stats;
+    stats->name = pools[id].name;
+    stats->size = pools[id].size;
+#if defined(HAVE_POSIX_THREAD)
+    pool_cache *cache;
+    // other threads' counts may be a little stale
+    for (cache = pool_caches; cache; cache = cache->next) {
+	stats->gets += cache->gets[id];
+	stats->puts += cache->puts[id];
+    }
+#endif
+    Mutex_Unlock(&pool_mutex);
+}
+
+void pool_debug (void) {
+    pool_stats stats;
+    int ix;
+    for (ix = 0; ix < POOL_MAX; ix++) {
+	pool_getstats(ix, &stats);
+	printf("pool %s size=%zu gets/puts/live=%jd/%jd/%jd malloc/free=%jd/%jd oversize=%jd badputs=%jd depot=%d\n", \
+	       stats.name, stats.size, stats.gets, stats.puts, (stats.gets - stats.puts), \
+	       stats.mallocs, stats.frees, stats.oversize, stats.badputs, stats.depot);
+    }
+}
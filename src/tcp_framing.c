@@ -0,0 +1,172 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * tcp_framing.c
+ * Recovery of the client's writes from a TCP stream (--tcp-framing)
+ *
+ * TCP is a byte stream, a read may hold the tail of one write and
+ * several more writes, or a piece of one.  The parser follows the
+ * TCP_datagram headers and skips over the bodies without touching
+ * them.  A header that doesn't check out, e.g. after a short write
+ * by the client, loses the framing and the parser searches for the
+ * next header type word.
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "tcp_framing.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    TCPFRAME_SYNC = 0,
+    TCPFRAME_HDR,
+    TCPFRAME_BODY,
+};
+
+// first byte of HEADER_TIMESTAMP in network order
+#define TCPFRAME_LEAD ((HEADER_TIMESTAMP >> 24) & 0xFF)
+
+void tcpframe_init (TcpFrameParser *parser) {
+    memset(parser, 0, sizeof(TcpFrameParser));
+    // the stream may open with the client's test headers, those
+    // aren't writes and don't count as lost framing
+    parser->state = TCPFRAME_HDR;
+}
+
+static int tcpframe_hdrcheck (const TCP_datagram *hdr) {
+    uint32_t len = ntohl(hdr->typelen.length);
+    return ((ntohl(hdr->typelen.type) == HEADER_TIMESTAMP) &&
+	    (len >= sizeof(TCP_datagram)) && (len <= TCPFRAME_MAXLEN) &&
+	    !(ntohl(hdr->id2) & 0x80000000) && (hdr->reserved1 == 0) && (hdr->reserved2 == 0));
+}
+
+/*
+ * Advance over the next len bytes of buf.  Returns 1 when they hold
+ * the last byte of a write, with frame filled in and buf and len
+ * moved past it, else 0 with the buffer used up.
+ */
+int tcpframe_next (TcpFrameParser *parser, const char **buf, int *len, TcpFrame *frame) {
+    const unsigned char *p = (const unsigned char *) *buf;
+    const unsigned char *end = p + *len;
+    const unsigned char *q;
+    TCP_datagram hdr;
+    int n;
+
+    while (p < end) {
+	switch (parser->state) {
+	case TCPFRAME_SYNC :
+	    if ((q = (const unsigned char *) memchr(p, TCPFRAME_LEAD, end - p)) == NULL) {
+		p = end;
+	    } else {
+		p = q;
+		parser->have = 0;
+		parser->state = TCPFRAME_HDR;
+	    }
+	    break;
+	case TCPFRAME_HDR :
+	    n = sizeof(TCP_datagram) - parser->have;
+	    if (n > (end - p))
+		n = end - p;
+	    memcpy(&parser->hdr[parser->have], p, n);
+	    p += n;
+	    if ((parser->have += n) < (int) sizeof(TCP_datagram))
+		break;
+	    memcpy(&hdr, parser->hdr, sizeof(hdr));
+	    if (!tcpframe_hdrcheck(&hdr)) {
+		if (parser->synced) {
+		    parser->synced = 0;
+		    parser->resyncs++;
+		}
+		// the next header may start within the staged bytes
+		q = (const unsigned char *) memchr(&parser->hdr[1], TCPFRAME_LEAD, sizeof(TCP_datagram) - 1);
+		if (q) {
+		    parser->have = &parser->hdr[sizeof(TCP_datagram)] - q;
+		    memmove(parser->hdr, q, parser->have);
+		} else {
+		    parser->state = TCPFRAME_SYNC;
+		}
+		break;
+	    }
+	    parser->synced = 1;
+	    parser->have = 0;
+#ifdef HAVE_INT64_T
+	    parser->frame.id = ((intmax_t) ntohl(hdr.id2) << 32) | ntohl(hdr.id);
+#else
+	    parser->frame.id = ntohl(hdr.id);
+#endif
+	    parser->frame.len = ntohl(hdr.typelen.length);
+	    parser->frame.sent.tv_sec = ntohl(hdr.tv_sec);
+	    parser->frame.sent.tv_usec = ntohl(hdr.tv_usec);
+	    parser->remaining = parser->frame.len - sizeof(TCP_datagram);
+	    if (parser->remaining) {
+		parser->state = TCPFRAME_BODY;
+		break;
+	    }
+	    *frame = parser->frame;
+	    *buf = (const char *) p;
+	    *len = end - p;
+	    return 1;
+	case TCPFRAME_BODY :
+	    // the body is skipped, not read
+	    if (parser->remaining > (uintmax_t) (end - p)) {
+		parser->remaining -= end - p;
+		p = end;
+		break;
+	    }
+	    p += parser->remaining;
+	    parser->remaining = 0;
+	    parser->state = TCPFRAME_HDR;
+	    *frame = parser->frame;
+	    *buf = (const char *) p;
+	    *len = end - p;
+	    return 1;
+	}
+    }
+    *buf = (const char *) p;
+    *len = 0;
+    return 0;
+}
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
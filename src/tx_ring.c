@@ -0,0 +1,374 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * tx_ring.c
+ * AF_PACKET PACKET_TX_RING packet generator (--tx-ring)
+ *
+ * TPACKET_V2 ring, a slot is the tpacket2_hdr followed by the frame.
+ * The kernel flips a slot back to TP_STATUS_AVAILABLE once its frame
+ * is on the wire (or rejected, PACKET_LOSS keeps a bad frame from
+ * stalling the ring.)  PACKET_QDISC_BYPASS hands the frames straight
+ * to the driver where the kernel supports it.
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "tx_ring.h"
+#include "SocketAddr.h"
+#include "util.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(HAVE_LINUX_FILTER_H) && defined(HAVE_AF_PACKET)
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <poll.h>
+#include <net/if.h>
+#include <net/route.h>
+#include <net/if_arp.h>
+
+// the frame follows the aligned tpacket2_hdr, see packet_mmap.txt
+#define TXRING_DATAOFF (TPACKET2_HDRLEN - sizeof(struct sockaddr_ll))
+#define TXRING_IP_DF 0x4000
+
+// the kernel packs whole slots into each block, any leftover at the
+// end of a block is skipped
+static inline struct tpacket2_hdr *tx_ring_slot (tx_ring *ring, int ix) {
+    return (struct tpacket2_hdr *) (ring->map + ((size_t) (ix / ring->perblock) * ring->block_size) + \
+				    ((size_t) (ix % ring->perblock) * ring->frame_size));
+}
+
+int tx_ring_open (tx_ring *ring, const char *ifname, int framelen, int frames) {
+    struct tpacket_req req;
+    struct sockaddr_ll sll;
+    int version = TPACKET_V2;
+    int optval = 1;
+    long pagesize = sysconf(_SC_PAGESIZE);
+    int rc;
+
+    memset(ring, 0, sizeof(tx_ring));
+    ring->framelen = framelen;
+    ring->sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_IP));
+    WARN_errno(ring->sock == INVALID_SOCKET, "tx ring socket (AF_PACKET)");
+    if (ring->sock == INVALID_SOCKET)
+	return -1;
+    // transmit only, don't queue the device's receive traffic
+    SockAddr_Drop_All_BPF(ring->sock);
+    rc = setsockopt(ring->sock, SOL_PACKET, PACKET_VERSION, &version, sizeof(version));
+    WARN_errno(rc < 0, "tx ring PACKET_VERSION");
+    if (rc < 0)
+	goto fail;
+    rc = setsockopt(ring->sock, SOL_PACKET, PACKET_LOSS, &optval, sizeof(optval));
+    WARN_errno(rc < 0, "tx ring PACKET_LOSS");
+#ifdef PACKET_QDISC_BYPASS
+    rc = setsockopt(ring->sock, SOL_PACKET, PACKET_QDISC_BYPASS, &optval, sizeof(optval));
+    WARN_errno(rc < 0, "tx ring PACKET_QDISC_BYPASS");
+#endif
+    // a block is whole pages holding one or more whole slots
+    ring->frame_size = TPACKET_ALIGN(TXRING_DATAOFF + framelen);
+    req.tp_block_size = ((ring->frame_size + pagesize - 1) / pagesize) * pagesize;
+    req.tp_frame_size = ring->frame_size;
+    ring->block_size = req.tp_block_size;
+    ring->perblock = req.tp_block_size / req.tp_frame_size;
+    req.tp_block_nr = (frames + ring->perblock - 1) / ring->perblock;
+    req.tp_frame_nr = req.tp_block_nr * ring->perblock;
+    rc = setsockopt(ring->sock, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req));
+    WARN_errno(rc < 0, "tx ring PACKET_TX_RING");
+    if (rc < 0)
+	goto fail;
+    ring->frame_nr = req.tp_frame_nr;
+    ring->maplen = (size_t) req.tp_block_size * req.tp_block_nr;
+    ring->map = (unsigned char *) mmap(NULL, ring->maplen, PROT_READ | PROT_WRITE, MAP_SHARED, ring->sock, 0);
+    WARN_errno(ring->map == MAP_FAILED, "tx ring mmap");
+    if (ring->map == MAP_FAILED) {
+	ring->map = NULL;
+	goto fail;
+    }
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_IP);
+    sll.sll_ifindex = if_nametoindex(ifname);
+    rc = bind(ring->sock, (struct sockaddr *) &sll, sizeof(sll));
+    WARN_errno(rc < 0, "tx ring bind");
+    if (rc < 0)
+	goto fail;
+    return 0;
+
+  fail:
+    tx_ring_close(ring);
+    return -1;
+}
+
+void tx_ring_close (tx_ring *ring) {
+    if (ring->map)
+	munmap(ring->map, ring->maplen);
+    ring->map = NULL;
+    if (ring->sock != INVALID_SOCKET)
+	close(ring->sock);
+    ring->sock = INVALID_SOCKET;
+}
+
+static uint16_t tx_ring_ipsum (const void *hdr, int len) {
+    const uint16_t *word = (const uint16_t *) hdr;
+    uint32_t sum = 0;
+    while (len > 1) {
+	sum += *word++;
+	len -= 2;
+    }
+    while (sum >> 16)
+	sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t) ~sum;
+}
+
+/*
+ * Ethernet/IPv4/UDP frame carrying payload, DF set and no UDP
+ * checksum (allowed for IPv4) so slots never need a checksum update
+ */
+int tx_ring_build_udp4 (unsigned char *frame, const unsigned char *srcmac, const unsigned char *dstmac,
+			const struct sockaddr_in *src, const struct sockaddr_in *dst, int tos, int ttl,
+			const char *payload, int len) {
+    struct ether_header *eth = (struct ether_header *) frame;
+    struct iphdr *ip = (struct iphdr *) (frame + sizeof(struct ether_header));
+    struct udphdr *udp = (struct udphdr *) ((unsigned char *) ip + sizeof(struct iphdr));
+
+    memcpy(eth->ether_dhost, dstmac, ETH_ALEN);
+    memcpy(eth->ether_shost, srcmac, ETH_ALEN);
+    eth->ether_type = htons(ETHERTYPE_IP);
+    memset(ip, 0, sizeof(struct iphdr));
+    ip->version = 4;
+    ip->ihl = sizeof(struct iphdr) / 4;
+    ip->tos = tos;
+    ip->tot_len = htons(sizeof(struct iphdr) + sizeof(struct udphdr) + len);
+    ip->frag_off = htons(TXRING_IP_DF);
+    ip->ttl = ttl;
+    ip->protocol = IPPROTO_UDP;
+    ip->saddr = src->sin_addr.s_addr;
+    ip->daddr = dst->sin_addr.s_addr;
+    ip->check = tx_ring_ipsum(ip, sizeof(struct iphdr));
+    udp->source = src->sin_port;
+    udp->dest = dst->sin_port;
+    udp->len = htons(sizeof(struct udphdr) + len);
+    udp->check = 0;
+    memcpy(frame + TXRING_UDP4_PAYLOAD, payload, len);
+    return (int) (TXRING_UDP4_PAYLOAD + len);
+}
+
+void tx_ring_template (tx_ring *ring, const unsigned char *frame) {
+    for (int ix = 0; ix < ring->frame_nr; ix++) {
+	struct tpacket2_hdr *hdr = tx_ring_slot(ring, ix);
+	memcpy((unsigned char *) hdr + TXRING_DATAOFF, frame, ring->framelen);
+	hdr->tp_len = ring->framelen;
+	hdr->tp_status = TP_STATUS_AVAILABLE;
+    }
+    ring->next = 0;
+}
+
+/*
+ * UDP payload of the next free slot, NULL while the kernel still
+ * holds it
+ */
+unsigned char *tx_ring_next (tx_ring *ring) {
+    struct tpacket2_hdr *hdr = tx_ring_slot(ring, ring->next);
+    unsigned int status = *(volatile unsigned int *) &hdr->tp_status;
+
+    if (status & TP_STATUS_WRONG_FORMAT) {
+	ring->rejected++;
+	hdr->tp_status = TP_STATUS_AVAILABLE;
+    } else if (status != TP_STATUS_AVAILABLE) {
+	return NULL;
+    }
+    return ((unsigned char *) hdr + TXRING_DATAOFF + TXRING_UDP4_PAYLOAD);
+}
+
+void tx_ring_queue (tx_ring *ring) {
+    struct tpacket2_hdr *hdr = tx_ring_slot(ring, ring->next);
+    hdr->tp_len = ring->framelen;
+    // the frame must be visible before the kernel sees the status
+    __sync_synchronize();
+    hdr->tp_status = TP_STATUS_SEND_REQUEST;
+    if (++ring->next == ring->frame_nr)
+	ring->next = 0;
+}
+
+/*
+ * Send everything queued, returns the bytes sent or -1
+ */
+int tx_ring_kick (tx_ring *ring) {
+    ring->kicks++;
+    return (int) send(ring->sock, NULL, 0, MSG_DONTWAIT);
+}
+
+int tx_ring_wait (tx_ring *ring, int msecs) {
+    struct pollfd pfd;
+    pfd.fd = ring->sock;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+    return poll(&pfd, 1, msecs);
+}
+
+/*
+ * Wait for the kernel to be through with every slot, e.g. so the
+ * FIN, which goes out the UDP socket, can't pass the last frames
+ */
+int tx_ring_drain (tx_ring *ring, int msecs) {
+    while (1) {
+	int busy = 0;
+	for (int ix = 0; ix < ring->frame_nr; ix++) {
+	    unsigned int status = *(volatile unsigned int *) &tx_ring_slot(ring, ix)->tp_status;
+	    if (status & (TP_STATUS_SEND_REQUEST | TP_STATUS_SENDING))
+		busy++;
+	}
+	if (!busy)
+	    return 0;
+	if (msecs-- <= 0)
+	    return busy;
+	tx_ring_kick(ring);
+	tx_ring_wait(ring, 1);
+    }
+}
+
+int tx_ring_ifmac (const char *ifname, unsigned char *mac, int *loopback, int *mtu) {
+    struct ifreq ifr;
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int rc = -1;
+
+    if (sock == INVALID_SOCKET)
+	return -1;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    if (ioctl(sock, SIOCGIFFLAGS, &ifr) == 0) {
+	*loopback = ((ifr.ifr_flags & IFF_LOOPBACK) != 0);
+	if (ioctl(sock, SIOCGIFMTU, &ifr) == 0)
+	    *mtu = ifr.ifr_mtu;
+	if (ioctl(sock, SIOCGIFHWADDR, &ifr) == 0) {
+	    memcpy(mac, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+	    rc = 0;
+	}
+    }
+    close(sock);
+    return rc;
+}
+
+static int tx_ring_sysctl (const char *ifname, const char *name) {
+    char path[128];
+    int value = 0;
+    FILE *fp;
+    snprintf(path, sizeof(path), "/proc/sys/net/ipv4/conf/%s/%s", ifname, name);
+    if ((fp = fopen(path, "r")) != NULL) {
+	if (fscanf(fp, "%d", &value) != 1)
+	    value = 0;
+	fclose(fp);
+    }
+    return value;
+}
+
+/*
+ * Frames injected on loopback come in as if from a wire, the kernel
+ * drops their local (127/8) source unless accept_local and
+ * route_localnet are set
+ */
+int tx_ring_loopback_ok (const char *ifname) {
+    return ((tx_ring_sysctl("all", "accept_local") || tx_ring_sysctl(ifname, "accept_local")) && \
+	    (tx_ring_sysctl("all", "route_localnet") || tx_ring_sysctl(ifname, "route_localnet")));
+}
+
+/*
+ * MAC of the next hop towards dst out ifname, the longest matching
+ * route's gateway or dst itself, from the kernel's neighbor table
+ */
+int tx_ring_neighbor (const char *ifname, struct in_addr dst, unsigned char *mac) {
+    char line[256], dev[IFNAMSIZ + 1];
+    unsigned long dest, gw, mask;
+    unsigned int flags;
+    unsigned long bestmask = 0;
+    int found = 0;
+    struct in_addr nexthop = dst;
+    FILE *fp = fopen("/proc/net/route", "r");
+
+    if (fp) {
+	while (fgets(line, sizeof(line), fp)) {
+	    if (sscanf(line, "%16s %lx %lx %x %*d %*d %*d %lx", dev, &dest, &gw, &flags, &mask) != 5)
+		continue;
+	    if (strcmp(dev, ifname) || !(flags & RTF_UP) || ((dst.s_addr & mask) != dest))
+		continue;
+	    if (!found || (ntohl(mask) > ntohl(bestmask))) {
+		found = 1;
+		bestmask = mask;
+		nexthop.s_addr = (flags & RTF_GATEWAY) ? (in_addr_t) gw : dst.s_addr;
+	    }
+	}
+	fclose(fp);
+    }
+    fp = fopen("/proc/net/arp", "r");
+    if (!fp)
+	return -1;
+    found = 0;
+    while (!found && fgets(line, sizeof(line), fp)) {
+	char ip[INET_ADDRSTRLEN + 1], hw[32];
+	struct in_addr addr;
+	if (sscanf(line, "%16s %*x %x %31s %*s %16s", ip, &flags, hw, dev) != 4)
+	    continue;
+	if (!(flags & ATF_COM) || strcmp(dev, ifname) || (inet_pton(AF_INET, ip, &addr) != 1) || \
+	    (addr.s_addr != nexthop.s_addr))
+	    continue;
+	found = (tx_ring_parse_mac(hw, mac) == 0);
+    }
+    fclose(fp);
+    return (found ? 0 : -1);
+}
+
+int tx_ring_parse_mac (const char *str, unsigned char *mac) {
+    unsigned int byte[ETH_ALEN];
+    if (sscanf(str, "%x:%x:%x:%x:%x:%x", &byte[0], &byte[1], &byte[2], &byte[3], &byte[4], &byte[5]) != ETH_ALEN)
+	return -1;
+    for (int ix = 0; ix < ETH_ALEN; ix++) {
+	if (byte[ix] > 0xFF)
+	    return -1;
+	mac[ix] = (unsigned char) byte[ix];
+    }
+    return 0;
+}
+#endif // HAVE_AF_PACKET
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
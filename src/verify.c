@@ -0,0 +1,328 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * verify.c
+ * Payload integrity verification (--verify)
+ *
+ * Nothing else in iperf looks at the payload, so corruption by NIC
+ * offloads, middleboxes or kTLS goes unnoticed.  Blocks carry a
+ * CRC32C (Castagnoli) trailer which the receiver checks as the bytes
+ * arrive, in a single pass and without buffering.
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "verify.h"
+#include <stddef.h>
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CRC32C_POLY 0x82F63B78	// reflected Castagnoli polynomial
+
+enum {
+    VERIFY_SYNC = 0,		// looking for the first block's magic
+    VERIFY_HDR,
+    VERIFY_BODY,
+    VERIFY_TRAILER
+};
+
+static uint32_t crc32c_tables[8][256];
+static uint32_t (*crc32c_fn)(uint32_t, const unsigned char *, size_t) = NULL;
+static const char *crc32c_name = "table";
+
+/*
+ * Slicing by 8 table fallback, the crc is pre and post inverted by
+ * the caller
+ */
+static uint32_t crc32c_sw (uint32_t crc, const unsigned char *p, size_t len) {
+    while (len && ((uintptr_t) p & 7)) {
+	crc = crc32c_tables[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	len--;
+    }
+    while (len >= 8) {
+	uint32_t lo = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24));
+	crc = crc32c_tables[7][lo & 0xff] ^ crc32c_tables[6][(lo >> 8) & 0xff] ^
+	      crc32c_tables[5][(lo >> 16) & 0xff] ^ crc32c_tables[4][lo >> 24] ^
+	      crc32c_tables[3][p[4]] ^ crc32c_tables[2][p[5]] ^
+	      crc32c_tables[1][p[6]] ^ crc32c_tables[0][p[7]];
+	p += 8;
+	len -= 8;
+    }
+    while (len--) {
+	crc = crc32c_tables[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42 (uint32_t crc, const unsigned char *p, size_t len) {
+    uint64_t crc64;
+    while (len && ((uintptr_t) p & 7)) {
+	crc = __builtin_ia32_crc32qi(crc, *p++);
+	len--;
+    }
+    crc64 = crc;
+    while (len >= 8) {
+	uint64_t word;
+	memcpy(&word, p, sizeof(word));
+	crc64 = __builtin_ia32_crc32di(crc64, word);
+	p += 8;
+	len -= 8;
+    }
+    crc = (uint32_t) crc64;
+    while (len--) {
+	crc = __builtin_ia32_crc32qi(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+static uint32_t crc32c_armv8 (uint32_t crc, const unsigned char *p, size_t len) {
+    while (len && ((uintptr_t) p & 7)) {
+	crc = __crc32cb(crc, *p++);
+	len--;
+    }
+    while (len >= 8) {
+	uint64_t word;
+	memcpy(&word, p, sizeof(word));
+	crc = __crc32cd(crc, word);
+	p += 8;
+	len -= 8;
+    }
+    while (len--) {
+	crc = __crc32cb(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+/*
+ * Build the tables and pick the implementation, call before any
+ * traffic threads start
+ */
+void crc32c_init (void) {
+    int ix, jx;
+    for (ix = 0; ix < 256; ix++) {
+	uint32_t crc = ix;
+	for (jx = 0; jx < 8; jx++)
+	    crc = (crc & 1) ? ((crc >> 1) ^ CRC32C_POLY) : (crc >> 1);
+	crc32c_tables[0][ix] = crc;
+    }
+    for (ix = 0; ix < 256; ix++) {
+	for (jx = 1; jx < 8; jx++) {
+	    uint32_t prev = crc32c_tables[jx - 1][ix];
+	    crc32c_tables[jx][ix] = crc32c_tables[0][prev & 0xff] ^ (prev >> 8);
+	}
+    }
+    crc32c_fn = crc32c_sw;
+#if defined(__x86_64__) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+	crc32c_fn = crc32c_sse42;
+	crc32c_name = "sse4.2";
+    }
+#endif
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+    crc32c_fn = crc32c_armv8;
+    crc32c_name = "armv8";
+#endif
+}
+
+const char *crc32c_impl (void) {
+    return crc32c_name;
+}
+
+/*
+ * Running CRC32C, start with a crc of zero and pass the previous
+ * result to continue across buffers
+ */
+uint32_t crc32c (uint32_t crc, const void *buf, size_t len) {
+    return ~(*crc32c_fn)(~crc, (const unsigned char *) buf, len);
+}
+
+uint32_t crc32c_table (uint32_t crc, const void *buf, size_t len) {
+    return ~crc32c_sw(~crc, (const unsigned char *) buf, len);
+}
+
+/*
+ * Write a verify block of len bytes (at least VERIFY_MINLEN,) the
+ * payload is an xorshift64* sequence seeded by the id
+ */
+void verify_fill (char *block, int len, uint32_t id) {
+    verify_hdr *hdr = (verify_hdr *) block;
+    uint64_t state = (id + 1ULL) * 0x9E3779B97F4A7C15ULL;
+    char *p = block + sizeof(verify_hdr);
+    int payload = len - VERIFY_MINLEN;
+    uint32_t crc;
+
+    hdr->magic = htonl(VERIFY_MAGIC);
+    hdr->length = htonl(len);
+    hdr->id = htonl(id);
+    hdr->reserved = 0;
+    while (payload > 0) {
+	uint64_t word;
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	word = state * 0x2545F4914F6CDD1DULL;
+	memcpy(p, &word, (payload < 8) ? payload : 8);
+	p += 8;
+	payload -= 8;
+    }
+    crc = htonl(crc32c(0, block, len - sizeof(uint32_t)));
+    memcpy(block + len - sizeof(uint32_t), &crc, sizeof(crc));
+}
+
+/*
+ * Check a verify block received whole, i.e. a UDP datagram's, returns
+ * non zero when it's intact and carries the expected id
+ */
+int verify_block (const char *block, int len, uint32_t id) {
+    verify_hdr hdr;
+    uint32_t crc;
+    if (len < VERIFY_MINLEN)
+	return 0;
+    memcpy(&hdr, block, sizeof(hdr));
+    memcpy(&crc, block + len - sizeof(uint32_t), sizeof(crc));
+    return ((ntohl(hdr.magic) == VERIFY_MAGIC) && (ntohl(hdr.length) == (uint32_t) len) &&
+	    (ntohl(hdr.id) == id) && (ntohl(crc) == crc32c(0, block, len - sizeof(uint32_t))));
+}
+
+void verify_stream_init (VerifyStream *stream) {
+    memset(stream, 0, sizeof(VerifyStream));
+    stream->state = VERIFY_SYNC;
+}
+
+/*
+ * Run the next len bytes of a TCP stream through the verifier,
+ * adding the blocks completed and the corrupt ones.  A block whose
+ * header is bad can't be framed, the stream then searches for the
+ * next magic.
+ */
+void verify_stream (VerifyStream *stream, const char *buf, int len, int *blocks, int *corrupt) {
+    const unsigned char *p = (const unsigned char *) buf;
+    const unsigned char *end = p + len;
+    static const unsigned char magic[4] = { 'i', 'p', 'v', 'f' };
+    while (p < end) {
+	switch (stream->state) {
+	case VERIFY_SYNC :
+	    // the magic may straddle reads, have counts its bytes matched
+	    if (*p == magic[stream->have]) {
+		stream->hdr[stream->have] = *p;
+		if (++stream->have == (int) sizeof(magic))
+		    stream->state = VERIFY_HDR;
+	    } else {
+		stream->have = (*p == magic[0]) ? 1 : 0;
+		stream->hdr[0] = magic[0];
+	    }
+	    p++;
+	    break;
+	case VERIFY_HDR :
+	{
+	    int n = sizeof(verify_hdr) - stream->have;
+	    verify_hdr hdr;
+	    if (n > (end - p))
+		n = end - p;
+	    memcpy(&stream->hdr[stream->have], p, n);
+	    p += n;
+	    if ((stream->have += n) < (int) sizeof(verify_hdr))
+		break;
+	    memcpy(&hdr, stream->hdr, sizeof(hdr));
+	    if ((ntohl(hdr.magic) != VERIFY_MAGIC) || (ntohl(hdr.length) < (uint32_t) VERIFY_MINLEN) ||
+		(ntohl(hdr.length) > VERIFY_MAXLEN)) {
+		(*blocks)++;
+		(*corrupt)++;
+		stream->have = 0;
+		stream->state = VERIFY_SYNC;
+		break;
+	    }
+	    stream->crc = crc32c(0, stream->hdr, sizeof(verify_hdr));
+	    stream->remaining = ntohl(hdr.length) - VERIFY_MINLEN;
+	    stream->have = 0;
+	    stream->state = stream->remaining ? VERIFY_BODY : VERIFY_TRAILER;
+	    break;
+	}
+	case VERIFY_BODY :
+	{
+	    uint32_t n = stream->remaining;
+	    if (n > (uint32_t) (end - p))
+		n = end - p;
+	    stream->crc = crc32c(stream->crc, p, n);
+	    p += n;
+	    if ((stream->remaining -= n) == 0)
+		stream->state = VERIFY_TRAILER;
+	    break;
+	}
+	case VERIFY_TRAILER :
+	{
+	    int n = sizeof(uint32_t) - stream->have;
+	    uint32_t crc, id;
+	    if (n > (end - p))
+		n = end - p;
+	    memcpy(&stream->trailer[stream->have], p, n);
+	    p += n;
+	    if ((stream->have += n) < (int) sizeof(uint32_t))
+		break;
+	    memcpy(&crc, stream->trailer, sizeof(crc));
+	    memcpy(&id, &stream->hdr[offsetof(verify_hdr, id)], sizeof(id));
+	    id = ntohl(id);
+	    (*blocks)++;
+	    if ((ntohl(crc) != stream->crc) || (id != stream->id))
+		(*corrupt)++;
+	    // follow the sender's ids, a bad one counts once
+	    stream->id = id + 1;
+	    stream->have = 0;
+	    stream->state = VERIFY_HDR;
+	    break;
+	}
+	}
+    }
+}
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
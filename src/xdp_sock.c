@@ -0,0 +1,414 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2020
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ * ________________________________________________________________
+ *
+ * xdp_sock.c
+ * AF_XDP socket engine (--xdp)
+ *
+ * The rings follow the kernel's AF_XDP layout, the producer and
+ * consumer indexes are free running and masked on use.  A receive
+ * socket hands every UMEM frame to the fill ring up front and
+ * returns each one after it's read.  A transmit socket keeps its
+ * frames on a free list, refilled from the completion ring.
+ *
+ * There's no libbpf, the redirect program is a handful of eBPF
+ * instructions loaded with bpf(2) and attached by a bpf link, so
+ * it goes away with the socket.
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "xdp_sock.h"
+#include "tx_ring.h"
+#include "util.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef HAVE_AF_XDP
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <net/if.h>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+
+#define XDP_INSN(c, d, s, o, i) ((struct bpf_insn) { .code = (c), .dst_reg = (d), .src_reg = (s), .off = (o), .imm = (i) })
+#define XDP_PROG_MAX 40
+
+static inline uint32_t xdp_sock_load_acquire (uint32_t *index) {
+    return __atomic_load_n(index, __ATOMIC_ACQUIRE);
+}
+
+static inline void xdp_sock_store_release (uint32_t *index, uint32_t value) {
+    __atomic_store_n(index, value, __ATOMIC_RELEASE);
+}
+
+static int xdp_sock_bpf (int cmd, union bpf_attr *attr) {
+    return (int) syscall(__NR_bpf, cmd, attr, sizeof(union bpf_attr));
+}
+
+static int xdp_sock_map_ring (xdp_sock *xs, xdp_sock_ring *ring, struct xdp_ring_offset *off, size_t descsize, off_t pgoff) {
+    ring->maplen = off->desc + (XDP_SOCK_FRAMES * descsize);
+    ring->map = mmap(NULL, ring->maplen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, xs->sock, pgoff);
+    if (ring->map == MAP_FAILED) {
+	ring->map = NULL;
+	return -1;
+    }
+    ring->producer = (uint32_t *) ((char *) ring->map + off->producer);
+    ring->consumer = (uint32_t *) ((char *) ring->map + off->consumer);
+    ring->descs = (char *) ring->map + off->desc;
+    ring->mask = XDP_SOCK_FRAMES - 1;
+    return 0;
+}
+
+int xdp_sock_open (xdp_sock *xs, const char *ifname, int queue, int rx) {
+    struct xdp_umem_reg umemreg;
+    struct xdp_mmap_offsets off;
+    struct sockaddr_xdp sxdp;
+    socklen_t optlen = sizeof(off);
+    int ringsize = XDP_SOCK_FRAMES;
+    int rc;
+
+    memset(xs, 0, sizeof(xdp_sock));
+    xs->mapfd = xs->progfd = xs->linkfd = -1;
+    xs->queue = queue;
+    xs->sock = socket(AF_XDP, SOCK_RAW, 0);
+    WARN_errno(xs->sock == INVALID_SOCKET, "xdp socket (AF_XDP)");
+    if (xs->sock == INVALID_SOCKET)
+	return -1;
+    xs->umemlen = (size_t) XDP_SOCK_FRAMES * XDP_SOCK_FRAMESIZE;
+    xs->umem = (unsigned char *) mmap(NULL, xs->umemlen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (xs->umem == MAP_FAILED) {
+	xs->umem = NULL;
+	WARN_errno(1, "xdp umem mmap");
+	goto fail;
+    }
+    memset(&umemreg, 0, sizeof(umemreg));
+    umemreg.addr = (uintptr_t) xs->umem;
+    umemreg.len = xs->umemlen;
+    umemreg.chunk_size = XDP_SOCK_FRAMESIZE;
+    rc = setsockopt(xs->sock, SOL_XDP, XDP_UMEM_REG, &umemreg, sizeof(umemreg));
+    WARN_errno(rc < 0, "xdp XDP_UMEM_REG");
+    if (rc < 0)
+	goto fail;
+    // the kernel wants both UMEM rings even for one direction
+    if ((setsockopt(xs->sock, SOL_XDP, XDP_UMEM_FILL_RING, &ringsize, sizeof(ringsize)) < 0) || \
+	(setsockopt(xs->sock, SOL_XDP, XDP_UMEM_COMPLETION_RING, &ringsize, sizeof(ringsize)) < 0) || \
+	(setsockopt(xs->sock, SOL_XDP, (rx ? XDP_RX_RING : XDP_TX_RING), &ringsize, sizeof(ringsize)) < 0)) {
+	WARN_errno(1, "xdp ring size");
+	goto fail;
+    }
+    rc = getsockopt(xs->sock, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen);
+    WARN_errno(rc < 0, "xdp XDP_MMAP_OFFSETS");
+    if (rc < 0)
+	goto fail;
+    if ((xdp_sock_map_ring(xs, &xs->fill, &off.fr, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING) < 0) || \
+	(xdp_sock_map_ring(xs, &xs->comp, &off.cr, sizeof(uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING) < 0) || \
+	(rx && (xdp_sock_map_ring(xs, &xs->rx, &off.rx, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING) < 0)) || \
+	(!rx && (xdp_sock_map_ring(xs, &xs->tx, &off.tx, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING) < 0))) {
+	WARN_errno(1, "xdp ring mmap");
+	goto fail;
+    }
+    if (rx) {
+	// every frame starts out with the kernel
+	uint64_t *addrs = (uint64_t *) xs->fill.descs;
+	for (int ix = 0; ix < XDP_SOCK_FRAMES; ix++)
+	    addrs[ix] = (uint64_t) ix * XDP_SOCK_FRAMESIZE;
+	xs->fill.cached = XDP_SOCK_FRAMES;
+	xdp_sock_store_release(xs->fill.producer, xs->fill.cached);
+    } else {
+	xs->txfree = (uint64_t *) malloc(XDP_SOCK_FRAMES * sizeof(uint64_t));
+	if (!xs->txfree)
+	    goto fail;
+	for (int ix = 0; ix < XDP_SOCK_FRAMES; ix++)
+	    xs->txfree[ix] = (uint64_t) ix * XDP_SOCK_FRAMESIZE;
+	xs->ntxfree = XDP_SOCK_FRAMES;
+    }
+    memset(&sxdp, 0, sizeof(sxdp));
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = if_nametoindex(ifname);
+    sxdp.sxdp_queue_id = queue;
+    rc = bind(xs->sock, (struct sockaddr *) &sxdp, sizeof(sxdp));
+    WARN_errno(rc < 0, "xdp bind");
+    if (rc < 0)
+	goto fail;
+    return 0;
+
+  fail:
+    xdp_sock_close(xs);
+    return -1;
+}
+
+void xdp_sock_close (xdp_sock *xs) {
+    xdp_sock_ring *rings[] = {&xs->fill, &xs->comp, &xs->rx, &xs->tx};
+    // the link detaches the program
+    if (xs->linkfd >= 0)
+	close(xs->linkfd);
+    if (xs->progfd >= 0)
+	close(xs->progfd);
+    if (xs->mapfd >= 0)
+	close(xs->mapfd);
+    xs->mapfd = xs->progfd = xs->linkfd = -1;
+    for (unsigned int ix = 0; ix < (sizeof(rings) / sizeof(rings[0])); ix++) {
+	if (rings[ix]->map)
+	    munmap(rings[ix]->map, rings[ix]->maplen);
+	rings[ix]->map = NULL;
+    }
+    if (xs->sock != INVALID_SOCKET)
+	close(xs->sock);
+    xs->sock = INVALID_SOCKET;
+    if (xs->umem)
+	munmap(xs->umem, xs->umemlen);
+    xs->umem = NULL;
+    if (xs->txfree)
+	free(xs->txfree);
+    xs->txfree = NULL;
+}
+
+/*
+ * Load the redirect program, the flow's IPv4/UDP datagrams (no IP
+ * options, no fragments) arriving on the socket's queue go to the
+ * socket, anything else on to the stack.  Tries native XDP first.
+ */
+int xdp_sock_attach (xdp_sock *xs, const char *ifname, const struct sockaddr_in *local, const struct sockaddr_in *peer) {
+    struct bpf_insn prog[XDP_PROG_MAX];
+    int topass[XDP_PROG_MAX];
+    int n = 0, npass = 0, ldmap;
+    union bpf_attr attr;
+    uint32_t key = xs->queue;
+    uint32_t value = xs->sock;
+    char license[] = "Dual BSD/GPL";
+    struct {
+	int off;
+	int size;
+	uint32_t mask;
+	uint32_t match;
+    } checks[] = {
+	{12, BPF_H, 0, (uint16_t) htons(ETH_P_IP)},
+	{14, BPF_B, 0, 0x45},
+	{20, BPF_H, (uint16_t) htons(0x3FFF), 0},	// MF and fragment offset
+	{23, BPF_B, 0, IPPROTO_UDP},
+	{26, BPF_W, 0, peer->sin_addr.s_addr},
+	{30, BPF_W, 0, local->sin_addr.s_addr},
+	{34, BPF_H, 0, peer->sin_port},
+	{36, BPF_H, 0, local->sin_port}
+    };
+
+    // r6 = ctx, r2 = data, r3 = data_end, all of the headers present
+    prog[n++] = XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0);
+    prog[n++] = XDP_INSN(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, offsetof(struct xdp_md, data), 0);
+    prog[n++] = XDP_INSN(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_6, offsetof(struct xdp_md, data_end), 0);
+    prog[n++] = XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0);
+    prog[n++] = XDP_INSN(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, TXRING_UDP4_PAYLOAD);
+    topass[npass++] = n;
+    prog[n++] = XDP_INSN(BPF_JMP | BPF_JGT | BPF_X, BPF_REG_4, BPF_REG_3, 0, 0);
+    // header fields as loaded, i.e. in network order, 32 bit compares
+    for (unsigned int ix = 0; ix < (sizeof(checks) / sizeof(checks[0])); ix++) {
+	prog[n++] = XDP_INSN(BPF_LDX | BPF_MEM | checks[ix].size, BPF_REG_5, BPF_REG_2, checks[ix].off, 0);
+	if (checks[ix].mask)
+	    prog[n++] = XDP_INSN(BPF_ALU | BPF_AND | BPF_K, BPF_REG_5, 0, 0, (int32_t) checks[ix].mask);
+	topass[npass++] = n;
+	prog[n++] = XDP_INSN(BPF_JMP32 | BPF_JNE | BPF_K, BPF_REG_5, 0, 0, (int32_t) checks[ix].match);
+    }
+    // bpf_redirect_map(map, rx_queue_index, XDP_PASS), no socket on
+    // that queue passes the frame
+    prog[n++] = XDP_INSN(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, offsetof(struct xdp_md, rx_queue_index), 0);
+    ldmap = n;
+    prog[n++] = XDP_INSN(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, 0);
+    prog[n++] = XDP_INSN(0, 0, 0, 0, 0);
+    prog[n++] = XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS);
+    prog[n++] = XDP_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map);
+    prog[n++] = XDP_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+    for (int ix = 0; ix < npass; ix++)
+	prog[topass[ix]].off = n - (topass[ix] + 1);
+    prog[n++] = XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS);
+    prog[n++] = XDP_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(key);
+    attr.value_size = sizeof(value);
+    attr.max_entries = xs->queue + 1;
+    xs->mapfd = xdp_sock_bpf(BPF_MAP_CREATE, &attr);
+    WARN_errno(xs->mapfd < 0, "xdp map create");
+    if (xs->mapfd < 0)
+	return -1;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = xs->mapfd;
+    attr.key = (uintptr_t) &key;
+    attr.value = (uintptr_t) &value;
+    if (xdp_sock_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0) {
+	WARN_errno(1, "xdp map update");
+	return -1;
+    }
+    prog[ldmap].imm = xs->mapfd;
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = (uintptr_t) prog;
+    attr.insn_cnt = n;
+    attr.license = (uintptr_t) license;
+    xs->progfd = xdp_sock_bpf(BPF_PROG_LOAD, &attr);
+    WARN_errno(xs->progfd < 0, "xdp program load");
+    if (xs->progfd < 0)
+	return -1;
+    for (xs->skbmode = 0; xs->skbmode < 2; xs->skbmode++) {
+	memset(&attr, 0, sizeof(attr));
+	attr.link_create.prog_fd = xs->progfd;
+	attr.link_create.target_ifindex = if_nametoindex(ifname);
+	attr.link_create.attach_type = BPF_XDP;
+	attr.link_create.flags = (xs->skbmode ? XDP_FLAGS_SKB_MODE : XDP_FLAGS_DRV_MODE);
+	if ((xs->linkfd = xdp_sock_bpf(BPF_LINK_CREATE, &attr)) >= 0)
+	    return 0;
+    }
+    xs->skbmode = 0;
+    WARN_errno(1, "xdp attach");
+    return -1;
+}
+
+/*
+ * Wait for received frames, or for transmit room, returns poll()'s
+ */
+int xdp_sock_wait (xdp_sock *xs, int msecs) {
+    struct pollfd pfd;
+    pfd.fd = xs->sock;
+    pfd.events = (xs->rx.map ? POLLIN : POLLOUT);
+    pfd.revents = 0;
+    return poll(&pfd, 1, msecs);
+}
+
+/*
+ * The number of received frames ready, up to max
+ */
+int xdp_sock_rx_peek (xdp_sock *xs, int max) {
+    uint32_t ready = xdp_sock_load_acquire(xs->rx.producer) - xs->rx.cached;
+    return (((int) ready < max) ? (int) ready : max);
+}
+
+unsigned char *xdp_sock_rx_frame (xdp_sock *xs, int ix, int *len) {
+    struct xdp_desc *desc = &((struct xdp_desc *) xs->rx.descs)[(xs->rx.cached + ix) & xs->rx.mask];
+    *len = desc->len;
+    return (xs->umem + desc->addr);
+}
+
+/*
+ * Done with n received frames, the kernel gets their UMEM frames back
+ */
+void xdp_sock_rx_release (xdp_sock *xs, int n) {
+    uint64_t *fill = (uint64_t *) xs->fill.descs;
+    for (int ix = 0; ix < n; ix++) {
+	struct xdp_desc *desc = &((struct xdp_desc *) xs->rx.descs)[(xs->rx.cached + ix) & xs->rx.mask];
+	// back to the start of the chunk
+	fill[(xs->fill.cached + ix) & xs->fill.mask] = desc->addr & ~((uint64_t) XDP_SOCK_FRAMESIZE - 1);
+    }
+    xs->fill.cached += n;
+    xs->rx.cached += n;
+    xs->frames += n;
+    xdp_sock_store_release(xs->fill.producer, xs->fill.cached);
+    xdp_sock_store_release(xs->rx.consumer, xs->rx.cached);
+}
+
+void xdp_sock_tx_template (xdp_sock *xs, const unsigned char *frame, int framelen) {
+    xs->framelen = framelen;
+    for (int ix = 0; ix < xs->ntxfree; ix++)
+	memcpy(xs->umem + xs->txfree[ix], frame, framelen);
+}
+
+// free the frames the kernel is through with
+static void xdp_sock_tx_reclaim (xdp_sock *xs) {
+    uint32_t done = xdp_sock_load_acquire(xs->comp.producer) - xs->comp.cached;
+    uint64_t *comp = (uint64_t *) xs->comp.descs;
+    for (uint32_t ix = 0; ix < done; ix++)
+	xs->txfree[xs->ntxfree++] = comp[(xs->comp.cached + ix) & xs->comp.mask];
+    xs->comp.cached += done;
+    xdp_sock_store_release(xs->comp.consumer, xs->comp.cached);
+}
+
+/*
+ * UDP payload of the next free frame, NULL while all are in flight
+ */
+unsigned char *xdp_sock_tx_next (xdp_sock *xs) {
+    if (!xs->ntxfree) {
+	xdp_sock_tx_reclaim(xs);
+	if (!xs->ntxfree)
+	    return NULL;
+    }
+    return (xs->umem + xs->txfree[xs->ntxfree - 1] + TXRING_UDP4_PAYLOAD);
+}
+
+void xdp_sock_tx_queue (xdp_sock *xs) {
+    struct xdp_desc *desc = &((struct xdp_desc *) xs->tx.descs)[xs->tx.cached & xs->tx.mask];
+    desc->addr = xs->txfree[--xs->ntxfree];
+    desc->len = xs->framelen;
+    desc->options = 0;
+    xs->tx.cached++;
+    xs->frames++;
+}
+
+/*
+ * Publish the queued frames and have the kernel send them
+ */
+int xdp_sock_kick (xdp_sock *xs) {
+    xdp_sock_store_release(xs->tx.producer, xs->tx.cached);
+    xs->kicks++;
+    return (int) sendto(xs->sock, NULL, 0, MSG_DONTWAIT, NULL, 0);
+}
+
+/*
+ * Wait for every queued frame to complete, returns those still out
+ */
+int xdp_sock_tx_drain (xdp_sock *xs, int msecs) {
+    while (1) {
+	xdp_sock_tx_reclaim(xs);
+	if (xs->ntxfree == XDP_SOCK_FRAMES)
+	    return 0;
+	if (msecs-- <= 0)
+	    return (XDP_SOCK_FRAMES - xs->ntxfree);
+	xdp_sock_kick(xs);
+	xdp_sock_wait(xs, 1);
+    }
+}
+#endif // HAVE_AF_XDP
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif